@@ -66,6 +66,45 @@ void healpix_get_boundaries(int nside, int pix, double out[4][3]);
  */
 void healpix_get_bounding_cap(int nside, int pix, double out[4]);
 
+/*
+ * Function: healpix_query_disc
+ * Find the healpix nest pixels intersecting a disc.
+ *
+ * The result is inclusive: all the pixels overlapping the disc are
+ * returned, but a few pixels close to the border might not actually touch
+ * it.
+ *
+ * Parameters:
+ *   order  - Order of the returned pixels (up to 13).
+ *   cap    - The disc, as a cap (normalized direction and cosine of the
+ *            angular radius).
+ *   ranges - Receive a newly allocated array of [start, end) pixel ranges,
+ *            sorted and non contiguous.  Should be freed by the caller.
+ *
+ * Return:
+ *   The number of ranges.
+ */
+int healpix_query_disc(int order, const double cap[4], int **ranges);
+
+/*
+ * Function: healpix_query_polygon
+ * Find the healpix nest pixels intersecting a convex polygon.
+ *
+ * Same as <healpix_query_disc>, but for a convex spherical polygon whose
+ * edges are great circle arcs.
+ *
+ * Parameters:
+ *   order  - Order of the returned pixels (up to 13).
+ *   n      - Number of vertices (at least three).
+ *   verts  - Normalized vertices, in clockwise or counter clockwise order.
+ *   ranges - Receive a newly allocated array of [start, end) pixel ranges.
+ *
+ * Return:
+ *   The number of ranges.
+ */
+int healpix_query_polygon(int order, int n, const double (*verts)[3],
+                          int **ranges);
+
 /* Compute moon position.
  *
  * inputs:
@@ -237,6 +276,51 @@ int orbit_compute_pv(
         double od,        // variation of o in time (rad/day).
         double wd);       // variation of w in time (rad/day).
 
+/*
+ * Type: orbit_elements_t
+ * Keplerian orbit elements, as used by <orbit_compute_pv_batch>.
+ *
+ * Attributes:
+ *   d      - Epoch of the mean anomaly (MJD).
+ *   i      - Inclination (rad).
+ *   o      - Longitude of the Ascending Node (rad).
+ *   w      - Argument of Perihelion (rad).
+ *   q      - Perihelion distance (AU).
+ *   e      - Eccentricity.
+ *   n      - Mean motion (rad/day).  If set to zero, it is computed from
+ *            q and e for an heliocentric orbit.
+ *   ma     - Mean Anomaly at the epoch (rad).  For parabolic orbits this
+ *            should be zero, with d set to the time of perihelion.
+ */
+typedef struct {
+    double d;
+    double i;
+    double o;
+    double w;
+    double q;
+    double e;
+    double n;
+    double ma;
+} orbit_elements_t;
+
+/*
+ * Function: orbit_compute_pv_batch
+ * Compute the positions and speeds of many bodies at a given time.
+ *
+ * Contrary to <orbit_compute_pv>, this supports elliptic, parabolic and
+ * hyperbolic orbits, and always solves the Kepler equation to full
+ * precision, using a fixed number of iterations.
+ *
+ * Parameters:
+ *   nb     - Number of bodies.
+ *   elems  - Orbit elements of each body.
+ *   mjd    - Time of the positions (MJD).
+ *   pos    - Get the computed positions (AU).
+ *   speed  - Get the computed speeds (AU/day).  Can be NULL.
+ */
+void orbit_compute_pv_batch(int nb, const orbit_elements_t *elems,
+                            double mjd, double (*pos)[3], double (*speed)[3]);
+
 /*
  * Function: orbit_elements_from_pv
  * Compute Kepler orbit element from a body positon and speed.
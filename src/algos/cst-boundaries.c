@@ -2359,3 +2359,29 @@ int find_constellation_at(const double pos[3], char id[5])
     memcpy(id, "???", 4);
     return -1;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "swe.h"
+
+static int bench_find_constellation_at(void)
+{
+    const int N = 1000;
+    double pos[3], z, r, a;
+    char id[5];
+    int i;
+    for (i = 0; i < N; i++) {
+        z = 1 - 2 * (i + 0.5) / N;
+        r = sqrt(1 - z * z);
+        a = i * 2.399963;
+        vec3_set(pos, r * cos(a), r * sin(a), z);
+        bench_keep(find_constellation_at(pos, id));
+    }
+    return N;
+}
+
+BENCH_REGISTER(NULL, bench_find_constellation_at)
+
+#endif
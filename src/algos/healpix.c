@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
 #include "utils/vec.h"
 
 // Some of the code comes from the official healpix C implementation.
@@ -326,3 +327,220 @@ void healpix_get_bounding_cap(int nside, int pix, double out[4])
             out[3] = d;
     }
 }
+
+/*
+ * Range queries.
+ *
+ * We go down the nested hierarchy, starting from the twelve base pixels,
+ * and test the bounding cap of each pixel against the shape.  A pixel fully
+ * inside the shape gives a full range of pixels at the final order, a
+ * pixel outside is skipped, and for the others we test the four children.
+ * Since we visit the pixels in nested order the ranges are sorted, and we
+ * merge the contiguous ones.
+ */
+
+enum {
+    SHAPE_OUTSIDE = 0,
+    SHAPE_INTERSECT,
+    SHAPE_INSIDE,
+};
+
+typedef struct {
+    int (*test)(const void *shape, const double cap[4]);
+    const void *shape;
+    int order;
+    int *ranges;
+    int nb;
+    int allocated;
+} query_t;
+
+static void query_add_range(query_t *q, int start, int end)
+{
+    if (q->nb && q->ranges[q->nb * 2 - 1] == start) {
+        q->ranges[q->nb * 2 - 1] = end;
+        return;
+    }
+    if (q->nb >= q->allocated) {
+        q->allocated = q->allocated ? q->allocated * 2 : 64;
+        q->ranges = realloc(q->ranges, q->allocated * 2 * sizeof(int));
+    }
+    q->ranges[q->nb * 2 + 0] = start;
+    q->ranges[q->nb * 2 + 1] = end;
+    q->nb++;
+}
+
+static void query_rec(query_t *q, int order, int pix)
+{
+    double cap[4];
+    int r, i, shift;
+
+    healpix_get_bounding_cap(1 << order, pix, cap);
+    r = q->test(q->shape, cap);
+    if (r == SHAPE_OUTSIDE) return;
+    if (r == SHAPE_INSIDE || order == q->order) {
+        shift = 2 * (q->order - order);
+        query_add_range(q, pix << shift, (pix + 1) << shift);
+        return;
+    }
+    for (i = 0; i < 4; i++) query_rec(q, order + 1, pix * 4 + i);
+}
+
+static int query(query_t *q, int **ranges)
+{
+    int i;
+    assert(q->order >= 0 && q->order <= 13);
+    for (i = 0; i < 12; i++) query_rec(q, 0, i);
+    *ranges = q->ranges;
+    return q->nb;
+}
+
+static int disc_test(const void *shape, const double cap[4])
+{
+    const double *disc = shape;
+    if (!cap_intersects_cap(disc, cap)) return SHAPE_OUTSIDE;
+    if (cap_contains_cap(disc, cap)) return SHAPE_INSIDE;
+    return SHAPE_INTERSECT;
+}
+
+int healpix_query_disc(int order, const double cap[4], int **ranges)
+{
+    query_t q = {.test = disc_test, .shape = cap, .order = order};
+    return query(&q, ranges);
+}
+
+typedef struct {
+    int n;
+    double (*planes)[4]; // Half spaces as caps of cos zero.
+} polygon_t;
+
+static int polygon_test(const void *shape, const double cap[4])
+{
+    const polygon_t *poly = shape;
+    int i;
+    bool inside = true;
+    for (i = 0; i < poly->n; i++) {
+        if (!cap_intersects_cap(poly->planes[i], cap)) return SHAPE_OUTSIDE;
+        if (inside && !cap_contains_cap(poly->planes[i], cap))
+            inside = false;
+    }
+    return inside ? SHAPE_INSIDE : SHAPE_INTERSECT;
+}
+
+int healpix_query_polygon(int order, int n, const double (*verts)[3],
+                          int **ranges)
+{
+    int i;
+    double planes[n][4];
+    polygon_t poly = {.n = n, .planes = planes};
+    query_t q = {.test = polygon_test, .shape = &poly, .order = order};
+
+    assert(n >= 3);
+    for (i = 0; i < n; i++) {
+        vec3_cross(verts[i], verts[(i + 1) % n], planes[i]);
+        vec3_normalize(planes[i], planes[i]);
+        planes[i][3] = 0;
+    }
+    // Make sure the planes normals point inside the polygon.
+    if (vec3_dot(planes[0], verts[2]) < 0) {
+        for (i = 0; i < n; i++) vec3_mul(-1, planes[i], planes[i]);
+    }
+    return query(&q, ranges);
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+#define BENCH_N 10000
+
+static double g_bench_pos[BENCH_N][2];
+
+static void bench_healpix_setup(void)
+{
+    int i;
+    // Fibonacci sphere, so that the points spread over all the faces.
+    for (i = 0; i < BENCH_N; i++) {
+        g_bench_pos[i][0] = acos(1 - 2 * (i + 0.5) / BENCH_N);
+        g_bench_pos[i][1] = fmod(i * 2.399963, 2 * M_PI);
+    }
+}
+
+static int bench_healpix_ang2pix(void)
+{
+    int i, pix;
+    for (i = 0; i < BENCH_N; i++) {
+        healpix_ang2pix(1 << 8, g_bench_pos[i][0], g_bench_pos[i][1], &pix);
+        bench_keep(pix);
+    }
+    return BENCH_N;
+}
+
+BENCH_REGISTER(bench_healpix_setup, bench_healpix_ang2pix)
+
+static bool ranges_contain(const int *ranges, int nb, int pix)
+{
+    int i;
+    for (i = 0; i < nb; i++) {
+        if (pix >= ranges[i * 2] && pix < ranges[i * 2 + 1]) return true;
+    }
+    return false;
+}
+
+static void test_healpix_query(void)
+{
+    const int order = 5, nside = 1 << order;
+    int i, j, nb, pix, count;
+    int *ranges;
+    double cap[4] = {1, 0, 0, cos(10 * M_PI / 180)};
+    double v[3];
+    double verts[4][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+    // Full sky.
+    nb = healpix_query_disc(order, (double[4]){0, 0, 1, -1}, &ranges);
+    assert(nb == 1 && ranges[0] == 0 && ranges[1] == 12 * nside * nside);
+    free(ranges);
+
+    // All the pixels with a center inside the disc must be returned.
+    nb = healpix_query_disc(order, cap, &ranges);
+    count = 0;
+    for (i = 0; i < nb; i++) {
+        assert(ranges[i * 2] < ranges[i * 2 + 1]);
+        if (i) assert(ranges[i * 2] > ranges[i * 2 - 1]);
+        count += ranges[i * 2 + 1] - ranges[i * 2];
+    }
+    for (pix = 0; pix < 12 * nside * nside; pix++) {
+        healpix_pix2vec(nside, pix, v);
+        if (vec3_dot(v, cap) >= cap[3])
+            assert(ranges_contain(ranges, nb, pix));
+    }
+    // The disc covers about 0.76% of the sky.
+    assert(count > 0.0076 * 12 * nside * nside);
+    assert(count < 0.0076 * 12 * nside * nside * 2);
+    free(ranges);
+
+    // Octant triangle, in both orientations.
+    for (i = 0; i < 2; i++) {
+        if (i == 1) {
+            vec3_copy(verts[0], verts[3]);
+            vec3_copy(verts[2], verts[0]);
+            vec3_copy(verts[3], verts[2]);
+        }
+        nb = healpix_query_polygon(order, 3, verts, &ranges);
+        count = 0;
+        for (pix = 0; pix < 12 * nside * nside; pix++) {
+            healpix_pix2vec(nside, pix, v);
+            if (v[0] > 0 && v[1] > 0 && v[2] > 0)
+                assert(ranges_contain(ranges, nb, pix));
+        }
+        for (j = 0; j < nb; j++) count += ranges[j * 2 + 1] - ranges[j * 2];
+        assert(count >= 12 * nside * nside / 8);
+        assert(count < 12 * nside * nside / 8 * 1.5);
+        free(ranges);
+    }
+}
+
+TEST_REGISTER(NULL, test_healpix_query, TEST_AUTO);
+
+#endif
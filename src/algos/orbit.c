@@ -7,7 +7,11 @@
  * repository.
  */
 
+#include "algos.h"
+
 #include <math.h>
+#include <string.h>
+
 #define PI (3.141592653589793238462643)
 
 static void vec3_cross(const double a[3], const double b[3], double out[3])
@@ -125,6 +129,296 @@ int orbit_compute_pv(
     return 0;
 }
 
+/*
+ * Batch orbit propagation.
+ *
+ * The bodies are processed by blocks.  In each block we split the orbits
+ * into elliptic, near-parabolic and hyperbolic groups, stored as structure
+ * of arrays.  Each group is solved with a fixed number of iterations, with
+ * the loop over the bodies innermost and no data dependent exit, so that
+ * the compiler can vectorize it.  All the solvers return the position and
+ * speed in the orbit plane (x toward the perihelion), that are then
+ * rotated into the ecliptic frame.
+ */
+
+#define GAUSS_K 0.01720209895 // Gaussian gravitational constant.
+#define BATCH_SIZE 64
+
+// Eccentricity range around 1 where we use the universal variable solver.
+#define NEAR_PARABOLIC 0.02
+
+typedef struct {
+    int     nb;
+    int     idx[BATCH_SIZE];    // Index of the body in the block.
+    double  m[BATCH_SIZE];      // Mean anomaly, or time from perihelion.
+    double  e[BATCH_SIZE];      // Eccentricity.
+    double  a[BATCH_SIZE];      // |Semi major axis|, or perihelion dist.
+    double  n[BATCH_SIZE];      // Mean motion, or μ.
+    double  x[BATCH_SIZE];      // Output position in the orbit plane.
+    double  y[BATCH_SIZE];
+    double  vx[BATCH_SIZE];     // Output speed in the orbit plane.
+    double  vy[BATCH_SIZE];
+} orbit_group_t;
+
+/*
+ * Elliptic orbits: solve M = E - e sin(E) with Danby's quartic iteration.
+ * The starting guess from Danby (1987) converges to full precision in four
+ * iterations for all e < 1 - NEAR_PARABOLIC.
+ */
+static void solve_elliptic(orbit_group_t *g)
+{
+    int k, iter;
+    double ea[BATCH_SIZE], m[BATCH_SIZE];
+    double se, ce, f, f1, d1, d2, b, r;
+
+    for (k = 0; k < g->nb; k++) {
+        m[k] = remainder(g->m[k], 2 * PI);
+        ea[k] = m[k] + copysign(0.85 * g->e[k], m[k]);
+    }
+    for (iter = 0; iter < 4; iter++) {
+        for (k = 0; k < g->nb; k++) {
+            se = g->e[k] * sin(ea[k]);
+            ce = g->e[k] * cos(ea[k]);
+            f = ea[k] - se - m[k];
+            f1 = 1 - ce;
+            d1 = -f / f1;
+            d2 = -f / (f1 + d1 * se / 2);
+            ea[k] += -f / (f1 + d2 * se / 2 + d2 * d2 * ce / 6);
+        }
+    }
+    for (k = 0; k < g->nb; k++) {
+        b = sqrt(1 - g->e[k] * g->e[k]);
+        r = 1 - g->e[k] * cos(ea[k]);
+        g->x[k] = g->a[k] * (cos(ea[k]) - g->e[k]);
+        g->y[k] = g->a[k] * b * sin(ea[k]);
+        g->vx[k] = -g->a[k] * g->n[k] * sin(ea[k]) / r;
+        g->vy[k] = g->a[k] * g->n[k] * b * cos(ea[k]) / r;
+    }
+}
+
+/*
+ * Hyperbolic orbits: solve M = e sinh(H) - H with the same quartic
+ * iteration.  The starting guess is from Danby, and converges in six
+ * iterations for all the mean anomaly range we care about.
+ */
+static void solve_hyperbolic(orbit_group_t *g)
+{
+    int k, iter;
+    double h[BATCH_SIZE];
+    double sh, ch, f, f1, d1, d2, b, r;
+
+    for (k = 0; k < g->nb; k++)
+        h[k] = copysign(log(2 * fabs(g->m[k]) / g->e[k] + 1.8), g->m[k]);
+    for (iter = 0; iter < 6; iter++) {
+        for (k = 0; k < g->nb; k++) {
+            sh = g->e[k] * sinh(h[k]);
+            ch = g->e[k] * cosh(h[k]);
+            f = sh - h[k] - g->m[k];
+            f1 = ch - 1;
+            d1 = -f / f1;
+            d2 = -f / (f1 + d1 * sh / 2);
+            h[k] += -f / (f1 + d2 * sh / 2 + d2 * d2 * ch / 6);
+        }
+    }
+    for (k = 0; k < g->nb; k++) {
+        b = sqrt(g->e[k] * g->e[k] - 1);
+        r = g->e[k] * cosh(h[k]) - 1;
+        g->x[k] = g->a[k] * (g->e[k] - cosh(h[k]));
+        g->y[k] = g->a[k] * b * sinh(h[k]);
+        g->vx[k] = -g->a[k] * g->n[k] * sinh(h[k]) / r;
+        g->vy[k] = g->a[k] * g->n[k] * b * cosh(h[k]) / r;
+    }
+}
+
+/*
+ * Stumpff functions c0, c1, c2 and c3 of z.
+ * We use the series for small values of z to avoid cancellation errors.
+ */
+static void stumpff(double z, double c[4])
+{
+    int k;
+    double sz, t2, t3;
+    if (fabs(z) < 1.0) {
+        // Horner evaluation of the series, 12 terms are enough for |z| < 1.
+        t2 = t3 = 1;
+        for (k = 11; k >= 0; k--) {
+            t2 = 1 - z / ((2 * k + 3) * (2 * k + 4)) * t2;
+            t3 = 1 - z / ((2 * k + 4) * (2 * k + 5)) * t3;
+        }
+        c[2] = t2 / 2;
+        c[3] = t3 / 6;
+        c[0] = 1 - z * c[2];
+        c[1] = 1 - z * c[3];
+    } else if (z > 0) {
+        sz = sqrt(z);
+        c[0] = cos(sz);
+        c[1] = sin(sz) / sz;
+        c[2] = (1 - c[0]) / z;
+        c[3] = (1 - c[1]) / z;
+    } else {
+        sz = sqrt(-z);
+        c[0] = cosh(sz);
+        c[1] = sinh(sz) / sz;
+        c[2] = (1 - c[0]) / z;
+        c[3] = (1 - c[1]) / z;
+    }
+}
+
+/*
+ * Near parabolic orbits: use the universal variable formulation starting
+ * from the perihelion:
+ *
+ *   t = q s c1(α s²) + μ s³ c3(α s²)     with α = μ (1 - e) / q
+ *
+ * The starting guess is the exact solution for a parabola (Barker's
+ * equation), or the eccentric anomaly starting guess when far from the
+ * perihelion.  It is then refined with a fixed number of Laguerre-Conway
+ * iterations.
+ *
+ * This group is usually very small (only some comets), so we don't try to
+ * make the loops vectorizable here.
+ */
+static void solve_near_parabolic(orbit_group_t *g)
+{
+    int k, iter;
+    double q, mu, e, alpha, s, c[4], f, f1, f2, r, x, v0, den, dt, m, sa;
+    const double ln = 5; // Laguerre-Conway order.
+
+    for (k = 0; k < g->nb; k++) {
+        q = g->a[k];
+        mu = g->n[k];
+        e = g->e[k];
+        dt = g->m[k];
+        alpha = mu * (1 - e) / q;
+        sa = sqrt(fabs(alpha));
+        // For elliptic orbits, only keep the time from the closest perihelion.
+        if (alpha > 0) dt = remainder(dt, 2 * PI * mu / (sa * sa * sa));
+        // Solve the parabola case: μ s³ / 6 + q s - t = 0.
+        x = 6 * q / mu;
+        s = 2 * sqrt(x / 3) * sinh(asinh(9 * dt / mu / x * sqrt(3 / x)) / 3);
+        // If we are far from the perihelion, use the same starting values
+        // as for the elliptic and hyperbolic solvers instead (s = E / √α).
+        if (fabs(alpha) * s * s > 1) {
+            m = sa * sa * sa / mu * dt; // Mean anomaly.
+            if (alpha > 0)
+                s = (m + copysign(0.85 * e, m)) / sa;
+            else
+                s = copysign(log(2 * fabs(m) / e + 1.8), m) / sa;
+        }
+        for (iter = 0; iter < 8; iter++) {
+            stumpff(alpha * s * s, c);
+            f = q * s * c[1] + mu * s * s * s * c[3] - dt;
+            f1 = q * c[0] + mu * s * s * c[2];
+            f2 = mu * e * s * c[1];
+            den = sqrt(fabs((ln - 1) * (ln - 1) * f1 * f1 -
+                            ln * (ln - 1) * f * f2));
+            s -= ln * f / (f1 + copysign(den, f1));
+        }
+        stumpff(alpha * s * s, c);
+        r = q * c[0] + mu * s * s * c[2];
+        v0 = sqrt(mu * (1 + e) / q); // Speed at perihelion.
+        g->x[k] = q - mu * s * s * c[2];
+        g->y[k] = v0 * q * s * c[1];
+        g->vx[k] = -mu * s * c[1] / r;
+        g->vy[k] = v0 * q * c[0] / r;
+    }
+}
+
+/*
+ * Function: orbit_compute_pv_batch
+ * Compute the positions and speeds of many bodies at a given time.
+ *
+ * This gives the same results as calling <orbit_compute_pv> with a small
+ * precision for each body, but also supports parabolic and hyperbolic
+ * orbits.
+ *
+ * Parameters:
+ *   nb     - Number of bodies.
+ *   elems  - Orbit elements of the bodies.
+ *   mjd    - Time of the positions (MJD).
+ *   pos    - Get the computed positions (AU).
+ *   speed  - Get the computed speeds (AU/day).  Can be NULL.
+ */
+void orbit_compute_pv_batch(int nb, const orbit_elements_t *elems,
+                            double mjd, double (*pos)[3], double (*speed)[3])
+{
+    enum {ELLIPTIC, NEAR_PARABOLIC_, HYPERBOLIC};
+    int start, size, k, j, g;
+    double a, n, mu, co, so, cw, sw, ci, si;
+    // Orbit plane unit vectors toward the perihelion and 90° ahead.
+    double px[3][BATCH_SIZE], py[3][BATCH_SIZE];
+    double x[BATCH_SIZE], y[BATCH_SIZE], vx[BATCH_SIZE], vy[BATCH_SIZE];
+    orbit_group_t groups[3], *group;
+    const orbit_elements_t *el;
+
+    for (start = 0; start < nb; start += BATCH_SIZE) {
+        size = nb - start < BATCH_SIZE ? nb - start : BATCH_SIZE;
+        el = elems + start;
+        for (g = 0; g < 3; g++) groups[g].nb = 0;
+
+        for (k = 0; k < size; k++) {
+            a = el[k].e != 1 ? el[k].q / (1 - el[k].e) : INFINITY;
+            n = el[k].n ?: GAUSS_K / sqrt(fabs(a * a * a));
+            if (el[k].e < 1 - NEAR_PARABOLIC) g = ELLIPTIC;
+            else if (el[k].e > 1 + NEAR_PARABOLIC) g = HYPERBOLIC;
+            else g = NEAR_PARABOLIC_;
+            group = &groups[g];
+            j = group->nb++;
+            group->idx[j] = k;
+            group->e[j] = el[k].e;
+            if (g == NEAR_PARABOLIC_) {
+                mu = el[k].n && el[k].e != 1 ? n * n * fabs(a * a * a) :
+                                               GAUSS_K * GAUSS_K;
+                group->m[j] = mjd - el[k].d + (el[k].n ? el[k].ma / n : 0);
+                group->a[j] = el[k].q;
+                group->n[j] = mu;
+            } else {
+                group->m[j] = el[k].ma + n * (mjd - el[k].d);
+                group->a[j] = fabs(a);
+                group->n[j] = n;
+            }
+        }
+
+        for (k = 0; k < size; k++) {
+            co = cos(el[k].o); so = sin(el[k].o);
+            cw = cos(el[k].w); sw = sin(el[k].w);
+            ci = cos(el[k].i); si = sin(el[k].i);
+            px[0][k] = co * cw - so * sw * ci;
+            px[1][k] = so * cw + co * sw * ci;
+            px[2][k] = sw * si;
+            py[0][k] = -co * sw - so * cw * ci;
+            py[1][k] = -so * sw + co * cw * ci;
+            py[2][k] = cw * si;
+        }
+
+        solve_elliptic(&groups[ELLIPTIC]);
+        solve_near_parabolic(&groups[NEAR_PARABOLIC_]);
+        solve_hyperbolic(&groups[HYPERBOLIC]);
+
+        for (g = 0; g < 3; g++) {
+            group = &groups[g];
+            for (j = 0; j < group->nb; j++) {
+                k = group->idx[j];
+                x[k] = group->x[j];
+                y[k] = group->y[j];
+                vx[k] = group->vx[j];
+                vy[k] = group->vy[j];
+            }
+        }
+
+        // Rotate from the orbit plane into the ecliptic.
+        for (k = 0; k < size; k++) {
+            for (j = 0; j < 3; j++)
+                pos[start + k][j] = x[k] * px[j][k] + y[k] * py[j][k];
+        }
+        if (!speed) continue;
+        for (k = 0; k < size; k++) {
+            for (j = 0; j < 3; j++)
+                speed[start + k][j] = vx[k] * px[j][k] + vy[k] * py[j][k];
+        }
+    }
+}
+
 /*
  * Function: orbit_elements_from_pv
  * Compute Kepler orbit element from a body positon and speed.
@@ -228,3 +522,30 @@ int orbit_elements_from_pv(const double p[3], const double v[3], double mu,
 
     return 0;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+static int bench_orbit_compute_pv(void)
+{
+    const int N = 10000;
+    double pos[3], speed[3];
+    int i;
+    const double d2r = M_PI / 180;
+    // Ceres orbit elements, over about 27 years.
+    for (i = 0; i < N; i++) {
+        orbit_compute_pv(0, 58000 + i, pos, speed,
+                         58600, 10.594 * d2r, 80.305 * d2r, 73.598 * d2r,
+                         2.7691, 0.21408 * d2r, 0.0760, 77.372 * d2r,
+                         0, 0);
+        bench_keep(pos[0]);
+    }
+    return N;
+}
+
+BENCH_REGISTER(NULL, bench_orbit_compute_pv)
+
+#endif
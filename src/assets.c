@@ -11,6 +11,8 @@
 #include <sys/stat.h>
 
 static const int DEFAULT_DELAY = 60;
+// Number of asset calls after which an asset is considered unused.
+static const int UNUSED_DELAY = 128;
 
 #ifdef __EMSCRIPTEN__
 static const bool HAS_FS = false;
@@ -196,11 +198,15 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code)
         if (asset->delay) {
             asset->delay--;
             assert(*code == 0 && *size == 0);
+            core_mark_dirty();
             return NULL;
         }
         asset->request = request_create(asset->url);
     }
     data = request_get_data(asset->request, size, code);
+    // Keep rendering until the data arrives.
+    if (!*code) core_mark_dirty();
+    if (*code && data) asset->size = *size;
     if (*code && data && (flags & ASSET_USED_ONCE))
         asset->flags |= CAN_RELEASE;
 
@@ -237,11 +243,60 @@ static void assets_update(void)
             continue;
         }
         if (asset->flags & STATIC) continue;
-        if (asset->last_used++ < 128) continue;
-        // XXX: to finish: delete unused assets.
+        // The unused assets are released by the memory budget, see
+        // assets_evict.
+        if (asset->last_used < UNUSED_DELAY) asset->last_used++;
     }
 }
 
+// Memory owned by an asset, that is released by asset_release_.  We ignore
+// the bundled assets, since their data can be used directly by the fonts.
+static int asset_mem_size(const asset_t *asset)
+{
+    if (asset->flags & STATIC) return 0;
+    if ((asset->flags & FREE_DATA) && asset->data) return asset->size;
+    if (asset->request) return asset->size;
+    return 0;
+}
+
+static int64_t assets_get_size(void *user)
+{
+    asset_t *asset;
+    int64_t size = 0;
+    for (asset = g_assets; asset; asset = asset->hh.next)
+        size += asset_mem_size(asset);
+    return size;
+}
+
+// Release the data of the assets that have not been used recently.
+static int64_t assets_evict(void *user, int64_t size)
+{
+    asset_t *asset, *tmp;
+    int64_t freed = 0;
+    HASH_ITER(hh, g_assets, asset, tmp) {
+        if (freed >= size) break;
+        if (asset->last_used < UNUSED_DELAY) continue;
+        if (!asset_mem_size(asset)) continue;
+        freed += asset_mem_size(asset);
+        asset_release_(asset);
+    }
+    return freed;
+}
+
+void assets_register_membudget(void)
+{
+    membudget_register("assets", MEMBUDGET_PRIORITY_NORMAL, NULL,
+                       assets_get_size, assets_evict);
+}
+
+const char *asset_get_etag(const char *url)
+{
+    asset_t *asset;
+    HASH_FIND_STR(g_assets, url, asset);
+    if (!asset || !asset->request) return NULL;
+    return request_get_etag(asset->request);
+}
+
 const char *asset_iter_(const char *base, void **i)
 {
     asset_t *asset = (*i);
@@ -85,6 +85,16 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code);
  */
 void asset_release(const char *url);
 
+/*
+ * Function: asset_get_etag
+ * Return the ETag of an online asset, if the server provided one.
+ *
+ * This can be used to identify a given version of an asset, for example
+ * to cache some data computed from it.  Returns NULL for bundled or local
+ * assets, or if the asset has not been requested yet.
+ */
+const char *asset_get_etag(const char *url);
+
 /*
  * Macro: ASSET_ITER
  * Iter all the asset url that start with a given prefix.
@@ -95,6 +105,14 @@ void asset_release(const char *url);
     for (void *i_ = NULL; (path_ = asset_iter_(base_, &i_)); )
 const char *asset_iter_(const char *base, void **i);
 
+/*
+ * Function: assets_register_membudget
+ * Register the assets data into the global memory budget.
+ *
+ * Called once by core_init.
+ */
+void assets_register_membudget(void);
+
 /*
  * Function: asset_register
  * Register a bundled asset with a given url
@@ -0,0 +1,477 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+/*
+ * Headless benchmark tool.
+ *
+ * Run the core update and render loop with the null renderer following a
+ * scenario file, and output a JSON report with the frame times, per module
+ * CPU times, number of allocations and number of loaded tiles.  This does
+ * not need a window or a GPU, so that it can run in CI.
+ *
+ * Usage:
+ *   swe-bench <scenario.json> [<report.json>]
+ *
+ * Scenario format (all the angles in degrees):
+ *
+ *   {
+ *     "width": 800, "height": 600,
+ *     "data_dir": "data/skydata",
+ *     "latitude": 43.6, "longitude": 1.44, "elevation": 150,
+ *     "utc": "2020-03-20T20:00:00",
+ *     "fov": 60, "projection": "stereographic",
+ *     "azimuth": 180, "altitude": 30,
+ *     "record": "/tmp/frames.bin",
+ *     "steps": [
+ *       {"type": "wait", "frames": 60},
+ *       {"type": "slew", "azimuth": 90, "altitude": 45, "frames": 120},
+ *       {"type": "zoom", "fov": 5, "frames": 60},
+ *       {"type": "timelapse", "speed": 3600, "frames": 120}
+ *     ]
+ *   }
+ *
+ * The simulation always uses a fixed time step of 1/60 sec per frame, so
+ * that the results only depend on the scenario.  Remote urls are mapped
+ * to files in the data directory, and never hit the network.
+ *
+ * If 'record' is set, all the render calls are also saved into a command
+ * log that can be replayed with <render_replay>.
+ */
+
+#include "swe.h"
+
+#include <time.h>
+
+#ifndef __EMSCRIPTEN__
+
+#define FRAME_DT (1.0 / 60)
+
+/*
+ * Allocations counting.
+ *
+ * The program is linked with --wrap=malloc,--wrap=calloc,--wrap=realloc so
+ * that all the allocations of the engine go through those functions.
+ */
+static struct {
+    int64_t count;
+    int64_t bytes;
+} g_allocs = {};
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&g_allocs.count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_allocs.bytes, size, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    __atomic_add_fetch(&g_allocs.count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_allocs.bytes, n * size, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&g_allocs.count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_allocs.bytes, size, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+/*
+ * Per module timing.
+ *
+ * We replace the klass of each module by a copy whose update and render
+ * methods measure the time spent in the original ones.
+ */
+typedef struct {
+    obj_klass_t         klass;  // Must be first.
+    const obj_klass_t   *orig;
+    double              update_time;
+    double              render_time;
+} module_stats_t;
+
+static module_stats_t *g_modules = NULL;
+static int g_modules_nb = 0;
+
+static double get_cpu_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int timed_update(obj_t *obj, double dt)
+{
+    module_stats_t *stats = (void*)obj->klass;
+    double t = get_cpu_time();
+    int ret = stats->orig->update(obj, dt);
+    stats->update_time += get_cpu_time() - t;
+    return ret;
+}
+
+static int timed_render(const obj_t *obj, const painter_t *painter)
+{
+    module_stats_t *stats = (void*)obj->klass;
+    double t = get_cpu_time();
+    int ret = stats->orig->render(obj, painter);
+    stats->render_time += get_cpu_time() - t;
+    return ret;
+}
+
+static void instrument_modules(void)
+{
+    obj_t *module;
+    module_stats_t *stats;
+    int i = 0;
+
+    DL_COUNT(core->obj.children, module, g_modules_nb);
+    g_modules = calloc(g_modules_nb, sizeof(*g_modules));
+    DL_FOREACH(core->obj.children, module) {
+        stats = &g_modules[i++];
+        stats->orig = module->klass;
+        stats->klass = *module->klass;
+        if (stats->orig->update) stats->klass.update = timed_update;
+        if (stats->orig->render) stats->klass.render = timed_render;
+        // The gui directly renders with OpenGL.
+        if (strcmp(stats->orig->id, "gui") == 0)
+            stats->klass.post_render = NULL;
+        module->klass = &stats->klass;
+    }
+}
+
+/*
+ * Map the remote urls to the local data directory.
+ */
+static void *local_assets_hook(void *user, const char *url, int *size,
+                               int *code)
+{
+    const char *data_dir = user;
+    const char *path;
+    char local[1024];
+    void *data;
+
+    if (!strstr(url, "://") || str_startswith(url, "asset://")) {
+        *code = -1; // Normal handling.
+        return NULL;
+    }
+    path = strstr(url, "://") + 3;
+    path = strchr(path, '/') ?: "";
+    snprintf(local, sizeof(local), "%s%s", data_dir, path);
+    data = read_file(local, size);
+    *code = data ? 200 : 404;
+    return data;
+}
+
+static void add_source(const char *data_dir, const char *module,
+                       const char *path, const char *key)
+{
+    char url[1024];
+    snprintf(url, sizeof(url), "%s/%s", data_dir, path);
+    module_add_data_source(core_get_module(module), url, key);
+}
+
+// Same as add_default_sources in main.c, but relative to the data dir.
+static void add_sources(const char *data_dir)
+{
+    add_source(data_dir, "landscapes", "landscapes/guereins", "guereins");
+    add_source(data_dir, "stars", "stars", NULL);
+    add_source(data_dir, "dsos", "dso", NULL);
+    add_source(data_dir, "skycultures", "skycultures/western", "western");
+    add_source(data_dir, "milkyway", "surveys/milkyway", "hips");
+    add_source(data_dir, "planets", "surveys/sso/moon", "default");
+    add_source(data_dir, "planets", "surveys/sso/moon", "moon");
+    add_source(data_dir, "planets", "surveys/sso/sun", "sun");
+    add_source(data_dir, "minor_planets", "mpcorb.dat", "mpc_asteroids");
+    add_source(data_dir, "comets", "CometEls.txt", "mpc_comets");
+    add_source(data_dir, "satellites", "tle_satellite.jsonl.gz",
+               "jsonl/sat");
+}
+
+static int parse_projection(const char *str)
+{
+    const struct {
+        const char *name;
+        int proj;
+    } projs[] = {
+        {"perspective",     PROJ_PERSPECTIVE},
+        {"stereographic",   PROJ_STEREOGRAPHIC},
+        {"mercator",        PROJ_MERCATOR},
+        {"hammer",          PROJ_HAMMER},
+        {"mollweide",       PROJ_MOLLWEIDE},
+    };
+    int i;
+    for (i = 0; i < ARRAY_SIZE(projs); i++) {
+        if (strcmp(projs[i].name, str) == 0) return projs[i].proj;
+    }
+    LOG_E("Unknown projection: %s", str);
+    return PROJ_STEREOGRAPHIC;
+}
+
+static double parse_utc(const char *str)
+{
+    int iy, im, id, ih = 0, imn = 0, r;
+    double sec = 0, d1, d2;
+    r = sscanf(str, "%d-%d-%dT%d:%d:%lf", &iy, &im, &id, &ih, &imn, &sec);
+    if (r < 3 || eraDtf2d("UTC", iy, im, id, ih, imn, sec, &d1, &d2)) {
+        LOG_E("Cannot parse time: %s", str);
+        return NAN;
+    }
+    return d1 - DJM0 + d2;
+}
+
+static void setup_scenario(json_value *scenario)
+{
+    observer_t *obs = core->observer;
+    const char *str;
+    double utc;
+
+    obj_set_attr(&obs->obj, "latitude",
+                 json_get_attr_f(scenario, "latitude", 0) * DD2R);
+    obj_set_attr(&obs->obj, "longitude",
+                 json_get_attr_f(scenario, "longitude", 0) * DD2R);
+    obj_set_attr(&obs->obj, "elevation",
+                 json_get_attr_f(scenario, "elevation", 0));
+    if ((str = json_get_attr_s(scenario, "utc"))) {
+        utc = parse_utc(str);
+        if (!isnan(utc)) obj_set_attr(&obs->obj, "utc", utc);
+    }
+    if ((str = json_get_attr_s(scenario, "projection")))
+        core->proj = parse_projection(str);
+    core->fov = json_get_attr_f(scenario, "fov", 60) * DD2R;
+    obs->yaw = json_get_attr_f(scenario, "azimuth", 0) * DD2R;
+    obs->pitch = json_get_attr_f(scenario, "altitude", 30) * DD2R;
+}
+
+typedef struct {
+    double *frame_times;
+    int nb;
+    int capacity;
+} frames_t;
+
+static void run_frame(frames_t *frames, int w, int h)
+{
+    double t = get_time();
+    core_update(FRAME_DT);
+    core_render(w, h, 1.0);
+    if (frames->nb >= frames->capacity) {
+        frames->capacity = max(1024, frames->capacity * 2);
+        frames->frame_times = realloc(frames->frame_times,
+                frames->capacity * sizeof(*frames->frame_times));
+    }
+    frames->frame_times[frames->nb++] = get_time() - t;
+}
+
+static void run_step(json_value *step, frames_t *frames, int w, int h)
+{
+    observer_t *obs = core->observer;
+    const char *type = json_get_attr_s(step, "type") ?: "wait";
+    int i, nb = json_get_attr_i(step, "frames", 1);
+    double az0 = obs->yaw, alt0 = obs->pitch, fov0 = core->fov;
+    double az1, alt1, fov1, speed, k;
+
+    az1 = json_get_attr_f(step, "azimuth", az0 * DR2D) * DD2R;
+    alt1 = json_get_attr_f(step, "altitude", alt0 * DR2D) * DD2R;
+    fov1 = json_get_attr_f(step, "fov", fov0 * DR2D) * DD2R;
+    speed = json_get_attr_f(step, "speed", 1);
+
+    for (i = 0; i < nb; i++) {
+        k = (i + 1.0) / nb;
+        if (strcmp(type, "slew") == 0) {
+            obs->yaw = mix(az0, az1, k);
+            obs->pitch = mix(alt0, alt1, k);
+        } else if (strcmp(type, "zoom") == 0) {
+            core->fov = fov0 * pow(fov1 / fov0, k);
+        } else if (strcmp(type, "timelapse") == 0) {
+            obs->tt += speed * FRAME_DT / ERFA_DAYSEC;
+        } else if (strcmp(type, "wait") != 0) {
+            LOG_E("Unknown step type: %s", type);
+            return;
+        }
+        run_frame(frames, w, h);
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int nb, double p)
+{
+    if (!nb) return 0;
+    return sorted[min((int)(p / 100 * nb), nb - 1)];
+}
+
+static json_value *make_report(const char *scenario_path, frames_t *frames,
+                               int64_t nb_allocs, int64_t allocs_bytes,
+                               double total_time,
+                               const render_stats_t *rstats)
+{
+    json_value *report, *times, *modules, *module, *allocs, *tiles, *draw,
+               *op;
+    double *sorted, sum = 0;
+    int i, nb_loaded, nb_errors, nb = max(rstats->frames, 1);
+    const module_stats_t *stats;
+    const struct {
+        const char *name;
+        double p;
+    } percentiles[] = {
+        {"p50", 50}, {"p90", 90}, {"p99", 99}, {"max", 100},
+    };
+
+    sorted = malloc(max(1, frames->nb) * sizeof(*sorted));
+    memcpy(sorted, frames->frame_times, frames->nb * sizeof(*sorted));
+    qsort(sorted, frames->nb, sizeof(*sorted), cmp_double);
+    for (i = 0; i < frames->nb; i++) sum += sorted[i];
+
+    report = json_object_new(0);
+    json_object_push(report, "scenario", json_string_new(scenario_path));
+    json_object_push(report, "frames", json_integer_new(frames->nb));
+    json_object_push(report, "total_ms", json_double_new(total_time * 1000));
+
+    times = json_object_push(report, "frame_time_ms", json_object_new(0));
+    json_object_push(times, "mean",
+                     json_double_new(sum / max(1, frames->nb) * 1000));
+    for (i = 0; i < ARRAY_SIZE(percentiles); i++) {
+        json_object_push(times, percentiles[i].name, json_double_new(
+                percentile(sorted, frames->nb, percentiles[i].p) * 1000));
+    }
+
+    modules = json_object_push(report, "modules_cpu_ms", json_object_new(0));
+    for (i = 0; i < g_modules_nb; i++) {
+        stats = &g_modules[i];
+        module = json_object_push(modules, stats->orig->id,
+                                  json_object_new(0));
+        json_object_push(module, "update",
+                         json_double_new(stats->update_time * 1000));
+        json_object_push(module, "render",
+                         json_double_new(stats->render_time * 1000));
+    }
+
+    allocs = json_object_push(report, "allocations", json_object_new(0));
+    json_object_push(allocs, "count", json_integer_new(nb_allocs));
+    json_object_push(allocs, "bytes", json_integer_new(allocs_bytes));
+
+    hips_get_stats(&nb_loaded, &nb_errors);
+    tiles = json_object_push(report, "tiles", json_object_new(0));
+    json_object_push(tiles, "loaded", json_integer_new(nb_loaded));
+    json_object_push(tiles, "errors", json_integer_new(nb_errors));
+
+    draw = json_object_push(report, "draw_per_frame", json_object_new(0));
+    for (i = RENDER_OP_POINTS_2D; i < RENDER_OP_COUNT; i++) {
+        op = json_object_push(draw, render_op_get_name(i),
+                              json_object_new(0));
+        json_object_push(op, "calls",
+                json_double_new((double)rstats->ops[i].calls / nb));
+        json_object_push(op, "vertices",
+                json_double_new((double)rstats->ops[i].vertices / nb));
+        json_object_push(op, "textures",
+                json_double_new((double)rstats->ops[i].textures / nb));
+    }
+
+    free(sorted);
+    return report;
+}
+
+int main(int argc, char **argv)
+{
+    json_value *scenario, *steps, *report;
+    const char *data_dir, *record;
+    renderer_t *null_rend, *rec_rend = NULL;
+    render_stats_t rstats;
+    char *data, *buf;
+    int i, size, w, h;
+    int64_t nb_allocs, allocs_bytes;
+    double t;
+    frames_t frames = {};
+    FILE *out = stdout;
+    json_serialize_opts opts = {
+        .mode = json_serialize_mode_multiline,
+        .indent_size = 4,
+    };
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <scenario.json> [<report.json>]\n",
+                argv[0]);
+        return -1;
+    }
+    data = read_file(argv[1], &size);
+    if (!data) {
+        LOG_E("Cannot read scenario file %s", argv[1]);
+        return -1;
+    }
+    scenario = json_parse(data, size);
+    free(data);
+    if (!scenario || scenario->type != json_object) {
+        LOG_E("Cannot parse scenario file %s", argv[1]);
+        return -1;
+    }
+    w = json_get_attr_i(scenario, "width", 800);
+    h = json_get_attr_i(scenario, "height", 600);
+    data_dir = json_get_attr_s(scenario, "data_dir") ?: "data/skydata";
+
+    // No GL context: use the null renderer and fake textures.
+    texture_set_headless(true);
+    core_init(w, h, 1.0);
+    null_rend = render_null_create();
+    core->rend = null_rend;
+    if ((record = json_get_attr_s(scenario, "record"))) {
+        rec_rend = render_record_create(record, null_rend);
+        if (rec_rend) core->rend = rec_rend;
+    }
+    asset_set_hook((void*)data_dir, local_assets_hook);
+    add_sources(data_dir);
+    instrument_modules();
+    setup_scenario(scenario);
+
+    // Only count the allocations of the scenario.
+    nb_allocs = g_allocs.count;
+    allocs_bytes = g_allocs.bytes;
+    t = get_time();
+    steps = json_get_attr(scenario, "steps", json_array);
+    for (i = 0; steps && i < steps->u.array.length; i++)
+        run_step(steps->u.array.values[i], &frames, w, h);
+    t = get_time() - t;
+    nb_allocs = g_allocs.count - nb_allocs;
+    allocs_bytes = g_allocs.bytes - allocs_bytes;
+    render_record_release(rec_rend);
+
+    render_null_get_stats(null_rend, &rstats);
+    report = make_report(argv[1], &frames, nb_allocs, allocs_bytes, t,
+                         &rstats);
+    buf = calloc(1, json_measure_ex(report, opts));
+    json_serialize_ex(buf, report, opts);
+    if (argc > 2 && !(out = fopen(argv[2], "w"))) {
+        LOG_E("Cannot write report to %s", argv[2]);
+        return -1;
+    }
+    fprintf(out, "%s\n", buf);
+    if (out != stdout) fclose(out);
+
+    free(buf);
+    json_builder_free(report);
+    json_value_free(scenario);
+    free(frames.frame_times);
+    return 0;
+}
+
+#endif
@@ -48,6 +48,68 @@ static json_value *core_fn_progressbars(obj_t *obj, const attribute_t *attr,
     return ret;
 }
 
+static json_value *core_fn_profiler_stats(obj_t *obj,
+                                          const attribute_t *attr,
+                                          const json_value *args)
+{
+    return profile_get_stats();
+}
+
+static json_value *core_fn_textures_mem_size(obj_t *obj,
+                                             const attribute_t *attr,
+                                             const json_value *args)
+{
+    return args_value_new(TYPE_FLOAT, (double)texture_get_total_mem_size());
+}
+
+static json_value *core_fn_memory_limit(obj_t *obj,
+                                        const attribute_t *attr,
+                                        const json_value *args)
+{
+    double limit;
+    if (args && args->u.array.length) {
+        args_get(args, TYPE_FLOAT, &limit);
+        membudget_set_limit(limit);
+    }
+    return args_value_new(TYPE_FLOAT, (double)membudget_get_limit());
+}
+
+static json_value *core_fn_target_fps(obj_t *obj,
+                                      const attribute_t *attr,
+                                      const json_value *args)
+{
+    double fps, frame_time;
+    if (args && args->u.array.length) {
+        args_get(args, TYPE_FLOAT, &fps);
+        governor_set_target(fps > 0 ? 1.0 / fps : 0);
+    }
+    frame_time = governor_get_target();
+    return args_value_new(TYPE_FLOAT, frame_time ? 1.0 / frame_time : 0.0);
+}
+
+static void add_memory_stat(void *user, const char *name, int priority,
+                            int64_t size)
+{
+    json_value *caches = user;
+    json_object_push(caches, name, json_double_new(size));
+}
+
+static json_value *core_fn_memory_stats(obj_t *obj,
+                                        const attribute_t *attr,
+                                        const json_value *args)
+{
+    json_value *ret, *caches;
+    ret = json_object_new(0);
+    caches = json_object_new(0);
+    membudget_list(caches, add_memory_stat);
+    json_object_push(ret, "caches", caches);
+    json_object_push(ret, "total", json_double_new(membudget_get_total()));
+    json_object_push(ret, "limit", json_double_new(membudget_get_limit()));
+    json_object_push(ret, "textures",
+                     json_double_new(texture_get_total_mem_size()));
+    return ret;
+}
+
 static obj_t *core_get(const obj_t *obj, const char *id, int flags)
 {
     obj_t *module;
@@ -60,6 +122,14 @@ static obj_t *core_get(const obj_t *obj, const char *id, int flags)
     return NULL;
 }
 
+EMSCRIPTEN_KEEPALIVE
+void core_on_memory_pressure(void)
+{
+    LOG_I("Memory pressure: release %.1f MB of caches",
+          membudget_get_total() / 2.0 / (1 << 20));
+    membudget_on_pressure();
+}
+
 EMSCRIPTEN_KEEPALIVE
 obj_t *core_get_module(const char *id)
 {
@@ -201,6 +271,7 @@ static void core_set_default(void)
 
     core->telescope_auto = true;
     core->mount_frame = FRAME_OBSERVED;
+    core->render_jobs = true;
     observer_update(core->observer, false);
 }
 
@@ -224,7 +295,7 @@ static uint8_t *texture_load_function(
 EMSCRIPTEN_KEEPALIVE
 void core_init(double win_w, double win_h, double pixel_scale)
 {
-    char cache_dir[1024];
+    char cache_dir[1024], names_path[1100];
     obj_klass_t *module;
 
     // Why do we even need those attributes?
@@ -240,6 +311,10 @@ void core_init(double win_w, double win_h, double pixel_scale)
     snprintf(cache_dir, sizeof(cache_dir), "%s/%s",
              sys_get_user_dir(), ".cache");
     request_init(cache_dir);
+    snprintf(names_path, sizeof(names_path), "%s/%s",
+             cache_dir, "names.bin");
+    names_init(names_path);
+    assets_register_membudget();
 
     core = (core_t*)obj_create("core", "core", NULL);
     core->win_size[0] = win_w;
@@ -262,12 +337,51 @@ void core_init(double win_w, double win_h, double pixel_scale)
     core_set_default();
 }
 
+EMSCRIPTEN_KEEPALIVE
+void core_init_headless(double win_w, double win_h, double pixel_scale)
+{
+    texture_set_headless(true);
+    texture_set_keep_data(true);
+    core_init(win_w, win_h, pixel_scale);
+}
+
+// Get at least 'nb' command lists that use a given renderer to measure
+// the texts.  Call with a NULL renderer to release all the lists.
+static renderer_t **get_render_lists(renderer_t *measure, int nb)
+{
+    typeof(core->render_lists) *lists = &core->render_lists;
+    int i;
+
+    if (measure != lists->measure) {
+        for (i = 0; i < lists->nb; i++)
+            render_list_release(lists->lists[i]);
+        lists->nb = 0;
+        lists->measure = measure;
+    }
+    if (!measure) {
+        free(lists->lists);
+        lists->lists = NULL;
+        return NULL;
+    }
+    if (nb > lists->nb) {
+        lists->lists = realloc(lists->lists, nb * sizeof(*lists->lists));
+        for (i = lists->nb; i < nb; i++)
+            lists->lists[i] = render_list_create(measure);
+        lists->nb = nb;
+    }
+    return lists->lists;
+}
+
 void core_release(void)
 {
     obj_t *module;
     DL_FOREACH(core->obj.children, module) {
         if (module->klass->del) module->klass->del(module);
     }
+    render_soft_release(core->rend_soft);
+    core->rend_soft = NULL;
+    get_render_lists(NULL, 0);
+    names_release();
     profile_release();
 }
 
@@ -420,6 +534,11 @@ int core_update(double dt)
     obj_t *atm, *module;
     task_t *task, *task_tmp;
 
+    // A profiled frame goes from the start of an update to the end of the
+    // following render.
+    profile_frame(core->profiler);
+    PROFILE(core_update, 0);
+
     atm = core_get_module("atmosphere");
     assert(atm);
     obj_get_attr(atm, "visible", &atm_visible);
@@ -428,6 +547,8 @@ int core_update(double dt)
     if (core->telescope_auto)
         telescope_auto(&core->telescope, core->fov);
     progressbar_update();
+    names_update();
+    membudget_update();
 
     // Update eye adaptation.
     if (core->fast_adaptation && core->lwmax > core->tonemapper.lwmax) {
@@ -452,6 +573,7 @@ int core_update(double dt)
     core_update_mount(dt);
     core_update_time(dt);
 
+    if (core->tasks) core_mark_dirty();
     DL_FOREACH_SAFE(core->tasks, task, task_tmp) {
         if (task->fun(task, dt) != 0) {
             DL_DELETE(core->tasks, task);
@@ -464,6 +586,7 @@ int core_update(double dt)
         if (module->klass->update) {
             r = module->klass->update(module, dt);
             if (r < 0) LOG_E("Error updating module '%s'", module->id);
+            if (r > 0) core_mark_dirty();
         }
     }
 
@@ -651,13 +774,124 @@ static void render_proj_markers(const painter_t *painter_)
 }
 
 
-EMSCRIPTEN_KEEPALIVE
-int core_render(double win_w, double win_h, double pixel_scale)
+// Render a module, with the quality set by the frame governor if we render
+// the interactive view.
+static void render_module(const obj_t *module, painter_t *painter,
+                          bool interactive)
+{
+    double start;
+    if (!interactive || !(module->klass->flags & OBJ_ADAPTIVE) ||
+            !module->id) {
+        obj_render(module, painter);
+        return;
+    }
+    painter->degrade = governor_get_degrade(module->id);
+    start = sys_get_unix_time();
+    obj_render(module, painter);
+    governor_report(module->id, sys_get_unix_time() - start);
+    painter->degrade = 0;
+}
+
+// A module rendered into a command list from a job thread.
+typedef struct {
+    const obj_t *module;
+    painter_t   painter;
+    bool        adaptive; // Set if the quality is set by the governor.
+    double      time; // Render time (s).
+} render_job_t;
+
+static void render_job(void *user, int i)
+{
+    render_job_t *job = (render_job_t*)user + i;
+    const double start = sys_get_unix_time();
+    obj_render(job->module, &job->painter);
+    job->time = sys_get_unix_time() - start;
+}
+
+// Test whether a module can be rendered from a job thread.  The layers can
+// if all their children can.
+static bool can_render_in_job(const obj_t *module)
+{
+    const obj_t *child;
+    if (module->klass->flags & OBJ_RENDER_JOB) return true;
+    if (strcmp(module->klass->id, "layer") != 0 || !module->children)
+        return false;
+    DL_FOREACH(module->children, child) {
+        if (!can_render_in_job(child)) return false;
+    }
+    return true;
+}
+
+// Render all the modules in order.  The modules that support it are first
+// rendered in parallel into command lists, that are then submitted in
+// the modules order, so that we get the same result as with a sequential
+// rendering.
+static void render_modules(painter_t *painter, bool interactive)
+{
+    obj_t *module;
+    render_job_t *jobs;
+    renderer_t **lists;
+    int i, nb = 0;
+
+    // Without threads, the lists would only add a copy of the commands.
+    if (core->render_jobs && worker_parallel_threads()) {
+        DL_FOREACH(core->obj.children, module)
+            nb += can_render_in_job(module) ? 1 : 0;
+    }
+    if (!nb) {
+        DL_FOREACH(core->obj.children, module)
+            render_module(module, painter, interactive);
+        return;
+    }
+
+    lists = get_render_lists(painter->rend, nb);
+    jobs = calloc(nb, sizeof(*jobs));
+    i = 0;
+    DL_FOREACH(core->obj.children, module) {
+        if (!can_render_in_job(module)) continue;
+        jobs[i].module = module;
+        jobs[i].painter = *painter;
+        jobs[i].painter.rend = lists[i];
+        jobs[i].adaptive = interactive &&
+                (module->klass->flags & OBJ_ADAPTIVE) && module->id;
+        if (jobs[i].adaptive)
+            jobs[i].painter.degrade = governor_get_degrade(module->id);
+        i++;
+    }
+    worker_parallel_for(nb, render_job, jobs);
+
+    i = 0;
+    DL_FOREACH(core->obj.children, module) {
+        if (i >= nb || jobs[i].module != module) {
+            render_module(module, painter, interactive);
+            continue;
+        }
+        render_list_submit(lists[i], painter->rend);
+        render_list_clear(lists[i]);
+        if (jobs[i].adaptive)
+            governor_report(module->id, jobs[i].time);
+        i++;
+    }
+    free(jobs);
+}
+
+/*
+ * Render the view.
+ *
+ * The interactive flag is set for the main view rendering: the frame
+ * governor then adapts the modules quality to the measured times, and we
+ * do the post render.  The exported images and vector files are always
+ * rendered with the full quality.
+ */
+static int render(renderer_t *rend, double win_w, double win_h,
+                  double pixel_scale, bool interactive)
 {
     PROFILE(core_render, 0);
     obj_t *module;
     projection_t proj;
     double max_vmag, hints_vmag;
+    bool dirty;
+    const double start = sys_get_unix_time();
 
     // Used to make sure some values are not touched during render.
     struct {
@@ -679,14 +913,15 @@ int core_render(double win_w, double win_h, double pixel_scale)
     hints_vmag = compute_vmag_for_radius(core->show_hints_radius);
 
     fps_tick(&core->fps, sys_get_unix_time());
+    // The fps change alone doesn't need a new frame.
+    dirty = core->frames.dirty;
     module_changed(&core->obj, "fps");
+    core->frames.dirty = dirty;
 
-    if (!core->rend)
-        core->rend = render_gl_create();
     labels_reset();
 
     painter_t painter = {
-        .rend = core->rend,
+        .rend = rend,
         .obs = core->observer,
         .fb_size = {win_w * pixel_scale, win_h * pixel_scale},
         .pixel_scale = pixel_scale,
@@ -704,9 +939,7 @@ int core_render(double win_w, double win_h, double pixel_scale)
     painter_update_clip_info(&painter);
     paint_prepare(&painter, win_w, win_h, pixel_scale);
 
-    DL_FOREACH(core->obj.children, module) {
-        obj_render(module, &painter);
-    }
+    render_modules(&painter, interactive);
 
     // Render the viewport cap for debugging.
     if ((0)) {
@@ -720,11 +953,13 @@ int core_render(double win_w, double win_h, double pixel_scale)
 
     // Flush all rendering pipeline
     paint_finish(&painter);
+    if (interactive) governor_frame(sys_get_unix_time() - start);
 
     assert(bck.obs.tt == core->observer->tt);
 
     // Do post render (e.g. for GUI)
     DL_FOREACH(core->obj.children, module) {
+        if (!interactive) break;
         if (module->klass->post_render)
             module->klass->post_render(module, &painter);
     }
@@ -735,10 +970,125 @@ int core_render(double win_w, double win_h, double pixel_scale)
     return 0;
 }
 
+EMSCRIPTEN_KEEPALIVE
+void core_mark_dirty(void)
+{
+    if (core) core->frames.dirty = true;
+}
+
+// Get the state of the view that affects the rendering.
+static void get_frame_state(typeof(core->frames.last) *state,
+                            double win_w, double win_h, double pixel_scale)
+{
+    const observer_t *obs = core->observer;
+    *state = (typeof(*state)) {
+        .obs_hash = obs->hash_partial,
+        .tt = obs->tt,
+        .yaw = obs->yaw,
+        .pitch = obs->pitch,
+        .roll = obs->roll,
+        .view_offset_alt = obs->view_offset_alt,
+        .fov = core->fov,
+        .proj = core->proj,
+        .win_size = {win_w, win_h},
+        .pixel_scale = pixel_scale,
+        .selection = core->selection,
+        .hovered = core->hovered,
+        .lwmax = core->tonemapper.lwmax,
+    };
+    vec4_copy(obs->mount_quat, state->mount_quat);
+}
+
+// Test whether a frame rendered with a given state would look the same as
+// the last rendered frame.
+static bool frame_state_unchanged(const typeof(core->frames.last) *state)
+{
+    const typeof(core->frames.last) *last = &core->frames.last;
+    // The sky rotates at the sidereal rate, so a time change only shows
+    // once it moves the stars by more than half a pixel.
+    const double sidereal_rate = 2 * M_PI / 86164.0905; // rad/s
+    const double pixel = state->fov / state->win_size[0];
+
+    if (fabs(state->tt - last->tt) * ERFA_DAYSEC * sidereal_rate > pixel / 2)
+        return false;
+    if (fabs(state->lwmax - last->lwmax) > 1e-3 * last->lwmax)
+        return false;
+    return state->obs_hash == last->obs_hash &&
+           state->yaw == last->yaw &&
+           state->pitch == last->pitch &&
+           state->roll == last->roll &&
+           state->view_offset_alt == last->view_offset_alt &&
+           vec4_equal(state->mount_quat, last->mount_quat) &&
+           state->fov == last->fov &&
+           state->proj == last->proj &&
+           state->win_size[0] == last->win_size[0] &&
+           state->win_size[1] == last->win_size[1] &&
+           state->pixel_scale == last->pixel_scale &&
+           state->selection == last->selection &&
+           state->hovered == last->hovered;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int core_render(double win_w, double win_h, double pixel_scale)
+{
+    typeof(core->frames.last) state;
+
+    get_frame_state(&state, win_w, win_h, pixel_scale);
+    if (    core->skip_unchanged_frames && core->frames.valid &&
+            !core->frames.dirty && frame_state_unchanged(&state)) {
+        // Keep the luminance reported by the last frame for the eye
+        // adaptation, as if we had rendered it again.
+        core->lwmax = max(core->lwmax, core->frames.lwmax);
+        core->frames.nb_skipped++;
+        return 1;
+    }
+
+    if (!core->rend)
+        core->rend = render_gl_create();
+    core->frames.dirty = false;
+    render(core->rend, win_w, win_h, pixel_scale, true);
+    core->frames.last = state;
+    core->frames.valid = true;
+    core->frames.lwmax = core->lwmax;
+    core->frames.nb_rendered++;
+    return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void *core_render_image(double win_w, double win_h, double pixel_scale,
+                        const char *format, int quality, int *size)
+{
+    const uint8_t *img;
+    int w, h;
+
+    if (!core->rend_soft)
+        core->rend_soft = render_soft_create(true);
+    // The post render callbacks (like the GUI) draw directly with OpenGL.
+    render(core->rend_soft, win_w, win_h, pixel_scale, false);
+    img = render_soft_get_buffer(core->rend_soft, &w, &h);
+    return img_encode(img, w, h, 4, format, quality, size);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int core_render_vector(double win_w, double win_h, const char *path)
+{
+    renderer_t *rend;
+    int len = strlen(path);
+
+    if (len > 4 && strcasecmp(path + len - 4, ".pdf") == 0)
+        rend = render_pdf_create(path);
+    else
+        rend = render_svg_create(path);
+    if (!rend) return -1;
+    render(rend, win_w, win_h, 1.0, false);
+    return render_svg_release(rend);
+}
+
 EMSCRIPTEN_KEEPALIVE
 void core_on_mouse(int id, int state, double x, double y)
 {
     obj_t *module;
+    core_mark_dirty();
     DL_FOREACH(core->obj.children, module) {
         if (module->klass->on_mouse) {
             module->klass->on_mouse(module, id, state, x, y);
@@ -771,6 +1121,7 @@ void core_on_key(int key, int action)
     char buf[128];
 
     core->inputs.keys[key] = (action != KEY_ACTION_UP);
+    core_mark_dirty();
 
     if (core->gui_want_capture_mouse) return;
     if (action != KEY_ACTION_DOWN) return;
@@ -792,6 +1143,7 @@ void core_on_key(int key, int action)
 void core_on_char(uint32_t c)
 {
     int i;
+    core_mark_dirty();
     if (c > 0 && c < 0x10000) {
         for (i = 0; i < ARRAY_SIZE(core->inputs.chars); i++) {
             if (!core->inputs.chars[i]) {
@@ -1114,6 +1466,23 @@ static obj_klass_t core_klass = {
         PROPERTY(hovered, TYPE_OBJ, MEMBER(core_t, hovered)),
         PROPERTY(progressbars, TYPE_JSON, .fn = core_fn_progressbars),
         PROPERTY(fps, TYPE_INT, MEMBER(core_t, fps.avg)),
+        PROPERTY(profiler, TYPE_INT, MEMBER(core_t, profiler)),
+        PROPERTY(profiler_stats, TYPE_JSON, .fn = core_fn_profiler_stats),
+        // Target frame rate of the frame governor, zero to disable.
+        PROPERTY(target_fps, TYPE_FLOAT, .fn = core_fn_target_fps),
+        PROPERTY(render_jobs, TYPE_BOOL, MEMBER(core_t, render_jobs)),
+        PROPERTY(skip_unchanged_frames, TYPE_BOOL,
+                 MEMBER(core_t, skip_unchanged_frames)),
+        PROPERTY(frames_rendered, TYPE_INT,
+                 MEMBER(core_t, frames.nb_rendered)),
+        PROPERTY(frames_skipped, TYPE_INT, MEMBER(core_t, frames.nb_skipped)),
+        // Memory used by the textures, in bytes.
+        PROPERTY(textures_mem_size, TYPE_FLOAT,
+                 .fn = core_fn_textures_mem_size),
+        // Global memory limit of the caches in bytes, zero for no limit.
+        PROPERTY(memory_limit, TYPE_FLOAT, .fn = core_fn_memory_limit),
+        // Memory used by each cache, for debugging.
+        PROPERTY(memory_stats, TYPE_JSON, .fn = core_fn_memory_stats),
         PROPERTY(clicks, TYPE_INT, MEMBER(core_t, clicks)),
         PROPERTY(ignore_clicks, TYPE_BOOL, MEMBER(core_t, ignore_clicks)),
         PROPERTY(zoom, TYPE_FLOAT, MEMBER(core_t, zoom)),
@@ -1173,6 +1542,37 @@ static void test_core(void)
     obj_get_attr(obs, "utc", &v);
 }
 
+static void test_skip_frames(void)
+{
+    typeof(core->frames) frames = core->frames;
+    typeof(core->frames.last) state;
+    const double fov = core->fov;
+
+    core->fov = 60 * DD2R;
+    get_frame_state(&core->frames.last, 800, 600, 1.0);
+    state = core->frames.last;
+    assert(frame_state_unchanged(&state));
+
+    // One second doesn't move the sky by half a pixel, one minute does.
+    state.tt += 1.0 / ERFA_DAYSEC;
+    assert(frame_state_unchanged(&state));
+    state.tt += 60.0 / ERFA_DAYSEC;
+    assert(!frame_state_unchanged(&state));
+    state = core->frames.last;
+    state.yaw += 0.001;
+    assert(!frame_state_unchanged(&state));
+
+    // Only the attributes changes other than the time mark the frame dirty.
+    core->frames.dirty = false;
+    module_changed(&core->observer->obj, "tt");
+    assert(!core->frames.dirty);
+    module_changed(&core->obj, "fov");
+    assert(core->frames.dirty);
+
+    core->fov = fov;
+    core->frames = frames;
+}
+
 static void test_basic(void)
 {
     obj_t *obj;
@@ -1191,9 +1591,40 @@ static void test_info(void)
     obj_get_info(obj, core->observer, INFO_VMAG, &vmag);
 }
 
+static void test_render_image(void)
+{
+    uint8_t *png, *img;
+    int i, size, w, h, bpp = 0;
+    double target;
+    obj_t *module;
+
+    texture_set_headless(true);
+    texture_set_keep_data(true);
+    png = core_render_image(64, 48, 2.0, "png", 0, &size);
+    assert(png && size > 8 && memcmp(png + 1, "PNG", 3) == 0);
+    img = img_read_from_mem(png, size, &w, &h, &bpp);
+    assert(img && w == 128 && h == 96 && bpp == 4);
+    free(img);
+    free(png);
+
+    // The exported images don't use nor feed the frame governor.
+    target = governor_get_target();
+    governor_set_target(1e-9);
+    for (i = 0; i < 2; i++) {
+        free(core_render_image(64, 48, 1.0, "png", 0, &size));
+        DL_FOREACH(core->obj.children, module)
+            assert(!module->id || governor_get_degrade(module->id) == 0);
+    }
+    governor_set_target(target);
+    texture_set_keep_data(false);
+    texture_set_headless(false);
+}
+
 TEST_REGISTER(NULL, test_core, TEST_AUTO);
 TEST_REGISTER(NULL, test_vec, TEST_AUTO);
+TEST_REGISTER(NULL, test_skip_frames, TEST_AUTO);
 TEST_REGISTER(NULL, test_basic, TEST_AUTO);
 TEST_REGISTER(NULL, test_info, TEST_AUTO);
+TEST_REGISTER(NULL, test_render_image, TEST_AUTO);
 
 #endif
@@ -20,6 +20,7 @@
 #include "observer.h"
 #include "obj.h"
 #include "module.h"
+#include "names.h"
 #include "otypes.h"
 #include "telescope.h"
 #include "tonemapper.h"
@@ -90,6 +91,14 @@ struct core
     bool            flip_view_horizontal;
 
     renderer_t      *rend;
+    renderer_t      *rend_soft; // Used by core_render_image.
+    // Render the OBJ_RENDER_JOB modules in parallel.
+    bool            render_jobs;
+    struct {
+        renderer_t  *measure;   // Renderer used to create the lists.
+        int         nb;
+        renderer_t  **lists;
+    } render_lists;
     int             proj;
     double          win_size[2];
     double          win_pixels_scale;
@@ -97,6 +106,7 @@ struct core
     obj_t           *hovered;
 
     fps_t           fps; // FPS counter.
+    int             profiler; // Profile one frame every N frames.
 
     // Number of clicks so far.  This is just so that we can wait for clicks
     // from the ui.
@@ -154,6 +164,32 @@ struct core
     // List of running tasks.
     task_t *tasks;
 
+    // Skip the frames that would look the same as the last rendered one.
+    // See <core_render>.
+    bool skip_unchanged_frames;
+
+    struct {
+        bool        dirty; // Set by <core_mark_dirty>.
+        bool        valid; // Set once a frame has been rendered.
+        double      lwmax; // Max luminance reported by the last frame.
+        int         nb_rendered;
+        int         nb_skipped;
+        // View state of the last rendered frame.
+        struct {
+            uint64_t    obs_hash;
+            double      tt;
+            double      yaw, pitch, roll, view_offset_alt;
+            double      mount_quat[4];
+            double      fov;
+            int         proj;
+            double      win_size[2];
+            double      pixel_scale;
+            const obj_t *selection;
+            const obj_t *hovered;
+            double      lwmax;
+        } last;
+    } frames;
+
     // Can be used for debugging.  It's conveniant to have an exposed test
     // attribute.
     bool test;
@@ -186,6 +222,16 @@ enum {
 
 void core_init(double win_w, double win_h, double pixel_scale);
 
+/*
+ * Function: core_init_headless
+ * Same as core_init, for rendering without any OpenGL context.
+ *
+ * The textures don't use OpenGL, and keep a CPU copy of their pixels, so
+ * that all of them can be drawn by <core_render_image>.  Must be called
+ * before any texture is created.
+ */
+void core_init_headless(double win_w, double win_h, double pixel_scale);
+
 void core_release(void);
 
 /*
@@ -224,13 +270,88 @@ void core_observer_update();
  */
 void core_set_view_offset(double center_y_offset);
 
+/*
+ * Function: core_render
+ * Render a frame.
+ *
+ * If the 'skip_unchanged_frames' attribute is set, the frame is only
+ * rendered if something changed since the last one: a module reported a
+ * change with <core_mark_dirty>, or the view moved.  Small time changes
+ * are ignored as long as the sky moves by less than half a pixel.
+ *
+ * Return:
+ *   0 if the frame has been rendered, 1 if it has been skipped, in which
+ *   case the caller should keep showing the last frame.
+ */
 int core_render(double win_w, double win_h, double pixel_scale);
+
+/*
+ * Function: core_mark_dirty
+ * Notify that something changed and the next frame has to be rendered.
+ *
+ * Called automatically by <module_changed>, the modules only need to call
+ * it directly for changes that don't go through the attributes, like
+ * moving objects or data that just finished loading.
+ */
+void core_mark_dirty(void);
+
+/*
+ * Function: core_render_image
+ * Render a frame with the software renderer and encode it into an image.
+ *
+ * With <core_init_headless> this doesn't need any OpenGL context, and can
+ * be used to render finder charts or thumbnails on a server.  Otherwise,
+ * only the textures created after the first call are drawn, since the
+ * others don't have a CPU copy of their pixels.
+ *
+ * Parameters:
+ *   win_w       - Width of the image in window units.
+ *   win_h       - Height of the image in window units.
+ *   pixel_scale - Number of pixels per window unit.
+ *   format      - 'png' or 'webp'.
+ *   quality     - Webp quality (1 to 100), or 0 for lossless.
+ *   size        - Get the size of the returned buffer.
+ *
+ * Return:
+ *   A newly allocated buffer with the encoded image, or NULL in case of
+ *   error.
+ */
+void *core_render_image(double win_w, double win_h, double pixel_scale,
+                        const char *format, int quality, int *size);
+
+/*
+ * Function: core_render_vector
+ * Render a frame into a vector SVG or PDF chart.
+ *
+ * The page has the size of the window, with one point per window unit, so
+ * for example an A0 chart at 72 dpi is 2384x3370.  Only the vector
+ * elements are exported, the surveys and the atmosphere are not rendered.
+ *
+ * Parameters:
+ *   win_w       - Width of the page in window units.
+ *   win_h       - Height of the page in window units.
+ *   path        - Output file.  If it ends with '.pdf' we render a PDF,
+ *                 otherwise an SVG.
+ *
+ * Return:
+ *   0 on success, -1 if the output file cannot be created or written.
+ */
+int core_render_vector(double win_w, double win_h, const char *path);
 // x and y in screen coordinates.
 void core_on_mouse(int id, int state, double x, double y);
 void core_on_key(int key, int action);
 void core_on_char(uint32_t c);
 void core_on_zoom(double zoom, double x, double y);
 
+/*
+ * Function: core_on_memory_pressure
+ * Release some of the cached data.
+ *
+ * Should be called when the system reports that the memory is low.  See
+ * <membudget_on_pressure>.
+ */
+void core_on_memory_pressure(void);
+
 /*
  * Function: core_get_proj
  * Get the core current view projection
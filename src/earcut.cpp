@@ -20,7 +20,7 @@ using Point = std::array<double, 2>;
 
 struct earcut {
     std::vector<std::vector<Point>> polygon;
-    std::vector<uint16_t> triangles;
+    std::vector<uint32_t> triangles;
 };
 
 
@@ -42,12 +42,27 @@ void earcut_add_poly(earcut_t *earcut, int size, double vertices[][2])
     for (i = 0; i < size; i++) {
         poly.push_back({vertices[i][0], vertices[i][1]});
     }
-    earcut->polygon.push_back(poly);
+    earcut->polygon.push_back(std::move(poly));
 }
 
-const uint16_t *earcut_triangulate(earcut_t *earcut, int *size)
+void earcut_add_polys(earcut_t *earcut, int nb, const int *sizes,
+                      double vertices[][2])
 {
-    earcut->triangles = mapbox::earcut<uint16_t>(earcut->polygon);
+    int r, i, j = 0;
+    earcut->polygon.reserve(earcut->polygon.size() + nb);
+    for (r = 0; r < nb; r++) {
+        std::vector<Point> poly;
+        poly.reserve(sizes[r]);
+        for (i = 0; i < sizes[r]; i++, j++) {
+            poly.push_back({vertices[j][0], vertices[j][1]});
+        }
+        earcut->polygon.push_back(std::move(poly));
+    }
+}
+
+const uint32_t *earcut_triangulate(earcut_t *earcut, int *size)
+{
+    earcut->triangles = mapbox::earcut<uint32_t>(earcut->polygon);
     *size = earcut->triangles.size();
     return earcut->triangles.data();
 }
@@ -19,6 +19,14 @@ typedef struct earcut earcut_t;
 earcut_t *earcut_new(void);
 void earcut_delete(earcut_t *earcut);
 void earcut_add_poly(earcut_t *earcut, int size, double vertices[][2]);
-const uint16_t *earcut_triangulate(earcut_t *earcut, int *size);
+
+// Add several rings at once, the vertices of all the rings being stored
+// contiguously.  The first ring is the outer contour, the others are holes.
+void earcut_add_polys(earcut_t *earcut, int nb, const int *sizes,
+                      double vertices[][2]);
+
+// Return the triangles indices.  The indices are 32 bits so that polygons
+// with more than 65536 vertices are supported.
+const uint32_t *earcut_triangulate(earcut_t *earcut, int *size);
 
 #endif // EARCUT_H
@@ -249,3 +249,62 @@ int eph_read_table_row(const void *data, int data_size, int *data_ofs,
     *data_ofs += columns[0].row_size;
     return 0;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void *g_bench_data;
+static int g_bench_size;
+
+static void bench_eph_load_setup(void)
+{
+    const char *path = "data/skydata/stars/Norder1/Dir0/Npix0.eph";
+    if (!g_bench_data) g_bench_data = read_file(path, &g_bench_size);
+}
+
+static int bench_eph_load_on_chunk(const char type[4],
+                                   const void *data, int size,
+                                   const json_value *json, void *user)
+{
+    int version, order, pix, nb, row_size, flags, i, data_ofs = 0;
+    int *count = user;
+    double vmag, ra, de;
+    void *table_data;
+    eph_table_column_t columns[] = {
+        {"vmag", 'f', EPH_VMAG},
+        {"ra",   'f', EPH_RAD},
+        {"de",   'f', EPH_RAD},
+    };
+
+    if (strncmp(type, "STAR", 4) != 0) return 0;
+    eph_read_tile_header(data, size, &data_ofs, &version, &order, &pix);
+    nb = eph_read_table_header(version, data, size, &data_ofs, &row_size,
+                               &flags, ARRAY_SIZE(columns), columns);
+    if (nb < 0) return -1;
+    table_data = eph_read_compressed_block(data, size, &data_ofs, &size);
+    if (!table_data) return -1;
+    data_ofs = 0;
+    if (flags & 1) eph_shuffle_bytes(table_data, row_size, nb);
+    for (i = 0; i < nb; i++) {
+        eph_read_table_row(table_data, size, &data_ofs, ARRAY_SIZE(columns),
+                           columns, &vmag, &ra, &de);
+        bench_keep(vmag);
+    }
+    free(table_data);
+    *count += nb;
+    return 0;
+}
+
+// Parse and decompress a stars tile, as done by the stars module.
+static int bench_eph_load(void)
+{
+    int count = 0;
+    if (!g_bench_data) return -1;
+    eph_load(g_bench_data, g_bench_size, &count, bench_eph_load_on_chunk);
+    return count;
+}
+
+BENCH_REGISTER(bench_eph_load_setup, bench_eph_load)
+
+#endif
@@ -63,22 +63,54 @@ static double find_zero(double (*f)(double x, void *user),
     return newton(f, x - step, x, precision, user);
 }
 
-static double rise_dist(double time, void *user)
+typedef struct {
+    observer_t *obs;
+    obj_t *obj;
+} event_data_t;
+
+// Compute the observed position of an object and its radius at a given time.
+static void get_observed(observer_t *obs, obj_t *obj, double time,
+                         double observed[4], double *radius)
 {
-    struct {
-        observer_t *obs;
-        obj_t *obj;
-    } *data = user;
-    double radius = 0, pvo[2][4], observed[4], az, alt;
-
-    data->obs->tt = time;
-    observer_update(data->obs, false);
-    obj_get_pvo(data->obj, data->obs, pvo);
-    convert_framev4(data->obs, FRAME_ICRF, FRAME_OBSERVED, pvo[0], observed);
+    double pvo[2][4];
+    obs->tt = time;
+    observer_update(obs, false);
+    obj_get_pvo(obj, obs, pvo);
+    convert_framev4(obs, FRAME_ICRF, FRAME_OBSERVED, pvo[0], observed);
+    *radius = 0;
+    obj_get_info(obj, obs, INFO_RADIUS, radius);
+}
+
+// Altitude of the top of the object above the horizon.
+static double rise_dist_at(const observer_t *obs, const double observed[4],
+                           double radius)
+{
+    double az, alt;
     eraC2s(observed, &az, &alt);
-    az = eraAnp(az);
-    obj_get_info(data->obj, data->obs, INFO_RADIUS, &radius);
-    return alt + radius - data->obs->horizon;
+    return alt + radius - obs->horizon;
+}
+
+// East component of the observed direction: goes from positive to
+// negative at the upper culmination.
+static double transit_dist_at(const double observed[4])
+{
+    return observed[1] / vec3_norm(observed);
+}
+
+static double rise_dist(double time, void *user)
+{
+    event_data_t *data = user;
+    double observed[4], radius;
+    get_observed(data->obs, data->obj, time, observed, &radius);
+    return rise_dist_at(data->obs, observed, radius);
+}
+
+static double transit_dist(double time, void *user)
+{
+    event_data_t *data = user;
+    double observed[4], radius;
+    get_observed(data->obs, data->obj, time, observed, &radius);
+    return transit_dist_at(observed);
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -92,14 +124,157 @@ double compute_event(observer_t *obs,
     observer_t obs2 = *obs;
     double ret;
     int rising;
-    struct {
-        observer_t *obs;
-        obj_t *obj;
-    } data = {&obs2, obj};
+    event_data_t data = {&obs2, obj};
     rising = event == EVENT_RISE ? +1 : -1;
-    ret = find_zero(rise_dist, start_time, end_time,
+    ret = find_zero(event == EVENT_TRANSIT ? transit_dist : rise_dist,
+                    start_time, end_time,
                     (end_time - start_time) / 24, precision,
                     rising, &data);
     return ret;
 }
 
+/*
+ * Batch events computation.
+ */
+
+// Number of objects processed by a single worker.
+#define EVENTS_CHUNK_SIZE 256
+
+// Margin used for the analytical circumpolar test, to account for the
+// refraction and the apparent motion of the objects.
+#define EVENTS_ALT_MARGIN (1.0 * DD2R)
+
+typedef struct {
+    observer_t      obs;    // Private copy of the observer.
+    obj_t           **objs;
+    event_times_t   *out;
+    int             nb;
+    double          start_time;
+    double          end_time;
+    double          precision;
+} events_task_t;
+
+/*
+ * Test if an object at infinity is circumpolar or never rises, using the
+ * altitude of its upper and lower culminations:
+ *   alt_max = 90° - |φ - δ|
+ *   alt_min = |φ + δ| - 90°
+ */
+static int events_get_flags(observer_t *obs, obj_t *obj)
+{
+    double pvo[2][4], cirs[4], dec, radius = 0, alt_max, alt_min;
+    obj_get_pvo(obj, obs, pvo);
+    if (pvo[0][3] != 0) return 0; // Not at infinity.
+    convert_framev4(obs, FRAME_ICRF, FRAME_CIRS, pvo[0], cirs);
+    dec = asin(cirs[2] / vec3_norm(cirs));
+    obj_get_info(obj, obs, INFO_RADIUS, &radius);
+    alt_max = M_PI / 2 - fabs(obs->phi - dec) + radius - obs->horizon;
+    alt_min = fabs(obs->phi + dec) - M_PI / 2 + radius - obs->horizon;
+    if (alt_min > EVENTS_ALT_MARGIN) return EVENT_CIRCUMPOLAR;
+    if (alt_max < -EVENTS_ALT_MARGIN) return EVENT_NEVER_RISES;
+    return 0;
+}
+
+static void events_task_run(void *user, int idx)
+{
+    events_task_t *task = (events_task_t*)user + idx;
+    observer_t *obs = &task->obs;
+    event_times_t *out;
+    event_data_t data = {obs};
+    int i, k, nb_steps, sr, st;
+    double step, t, observed[4], radius;
+    // Per object state of the search.
+    struct {
+        int     last_rise_sign;
+        int     last_transit_sign;
+        double  rise; // Upper bound of the found brackets.
+        double  set;
+        double  transit;
+    } *states;
+
+    // Use steps of at most one hour.
+    nb_steps = max(24, (int)ceil((task->end_time - task->start_time) * 24));
+    step = (task->end_time - task->start_time) / nb_steps;
+    states = calloc(task->nb, sizeof(*states));
+
+    obs->tt = task->start_time;
+    observer_update(obs, false);
+    for (i = 0; i < task->nb; i++) {
+        out = &task->out[i];
+        out->rise = out->set = out->transit = NAN;
+        out->flags = events_get_flags(obs, task->objs[i]);
+        states[i].rise = states[i].set = states[i].transit = NAN;
+    }
+
+    // Sample all the objects at each step, and only remember the brackets.
+    for (k = 0; k <= nb_steps; k++) {
+        t = task->start_time + k * step;
+        obs->tt = t;
+        observer_update(obs, false);
+        for (i = 0; i < task->nb; i++) {
+            out = &task->out[i];
+            if (out->flags & EVENT_NEVER_RISES) continue;
+            // Skip if we already found all the events.
+            if (!isnan(states[i].transit) &&
+                    ((out->flags & EVENT_CIRCUMPOLAR) ||
+                     (!isnan(states[i].rise) && !isnan(states[i].set))))
+                continue;
+            get_observed(obs, task->objs[i], t, observed, &radius);
+            sr = sign(rise_dist_at(obs, observed, radius));
+            st = sign(transit_dist_at(observed));
+            if (k > 0 && !(out->flags & EVENT_CIRCUMPOLAR)) {
+                if (sr == 1 && states[i].last_rise_sign == -1 &&
+                        isnan(states[i].rise))
+                    states[i].rise = t;
+                if (sr == -1 && states[i].last_rise_sign == 1 &&
+                        isnan(states[i].set))
+                    states[i].set = t;
+            }
+            if (k > 0 && st == -1 && states[i].last_transit_sign == 1 &&
+                    isnan(states[i].transit))
+                states[i].transit = t;
+            states[i].last_rise_sign = sr;
+            states[i].last_transit_sign = st;
+        }
+    }
+
+    // Refine the brackets found.
+    for (i = 0; i < task->nb; i++) {
+        out = &task->out[i];
+        data.obj = task->objs[i];
+        if (!isnan(states[i].rise))
+            out->rise = newton(rise_dist, states[i].rise - step,
+                               states[i].rise, task->precision, &data);
+        if (!isnan(states[i].set))
+            out->set = newton(rise_dist, states[i].set - step,
+                              states[i].set, task->precision, &data);
+        if (!isnan(states[i].transit))
+            out->transit = newton(transit_dist, states[i].transit - step,
+                                  states[i].transit, task->precision, &data);
+    }
+    free(states);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void compute_events_batch(const observer_t *obs, int nb, obj_t **objs,
+                          double start_time, double end_time,
+                          double precision, event_times_t *out)
+{
+    int i, nb_tasks;
+    events_task_t *tasks, *task;
+
+    nb_tasks = (nb + EVENTS_CHUNK_SIZE - 1) / EVENTS_CHUNK_SIZE;
+    tasks = calloc(nb_tasks, sizeof(*tasks));
+    for (i = 0; i < nb_tasks; i++) {
+        task = &tasks[i];
+        task->obs = *obs;
+        task->objs = objs + i * EVENTS_CHUNK_SIZE;
+        task->out = out + i * EVENTS_CHUNK_SIZE;
+        task->nb = min(EVENTS_CHUNK_SIZE, nb - i * EVENTS_CHUNK_SIZE);
+        task->start_time = start_time;
+        task->end_time = end_time;
+        task->precision = precision;
+    }
+    worker_parallel_for(nb_tasks, events_task_run, tasks);
+    free(tasks);
+}
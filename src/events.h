@@ -16,6 +16,13 @@ typedef struct obj obj_t;
 enum {
     EVENT_RISE      = 1 << 0,
     EVENT_SET       = 1 << 1,
+    EVENT_TRANSIT   = 1 << 2,
+};
+
+// Flags set by compute_events_batch.
+enum {
+    EVENT_CIRCUMPOLAR   = 1 << 0, // Object never sets.
+    EVENT_NEVER_RISES   = 1 << 1, // Object never rises.
 };
 
 // Compute time for a given event.
@@ -28,3 +35,42 @@ double compute_event(observer_t *obs, obj_t *obj, int event,
                      double start_time, double end_time,
                      double precision);
 
+
+/*
+ * Type: event_times_t
+ * Result of <compute_events_batch> for a single object.
+ *
+ * All the times are the first event in the searched range, in MJD (TT),
+ * or NAN if there is no such event.
+ */
+typedef struct event_times {
+    double rise;
+    double set;
+    double transit; // Upper culmination.
+    int    flags;   // Union of EVENT_CIRCUMPOLAR or EVENT_NEVER_RISES.
+} event_times_t;
+
+/*
+ * Function: compute_events_batch
+ * Compute rise, set and transit times of many objects at once.
+ *
+ * The objects are split into chunks that run in parallel with
+ * <worker_parallel_for>, and the call blocks until they are all done.  For
+ * each time sample the observer is updated once and shared by all the
+ * objects of the chunk.  Objects at infinity (stars, DSOs) that are
+ * circumpolar or never rise are detected analytically from their
+ * declination and the observer latitude, and are not searched for rise
+ * and set.
+ *
+ * Parameters:
+ *   obs        - The observer.  Not modified.
+ *   nb         - Number of objects.
+ *   objs       - Array of objects.  Each object must appear only once.
+ *   start_time - Start of the search range in MJD (TT).
+ *   end_time   - End of the search range in MJD (TT).
+ *   precision  - Precision of the results (days).
+ *   out        - Array of nb results.
+ */
+void compute_events_batch(const observer_t *obs, int nb, obj_t **objs,
+                          double start_time, double end_time,
+                          double precision, event_times_t *out);
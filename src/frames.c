@@ -9,6 +9,10 @@
 
 #include "swe.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 static void correct_speed_of_light(double pv[2][3]) {
     double ldt = vec3_norm(pv[0]) * DAU / LIGHT_YEAR_IN_METER * DJY;
     vec3_addk(pv[0], pv[1], -ldt, pv[0]);
@@ -52,107 +56,71 @@ void position_to_apparent(const observer_t *obs, int origin, bool at_inf,
     }
 }
 
-static void convert_frame_forward(const observer_t *obs,
-                        int origin, int dest, bool at_inf, double p[3])
+// Apply the rotations of a forward frame conversion that come before
+// (post = false) or after (post = true) the refraction.
+static void rotate_forward(const observer_t *obs, int origin, int dest,
+                           bool post, double p[3])
 {
-    const eraASTROM *astrom = &obs->astrom;
+    double mat[3][3];
 
-    if (origin == FRAME_ASTROM) {
-        astrometric_to_apparent(obs, p, at_inf, p);
-    }
-    // ICRS to CIRS
-    if (origin < FRAME_CIRS && dest >= FRAME_CIRS) {
-        // Bias-precession-nutation, giving CIRS proper direction.
-        eraRxp(astrom->bpn, p, p);
-    }
-
-    if (dest == FRAME_JNOW) {
-        // The bridge between the classical and CIRS systems is the equation of
-        // the origins, which is ERA−GST or equivalently αCIRS − αapparent; its
-        // value is returned by several of the SOFA astrometry functions in
-        // case it is needed.
-        double mat[3][3];
-        mat3_set_identity(mat);
-        mat3_rz(-obs->eo, mat, mat);
-        mat3_mul_vec3(mat, p, p);
-        return;
-    }
-
-    // CIRS to OBSERVED.
-    if (origin < FRAME_OBSERVED && dest >= FRAME_OBSERVED) {
-        // Precomputed earth rotation and polar motion.
-        // Ignores Diurnal aberration for the moment
-        mat3_mul_vec3(obs->ri2h, p, p);
-
-        if (obs->refraction) {
-            if (at_inf) {
-                refraction(p, obs->refa, obs->refb, p);
-            } else {
-                // Special case for null's vectors
-                double dist = vec3_norm(p);
-                if (dist == 0.0) {
-                    vec3_set(p, 0, 0, 0);
-                    return;
-                }
-                vec3_mul(1.0 / dist, p, p);
-                refraction(p, obs->refa, obs->refb, p);
-                vec3_mul(dist, p, p);
-            }
+    if (!post) {
+        // ICRS to CIRS
+        if (origin < FRAME_CIRS && dest >= FRAME_CIRS) {
+            // Bias-precession-nutation, giving CIRS proper direction.
+            eraRxp(obs->astrom.bpn, p, p);
+        }
+        if (dest == FRAME_JNOW) {
+            // The bridge between the classical and CIRS systems is the
+            // equation of the origins, which is ERA−GST or equivalently
+            // αCIRS − αapparent; its value is returned by several of the
+            // SOFA astrometry functions in case it is needed.
+            mat3_set_identity(mat);
+            mat3_rz(-obs->eo, mat, mat);
+            mat3_mul_vec3(mat, p, p);
+            return;
+        }
+        // CIRS to OBSERVED.
+        if (origin < FRAME_OBSERVED && dest >= FRAME_OBSERVED) {
+            // Precomputed earth rotation and polar motion.
+            // Ignores Diurnal aberration for the moment
+            mat3_mul_vec3(obs->ri2h, p, p);
         }
+        return;
     }
 
+    if (dest == FRAME_JNOW) return;
     // OBSERVED to MOUNT.
     if (origin < FRAME_MOUNT && dest == FRAME_MOUNT) {
         mat3_mul_vec3(obs->ro2m, p, p);
         return;
     }
-
     // OBSERVED to VIEW.
     if (origin < FRAME_VIEW && dest >= FRAME_VIEW)
         mat3_mul_vec3(obs->ro2v, p, p);
 }
 
-static void convert_frame_backward(const observer_t *obs,
-                        int origin, int dest, bool at_inf, double p[3])
+// Same as rotate_forward for the backward conversions.
+static void rotate_backward(const observer_t *obs, int origin, int dest,
+                            bool post, double p[3])
 {
-    const eraASTROM *astrom = &obs->astrom;
-
-    // VIEW to OBSERVED.
-    if (origin >= FRAME_VIEW && dest < FRAME_VIEW)
-        mat3_mul_vec3(obs->rv2o, p, p);
-
-    // OBSERVED to MOUNT.
-    if (dest == FRAME_MOUNT) {
-        mat3_mul_vec3(obs->ro2m, p, p);
+    double mat[3][3];
+
+    if (!post) {
+        // VIEW to OBSERVED.
+        if (origin >= FRAME_VIEW && dest < FRAME_VIEW)
+            mat3_mul_vec3(obs->rv2o, p, p);
+        // OBSERVED to MOUNT.
+        if (dest == FRAME_MOUNT)
+            mat3_mul_vec3(obs->ro2m, p, p);
         return;
     }
 
+    if (dest == FRAME_MOUNT) return;
     // OBSERVED to CIRS
-    if (origin >= FRAME_OBSERVED && dest < FRAME_OBSERVED) {
-        if (obs->refraction){
-            if (at_inf) {
-                refraction_inv(p, obs->refa, obs->refb, p);
-            } else {
-                // Special case for null's vectors
-                double dist = vec3_norm(p);
-                if (dist == 0.0) {
-                    vec3_set(p, 0, 0, 0);
-                    return;
-                }
-                vec3_mul(1.0 / dist, p, p);
-                refraction_inv(p, obs->refa, obs->refb, p);
-                vec3_mul(dist, p, p);
-            }
-        }
+    if (origin >= FRAME_OBSERVED && dest < FRAME_OBSERVED)
         mat3_mul_vec3(obs->rh2i, p, p);
-    }
     // JNow to CIRS
     if (origin == FRAME_JNOW && dest < FRAME_JNOW) {
-        // The bridge between the classical and CIRS systems is the equation of
-        // the origins, which is ERA−GST or equivalently αCIRS − αapparent; its
-        // value is returned by several of the SOFA astrometry functions in
-        // case it is needed.
-        double mat[3][3];
         mat3_set_identity(mat);
         mat3_rz(obs->eo, mat, mat);
         mat3_mul_vec3(mat, p, p);
@@ -160,14 +128,98 @@ static void convert_frame_backward(const observer_t *obs,
     // CIRS to ICRF
     if (origin >= FRAME_CIRS && dest < FRAME_CIRS) {
         // Bias-precession-nutation
-        mat3_mul_vec3(astrom->bpn, p, p);
+        mat3_mul_vec3(obs->astrom.bpn, p, p);
+    }
+}
+
+// Return whether a conversion goes through the refraction.
+static bool has_refraction(const observer_t *obs, int origin, int dest)
+{
+    if (!obs->refraction) return false;
+    return (origin < FRAME_OBSERVED && dest >= FRAME_OBSERVED &&
+            dest != FRAME_JNOW) ||
+           (origin >= FRAME_OBSERVED && dest < FRAME_OBSERVED);
+}
+
+#ifdef HAVE_PTHREAD
+// Protects the creation of the observers cached rotations, since we can
+// convert frames with the same observer from several threads at once (see
+// render_modules).
+static pthread_mutex_t g_rframes_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void frame_reset_rotations(observer_t *obs)
+{
+    memset(obs->rframes_valid, 0, sizeof(obs->rframes_valid));
+    obs->rframes_nb = 0;
+}
+
+// Compute the composite rotations of a pair of frames.
+static void build_rotation(const observer_t *obs, int origin, int dest,
+                           frame_rotation_t *r)
+{
+    int i;
+    double p[3];
+
+    // Apply the rotations to the three axes to get the matrix rows.
+    for (i = 0; i < 3; i++) {
+        vec3_set(p, i == 0, i == 1, i == 2);
+        if (dest > origin) rotate_forward(obs, origin, dest, false, p);
+        if (dest < origin) rotate_backward(obs, origin, dest, false, p);
+        vec3_copy(p, r->pre[i]);
+        vec3_set(p, i == 0, i == 1, i == 2);
+        if (dest > origin) rotate_forward(obs, origin, dest, true, p);
+        if (dest < origin) rotate_backward(obs, origin, dest, true, p);
+        vec3_copy(p, r->post[i]);
     }
-    if (dest == FRAME_ASTROM) {
-        apparent_to_astrometric(obs, p, at_inf, p);
+    mat3_mul(r->post, r->pre, r->full);
+}
+
+// Return the rotations of a pair of frames, built on first use and cached
+// in the observer.
+static const frame_rotation_t *get_rotation(
+        const observer_t *obs, int origin, int dest)
+{
+    // The cache is not part of the observer state.
+    observer_t *o = (observer_t*)obs;
+
+    if (__atomic_load_n(&obs->rframes_valid[origin][dest], __ATOMIC_ACQUIRE))
+        return &obs->rframes[origin][dest];
+
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_rframes_lock);
+#endif
+    if (!obs->rframes_valid[origin][dest]) {
+        build_rotation(obs, origin, dest, &o->rframes[origin][dest]);
+        o->rframes_nb++;
+        __atomic_store_n(&o->rframes_valid[origin][dest], 1,
+                         __ATOMIC_RELEASE);
     }
-    assert(dest>=FRAME_ASTROM);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_rframes_lock);
+#endif
+    return &obs->rframes[origin][dest];
+}
 
-    vec3_normalize(p, p);
+// Apply the refraction, or its inverse, to a vector in the observed frame.
+// Return false for a null vector.
+static bool apply_refraction(const observer_t *obs, bool inv, bool at_inf,
+                             double p[3])
+{
+    double dist = 1.0;
+
+    if (!at_inf) {
+        // Special case for null's vectors
+        dist = vec3_norm(p);
+        if (dist == 0.0) return false;
+        vec3_mul(1.0 / dist, p, p);
+    }
+    if (inv)
+        refraction_inv(p, obs->refa, obs->refb, p);
+    else
+        refraction(p, obs->refa, obs->refb, p);
+    if (!at_inf) vec3_mul(dist, p, p);
+    return true;
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -177,14 +229,31 @@ int convert_frame(const observer_t *obs,
 {
     PROFILE(convert_frame, PROFILE_AGGREGATE);
     obs = obs ?: (observer_t*)core->observer;
+    const frame_rotation_t *r;
 
     vec3_copy(in, out);
     assert(!isnan(out[0] + out[1] + out[2]));
+    if (dest == origin) return 0;
+    r = get_rotation(obs, origin, dest);
+
+    if (origin == FRAME_ASTROM)
+        astrometric_to_apparent(obs, out, at_inf, out);
+
+    if (has_refraction(obs, origin, dest)) {
+        mat3_mul_vec3(r->pre, out, out);
+        if (!apply_refraction(obs, dest < origin, at_inf, out)) {
+            vec3_set(out, 0, 0, 0);
+            return 0;
+        }
+        mat3_mul_vec3(r->post, out, out);
+    } else {
+        mat3_mul_vec3(r->full, out, out);
+    }
 
-    if (dest > origin) {
-        convert_frame_forward(obs, origin, dest, at_inf, out);
-    } else if (dest < origin) {
-        convert_frame_backward(obs, origin, dest, at_inf, out);
+    if (dest < origin && dest != FRAME_MOUNT) {
+        if (dest == FRAME_ASTROM)
+            apparent_to_astrometric(obs, out, at_inf, out);
+        vec3_normalize(out, out);
     }
 
     assert(!isnan(out[0] + out[1] + out[2]));
@@ -205,6 +274,70 @@ int convert_framev4(const observer_t *obs,
     }
 }
 
+// Multiply all the vectors by a matrix.  Written with plain loops over
+// scalars so that the compiler can vectorize them.
+static void rotate_batch(const double mat[3][3], int n,
+                         const double (*in)[3], double (*out)[3])
+{
+    int i;
+    double x, y, z;
+    const double m00 = mat[0][0], m01 = mat[0][1], m02 = mat[0][2],
+                 m10 = mat[1][0], m11 = mat[1][1], m12 = mat[1][2],
+                 m20 = mat[2][0], m21 = mat[2][1], m22 = mat[2][2];
+
+    for (i = 0; i < n; i++) {
+        x = in[i][0];
+        y = in[i][1];
+        z = in[i][2];
+        out[i][0] = x * m00 + y * m10 + z * m20;
+        out[i][1] = x * m01 + y * m11 + z * m21;
+        out[i][2] = x * m02 + y * m12 + z * m22;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int convert_frame_batch(const observer_t *obs,
+                        int origin, int dest, bool at_inf,
+                        int n, const double (*in)[3], double (*out)[3])
+{
+    PROFILE(convert_frame_batch, PROFILE_AGGREGATE);
+    int i;
+    double norm;
+    obs = obs ?: (observer_t*)core->observer;
+    const frame_rotation_t *r;
+
+    // The astrometric frame conversions are not linear.
+    if (origin == FRAME_ASTROM || dest == FRAME_ASTROM) {
+        for (i = 0; i < n; i++)
+            convert_frame(obs, origin, dest, at_inf, in[i], out[i]);
+        return 0;
+    }
+    r = get_rotation(obs, origin, dest);
+
+    if (has_refraction(obs, origin, dest)) {
+        rotate_batch(r->pre, n, in, out);
+        for (i = 0; i < n; i++) {
+            if (!apply_refraction(obs, dest < origin, at_inf, out[i]))
+                vec3_set(out[i], NAN, NAN, NAN); // Null vector marker.
+        }
+        rotate_batch(r->post, n, out, out);
+    } else {
+        rotate_batch(r->full, n, in, out);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (isnan(out[i][0])) {
+            vec3_set(out[i], 0, 0, 0);
+            continue;
+        }
+        if (dest < origin && dest != FRAME_MOUNT) {
+            norm = vec3_norm(out[i]);
+            if (norm) vec3_mul(1.0 / norm, out[i], out[i]);
+        }
+    }
+    return 0;
+}
+
 void position_to_astrometric(const observer_t *obs, int origin,
                                 const double in[2][3], double out[2][3])
 {
@@ -306,10 +439,12 @@ void apparent_to_astrometric(const observer_t *obs, const double in[3],
 bool frame_get_rotation(const observer_t *obs, int origin, int dest,
                         double rot[3][3])
 {
-    // For the moment we only support ICRF to VIEW, without refraction.
-    if (origin != FRAME_ICRF || dest != FRAME_VIEW || obs->refraction)
-        return false;
-    mat3_copy(obs->rc2v, rot);
+    const frame_rotation_t *r;
+
+    if (origin == FRAME_ASTROM || dest == FRAME_ASTROM) return false;
+    if (has_refraction(obs, origin, dest)) return false;
+    r = get_rotation(obs, origin, dest);
+    mat3_copy(r->full, rot);
     return true;
 }
 
@@ -462,4 +597,105 @@ static void test_convert_origin(void)
 
 TEST_REGISTER(NULL, test_convert_origin, TEST_AUTO)
 
+static void test_convert_frame_batch(void)
+{
+    observer_t *obs;
+    double v[64][3], out[64][3], p[3], rot[3][3];
+    int i, origin, dest, refraction, at_inf;
+
+    core_init(100, 100, 1.0);
+    obs = core->observer;
+    obj_set_attr((obj_t*)obs, "utc", 58450.0);
+    obj_set_attr((obj_t*)obs, "latitude", 45 * DD2R);
+    obj_set_attr((obj_t*)obs, "pitch", 20 * DD2R);
+
+    for (refraction = 0; refraction < 2; refraction++) {
+        obs->refraction = refraction;
+        observer_update(obs, false);
+
+        // The cached matrices match the observer ones.
+        assert(frame_get_rotation(obs, FRAME_ICRF, FRAME_VIEW, rot) ==
+               !refraction);
+        if (!refraction) {
+            for (i = 0; i < 3; i++)
+                assert(vec3_dist(rot[i], obs->rc2v[i]) < 1e-12);
+        }
+
+        for (at_inf = 0; at_inf < 2; at_inf++)
+        for (origin = 0; origin < FRAMES_NB; origin++)
+        for (dest = 0; dest < FRAMES_NB; dest++) {
+            // Astrometric to apparent is only implemented at infinity.
+            if (!at_inf && (origin == FRAME_ASTROM || dest == FRAME_ASTROM))
+                continue;
+            for (i = 0; i < ARRAY_SIZE(v); i++) {
+                vec3_set(v[i], cos(i), sin(i * 1.3), cos(i * 0.7) - 0.2);
+                vec3_normalize(v[i], v[i]);
+                if (!at_inf) vec3_mul(1 + i, v[i], v[i]);
+            }
+            convert_frame_batch(obs, origin, dest, at_inf, ARRAY_SIZE(v),
+                                v, out);
+            for (i = 0; i < ARRAY_SIZE(v); i++) {
+                convert_frame(obs, origin, dest, at_inf, v[i], p);
+                assert(vec3_dist(p, out[i]) < 1e-9 * vec3_norm(p) + 1e-12);
+            }
+            // In place conversion.
+            convert_frame_batch(obs, origin, dest, at_inf, ARRAY_SIZE(v),
+                                v, v);
+            assert(memcmp(v, out, sizeof(v)) == 0);
+        }
+
+        // Going through an intermediate frame gives the same result.
+        vec3_set(v[0], 0.3, 0.4, 0.5);
+        vec3_normalize(v[0], v[0]);
+        convert_frame(obs, FRAME_ICRF, FRAME_VIEW, true, v[0], out[0]);
+        convert_frame(obs, FRAME_ICRF, FRAME_OBSERVED, true, v[0], p);
+        convert_frame(obs, FRAME_OBSERVED, FRAME_VIEW, true, p, p);
+        assert(vec3_dist(p, out[0]) < 1e-12);
+        convert_frame(obs, FRAME_VIEW, FRAME_ICRF, true, out[0], p);
+        assert(vec3_dist(p, v[0]) < 1e-9);
+    }
+
+    // The rotations are only cached for the pairs used since the last
+    // observer update.
+    obj_set_attr((obj_t*)obs, "utc", 58451.0);
+    observer_update(obs, false);
+    assert(obs->rframes_nb == 0);
+    convert_frame(obs, FRAME_ICRF, FRAME_VIEW, true, v[0], p);
+    convert_frame(obs, FRAME_ICRF, FRAME_VIEW, true, p, p);
+    assert(obs->rframes_nb == 1);
+    assert(obs->rframes_valid[FRAME_ICRF][FRAME_VIEW]);
+    for (i = 0; i < 3; i++) {
+        assert(vec3_dist(obs->rframes[FRAME_ICRF][FRAME_VIEW].full[i],
+                         obs->rc2v[i]) < 1e-12);
+    }
+}
+
+TEST_REGISTER(NULL, test_convert_frame_batch, TEST_AUTO)
+
+// Check that all the frame pairs used to render a frame stay cached.
+static void test_rotations_render(void)
+{
+    observer_t *obs;
+    int origin, dest, size, nb = 0;
+
+    core_init(100, 100, 1.0);
+    obs = core->observer;
+    obj_set_attr((obj_t*)obs, "utc", 58452.0);
+    texture_set_headless(true);
+    free(core_render_image(64, 48, 1.0, "png", 0, &size));
+    texture_set_headless(false);
+    for (origin = 0; origin < FRAMES_NB; origin++) {
+        for (dest = 0; dest < FRAMES_NB; dest++) {
+            if (obs->rframes_valid[origin][dest]) nb++;
+        }
+    }
+    // Each pair was built only once, even though a frame uses more than a
+    // few of them.
+    assert(nb > 8 && nb == obs->rframes_nb);
+    assert(obs->rframes_valid[FRAME_OBSERVED][FRAME_VIEW]);
+    assert(obs->rframes_valid[FRAME_VIEW][FRAME_ICRF]);
+}
+
+TEST_REGISTER(NULL, test_rotations_render, TEST_AUTO)
+
 #endif
@@ -96,6 +96,17 @@ enum {
 
 #define FRAMES_NB (FRAME_VIEW + 1)
 
+/*
+ * Type: frame_rotation_t
+ * Composite rotations from a frame to another, cached in the observer.
+ * The refraction, if any, is applied between pre and post.
+ */
+typedef struct {
+    double pre[3][3];   // Rotation before the refraction.
+    double post[3][3];  // Rotation after the refraction.
+    double full[3][3];  // Whole rotation when there is no refraction.
+} frame_rotation_t;
+
 /* Function: convert_frame
  * Rotate the passed 3D apparent coordinate vector from a Reference Frame to
  * another.
@@ -144,6 +155,41 @@ int convert_framev4(const observer_t *obs,
                     int origin, int dest,
                     const double in[S 4], double out[S 4]);
 
+/*
+ * Function: convert_frame_batch
+ * Same as convert_frame, for an array of vectors.
+ *
+ * When the conversion doesn't involve the FRAME_ASTROM frame, the vectors
+ * are rotated with the observer cached matrices, and the refraction, if
+ * any, is applied in a single pass between the two rotations.  This is
+ * much faster than calling convert_frame on each vector.
+ *
+ * Parameters:
+ *  obs     - The observer.  If NULL we use the current core observer.
+ *  origin  - Origin coordinates.  One of the <FRAME> enum values.
+ *  dest    - Destination coordinates.  One of the <FRAME> enum values.
+ *  at_inf  - true if all the vectors are normalized directions.
+ *  n       - Number of vectors.
+ *  in      - The input coordinates.
+ *  out     - The output coordinates.  Can be the same as the input.
+ *
+ * Return:
+ *  0 for success.
+ */
+int convert_frame_batch(const observer_t *obs,
+                        int origin, int dest, bool at_inf,
+                        int n, const double (*in)[3], double (*out)[3]);
+
+/*
+ * Function: frame_reset_rotations
+ * Invalidate the observer cached rotation matrices of the frame pairs.
+ *
+ * Called by observer_update after the observer matrices have changed.  The
+ * rotation of a pair is then rebuilt the first time it is used, so that
+ * convert_frame only has to do one or two matrix products per vector.
+ */
+void frame_reset_rotations(observer_t *obs);
+
 /* Enum: ORIGIN
  * Represent a reference system, i.e. the origin of a reference frame and the
  * associated intertial frame.
@@ -0,0 +1,158 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+// Degrade change at each decision.
+#define STEP 0.25
+// Degrade when we are over target * HIGH, restore under target * LOW.
+#define HIGH 1.05
+#define LOW 0.75
+// Number of frames to wait after a change before the next decision.
+#define COOLDOWN 10
+// Smoothing factor of the measured times.
+#define SMOOTH 0.1
+
+typedef struct {
+    UT_hash_handle  hh;
+    char            *name;
+    char            *counter; // Name of the profiler counter.
+    double          cost;     // Smoothed render time (s).
+    double          degrade;
+} client_t;
+
+static struct {
+    client_t    *clients; // Hash table of all the modules.
+    double      target;
+    double      frame_time; // Smoothed frame render time (s).
+    int         cooldown;
+} g_governor = {};
+
+static client_t *get_client(const char *name)
+{
+    client_t *client;
+    HASH_FIND_STR(g_governor.clients, name, client);
+    if (client) return client;
+    client = calloc(1, sizeof(*client));
+    client->name = strdup(name);
+    asprintf(&client->counter, "governor_%s", name);
+    HASH_ADD_KEYPTR(hh, g_governor.clients, client->name,
+                    strlen(client->name), client);
+    return client;
+}
+
+void governor_set_target(double frame_time)
+{
+    client_t *client, *tmp;
+    g_governor.target = frame_time;
+    g_governor.cooldown = 0;
+    if (frame_time) return;
+    HASH_ITER(hh, g_governor.clients, client, tmp)
+        client->degrade = 0;
+}
+
+double governor_get_target(void)
+{
+    return g_governor.target;
+}
+
+double governor_get_degrade(const char *name)
+{
+    return get_client(name)->degrade;
+}
+
+void governor_report(const char *name, double time)
+{
+    client_t *client = get_client(name);
+    client->cost = client->cost ? mix(client->cost, time, SMOOTH) : time;
+}
+
+void governor_frame(double time)
+{
+    client_t *client, *tmp, *best = NULL;
+    const double target = g_governor.target;
+
+    g_governor.frame_time = g_governor.frame_time ?
+        mix(g_governor.frame_time, time, SMOOTH) : time;
+    profile_counter("governor_frame_time", g_governor.frame_time * 1000);
+    HASH_ITER(hh, g_governor.clients, client, tmp)
+        profile_counter(client->counter, client->degrade);
+
+    if (!target) return;
+    if (g_governor.cooldown > 0) {
+        g_governor.cooldown--;
+        return;
+    }
+
+    if (g_governor.frame_time > target * HIGH) {
+        // Degrade the most expensive module that can still be degraded.
+        HASH_ITER(hh, g_governor.clients, client, tmp) {
+            if (client->degrade >= 1) continue;
+            if (!best || client->cost > best->cost) best = client;
+        }
+        if (!best) return;
+        best->degrade = min(1.0, best->degrade + STEP);
+    } else if (g_governor.frame_time < target * LOW) {
+        // Restore the most degraded module.
+        HASH_ITER(hh, g_governor.clients, client, tmp) {
+            if (client->degrade <= 0) continue;
+            if (!best || client->degrade > best->degrade) best = client;
+        }
+        if (!best) return;
+        best->degrade = max(0.0, best->degrade - STEP);
+    } else {
+        return;
+    }
+    LOG_D("Governor: %s degrade %.2f (frame %.1f ms)", best->name,
+          best->degrade, g_governor.frame_time * 1000);
+    g_governor.cooldown = COOLDOWN;
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_governor(void)
+{
+    typeof(g_governor) governor = g_governor;
+    client_t *client, *tmp;
+    int i;
+
+    memset(&g_governor, 0, sizeof(g_governor));
+    governor_set_target(0.010);
+    // 'a' is the most expensive module, so it gets degraded first.
+    for (i = 0; i < 100; i++) {
+        governor_report("a", 0.012);
+        governor_report("b", 0.004);
+        governor_frame(0.016);
+    }
+    assert(governor_get_degrade("a") == 1);
+    assert(governor_get_degrade("b") > 0);
+
+    // In the hysteresis band, nothing changes.
+    for (i = 0; i < 100; i++) governor_frame(0.009);
+    assert(governor_get_degrade("a") == 1);
+
+    // Fast enough: restore everything.
+    for (i = 0; i < 200; i++) governor_frame(0.002);
+    assert(governor_get_degrade("a") == 0);
+    assert(governor_get_degrade("b") == 0);
+
+    HASH_ITER(hh, g_governor.clients, client, tmp) {
+        HASH_DEL(g_governor.clients, client);
+        free(client->name);
+        free(client->counter);
+        free(client);
+    }
+    g_governor = governor;
+}
+
+TEST_REGISTER(NULL, test_governor, TEST_AUTO);
+
+#endif
@@ -0,0 +1,71 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+/*
+ * File: governor.h
+ * Frame time governor.
+ *
+ * The governor measures the render time of each adaptive module, and if
+ * the total frame render time goes over the target, it lowers the quality
+ * of the most expensive one.  When the frame time goes back well under
+ * the target, the quality is restored, one step at a time, starting with
+ * the most degraded module.  The gap between the two thresholds and a
+ * cool down period after each change prevent oscillations.
+ *
+ * The quality is passed to the modules with the painter 'degrade' value,
+ * from 0 (full quality) to 1 (lowest quality).  Each module decides what
+ * to do with it, for example render less faint stars, or update less
+ * satellites per frame.
+ *
+ * The decisions are shown in the profiler output as counters named
+ * 'governor_<module>'.
+ */
+
+/*
+ * Function: governor_set_target
+ * Set the target render time per frame in seconds, or zero to disable the
+ * governor and restore the full quality of all the modules.
+ */
+void governor_set_target(double frame_time);
+
+/*
+ * Function: governor_get_target
+ * Return the target render time per frame in seconds.
+ */
+double governor_get_target(void);
+
+/*
+ * Function: governor_get_degrade
+ * Return the current degrade value of a module, from 0 to 1.
+ */
+double governor_get_degrade(const char *name);
+
+/*
+ * Function: governor_report
+ * Report the time spent rendering a module in the current frame.
+ *
+ * Parameters:
+ *   name   - Name of the module.
+ *   time   - Render time in seconds.
+ */
+void governor_report(const char *name, double time);
+
+/*
+ * Function: governor_frame
+ * Update the modules degrade values at the end of a frame.
+ *
+ * Parameters:
+ *   time   - Total render time of the frame in seconds.
+ */
+void governor_frame(double time);
+
+#endif // GOVERNOR_H
@@ -12,6 +12,10 @@
 #include <string.h>
 #include <zlib.h> // For crc32.
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 // Should be good enough...
 #define URL_MAX_SIZE 4096
 
@@ -21,6 +25,9 @@
 // past its limit if the items are still in use!
 #define CACHE_SIZE (256 * (1 << 20))
 
+// Initial number of nodes of the iterators.
+#define ITER_INITIAL_CAPACITY 1024
+
 // Flags of the tiles:
 enum {
     // Bit fields set by tile if we know that we don't have further tiles
@@ -77,9 +84,41 @@ typedef struct {
     texture_t   *tex;
 } img_tile_t;
 
+/*
+ * Type: visible_tile_t
+ * A tile from the visible set of a survey.
+ */
+typedef struct {
+    int         pix;
+    double      cap[4];
+} visible_tile_t;
+
 // Gobal cache for all the tiles.
 static cache_t *g_cache = NULL;
 
+// Pool of iterators buffers, so that we don't allocate memory at each
+// traversal.
+static struct {
+    struct {
+        void    *nodes;
+        int     capacity;
+    } buffers[8];
+    int nb;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+} g_iter_pool = {
+#ifdef HAVE_PTHREAD
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
+// Global tiles loading statistics.
+static struct {
+    int nb_loaded;
+    int nb_errors;
+} g_stats = {};
+
 struct hips {
     char        *url;
     char        *service_url;
@@ -109,6 +148,18 @@ struct hips {
 
     // The settings as passed in the create function.
     hips_settings_t settings;
+
+    // Tiles rendered in the last frame with their bounding caps, so that
+    // when the view only moved a little we just update the frontier of the
+    // visible area instead of traversing the whole tree again.
+    struct {
+        bool    valid;
+        int     order;
+        double  view_cap[4]; // Painter bounding cap at the time.
+        int     nb;
+        int     capacity;
+        visible_tile_t *tiles;
+    } visible;
 };
 
 
@@ -267,37 +318,90 @@ static bool img_is_transparent(
 
 int hips_traverse(void *user, int callback(int order, int pix, void *user))
 {
-    typedef struct {
-        int order;
-        int pix;
-    } node_t;
-    node_t queue[1024];
-    const int n = ARRAY_SIZE(queue);
-    int start = 0, size = 12, r, i;
-    int order, pix;
-    // Enqueue the first 12 pix at order 0.
-    for (i = 0; i < 12; i++) {queue[i] = (node_t){0, i};}
-    while (size) {
-        order = queue[start % n].order;
-        pix = queue[start % n].pix;
-        start++;
-        size--;
+    hips_iterator_t iter;
+    int order, pix, r = 0;
+    hips_iter_init(&iter);
+    while (hips_iter_next(&iter, &order, &pix)) {
         r = callback(order, pix, user);
-        if (r < 0) return r;
-        if (r == 1) {
-            // Enqueue the 4 children tiles.
-            if (size + 4 >= n) {
-                // No more space.
-                LOG_W("Abort HIPS traverse");
-                return -1;
-            }
-            for (i = 0; i < 4; i++) {
-                queue[(start + size) % n] = (node_t){order + 1, pix * 4 + i};
-                size++;
-            }
-        }
+        if (r < 0) break;
+        if (r == 1) hips_iter_push_children(&iter, order, pix);
     }
-    return 0;
+    hips_iter_release(&iter);
+    return min(r, 0);
+}
+
+// Return a nodes buffer from the iterators pool, or NULL if the pool is
+// empty.
+static void *iter_pool_get(int *capacity)
+{
+    void *nodes = NULL;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_iter_pool.lock);
+#endif
+    if (g_iter_pool.nb) {
+        g_iter_pool.nb--;
+        nodes = g_iter_pool.buffers[g_iter_pool.nb].nodes;
+        *capacity = g_iter_pool.buffers[g_iter_pool.nb].capacity;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_iter_pool.lock);
+#endif
+    return nodes;
+}
+
+// Give a nodes buffer back to the iterators pool.
+static void iter_pool_put(void *nodes, int capacity)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_iter_pool.lock);
+#endif
+    if (g_iter_pool.nb < ARRAY_SIZE(g_iter_pool.buffers)) {
+        g_iter_pool.buffers[g_iter_pool.nb].nodes = nodes;
+        g_iter_pool.buffers[g_iter_pool.nb].capacity = capacity;
+        g_iter_pool.nb++;
+        nodes = NULL;
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_iter_pool.lock);
+#endif
+    free(nodes);
+}
+
+static void iter_push(hips_iterator_t *iter, int order, int pix)
+{
+    typedef __typeof__(iter->nodes[0]) node_t;
+    node_t *nodes;
+    int i;
+
+    if (iter->size == iter->capacity) {
+        // Grow the buffer, unrolling the ring at the same time.
+        nodes = malloc(iter->capacity * 2 * sizeof(*nodes));
+        for (i = 0; i < iter->size; i++)
+            nodes[i] = iter->nodes[(iter->start + i) % iter->capacity];
+        free(iter->nodes);
+        iter->nodes = nodes;
+        iter->capacity *= 2;
+        iter->start = 0;
+    }
+    i = iter->depth_first ? iter->size :
+                            (iter->start + iter->size) % iter->capacity;
+    iter->nodes[i] = (node_t){order, pix};
+    iter->size++;
+}
+
+static void iter_init(hips_iterator_t *iter, bool depth_first)
+{
+    int i;
+    memset(iter, 0, sizeof(*iter));
+    iter->depth_first = depth_first;
+    iter->nodes = iter_pool_get(&iter->capacity);
+    if (!iter->nodes) {
+        iter->capacity = ITER_INITIAL_CAPACITY;
+        iter->nodes = malloc(iter->capacity * sizeof(*iter->nodes));
+    }
+    // Enqueue the first 12 pix at order 0.
+    for (i = 0; i < 12; i++)
+        iter_push(iter, 0, depth_first ? 11 - i : i);
 }
 
 /*
@@ -306,14 +410,16 @@ int hips_traverse(void *user, int callback(int order, int pix, void *user))
  */
 void hips_iter_init(hips_iterator_t *iter)
 {
-    int i;
-    typedef __typeof__(iter->queue[0]) node_t;
-    memset(iter, 0, sizeof(*iter));
-    // Enqueue the first 12 pix at order 0.
-    iter->size = 12;
-    for (i = 0; i < 12; i++) {
-        iter->queue[i] = (node_t){0, i};
-    }
+    iter_init(iter, false);
+}
+
+/*
+ * Function: hips_iter_init_depth_first
+ * Same as hips_iter_init, but for a depth first traversal.
+ */
+void hips_iter_init_depth_first(hips_iterator_t *iter)
+{
+    iter_init(iter, true);
 }
 
 /*
@@ -324,12 +430,18 @@ void hips_iter_init(hips_iterator_t *iter)
  */
 bool hips_iter_next(hips_iterator_t *iter, int *order, int *pix)
 {
-    const int n = ARRAY_SIZE(iter->queue);
+    int i;
     if (!iter->size) return false;
-    // Get the first tile from the queue.
-    *order = iter->queue[iter->start % n].order;
-    *pix = iter->queue[iter->start % n].pix;
-    iter->start++;
+    if (iter->depth_first) {
+        // Get the last tile from the stack.
+        i = iter->size - 1;
+    } else {
+        // Get the first tile from the queue.
+        i = iter->start;
+        iter->start = (iter->start + 1) % iter->capacity;
+    }
+    *order = iter->nodes[i].order;
+    *pix = iter->nodes[i].pix;
     iter->size--;
     return true;
 }
@@ -338,29 +450,36 @@ bool hips_iter_next(hips_iterator_t *iter, int *order, int *pix)
  * Function: hips_iter_push_children
  * Add the four children of the giver pixel to the iterator.
  *
- * The children will be retrieved after all the currently queued values
- * from the iterator have been processed.
+ * In breadth first mode, the children will be retrieved after all the
+ * currently queued values from the iterator have been processed.
  */
 void hips_iter_push_children(hips_iterator_t *iter, int order, int pix)
 {
-    typedef __typeof__(iter->queue[0]) node_t;
-    const int n = ARRAY_SIZE(iter->queue);
     int i;
-    // Enqueue the next four tiles.
-    if (iter->size + 4 >= n) {
-        // Todo: we should probably use a dynamic array instead.
-        LOG_E("No more space!");
-        return;
-    }
-    for (i = 0; i < 4; i++) {
-        iter->queue[(iter->start + iter->size) % n] = (node_t) {
-            order + 1, pix * 4 + i
-        };
-        iter->size++;
-    }
+    // In depth first mode, push in reverse order so that the first child
+    // is the next one we get.
+    for (i = 0; i < 4; i++)
+        iter_push(iter, order + 1, pix * 4 + (iter->depth_first ? 3 - i : i));
+}
+
+/*
+ * Function: hips_iter_release
+ * Release the memory used by an iterator.
+ */
+void hips_iter_release(hips_iterator_t *iter)
+{
+    if (iter->nodes) iter_pool_put(iter->nodes, iter->capacity);
+    iter->nodes = NULL;
 }
 
 
+// Update the cache cost of a tile.
+static void set_tile_cost(const hips_t *hips, int order, int pix, int cost)
+{
+    tile_key_t key = {hips->hash, order, pix};
+    cache_set_cost(g_cache, &key, sizeof(key), sizeof(tile_t) + cost);
+}
+
 /*
  * Function: hips_get_tile_texture
  * Get the texture for a given hips tile.
@@ -410,12 +529,14 @@ texture_t *hips_get_tile_texture(
             *loading_complete = true;
     }
 
-    // Create texture if needed.
+    // Create texture if needed.  Once the image has been uploaded, the
+    // cost of the tile is the memory used by the texture.
     if (tile && tile->img && !tile->tex) {
         tile->tex = texture_from_data(tile->img, tile->w, tile->h, tile->bpp,
                                       0, 0, tile->w, tile->h, 0);
         free(tile->img);
         tile->img = NULL;
+        set_tile_cost(hips, order, pix, tile->tex->mem_size);
     }
     if (tile && tile->tex) {
         *loading_complete = true;
@@ -493,6 +614,8 @@ int hips_render(hips_t *hips, const painter_t *painter_,
     painter_t painter = *painter_;
     if (painter.color[3] == 0.0) return 0;
     if (!hips_is_ready(hips)) return 0;
+    // Split the tiles less if the governor asks for it.
+    split_order = max(0, split_order - (int)round(painter.degrade * 2));
     hips_render_traverse(hips, &painter, transf, angle, split_order,
                          USER_PASS(&nb_tot, &nb_loaded),
                          render_visitor);
@@ -592,6 +715,135 @@ int hips_get_render_order(const hips_t *hips, const painter_t *painter,
     return round(log2(px / (4.0 * sqrt(2.0) * w)));
 }
 
+// Simple set of healpix pixels with open addressing, used to visit each
+// tile only once in the incremental traversal.
+typedef struct {
+    int *pix; // -1 for the empty slots.
+    int size; // Power of two.
+    int nb;
+} pix_set_t;
+
+// Add a pixel to the set, return false if it was already there.
+static bool pix_set_add(pix_set_t *set, int pix)
+{
+    int i, old_size;
+    int *old;
+    if (set->nb * 2 >= set->size) {
+        old = set->pix;
+        old_size = set->size;
+        set->size = max(set->size * 2, 256);
+        set->pix = malloc(set->size * sizeof(*set->pix));
+        memset(set->pix, 0xff, set->size * sizeof(*set->pix));
+        set->nb = 0;
+        for (i = 0; i < old_size; i++) {
+            if (old[i] != -1) pix_set_add(set, old[i]);
+        }
+        free(old);
+    }
+    i = ((uint32_t)pix * 2654435761u) & (set->size - 1);
+    for (;; i = (i + 1) & (set->size - 1)) {
+        if (set->pix[i] == pix) return false;
+        if (set->pix[i] != -1) continue;
+        set->pix[i] = pix;
+        set->nb++;
+        return true;
+    }
+}
+
+static void visible_add(hips_t *hips, int pix, const double cap[4])
+{
+    typeof(hips->visible) *visible = &hips->visible;
+    if (visible->nb >= visible->capacity) {
+        visible->capacity = max(visible->capacity * 2, 64);
+        visible->tiles = realloc(visible->tiles,
+                                 visible->capacity * sizeof(*visible->tiles));
+    }
+    visible->tiles[visible->nb].pix = pix;
+    vec4_copy(cap, visible->tiles[visible->nb].cap);
+    visible->nb++;
+}
+
+// Check whether we can start from the tiles visible in the last frame
+// instead of doing a full traversal.
+static bool can_use_visible(const hips_t *hips, const painter_t *painter,
+                            const double transf[4][4], int render_order,
+                            int flags)
+{
+    const double *cap = painter->clip_info[hips->frame].bounding_cap;
+    const double *prev = hips->visible.view_cap;
+    double move, radius, prev_radius;
+
+    if (!hips->visible.valid || !hips->visible.nb) return false;
+    if (transf || (flags & HIPS_PLANET)) return false;
+    if (hips->visible.order != render_order) return false;
+    // The visible area might not be connected.
+    if (painter->proj->flags & PROJ_HAS_DISCONTINUITY) return false;
+
+    // Large jump or zoom: better to restart from scratch.
+    radius = acos(clamp(cap[3], -1.0, 1.0));
+    prev_radius = acos(clamp(prev[3], -1.0, 1.0));
+    move = acos(clamp(vec3_dot(cap, prev), -1.0, 1.0));
+    if (move > radius / 2) return false;
+    if (fabs(radius - prev_radius) > radius / 4) return false;
+    return true;
+}
+
+/*
+ * Incremental traversal: flood fill from the tiles visible in the last
+ * frame to their neighbours, until we reach the frontier of the visible
+ * area.  The tiles that are no longer visible are dropped from the set.
+ *
+ * Return false if none of the previous tiles is visible anymore, in which
+ * case nothing has been rendered and we need a full traversal.
+ */
+static bool traverse_visible(
+        hips_t *hips, const painter_t *painter,
+        int order, int split, int flags, void *user,
+        int (*callback)(hips_t *hips, const painter_t *painter,
+                        const double transf[4][4],
+                        int order, int pix, int split, int flags, void *user))
+{
+    typeof(hips->visible) *visible = &hips->visible;
+    visible_tile_t *queue, tile;
+    pix_set_t set = {};
+    uv_map_t map;
+    int i, j, size, capacity, neighbours[8];
+    const int nside = 1 << order;
+
+    size = visible->nb;
+    capacity = size * 2;
+    queue = malloc(capacity * sizeof(*queue));
+    memcpy(queue, visible->tiles, size * sizeof(*queue));
+    for (i = 0; i < size; i++) pix_set_add(&set, queue[i].pix);
+    visible->nb = 0;
+
+    for (i = 0; i < size; i++) {
+        tile = queue[i];
+        uv_map_init_healpix(&map, order, tile.pix, false, false);
+        if (painter_is_quad_clipped_with_cap(painter, hips->frame, &map,
+                                             tile.cap, true))
+            continue;
+        callback(hips, painter, NULL, order, tile.pix, split, flags, user);
+        visible_add(hips, tile.pix, tile.cap);
+        healpix_get_neighbours(nside, tile.pix, neighbours);
+        for (j = 0; j < 8; j++) {
+            if (neighbours[j] == -1) continue;
+            if (!pix_set_add(&set, neighbours[j])) continue;
+            if (size >= capacity) {
+                capacity *= 2;
+                queue = realloc(queue, capacity * sizeof(*queue));
+            }
+            queue[size].pix = neighbours[j];
+            uv_map_init_healpix(&map, order, neighbours[j], false, false);
+            uv_map_get_bounding_cap(&map, queue[size].cap);
+            size++;
+        }
+    }
+    free(queue);
+    free(set.pix);
+    return visible->nb > 0;
+}
+
 // Similar to hips_render, but instead of actually rendering the tiles
 // we call a callback function.  This can be used when we need better
 // control on the rendering.
@@ -606,8 +858,9 @@ int hips_render_traverse(
     int render_order, order, pix, split;
     int flags = 0;
     hips_iterator_t iter;
-    bool outside = true;
+    bool outside = true, use_visible;
     uv_map_t map;
+    double cap[4];
 
     hips_update(hips);
     render_order = hips_get_render_order(hips, painter, angle);
@@ -628,6 +881,24 @@ int hips_render_traverse(
 
     // Can't split less than the rendering order.
     split_order = max(split_order, render_order);
+    split = 1 << (split_order - render_order);
+
+    if (can_use_visible(hips, painter, transf, render_order, flags) &&
+        traverse_visible(hips, painter, render_order, split, flags, user,
+                         callback)) {
+        vec4_copy(painter->clip_info[hips->frame].bounding_cap,
+                  hips->visible.view_cap);
+        return 0;
+    }
+
+    // Only the sky surveys keep the visible tiles, since the planets and
+    // the landscape move with the observer.
+    use_visible = outside && !transf;
+    hips->visible.valid = use_visible;
+    hips->visible.nb = 0;
+    hips->visible.order = render_order;
+    vec4_copy(painter->clip_info[hips->frame].bounding_cap,
+              hips->visible.view_cap);
 
     // Breath first traversal of all the tiles.
     hips_iter_init(&iter);
@@ -635,15 +906,18 @@ int hips_render_traverse(
         // Early exit if the tile is clipped.
         uv_map_init_healpix(&map, order, pix, false, false);
         map.transf = (void*)transf;
-        if (painter_is_quad_clipped(painter, hips->frame, &map, outside))
+        if (outside) uv_map_get_bounding_cap(&map, cap);
+        if (painter_is_quad_clipped_with_cap(
+                    painter, hips->frame, &map, cap, outside))
             continue;
         if (order < render_order) { // Keep going.
             hips_iter_push_children(&iter, order, pix);
             continue;
         }
-        split = 1 << (split_order - render_order);
         callback(hips, painter, transf, order, pix, split, flags, user);
+        if (use_visible) visible_add(hips, pix, cap);
     }
+    hips_iter_release(&iter);
     return 0;
 }
 
@@ -716,15 +990,24 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
     assert(order >= 0);
     *code = 0;
 
-    if (!g_cache) g_cache = cache_create(CACHE_SIZE);
+    if (!g_cache) {
+        g_cache = cache_create(CACHE_SIZE);
+        cache_register_membudget(g_cache, "hips", MEMBUDGET_PRIORITY_HIGH);
+    }
     tile = cache_get(g_cache, &key, sizeof(key));
 
     // Got a tile but it is still loading.
     if (tile && tile->loader) {
-        if (!worker_iter(&tile->loader->worker)) return NULL;
-        cache_set_cost(g_cache, &key, sizeof(key), tile->loader->cost);
+        if (!worker_iter(&tile->loader->worker)) {
+            core_mark_dirty();
+            return NULL;
+        }
+        cache_set_cost(g_cache, &key, sizeof(key),
+                       sizeof(*tile) + tile->loader->cost);
         free(tile->loader);
         tile->loader = NULL;
+        g_stats.nb_loaded++;
+        if (tile->flags & TILE_LOAD_ERROR) g_stats.nb_errors++;
     }
     if (tile) {
         *code = 200;
@@ -788,11 +1071,14 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
         tile->data = hips->settings.create_tile(
                 hips->settings.user, order, pix, data, size,
                 &cost, &transparency);
+        cache_set_cost(g_cache, &key, sizeof(key), sizeof(*tile) + cost);
         tile->flags |= (transparency * TILE_NO_CHILD_0);
         if (!tile->data) {
             LOG_W("Cannot parse tile %s", url);
             tile->flags |= TILE_LOAD_ERROR;
+            g_stats.nb_errors++;
         }
+        g_stats.nb_loaded++;
         asset_release(url);
     } else {
         tile->loader = calloc(1, sizeof(*tile->loader));
@@ -802,12 +1088,19 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
         tile->loader->tile = tile;
         memcpy(tile->loader->data, data, size);
         asset_release(url);
+        core_mark_dirty();
         *code = 0;
         return NULL;
     }
     return tile;
 }
 
+void hips_get_stats(int *nb_loaded, int *nb_errors)
+{
+    if (nb_loaded) *nb_loaded = g_stats.nb_loaded;
+    if (nb_errors) *nb_errors = g_stats.nb_errors;
+}
+
 const void *hips_get_tile(hips_t *hips, int order, int pix, int flags,
                           int *code)
 {
@@ -881,3 +1174,126 @@ double hips_parse_date(const char *str)
     eraDtf2d("UTC", iy, im, id, ihr, imn, 0, &d1, &d2);
     return d1 - DJM0 + d2;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#define TEST_MAX_TILES 4096
+
+static int test_collect_visitor(hips_t *hips, const painter_t *painter,
+                                const double transf[4][4],
+                                int order, int pix, int split, int flags,
+                                void *user)
+{
+    int *nb = USER_GET(user, 0);
+    int *tiles = USER_GET(user, 1);
+    assert(*nb < TEST_MAX_TILES);
+    tiles[(*nb)++] = pix;
+    return 0;
+}
+
+static int test_cmp_int(const void *a, const void *b)
+{
+    return cmp(*(int*)a, *(int*)b);
+}
+
+static int test_traverse(hips_t *hips, const painter_t *painter, int *tiles)
+{
+    int nb = 0;
+    hips_render_traverse(hips, painter, NULL, 2 * M_PI, 0,
+                         USER_PASS(&nb, tiles), test_collect_visitor);
+    qsort(tiles, nb, sizeof(*tiles), test_cmp_int);
+    return nb;
+}
+
+// Check that the incremental traversal gives the same tiles as the full
+// one when the view moves.
+static void test_visible_traverse(void)
+{
+    observer_t obs = *core->observer;
+    projection_t proj;
+    painter_t painter;
+    hips_t inc = {
+        .frame = FRAME_ICRF,
+        .order = 9,
+        .tile_width = 256,
+        .allsky.not_available = true,
+        .properties = json_object_new(0),
+    };
+    hips_t full = inc;
+    int i, nb_inc, nb_full;
+    int tiles_inc[TEST_MAX_TILES], tiles_full[TEST_MAX_TILES];
+
+    projection_init(&proj, PROJ_STEREOGRAPHIC, 3 * DD2R, 800, 600);
+    painter = (painter_t) {
+        .obs = &obs,
+        .proj = &proj,
+        .fb_size = {800, 600},
+    };
+    for (i = 0; i < 50; i++) {
+        obj_set_attr((obj_t*)&obs, "yaw", i * 0.1 * DD2R);
+        obj_set_attr((obj_t*)&obs, "pitch", (10 + i * 0.05) * DD2R);
+        observer_update(&obs, false);
+        painter_update_clip_info(&painter);
+        // Check that we actually use the incremental traversal.
+        if (i) assert(can_use_visible(&inc, &painter, NULL,
+                                      inc.visible.order, 0));
+        nb_inc = test_traverse(&inc, &painter, tiles_inc);
+        full.visible.valid = false;
+        nb_full = test_traverse(&full, &painter, tiles_full);
+        assert(nb_inc && nb_inc == nb_full);
+        assert(memcmp(tiles_inc, tiles_full, nb_inc * sizeof(int)) == 0);
+    }
+
+    free(inc.visible.tiles);
+    free(full.visible.tiles);
+    json_value_free(inc.properties);
+}
+
+TEST_REGISTER(NULL, test_visible_traverse, TEST_AUTO);
+
+static void test_iterator(void)
+{
+    hips_iterator_t iter;
+    int order, pix, nb, last_order, max_size, i;
+    const int max_order = 5;
+    const int total = 12 * ((1 << (2 * (max_order + 1))) - 1) / 3;
+
+    // Breadth first, the queue goes over its initial capacity.
+    hips_iter_init(&iter);
+    nb = 0;
+    last_order = 0;
+    while (hips_iter_next(&iter, &order, &pix)) {
+        assert(order >= last_order);
+        last_order = order;
+        nb++;
+        if (order < max_order) hips_iter_push_children(&iter, order, pix);
+    }
+    assert(nb == total);
+    assert(iter.capacity > ITER_INITIAL_CAPACITY);
+    hips_iter_release(&iter);
+
+    // Depth first, the stack size only depends on the depth, and we get
+    // the pixels in nested order.
+    hips_iter_init_depth_first(&iter);
+    nb = 0;
+    max_size = 0;
+    i = 0;
+    while (hips_iter_next(&iter, &order, &pix)) {
+        nb++;
+        if (order == max_order) {
+            assert(pix == i);
+            i++;
+        }
+        if (order < max_order) hips_iter_push_children(&iter, order, pix);
+        max_size = max(max_size, iter.size);
+    }
+    assert(nb == total);
+    assert(max_size <= 11 + 3 * max_order + 4);
+    hips_iter_release(&iter);
+}
+
+TEST_REGISTER(NULL, test_iterator, TEST_AUTO);
+
+#endif
@@ -86,6 +86,16 @@ hips_t *hips_create(const char *url, double release_date,
 const void *hips_get_tile(hips_t *hips, int order, int pix, int flags,
                           int *code);
 
+/*
+ * Function: hips_get_stats
+ * Get global statistics about the loaded tiles, for debug and benchmarks.
+ *
+ * Parameters:
+ *   nb_loaded  - Number of tiles loaded since the start.  Can be NULL.
+ *   nb_errors  - Number of tiles that could not be parsed.  Can be NULL.
+ */
+void hips_get_stats(int *nb_loaded, int *nb_errors);
+
 /*
  * Function: hips_is_ready
  * Check if a hips survey is ready to use
@@ -110,7 +120,6 @@ bool hips_is_ready(hips_t *hips);
  *
  * Return:
  *   0 if the traverse finished.
- *   -1 if we reach the traverse limite.
  *   -v if the callback returned a negative value -v.
  */
 int hips_traverse(void *user, int callback(int order, int pix, void *user));
@@ -118,7 +127,7 @@ int hips_traverse(void *user, int callback(int order, int pix, void *user));
 
 /*
  * Struct: hips_iterator_t
- * Used for breadth first traversal of hips.
+ * Used for breadth first or depth first traversal of hips.
  *
  * To iter a hips index we can use the <hips_iter_init>, <hips_iter_next>
  * and <hips_iter_push_children> functions.  e.g:
@@ -132,16 +141,21 @@ int hips_traverse(void *user, int callback(int order, int pix, void *user));
  *         hips_iter_push_children(iter, order, pix);
  *      }
  *  }
+ *  hips_iter_release(&iter);
  *
+ * The nodes buffer grows as needed, and is taken from a global pool so
+ * that we don't allocate memory at each traversal.
  */
 typedef struct hips_iterator
 {
     struct {
         int order;
         int pix;
-    } queue[1024]; // Todo: make it dynamic?
+    } *nodes; // Ring buffer, or stack in depth first mode.
+    int capacity;
     int size;
     int start;
+    bool depth_first;
 } hips_iterator_t;
 
 /*
@@ -150,6 +164,18 @@ typedef struct hips_iterator
  */
 void hips_iter_init(hips_iterator_t *iter);
 
+/*
+ * Function: hips_iter_init_depth_first
+ * Same as <hips_iter_init>, but for a depth first traversal.
+ *
+ * The children pushed with <hips_iter_push_children> are retrieved before
+ * the other queued pixels, so the memory used only depends on the depth
+ * of the traversal, not on the width of the frontier.  This is better for
+ * the visitors that stop going deeper based on the tiles content, like
+ * the stars magnitude.
+ */
+void hips_iter_init_depth_first(hips_iterator_t *iter);
+
 /*
  * Function: hips_iter_next
  * Pop the next healpix pixel from the iterator.
@@ -162,11 +188,17 @@ bool hips_iter_next(hips_iterator_t *iter, int *order, int *pix);
  * Function: hips_iter_push_children
  * Add the four children of the giver pixel to the iterator.
  *
- * The children will be retrieved after all the currently queued values
- * from the iterator have been processed.
+ * In breadth first mode, the children will be retrieved after all the
+ * currently queued values from the iterator have been processed.
  */
 void hips_iter_push_children(hips_iterator_t *iter, int order, int pix);
 
+/*
+ * Function: hips_iter_release
+ * Release the memory used by an iterator.
+ */
+void hips_iter_release(hips_iterator_t *iter);
+
 /*
  * Function: hips_get_tile_texture
  * Get the texture for a given hips tile.
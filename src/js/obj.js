@@ -27,6 +27,8 @@ Module.afterInit(function() {
   var core_get_module = Module.cwrap('core_get_module', 'number', ['string']);
   var obj_get_info_json = Module.cwrap('obj_get_info_json', 'number',
     ['number', 'number', 'string']);
+  var obj_info_from_str = Module.cwrap('obj_info_from_str', 'number',
+    ['string']);
 
   // List of {obj, attr, callback}
   var g_listeners = [];
@@ -305,6 +307,53 @@ Module.afterInit(function() {
     return obj ? new SweObj(obj) : null;
   };
 
+  /*
+   * Function: getInfosTable
+   * Compute numerical infos of many objects at many times at once.
+   *
+   * Arguments:
+   *   objs   - Array of SweObj.
+   *   times  - Array of TT MJD times.
+   *   infos  - Array of numerical info names (e.g. ['radec', 'vmag']).
+   *   obs    - An observer.  If not set use the core observer.
+   *
+   * Return:
+   *   An object {stride: <number>, data: <Float64Array>}.  The values of
+   *   object i at time j start at index (i * times.length + j) * stride,
+   *   with all the requested infos in order.  Infos not supported by an
+   *   object are set to NaN.  Return null in case of error.
+   */
+  Module['getInfosTable'] = function(objs, times, infos, obs) {
+    obs = obs || Module.core.observer;
+    var i;
+    var objsPtr = Module._malloc(4 * objs.length);
+    var timesPtr = Module._malloc(8 * times.length);
+    var infosPtr = Module._malloc(4 * infos.length);
+    for (i = 0; i < objs.length; i++)
+      Module._setValue(objsPtr + i * 4, objs[i].v, 'i32');
+    for (i = 0; i < times.length; i++)
+      Module._setValue(timesPtr + i * 8, times[i], 'double');
+    for (i = 0; i < infos.length; i++)
+      Module._setValue(infosPtr + i * 4, obj_info_from_str(infos[i]), 'i32');
+    var stride = Module._obj_infos_table_stride(infos.length, infosPtr);
+    var ret = null;
+    if (stride >= 0) {
+      var size = objs.length * times.length * stride;
+      var outPtr = Module._malloc(8 * size);
+      Module._obj_get_infos_table(obs.v, objs.length, objsPtr, times.length,
+                                  timesPtr, infos.length, infosPtr, outPtr);
+      ret = {
+        stride: stride,
+        data: HEAPF64.slice(outPtr / 8, outPtr / 8 + size)
+      };
+      Module._free(outPtr);
+    }
+    Module._free(objsPtr);
+    Module._free(timesPtr);
+    Module._free(infosPtr);
+    return ret;
+  };
+
   Module['change'] = function(callback, context) {
     g_listeners.push({
       'obj': null,
@@ -179,6 +179,21 @@ Module['typeToStr'] = function(t) {
   return type_to_str(t);
 }
 
+/*
+ * Function: getProfilerTrace
+ * Return the last recorded profiler zones as a Chrome trace object.
+ *
+ * The profiler needs to be enabled first with the core 'profiler'
+ * attribute.  The returned value can be saved as a json file and opened
+ * in chrome://tracing or https://ui.perfetto.dev.
+ */
+Module['getProfilerTrace'] = function() {
+  var cret = Module._profile_get_trace();
+  var ret = Module.UTF8ToString(cret);
+  Module._free(cret);
+  return JSON.parse(ret);
+}
+
 /*
  * Function: calendar
  * Compute calendar events.
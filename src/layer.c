@@ -48,12 +48,13 @@ static int layer_update(obj_t *obj, double dt)
 {
     layer_t *layer = (layer_t*)obj;
     obj_t *child;
-    fader_update(&layer->visible, dt);
+    bool changed = false;
+    changed |= fader_update(&layer->visible, dt);
     MODULE_ITER(obj, child, NULL) {
         if (child->klass->flags & OBJ_MODULE)
-            module_update(child, dt);
+            changed |= module_update(child, dt) > 0;
     }
-    return 0;
+    return changed ? 1 : 0;
 }
 
 static int layer_render(const obj_t *obj, const painter_t *painter_)
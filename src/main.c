@@ -32,6 +32,10 @@ typedef struct
 {
     bool run_tests;
     char *tests_filter;
+    bool run_benchs;
+    char *benchs_filter;
+    char *benchs_baseline;
+    char *benchs_output;
     bool calendar;
     bool gen_doc;
     char *args[3];
@@ -45,11 +49,20 @@ static char doc[] = "A virtual planetarium";
 static char args_doc[] = "";
 #define OPT_RUN_TESTS 1
 #define OPT_GEN_DOC 2
+#define OPT_RUN_BENCHS 3
+#define OPT_BENCH_BASELINE 4
+#define OPT_BENCH_OUTPUT 5
 static struct argp_option options[] = {
 
 #if COMPILE_TESTS
     {"run-tests", OPT_RUN_TESTS, "filter", OPTION_ARG_OPTIONAL,
                                                     "Run the unit tests" },
+    {"run-benchmarks", OPT_RUN_BENCHS, "filter", OPTION_ARG_OPTIONAL,
+                                                "Run the micro-benchmarks" },
+    {"bench-baseline", OPT_BENCH_BASELINE, "file", 0,
+                    "Fail the benchmarks on regressions from a json baseline"},
+    {"bench-output", OPT_BENCH_OUTPUT, "file", 0,
+                                    "Save the benchmarks results as json"},
 #endif
     {"calendar", 'c', NULL, 0, "print events calendar"},
     {"gen-doc", OPT_GEN_DOC, NULL, 0, "print doc for the defined classes"},
@@ -66,6 +79,16 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
         args->run_tests = true;
         args->tests_filter = arg;
         break;
+    case OPT_RUN_BENCHS:
+        args->run_benchs = true;
+        args->benchs_filter = arg;
+        break;
+    case OPT_BENCH_BASELINE:
+        args->benchs_baseline = arg;
+        break;
+    case OPT_BENCH_OUTPUT:
+        args->benchs_output = arg;
+        break;
     case OPT_GEN_DOC:
         args->gen_doc = true;
         break;
@@ -196,6 +219,12 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (args.run_benchs) {
+        core_init(w, h, 1.0);
+        return benchs_run(args.benchs_filter, args.benchs_baseline,
+                          args.benchs_output) ? -1 : 0;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_SAMPLES, 2);
     g_window = glfwCreateWindow(w, h, title, NULL, NULL);
@@ -233,9 +262,14 @@ static void loop_function(void)
     glfwGetFramebufferSize(g_window, &fb_size[0], &fb_size[1]);
 
     core_update(dt);
-    core_render(fb_size[0], fb_size[1], 1.0);
-    glfwSwapBuffers(g_window);
-    glfwPollEvents();
+    if (core_render(fb_size[0], fb_size[1], 1.0) == 0) {
+        glfwSwapBuffers(g_window);
+        glfwPollEvents();
+    } else {
+        // Nothing changed: keep the last frame and sleep until the next
+        // event or frame time.
+        glfwWaitEventsTimeout(dt);
+    }
 }
 
 static void run_main_loop(void (*func)(void))
@@ -60,6 +60,156 @@ int module_list_objs(const obj_t *obj, observer_t *obs,
     return 0;
 }
 
+// Max healpix order of the tiles visited by the cone search.
+#define CONE_SEARCH_MAX_ORDER 12
+
+typedef struct {
+    const obj_t *module;
+    observer_t  *obs;
+    const double *cap;
+    double      max_mag;
+    void        *user;
+    int         (*f)(void *user, obj_t *obj);
+    int         nb_seen; // Number of objects passed to the callback.
+    bool        fainter; // Set if we skipped an object fainter than max_mag.
+    bool        stop;
+    bool        again;   // Set if a source returned MODULE_AGAIN.
+} cone_search_t;
+
+static int cone_search_callback(void *user, obj_t *obj)
+{
+    cone_search_t *d = user;
+    double vmag, pos[4];
+
+    d->nb_seen++;
+    if (!isnan(d->max_mag) &&
+            obj_get_info(obj, d->obs, INFO_VMAG, &vmag) == 0 &&
+            vmag > d->max_mag) {
+        d->fainter = true;
+        return 0;
+    }
+    obj_get_pos(obj, d->obs, FRAME_ICRF, pos);
+    vec3_normalize(pos, pos);
+    if (!cap_contains_vec3(d->cap, pos)) return 0;
+    if (d->f && d->f(d->user, obj)) {
+        d->stop = true;
+        return 1;
+    }
+    return 0;
+}
+
+static bool ranges_contain(const int *ranges, int nb, int pix)
+{
+    int lo = 0, hi = nb, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (pix < ranges[mid * 2]) hi = mid;
+        else if (pix >= ranges[mid * 2 + 1]) lo = mid + 1;
+        else return true;
+    }
+    return false;
+}
+
+/*
+ * List the objects of a tiled module (stars, dsos) by calling the list
+ * method with each tile intersecting the cone as hint.  Like for the
+ * rendering, we stop going down a tile as soon as it contains some objects
+ * fainter than the magnitude limit, or if it is empty (or doesn't exist).
+ */
+static int cone_search_tiles(const obj_t *module, const char *source,
+                             cone_search_t *d)
+{
+    int order, i, j, r, ret = 0, nb = 0, next_nb, nb_ranges, pix;
+    int *pixs, *next, *ranges;
+
+    nb_ranges = healpix_query_disc(0, d->cap, &ranges);
+    pixs = malloc(12 * sizeof(*pixs));
+    for (i = 0; i < nb_ranges; i++) {
+        for (pix = ranges[i * 2]; pix < ranges[i * 2 + 1]; pix++)
+            pixs[nb++] = pix;
+    }
+    free(ranges);
+
+    for (order = 0; nb && !d->stop; order++) {
+        nb_ranges = 0;
+        ranges = NULL;
+        if (order < CONE_SEARCH_MAX_ORDER)
+            nb_ranges = healpix_query_disc(order + 1, d->cap, &ranges);
+        next = malloc(nb * 4 * sizeof(*next));
+        next_nb = 0;
+        for (i = 0; i < nb && !d->stop; i++) {
+            d->fainter = false;
+            d->nb_seen = 0;
+            r = module->klass->list(module, d->obs, d->max_mag,
+                                    pixs[i] + 4 * (1 << (2 * order)),
+                                    source, d, cone_search_callback);
+            if (r == MODULE_AGAIN) ret = MODULE_AGAIN;
+            if (r != 0) continue;
+            if (d->fainter || !d->nb_seen) continue;
+            for (j = 0; j < 4; j++) {
+                pix = pixs[i] * 4 + j;
+                if (ranges_contain(ranges, nb_ranges, pix))
+                    next[next_nb++] = pix;
+            }
+        }
+        free(ranges);
+        free(pixs);
+        pixs = next;
+        nb = next_nb;
+    }
+    free(pixs);
+    return ret;
+}
+
+// Search the tiles of each source of a module.
+static int cone_search_source(void *user, const char *key)
+{
+    cone_search_t *d = user;
+    int r = cone_search_tiles(d->module, key, d);
+    if (r == MODULE_AGAIN) d->again = true;
+    return d->stop ? 1 : 0;
+}
+
+static int cone_search(const obj_t *module, cone_search_t *d)
+{
+    obj_t *child;
+    int ret = 0;
+
+    if (module == &core->obj) {
+        DL_FOREACH(module->children, child) {
+            if (cone_search(child, d) == MODULE_AGAIN) ret = MODULE_AGAIN;
+            if (d->stop) break;
+        }
+        return ret;
+    }
+    // The modules with a custom list method are the tiled ones.
+    if (module->klass->list && module->klass->list_sources) {
+        d->module = module;
+        d->again = false;
+        module->klass->list_sources(module, d, cone_search_source);
+        return d->again ? MODULE_AGAIN : 0;
+    }
+    if (module->klass->list)
+        return cone_search_tiles(module, NULL, d);
+    if (module->klass->flags & OBJ_LISTABLE)
+        return module_list_objs(module, d->obs, NAN, 0, NULL,
+                                d, cone_search_callback);
+    return -1;
+}
+
+/*
+ * Function: module_list_objs_in_cap
+ * List the objects of a module inside a cone.
+ */
+int module_list_objs_in_cap(const obj_t *module, observer_t *obs,
+                            const double cap[4], double max_mag,
+                            void *user, int (*f)(void *user, obj_t *obj))
+{
+    cone_search_t d = {.obs = obs, .cap = cap, .max_mag = max_mag,
+                       .user = user, .f = f};
+    return cone_search(module, &d);
+}
+
 // Only there because we can't easily call module_list_objs from js.
 EMSCRIPTEN_KEEPALIVE
 int module_list_objs2(const obj_t *obj, observer_t *obs,
@@ -182,6 +332,12 @@ void module_add_global_listener(void (*f)(obj_t *module, const char *attr))
 
 void module_changed(obj_t *module, const char *attr)
 {
+    // The time changes are checked against the last rendered frame by
+    // core_render, since most of them don't move anything on screen.
+    if (    !core || module != (obj_t*)core->observer ||
+            (strcmp(attr, "tt") && strcmp(attr, "utc") &&
+             strcmp(attr, "ut1")))
+        core_mark_dirty();
     if (g_listener)
         g_listener(module, attr);
 }
@@ -327,3 +483,145 @@ char *module_get_path(const obj_t *obj, const obj_t *root)
     free(base);
     return ret;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+// Fake tiled module: the objects are stored in tiles of order 0 and 1,
+// deeper tiles don't exist.
+typedef struct {
+    obj_t       obj;
+    int         order;
+    int         pix;
+    const char  *source; // NULL for the first source.
+    double      pos[3];
+    bool        found;
+} test_obj_t;
+
+static struct {
+    test_obj_t  objs[5];
+    bool        loading; // Set to make the order 1 tiles still loading.
+} g_test_tiles;
+
+static int test_obj_get_info(const obj_t *obj, const observer_t *obs,
+                             int info, void *out)
+{
+    const test_obj_t *o = (const test_obj_t*)obj;
+    double (*pvo)[4] = out;
+    if (info != INFO_PVO) return 1;
+    memset(pvo, 0, 2 * 4 * sizeof(double));
+    vec3_copy(o->pos, pvo[0]);
+    return 0;
+}
+
+static obj_klass_t test_obj_klass = {
+    .id = "test_cone_obj",
+    .get_info = test_obj_get_info,
+};
+
+static int test_tiles_list(const obj_t *obj, observer_t *obs,
+                           double max_mag, uint64_t hint, const char *source,
+                           void *user, int (*f)(void *user, obj_t *obj))
+{
+    int i, order, pix;
+    order = log2(hint / 4) / 2;
+    pix = hint - 4 * (1 << (2 * order));
+    if (order > 1) return -1;
+    if (order == 1 && g_test_tiles.loading) return MODULE_AGAIN;
+    // Like the stars, default to the first source.
+    source = source ?: "first";
+    for (i = 0; i < ARRAY_SIZE(g_test_tiles.objs); i++) {
+        if (g_test_tiles.objs[i].order != order) continue;
+        if (g_test_tiles.objs[i].pix != pix) continue;
+        if (strcmp(g_test_tiles.objs[i].source ?: "first", source) != 0)
+            continue;
+        if (f(user, &g_test_tiles.objs[i].obj)) break;
+    }
+    return 0;
+}
+
+static obj_klass_t test_tiles_klass = {
+    .id = "test_cone_tiles",
+    .list = test_tiles_list,
+};
+
+static int test_tiles_list_sources(const obj_t *obj, void *user,
+                                   int (*f)(void *user, const char *key))
+{
+    if (f(user, "first")) return 0;
+    f(user, "second");
+    return 0;
+}
+
+static obj_klass_t test_tiles_sources_klass = {
+    .id = "test_cone_tiles_sources",
+    .list = test_tiles_list,
+    .list_sources = test_tiles_list_sources,
+};
+
+static int test_cone_callback(void *user, obj_t *obj)
+{
+    ((test_obj_t*)obj)->found = true;
+    return 0;
+}
+
+static void test_list_objs_in_cap(void)
+{
+    obj_t module = {.klass = &test_tiles_klass};
+    obj_t module2 = {.klass = &test_tiles_sources_klass};
+    double cap[4];
+    test_obj_t *objs = g_test_tiles.objs;
+    int i, r;
+
+    core_init(100, 100, 1.0);
+    // A cone of 25° around the center of the first order 0 tile.
+    healpix_pix2vec(1, 0, cap);
+    cap[3] = cos(25 * DD2R);
+
+    // Two objects in the order 0 tile, so that we go down to the children.
+    objs[0] = (test_obj_t) {.order = 0, .pix = 0};
+    healpix_pix2vec(1, 0, objs[0].pos);
+    objs[1] = (test_obj_t) {.order = 0, .pix = 0};
+    healpix_pix2vec(2, 1, objs[1].pos);
+    // One object in a child tile.
+    objs[2] = (test_obj_t) {.order = 1, .pix = 0};
+    healpix_pix2vec(2, 0, objs[2].pos);
+    // One object outside of the cone.
+    objs[3] = (test_obj_t) {.order = 0, .pix = 6};
+    healpix_pix2vec(1, 6, objs[3].pos);
+    // One object in the second source.
+    objs[4] = (test_obj_t) {.order = 0, .pix = 0, .source = "second"};
+    healpix_pix2vec(2, 2, objs[4].pos);
+    for (i = 0; i < ARRAY_SIZE(g_test_tiles.objs); i++)
+        objs[i].obj.klass = &test_obj_klass;
+
+    r = module_list_objs_in_cap(&module, core->observer, cap, NAN,
+                                NULL, test_cone_callback);
+    assert(r == 0);
+    assert(objs[0].found && objs[1].found && objs[2].found);
+    assert(!objs[3].found && !objs[4].found);
+
+    // Search in all the sources.
+    for (i = 0; i < ARRAY_SIZE(g_test_tiles.objs); i++)
+        objs[i].found = false;
+    r = module_list_objs_in_cap(&module2, core->observer, cap, NAN,
+                                NULL, test_cone_callback);
+    assert(r == 0);
+    assert(objs[0].found && objs[1].found && objs[2].found);
+    assert(!objs[3].found && objs[4].found);
+
+    // Child tiles still loading.
+    for (i = 0; i < ARRAY_SIZE(g_test_tiles.objs); i++)
+        objs[i].found = false;
+    g_test_tiles.loading = true;
+    r = module_list_objs_in_cap(&module, core->observer, cap, NAN,
+                                NULL, test_cone_callback);
+    assert(r == MODULE_AGAIN);
+    assert(objs[0].found && !objs[2].found);
+    g_test_tiles.loading = false;
+}
+
+TEST_REGISTER(NULL, test_list_objs_in_cap, TEST_AUTO);
+
+#endif
@@ -48,6 +48,37 @@ int module_list_objs(const obj_t *module, observer_t *obs,
                      double max_mag, uint64_t hint, const char *source,
                      void *user, int (*f)(void *user, obj_t *obj));
 
+/*
+ * Function: module_list_objs_in_cap
+ * List the astro objects of a module inside a cone.
+ *
+ * For the tiled modules (stars, dsos), only the tiles intersecting the
+ * cone are loaded, and we don't go deeper than the tiles containing
+ * objects fainter than the magnitude limit.  The tiles of all the module
+ * sources (e.g. the stars surveys) are searched.  The objects are passed to
+ * the callback as soon as they are found.
+ *
+ * Parameters:
+ *   module   - The module (core for all modules).
+ *   obs      - The observer used to compute the objects positions and vmag.
+ *   cap      - The cone in ICRF, as a normalized direction and the cosine
+ *              of the angular radius.
+ *   max_mag  - Only consider objects below this magnitude.  Can be set to
+ *              NAN to ignore.
+ *   user     - Data passed to the callback.
+ *   f        - Callback function called once per object.  Can return a
+ *              non zero value to stop the search.
+ *
+ * Return:
+ *    0           - Success.
+ *   -1           - The module doesn't support listing.
+ *   MODULE_AGAIN - Some tiles are still loading and so calling the
+ *                  function again later might return more values.
+ */
+int module_list_objs_in_cap(const obj_t *module, observer_t *obs,
+                            const double cap[4], double max_mag,
+                            void *user, int (*f)(void *user, obj_t *obj));
+
 /*
  * Function: module_add_data_source
  * Add a data source url to a module
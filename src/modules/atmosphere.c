@@ -16,21 +16,14 @@
  *
  */
 
-/*
- * Type: atmosphere_t
- * Atmosphere module struct.
- */
-typedef struct atmosphere {
-    obj_t           obj;
-    // The twelves tile textures of healpix at order 0 and construction bufs.
-    struct {
-        texture_t       *tex;
-        float           (*buf)[3];  // color buffer (in xyY).
-        bool            visible;
-    } tiles[12];
-    fader_t         visible;
-    double          turbidity;
-} atmosphere_t;
+// The atmosphere is rendered on the order 1 healpix tiles, each one split
+// into a grid of GRID_SPLIT x GRID_SPLIT quads.
+#define NB_TILES 48
+#define GRID_SPLIT 4 // Adhoc split value to look good while not being too slow.
+#define GRID_SIZE ((GRID_SPLIT + 1) * (GRID_SPLIT + 1))
+
+// Angle the sun or the moon can move before we recompute the luminance.
+#define CACHE_MAX_MOVE (0.1 * DD2R)
 
 // All the precomputed data
 typedef struct {
@@ -58,8 +51,55 @@ typedef struct {
     // is rendered. It is used to avoid aliasing in fast varying regions of the
     // atmosphere, like near moon border.
     float cos_grid_angular_step;
+
+    // Cached luminance of the grid vertices of the tile being rendered, and
+    // index of the next vertex expected by compute_lum.
+    const float (*grid_pos)[3];
+    const float *grid_lum;
+    int grid_idx;
 } render_data_t;
 
+// Values the render data depend on.
+typedef struct {
+    double sun_pos[3];
+    double moon_pos[3];
+    double sun_vmag;
+    double moon_vmag;
+    double turbidity;
+    double bortle_index;
+    double phi;
+    double hm;
+    int year;
+    int month;
+} cache_key_t;
+
+/*
+ * Type: atmosphere_t
+ * Atmosphere module struct.
+ */
+typedef struct atmosphere {
+    obj_t           obj;
+    // The twelves tile textures of healpix at order 0 and construction bufs.
+    struct {
+        texture_t       *tex;
+        float           (*buf)[3];  // color buffer (in xyY).
+        bool            visible;
+    } tiles[12];
+    fader_t         visible;
+    double          turbidity;
+
+    // Render data and luminance of the grid vertices of all the tiles,
+    // only recomputed when the sun, the moon or the observer change.
+    struct {
+        bool            valid;
+        cache_key_t     key;
+        render_data_t   data;
+        bool            tiles_valid[NB_TILES];
+        float           pos[NB_TILES][GRID_SIZE][3];
+        float           lum[NB_TILES][GRID_SIZE];
+    } cache;
+} atmosphere_t;
+
 static double F2(const double *lam, double cos_theta,
                  double gamma, double cos_gamma)
 {
@@ -147,21 +187,86 @@ static void prepare_skybrightness(
                           eraSepp(sun_pos, zenith));
 }
 
+static void get_cache_key(const atmosphere_t *atm, const observer_t *obs,
+                          const double sun_pos[3], double sun_vmag,
+                          const double moon_pos[3], double moon_vmag,
+                          cache_key_t *key)
+{
+    int day, ihmsf[4];
+    vec3_copy(sun_pos, key->sun_pos);
+    vec3_copy(moon_pos, key->moon_pos);
+    key->sun_vmag = sun_vmag;
+    key->moon_vmag = moon_vmag;
+    key->turbidity = atm->turbidity;
+    key->bortle_index = core->bortle_index;
+    key->phi = obs->phi;
+    key->hm = obs->hm;
+    eraD2dtf("UTC", 0, DJM0, obs->utc, &key->year, &key->month, &day, ihmsf);
+}
+
+static bool cache_key_match(const cache_key_t *a, const cache_key_t *b)
+{
+    const double cos_max_move = cos(CACHE_MAX_MOVE);
+    return vec3_dot(a->sun_pos, b->sun_pos) >= cos_max_move &&
+           vec3_dot(a->moon_pos, b->moon_pos) >= cos_max_move &&
+           fabs(a->sun_vmag - b->sun_vmag) < 0.01 &&
+           fabs(a->moon_vmag - b->moon_vmag) < 0.01 &&
+           a->turbidity == b->turbidity &&
+           a->bortle_index == b->bortle_index &&
+           a->phi == b->phi && a->hm == b->hm &&
+           a->year == b->year && a->month == b->month;
+}
+
+// Compute the luminance of all the grid vertices of a tile at once.
+static void compute_tile_lum(atmosphere_t *atm, int pix)
+{
+    const render_data_t *d = &atm->cache.data;
+    const float (*pos)[3] = atm->cache.pos[pix];
+    float *lum = atm->cache.lum[pix];
+    float cos_moon[GRID_SIZE], cos_sun[GRID_SIZE], cos_zenith[GRID_SIZE];
+    double p[3];
+    int i;
+
+    for (i = 0; i < GRID_SIZE; i++) {
+        vec3_set(p, pos[i][0], pos[i][1], fabs(pos[i][2]));
+        cos_moon[i] = min(vec3_dot(p, d->moon_pos), d->cos_grid_angular_step);
+        cos_sun[i] = min(vec3_dot(p, d->sun_pos), d->cos_grid_angular_step);
+        cos_zenith[i] = p[2];
+    }
+    skybrightness_get_luminance_batch(&d->skybrightness, GRID_SIZE,
+                                      cos_moon, cos_sun, cos_zenith, lum);
+    for (i = 0; i < GRID_SIZE; i++) {
+        lum[i] = lum[i] * d->eclipse_factor + d->light_pollution_lum;
+    }
+    atm->cache.tiles_valid[pix] = true;
+}
+
 static float compute_lum(void *user, const float pos[3])
 {
     render_data_t *d = user;
     double p[3] = {pos[0], pos[1], pos[2]};
     const double zenith[3] = {0, 0, 1};
+    const float *grid_pos;
     float lum;
-    // Our formula does not work below the horizon.
-    p[2] = fabs(p[2]);
-    lum = skybrightness_get_luminance(&d->skybrightness,
-                min(vec3_dot(p, d->moon_pos), d->cos_grid_angular_step),
-                min(vec3_dot(p, d->sun_pos), d->cos_grid_angular_step),
-                vec3_dot(p, zenith));
-    lum *= d->eclipse_factor;
-
-    lum += d->light_pollution_lum;
+    int i = d->grid_idx++;
+
+    // Use the cached value if the renderer asks for the grid vertices in
+    // the expected order, which should always be the case.
+    grid_pos = (d->grid_lum && i < GRID_SIZE) ? d->grid_pos[i] : NULL;
+    if (grid_pos && fabsf(grid_pos[0] - pos[0]) < 1e-6f &&
+                    fabsf(grid_pos[1] - pos[1]) < 1e-6f &&
+                    fabsf(grid_pos[2] - pos[2]) < 1e-6f) {
+        lum = d->grid_lum[i];
+    } else {
+        // Our formula does not work below the horizon.
+        p[2] = fabs(p[2]);
+        lum = skybrightness_get_luminance(&d->skybrightness,
+                    min(vec3_dot(p, d->moon_pos), d->cos_grid_angular_step),
+                    min(vec3_dot(p, d->sun_pos), d->cos_grid_angular_step),
+                    vec3_dot(p, zenith));
+        lum *= d->eclipse_factor;
+        lum += d->light_pollution_lum;
+    }
 
     // Update luminance sum for eye adaptation.
     // If we are below horizon use the precomputed landscape luminance.
@@ -185,8 +290,9 @@ static int atmosphere_update(obj_t *obj, double dt)
 static void render_tile(atmosphere_t *atm, const painter_t *painter,
                         int order, int pix)
 {
-    int split, i;
+    int i;
     uv_map_t map;
+    render_data_t *data = painter->atm.user;
 
     if (painter_is_healpix_clipped(painter, FRAME_OBSERVED, order, pix, true))
         return;
@@ -195,9 +301,13 @@ static void render_tile(atmosphere_t *atm, const painter_t *painter,
             render_tile(atm, painter, order + 1, pix * 4 + i);
         return;
     }
-    split = 4; // Adhoc split value to look good while not being too slow.
+    if (!atm->cache.tiles_valid[pix]) compute_tile_lum(atm, pix);
+    data->grid_pos = (const float (*)[3])atm->cache.pos[pix];
+    data->grid_lum = atm->cache.lum[pix];
+    data->grid_idx = 0;
     uv_map_init_healpix(&map, order, pix, true, true);
-    paint_quad(painter, FRAME_OBSERVED, &map, split);
+    paint_quad(painter, FRAME_OBSERVED, &map, GRID_SPLIT);
+    data->grid_lum = NULL;
 }
 
 static int atmosphere_render(const obj_t *obj, const painter_t *painter_)
@@ -206,7 +316,8 @@ static int atmosphere_render(const obj_t *obj, const painter_t *painter_)
     atmosphere_t *atm = (atmosphere_t*)obj;
     obj_t *sun, *moon;
     double sun_pos[4], moon_pos[4], sun_vmag, moon_vmag;
-    render_data_t data;
+    render_data_t *data;
+    cache_key_t key;
     int i;
     painter_t painter = *painter_;
     core->lwsky_average = 0.0001;
@@ -224,51 +335,74 @@ static int atmosphere_render(const obj_t *obj, const painter_t *painter_)
     obj_get_info(sun, obs, INFO_VMAG, &sun_vmag);
     obj_get_info(moon, obs, INFO_VMAG, &moon_vmag);
 
-    // XXX: this could be cached!
-    data = prepare_render_data(sun_pos, sun_vmag, moon_pos, moon_vmag,
-                               atm->turbidity, core->bortle_index);
-    // This is quite ad-hoc as in reality we are using a HIPS grid
-    data.cos_grid_angular_step = cos(15. * DD2R);
-    prepare_skybrightness(&data.skybrightness,
-            &painter, sun_pos, moon_pos, moon_vmag);
+    // Only recompute the render data and the luminance when the inputs
+    // changed enough.
+    get_cache_key(atm, obs, sun_pos, sun_vmag, moon_pos, moon_vmag, &key);
+    data = &atm->cache.data;
+    if (!atm->cache.valid || !cache_key_match(&atm->cache.key, &key)) {
+        *data = prepare_render_data(sun_pos, sun_vmag, moon_pos, moon_vmag,
+                                    atm->turbidity, core->bortle_index);
+        // This is quite ad-hoc as in reality we are using a HIPS grid
+        data->cos_grid_angular_step = cos(15. * DD2R);
+        prepare_skybrightness(&data->skybrightness,
+                &painter, sun_pos, moon_pos, moon_vmag);
+        memset(atm->cache.tiles_valid, 0, sizeof(atm->cache.tiles_valid));
+        atm->cache.key = key;
+        atm->cache.valid = true;
+    }
 
     // Set the shader attributes.
-    painter.atm.p[0]  = data.Px[0];
-    painter.atm.p[1]  = data.Px[1];
-    painter.atm.p[2]  = data.Px[2];
-    painter.atm.p[3]  = data.Px[3];
-    painter.atm.p[4]  = data.Px[4];
-    painter.atm.p[5]  = data.kx;
-
-    painter.atm.p[6]  = data.Py[0];
-    painter.atm.p[7]  = data.Py[1];
-    painter.atm.p[8]  = data.Py[2];
-    painter.atm.p[9]  = data.Py[3];
-    painter.atm.p[10] = data.Py[4];
-    painter.atm.p[11] = data.ky;
+    painter.atm.p[0]  = data->Px[0];
+    painter.atm.p[1]  = data->Px[1];
+    painter.atm.p[2]  = data->Px[2];
+    painter.atm.p[3]  = data->Px[3];
+    painter.atm.p[4]  = data->Px[4];
+    painter.atm.p[5]  = data->kx;
+
+    painter.atm.p[6]  = data->Py[0];
+    painter.atm.p[7]  = data->Py[1];
+    painter.atm.p[8]  = data->Py[2];
+    painter.atm.p[9]  = data->Py[3];
+    painter.atm.p[10] = data->Py[4];
+    painter.atm.p[11] = data->ky;
 
     vec3_to_float(sun_pos, painter.atm.sun);
     painter.atm.compute_lum = compute_lum;
-    painter.atm.user = &data;
+    painter.atm.user = data;
     painter.flags |= PAINTER_ADD | PAINTER_ATMOSPHERE_SHADER;
     painter.color[3] = atm->visible.value;
 
-    data.max_lum = 0;
+    data->sum_lum = 0;
+    data->max_lum = 0;
+    data->nb_lum = 0;
     for (i = 0; i < 12; i++) {
         render_tile(atm, &painter, 0, i);
     }
 
-    core_report_luminance_in_fov(data.max_lum, true);
-    if (data.nb_lum)
-        core->lwsky_average = data.sum_lum / data.nb_lum;
+    core_report_luminance_in_fov(data->max_lum, true);
+    if (data->nb_lum)
+        core->lwsky_average = data->sum_lum / data->nb_lum;
     return 0;
 }
 
 static int atmosphere_init(obj_t *obj, json_value *args)
 {
     atmosphere_t *atm = (void*)obj;
+    int pix, i;
+    uv_map_t map;
+    double grid[GRID_SIZE][4];
+
     atm->turbidity = 0.96;  // Calibrated visually
     fader_init(&atm->visible, true);
+
+    // Precompute the grid vertices of all the tiles, as they will be passed
+    // to compute_lum by the renderer.
+    for (pix = 0; pix < NB_TILES; pix++) {
+        uv_map_init_healpix(&map, 1, pix, true, true);
+        uv_map_grid(&map, GRID_SPLIT, grid, NULL);
+        for (i = 0; i < GRID_SIZE; i++)
+            vec3_to_float(grid[i], atm->cache.pos[pix][i]);
+    }
     return 0;
 }
 
@@ -10,6 +10,7 @@
 #include "swe.h"
 #include "mpc.h"
 #include <regex.h>
+#include <zlib.h> // For crc32.
 
 typedef struct orbit_t {
     double d;    // date (julian day).
@@ -72,93 +73,121 @@ static const char *orbit_type_to_otype(char o)
     }
 }
 
-static void load_data(comets_t *comets, const char *data, int size)
+static void add_comets(comets_t *comets, const mpc_comet_t *recs, int nb)
 {
+    int i;
+    const mpc_comet_t *rec;
     comet_t *comet;
-    int num, nb_err = 0, len, line_idx = 0, r, nb;
-    double peri_time, peri_dist, e, peri, node, i, epoch, h, g;
     double last_epoch = 0;
-    const char *line = NULL;
-    char orbit_type;
-    char desgn[64];
     char buf[128];
-    obj_t *tmp;
 
+    for (i = 0; i < nb; i++) {
+        rec = &recs[i];
+        comet = (void*)module_add_new(&comets->obj, "mpc_comet", NULL, NULL);
+        comet->num = rec->number;
+        comet->h = rec->h;
+        comet->g = rec->g;
+        comet->orbit.d = rec->peri_time;
+        comet->orbit.i = rec->i * DD2R;
+        comet->orbit.o = rec->node * DD2R;
+        comet->orbit.w = rec->peri * DD2R;
+        comet->orbit.q = rec->peri_dist;
+        comet->orbit.e = rec->e;
+        strncpy(comet->obj.type, orbit_type_to_otype(rec->orbit_type), 4);
+        _Static_assert(sizeof(rec->desig) == sizeof(comet->name), "");
+        memcpy(comet->name, rec->desig, sizeof(rec->desig));
+        comet->obj.oid = oid_create("Com", rec->line_idx);
+        comet->pvo[0][0] = NAN;
+        last_epoch = max(rec->epoch, last_epoch);
+        names_add_obj(&comet->obj, 0);
+    }
+    LOG_I("Added %d comets (latest epoch: %s)", nb,
+          format_time(buf, last_epoch, 0, "YYYY-MM-DD"));
+}
+
+/*
+ * Parse the MPC text data into an array of records.
+ * Return the number of records.
+ */
+static int parse_data(const char *data, int size, mpc_comet_t **recs)
+{
+    int nb_err = 0, len, line_idx = 0, r, nb = 0, capacity = 0;
+    const char *line = NULL;
+    mpc_comet_t *rec;
+
+    *recs = NULL;
     while (iter_lines(data, size, &line, &len)) {
         line_idx++;
+        if (nb >= capacity) {
+            capacity = max(256, capacity * 2);
+            *recs = realloc(*recs, capacity * sizeof(**recs));
+        }
+        rec = &(*recs)[nb];
+        memset(rec, 0, sizeof(*rec));
         r = mpc_parse_comet_line(
-                line, len, &num, &orbit_type, &peri_time, &peri_dist, &e,
-                &peri, &node, &i, &epoch, &h, &g, desgn);
+                line, len, &rec->number, &rec->orbit_type, &rec->peri_time,
+                &rec->peri_dist, &rec->e, &rec->peri, &rec->node, &rec->i,
+                &rec->epoch, &rec->h, &rec->g, rec->desig);
         if (r) {
             nb_err++;
             continue;
         }
-
-        comet = (void*)module_add_new(&comets->obj, "mpc_comet", NULL, NULL);
-        comet->num = num;
-        comet->h = h;
-        comet->g = g;
-        comet->orbit.d = peri_time;
-        comet->orbit.i = i * DD2R;
-        comet->orbit.o = node * DD2R;
-        comet->orbit.w = peri * DD2R;
-        comet->orbit.q = peri_dist;
-        comet->orbit.e = e;
-        strncpy(comet->obj.type, orbit_type_to_otype(orbit_type), 4);
-        strcpy(comet->name, desgn);
-        comet->obj.oid = oid_create("Com", line_idx);
-        comet->pvo[0][0] = NAN;
-        last_epoch = max(epoch, last_epoch);
+        rec->line_idx = line_idx;
+        nb++;
     }
 
     if (nb_err) {
         LOG_W("Comet planet data got %d error lines.", nb_err);
     }
-    DL_COUNT(comets->obj.children, tmp, nb);
-    LOG_I("Parsed %d comets (latest epoch: %s)", nb,
-          format_time(buf, last_epoch, 0, "YYYY-MM-DD"));
+    return nb;
 }
 
-static int comet_update(comet_t *comet, const observer_t *obs)
+static void load_data(comets_t *comets, const char *data, int size,
+                      const char *etag)
 {
-    double a, p, n, ph[2][3], pv[2][3], or, sr, b, v, w, r, o, u, i;
-    const double K = 0.01720209895; // AU, day
-
-    // Position algo for elliptical comets.
-    if (comet->orbit.e < 0.98) {
-        // Mean distance.
-        a = comet->orbit.q / (1.0 - comet->orbit.e);
-        // Orbital period.
-        p = 2 * M_PI * sqrt(a * a * a) / K;
-        // Daily motion.
-        n = 2 * M_PI / p;
-
-        orbit_compute_pv(0.005 * DD2R,
-                         obs->tt, ph[0], NULL, comet->orbit.d, comet->orbit.i,
-                         comet->orbit.o, comet->orbit.w, a, n, comet->orbit.e,
-                         0, 0, 0);
-    } else {
-        // Algo for non elliptical orbits, taken from
-        // http://stjarnhimlen.se/comp/tutorial.html
-        // TODO: move into orbit_compute_pv directly somehow?
-        a = 1.5 * (obs->tt - comet->orbit.d) * K /
-                sqrt(2 * comet->orbit.q * comet->orbit.q * comet->orbit.q);
-        b = sqrt(1 + a * a);
-        w = pow(b + a, 1. / 3) - pow(b - a, 1. / 3);
-        v = 2 * atan(w);
-        r = comet->orbit.q * (1 + w * w);
-        // Compute position into the plane of the ecliptic.
-        o = comet->orbit.o;
-        u = v + comet->orbit.w;
-        i = comet->orbit.i;
-        ph[0][0] = r * (cos(o) * cos(u) - sin(o) * sin(u) * cos(i));
-        ph[0][1] = r * (sin(o) * cos(u) + cos(o) * sin(u) * cos(i));
-        ph[0][2] = r * (sin(u) * sin(i));
+    char path[1024];
+    int nb;
+    uint64_t key;
+    mpc_comet_t *recs;
+    const mpc_comet_t *cached;
+
+    // Try first to use the binary cache of the parsed data.
+    snprintf(path, sizeof(path), "%s/.cache/mpc/%08lx.bin",
+             sys_get_user_dir(),
+             crc32(0L, (const Bytef*)comets->source_url,
+                   strlen(comets->source_url)));
+    key = mpc_cache_key(comets->source_url, etag, data, size);
+    cached = mpc_cache_load(path, key, sizeof(*cached), &nb);
+    if (cached) {
+        add_comets(comets, cached, nb);
+        mpc_cache_release(cached);
+        return;
     }
 
+    nb = parse_data(data, size, &recs);
+    add_comets(comets, recs, nb);
+    if (sys_make_dir(path) == 0)
+        mpc_cache_save(path, key, recs, sizeof(*recs), nb);
+    free(recs);
+}
+
+static int comet_update(comet_t *comet, const observer_t *obs)
+{
+    double ph[2][3], pv[2][3], or, sr;
+    const orbit_elements_t elem = {
+        .d = comet->orbit.d,
+        .i = comet->orbit.i,
+        .o = comet->orbit.o,
+        .w = comet->orbit.w,
+        .q = comet->orbit.q,
+        .e = comet->orbit.e,
+    };
+
+    // Works for all kinds of orbits, including parabolic and hyperbolic.
+    orbit_compute_pv_batch(1, &elem, obs->tt, &ph[0], &ph[1]);
     mat3_mul_vec3(obs->re2i, ph[0], ph[0]);
+    mat3_mul_vec3(obs->re2i, ph[1], ph[1]);
 
-    vec3_set(ph[1], 0, 0, 0);
     position_to_apparent(obs, ORIGIN_HELIOCENTRIC, false, ph, pv);
     vec3_copy(pv[0], comet->pvo[0]);
     comet->pvo[0][3] = 1;
@@ -289,7 +318,7 @@ static int comets_update(obj_t *obj, double dt)
                   comets->source_url, code);
             return 0;
         }
-        load_data(comets, data, size);
+        load_data(comets, data, size, asset_get_etag(comets->source_url));
         asset_release(comets->source_url);
         // Make sure the search work.
         assert(strcmp(obj_get(NULL, "C/1995 O1", 0)->klass->id,
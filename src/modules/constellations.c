@@ -463,7 +463,7 @@ static bool constellation_lines_in_view(const constellation_t *con,
                                         const painter_t *painter)
 {
     int i, nb = 0;
-    double (*pos)[4], mx, my;
+    double (*pos)[4], (*view)[3], mx, my;
     bool ret;
     const double m = 100; // Border margins (windows unit).
 
@@ -474,17 +474,23 @@ static bool constellation_lines_in_view(const constellation_t *con,
 
     // Clipping test.
     pos = calloc(con->count, sizeof(*pos));
+    view = calloc(con->count, sizeof(*view));
     for (i = 0; i < con->count; i++) {
         if (!con->stars[i]) continue;
-        convert_frame(painter->obs, FRAME_ICRF, FRAME_VIEW, true,
-                      con->stars_pos[i], pos[nb]);
-        project(painter->proj, 0, pos[nb], pos[nb]);
-        nb++;
+        vec3_copy(con->stars_pos[i], view[nb++]);
     }
     if (nb == 0) {
+        free(view);
         free(pos);
         return true;
     }
+    convert_frame_batch(painter->obs, FRAME_ICRF, FRAME_VIEW, true, nb,
+                        view, view);
+    for (i = 0; i < nb; i++) {
+        vec3_copy(view[i], pos[i]);
+        project(painter->proj, 0, pos[i], pos[i]);
+    }
+    free(view);
     // Compute margins in NDC.
     mx = m * painter->pixel_scale / painter->fb_size[0] * 2;
     my = m * painter->pixel_scale / painter->fb_size[1] * 2;
@@ -507,7 +513,7 @@ static bool constellation_image_in_view(const constellation_t *con,
                                         const painter_t *painter)
 {
     int i;
-    double pos[4][4], mx, my;
+    double pos[4][4], view[4][3], mx, my;
     bool ret;
     const double m = 100; // Border margins (windows unit).
     const observer_t *obs = painter->obs;
@@ -523,10 +529,13 @@ static bool constellation_image_in_view(const constellation_t *con,
 
     // Clipping test.
     for (i = 0; i < 4; i++) {
-        vec4_set(pos[i], i / 2, i % 2, 1, 0);
-        mat3_mul_vec3(con->img.mat, pos[i], pos[i]);
-        vec3_normalize(pos[i], pos[i]);
-        convert_frame(obs, FRAME_ICRF, FRAME_VIEW, true, pos[i], pos[i]);
+        vec3_set(view[i], i / 2, i % 2, 1);
+        mat3_mul_vec3(con->img.mat, view[i], view[i]);
+        vec3_normalize(view[i], view[i]);
+    }
+    convert_frame_batch(obs, FRAME_ICRF, FRAME_VIEW, true, 4, view, view);
+    for (i = 0; i < 4; i++) {
+        vec4_set(pos[i], view[i][0], view[i][1], view[i][2], 0);
         project(painter->proj, 0, pos[i], pos[i]);
     }
 
@@ -800,27 +809,29 @@ static int constellations_update(obj_t *obj, double dt)
 {
     constellation_t *con;
     constellations_t *cons = (constellations_t*)obj;
+    bool changed = false;
 
-    fader_update(&cons->visible, dt);
-    fader_update(&cons->images_visible, dt);
-    fader_update(&cons->lines_visible, dt);
-    fader_update(&cons->labels_visible, dt);
-    fader_update(&cons->bounds_visible, dt);
+    changed |= fader_update(&cons->visible, dt);
+    changed |= fader_update(&cons->images_visible, dt);
+    changed |= fader_update(&cons->lines_visible, dt);
+    changed |= fader_update(&cons->labels_visible, dt);
+    changed |= fader_update(&cons->bounds_visible, dt);
 
     // Skip update if not visible.
-    if (cons->visible.value == 0.0) return 0;
+    if (cons->visible.value == 0.0) return changed ? 1 : 0;
     if (cons->lines_visible.value == 0.0 &&
         cons->images_visible.value == 0.0 &&
         cons->bounds_visible.value == 0.0 &&
         cons->labels_visible.value == 0.0 &&
-        (!core->selection || core->selection->parent != obj)) return 0;
+        (!core->selection || core->selection->parent != obj))
+        return changed ? 1 : 0;
 
     MODULE_ITER(obj, con, "constellation") {
-        fader_update(&con->image_loaded_fader, dt);
-        fader_update(&con->lines_in_view, dt);
-        fader_update(&con->image_in_view, dt);
+        changed |= fader_update(&con->image_loaded_fader, dt);
+        changed |= fader_update(&con->lines_in_view, dt);
+        changed |= fader_update(&con->image_in_view, dt);
     }
-    return 0;
+    return changed ? 1 : 0;
 }
 
 static int constellations_render(const obj_t *obj, const painter_t *painter)
@@ -270,6 +270,7 @@ static int on_file_tile_loaded(const char type[4],
     int nb, i, j, version, data_ofs = 0, flags, row_size, order, pix;
     int children_mask;
     char morpho[32], ids[256] = {};
+    const char *name;
     double bmag, temp_mag, tmp_ra, tmp_de, tmp_smax, tmp_smin, tmp_angle;
     void *tile_data;
     const double DAM2R = DD2R / 60.0; // arcmin to rad.
@@ -358,6 +359,8 @@ static int on_file_tile_loaded(const char type[4],
             s->names = calloc(1, 2 + strlen(ids));
             for (j = 0; ids[j]; j++)
                 s->names[j] = ids[j] != '|' ? ids[j] : '\0';
+            for (name = s->names; *name; name += strlen(name) + 1)
+                names_add(name, s->oid, nuniq);
         }
     }
     free(tile_data);
@@ -650,6 +653,7 @@ static int dsos_render(const obj_t *obj, const painter_t *painter_)
     survey_t *survey;
 
     painter.color[3] *= dsos->visible.value;
+    painter.stars_limit_mag -= painter.degrade * 3;
     DL_FOREACH(dsos->surveys, survey) {
         hips_traverse(USER_PASS(dsos, &painter, &nb_tot, &nb_loaded, survey),
                       render_visitor);
@@ -683,12 +687,24 @@ static int dsos_get_visitor(int order, int pix, void *user)
     return 1;
 }
 
+static obj_t *dsos_get_by_oid(const obj_t *obj, uint64_t oid,
+                              uint64_t hint);
+
 static obj_t *dsos_get(const obj_t *obj, const char *id, int flags)
 {
     int r, cat;
-    uint64_t n;
+    uint64_t n, oid, hint;
     regmatch_t matches[3];
     dsos_t *dsos = (dsos_t*)obj;
+    obj_t *ret;
+
+    // Try first the names index, so that we only need to look in a single
+    // tile.
+    if (names_lookup(id, &oid, &hint) && hint &&
+            oid_is_catalog(oid, "NDSO")) {
+        ret = dsos_get_by_oid(obj, oid, hint);
+        if (ret) return ret;
+    }
 
     r = regexec(&dsos->search_reg, id, 3, matches, 0);
     if (r) return NULL;
@@ -750,7 +766,8 @@ static int dsos_list(const obj_t *obj, observer_t *obs,
                      double max_mag, uint64_t hint, const char *source,
                      void *user, int (*f)(void *user, obj_t *obj))
 {
-    int order, pix, i, r, nb = 0;
+    int order, pix, i, r, ret = -1;
+    bool loading_complete;
     dsos_t *dsos = (dsos_t*)obj;
     dso_t *dso;
     tile_t *tile;
@@ -762,18 +779,21 @@ static int dsos_list(const obj_t *obj, observer_t *obs,
     pix = hint - 4 * (1 << (2 * (order)));
 
     DL_FOREACH(dsos->surveys, survey) {
-        tile = get_tile(dsos, survey, order, pix, true, NULL);
-        if (!tile) continue;
+        tile = get_tile(dsos, survey, order, pix, true, &loading_complete);
+        if (!tile) {
+            if (!loading_complete) ret = MODULE_AGAIN; // Try again later.
+            continue;
+        }
+        if (ret == -1) ret = 0;
         for (i = 0; i < tile->nb; i++) {
             if (!f) continue;
-            nb++;
             dso = dso_create(&tile->sources[i]);
             r = f(user, (obj_t*)dso);
             obj_release((obj_t*)dso);
             if (r) break;
         }
     }
-    return nb;
+    return ret;
 }
 
 static int dsos_add_data_source(obj_t *obj, const char *url, const char *key)
@@ -809,7 +829,7 @@ OBJ_REGISTER(dso_klass)
 static obj_klass_t dsos_klass = {
     .id     = "dsos",
     .size   = sizeof(dsos_t),
-    .flags  = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags  = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_ADAPTIVE,
     .init   = dsos_init,
     .update = dsos_update,
     .render = dsos_render,
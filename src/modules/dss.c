@@ -108,7 +108,7 @@ static int dss_add_data_source(obj_t *obj, const char *url, const char *key)
 static obj_klass_t dss_klass = {
     .id = "dss",
     .size = sizeof(dss_t),
-    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_ADAPTIVE,
     .init = dss_init,
     .update = dss_update,
     .render = dss_render,
@@ -13,6 +13,11 @@
 
 #include "utils/mesh.h"
 
+// Healpix order of the features index cells (about 3.7 deg).
+#define INDEX_ORDER 4
+// Meshes covering more cells than this go into the global list instead.
+#define INDEX_MAX_CELLS 64
+
 typedef struct feature feature_t;
 
 struct feature {
@@ -39,11 +44,28 @@ struct feature {
  *   filter - Function called for each feature.  Can set the fill and stroke
  *            color.  If it returns zero, then the feature is hidden.
  */
+// Reference to a feature mesh in the features index.
+typedef struct {
+    int             idx;
+    const feature_t *feature;
+    const mesh_t    *mesh;
+} mesh_ref_t;
+
 typedef struct image {
     obj_t       obj;
     feature_t   *features;
     int         frame;
     int         (*filter)(int idx, float fill_color[4], float stroke_color[4]);
+
+    // Index of the features meshes per healpix cell, used for the point
+    // queries.  Rebuilt on demand after the features changed.
+    struct {
+        bool        valid;
+        int         *cells;     // Offset of each cell first ref in refs.
+        mesh_ref_t  *refs;
+        int         nb_globals;
+        mesh_ref_t  *globals;   // Meshes too large to be put in cells.
+    } index;
 } image_t;
 
 
@@ -82,6 +104,7 @@ static void feature_add_geo(feature_t *feature, const geojson_geometry_t *geo)
         // For testing.  We want to avoid meshes with too long edges
         // for the distortion.
         mesh_subdivide(mesh, M_PI / 8);
+        mesh_build_index(mesh);
 
         DL_APPEND(feature->meshes, mesh);
         return;
@@ -130,6 +153,7 @@ static void add_geojson_feature(image_t *image,
 
     feature_add_geo(feature, &geo_feature->geometry);
     DL_APPEND(image->features, feature);
+    image->index.valid = false;
 }
 
 static void feature_del(obj_t *obj)
@@ -170,6 +194,7 @@ void geojson_remove_all_features(image_t *image)
         DL_DELETE(image->features, feature);
         obj_release(&feature->obj);
     }
+    image->index.valid = false;
 }
 
 // XXX: deprecated: we use filter_all instead now!
@@ -296,10 +321,81 @@ static int image_render(const obj_t *obj, const painter_t *painter_)
     return 0;
 }
 
+static void image_release_index(image_t *image)
+{
+    free(image->index.cells);
+    free(image->index.refs);
+    free(image->index.globals);
+    memset(&image->index, 0, sizeof(image->index));
+}
+
+/*
+ * Put all the features meshes into healpix cells buckets, according to
+ * their bounding caps.  The refs are added in the features order, so that
+ * the queries return the features in the same order as a linear scan.
+ */
+static void image_build_index(image_t *image)
+{
+    const int nb_cells = 12 << (2 * INDEX_ORDER);
+    int pass, i, j, nb_ranges, nb, pix, idx;
+    int *ranges, *cursors;
+    const feature_t *feature;
+    const mesh_t *mesh;
+    mesh_ref_t ref;
+
+    image_release_index(image);
+    image->index.cells = calloc(nb_cells + 1, sizeof(int));
+    cursors = calloc(nb_cells, sizeof(int));
+
+    // First pass to count the refs in each cell, second pass to fill them.
+    for (pass = 0; pass < 2; pass++) {
+        image->index.nb_globals = 0;
+        idx = 0;
+        for (feature = image->features; feature;
+             feature = feature->next, idx++) {
+            for (mesh = feature->meshes; mesh; mesh = mesh->next) {
+                ref = (mesh_ref_t){idx, feature, mesh};
+                nb_ranges = healpix_query_disc(INDEX_ORDER,
+                                               mesh->bounding_cap, &ranges);
+                for (i = 0, nb = 0; i < nb_ranges; i++)
+                    nb += ranges[i * 2 + 1] - ranges[i * 2];
+                if (nb > INDEX_MAX_CELLS) {
+                    if (pass == 1)
+                        image->index.globals[image->index.nb_globals] = ref;
+                    image->index.nb_globals++;
+                    free(ranges);
+                    continue;
+                }
+                for (i = 0; i < nb_ranges; i++) {
+                    for (pix = ranges[i * 2]; pix < ranges[i * 2 + 1]; pix++) {
+                        if (pass == 0) {
+                            image->index.cells[pix + 1]++;
+                            continue;
+                        }
+                        j = image->index.cells[pix] + cursors[pix]++;
+                        image->index.refs[j] = ref;
+                    }
+                }
+                free(ranges);
+            }
+        }
+        if (pass == 1) break;
+        for (pix = 0; pix < nb_cells; pix++)
+            image->index.cells[pix + 1] += image->index.cells[pix];
+        image->index.refs = calloc(image->index.cells[nb_cells] + 1,
+                                   sizeof(*image->index.refs));
+        image->index.globals = calloc(image->index.nb_globals + 1,
+                                      sizeof(*image->index.globals));
+    }
+    free(cursors);
+    image->index.valid = true;
+}
+
 static void image_del(obj_t *obj)
 {
     image_t *image = (void*)obj;
     geojson_remove_all_features(image);
+    image_release_index(image);
 }
 
 // Special function for fast geojson parsing directly from js!
@@ -339,14 +435,13 @@ EMSCRIPTEN_KEEPALIVE
 int geojson_query_rendered_features(
         const obj_t *obj, double win_pos[2], int max_ret, int *index)
 {
-    const image_t *image = (void*)obj;
-    int i = 0, nb = 0;
-    const feature_t *feature;
-    const mesh_t *mesh;
+    image_t *image = (void*)obj;
+    int i, j, nb = 0, pix, end;
+    const mesh_ref_t *ref, *cell;
     painter_t painter;
     int frame = image->frame;
     projection_t proj;
-    double pos[3];
+    double pos[3], theta, phi;
 
     core_get_proj(&proj);
     painter = (painter_t) {
@@ -355,14 +450,27 @@ int geojson_query_rendered_features(
     };
     painter_update_clip_info(&painter);
     painter_unproject(&painter, frame, win_pos, pos);
-
-    for (feature = image->features; feature; feature = feature->next, i++) {
+    vec3_normalize(pos, pos);
+
+    if (!image->index.valid) image_build_index(image);
+    eraC2s(pos, &phi, &theta);
+    healpix_ang2pix(1 << INDEX_ORDER, M_PI / 2 - theta, phi, &pix);
+    cell = image->index.refs + image->index.cells[pix];
+    end = image->index.cells[pix + 1] - image->index.cells[pix];
+
+    // Merge the cell and global refs, both sorted by feature index.
+    i = 0;
+    j = 0;
+    while (i < end || j < image->index.nb_globals) {
+        if (j == image->index.nb_globals ||
+                (i < end && cell[i].idx <= image->index.globals[j].idx))
+            ref = &cell[i++];
+        else
+            ref = &image->index.globals[j++];
         if (nb >= max_ret) break;
-        if (feature->hidden) continue;
-        for (mesh = feature->meshes; mesh; mesh = mesh->next) {
-            if (mesh_contains_vec3(mesh, pos))
-                index[nb++] = i;
-        }
+        if (ref->feature->hidden) continue;
+        if (mesh_contains_vec3(ref->mesh, pos))
+            index[nb++] = ref->idx;
     }
     return nb;
 }
@@ -383,6 +491,7 @@ OBJ_REGISTER(geojson_feature_klass)
 static obj_klass_t image_klass = {
     .id = "geojson",
     .size = sizeof(image_t),
+    .flags = OBJ_RENDER_JOB,
     .init = image_init,
     .render = image_render,
     .del = image_del,
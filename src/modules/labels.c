@@ -9,6 +9,8 @@
 
 #include "swe.h"
 
+#include <limits.h>
+
 
 typedef struct label label_t;
 struct label
@@ -155,9 +157,18 @@ static int labels_render(const obj_t *obj, const painter_t *painter)
     label_t *label;
     double pos[2], color[4];
     const double max_overlap = 8;
+    int nb = 0;
+    // Only show the labels with the highest priority if the governor asks
+    // for it.
+    const int max_nb = painter->degrade ? 32 + 224 * (1 - painter->degrade) :
+                                          INT_MAX;
 
     DL_SORT(g_labels->labels, label_cmp);
     DL_FOREACH(g_labels->labels, label) {
+        if (nb++ >= max_nb) {
+            label->fader.target = false;
+            if (!label->fader.value) continue;
+        }
         // Re-project label on screen
         if (label->frame != -1) {
             painter_project(painter, label->frame, label->pos, label->at_inf,
@@ -165,7 +176,7 @@ static int labels_render(const obj_t *obj, const painter_t *painter)
         }
         label_get_bounds(painter, label, label->align, label->effects,
                          label->bounds);
-        label->fader.target = label->active &&
+        label->fader.target = label->active && nb <= max_nb &&
                                 (test_label_overlaps(label) <= max_overlap);
         pos[0] = label->bounds[0];
         pos[1] = label->bounds[1];
@@ -181,10 +192,11 @@ static int labels_render(const obj_t *obj, const painter_t *painter)
 static int labels_update(obj_t *obj, double dt)
 {
     label_t *label = (label_t *)obj;
+    bool changed = false;
     DL_FOREACH(g_labels->labels, label) {
-        fader_update(&label->fader, dt);
+        changed |= fader_update(&label->fader, dt);
     }
-    return 0;
+    return changed ? 1 : 0;
 }
 
 
@@ -285,7 +297,7 @@ uint64_t labels_get_obj_at(const double pos[2], double max_dist)
 static obj_klass_t labels_klass = {
     .id = "labels",
     .size = sizeof(labels_t),
-    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_ADAPTIVE,
     .init = labels_init,
     .render = labels_render,
     .update = labels_update,
@@ -237,12 +237,13 @@ static int landscapes_update(obj_t *obj, double dt)
 {
     landscapes_t *lss = (landscapes_t*)obj;
     obj_t *ls;
+    bool changed = false;
     MODULE_ITER((obj_t*)lss, ls, "landscape") {
-        landscape_update(ls, dt);
+        changed |= landscape_update(ls, dt);
     }
-    fader_update(&lss->visible, dt);
-    fader_update(&lss->fog_visible, dt);
-    return 0;
+    changed |= fader_update(&lss->visible, dt);
+    changed |= fader_update(&lss->fog_visible, dt);
+    return changed ? 1 : 0;
 }
 
 static int landscapes_render(const obj_t *obj, const painter_t *painter)
@@ -503,7 +503,7 @@ static void render_recursion(
     int i, j, dir;
     int split_az, split_al, new_splits[2], new_pos[2];
     double p[4], lines[4][4] = {}, u[2], v[2];
-    double pos_view[4][4], pos_clip[4][4];
+    double pos_view[4][4], pos_clip[4][4], corners[4][3];
     double uv[4][2] = {{0.0, 1.0}, {1.0, 1.0}, {0.0, 0.0}, {1.0, 0.0}};
     double mat[3][3] = MAT3_IDENTITY;
     uv_map_t map = {
@@ -515,14 +515,17 @@ static void render_recursion(
     mat3_iscale(mat, 1. / splits[0], 1. / splits[1], 0);
     mat3_itranslate(mat, pos[0], pos[1]);
 
-    // Compute quad corners in clipping space.
+    // Compute quad corners in clipping space.  They are all at infinity.
     for (i = 0; i < 4; i++) {
         mat3_mul_vec2(mat, uv[i], p);
         spherical_project(&map, p, p);
-        convert_framev4(painter->obs, line->frame, FRAME_VIEW, p, p);
-        vec4_copy(p, pos_view[i]);
-        project(painter->proj, 0, p, p);
-        vec4_copy(p, pos_clip[i]);
+        vec3_copy(p, corners[i]);
+    }
+    convert_frame_batch(painter->obs, line->frame, FRAME_VIEW, true, 4,
+                        corners, corners);
+    for (i = 0; i < 4; i++) {
+        vec4_set(pos_view[i], corners[i][0], corners[i][1], corners[i][2], 0);
+        project(painter->proj, 0, pos_view[i], pos_clip[i]);
     }
     // If the quad is clipped we stop the recursion.
     // We only start to test after a certain level to prevent distortion
@@ -599,28 +602,30 @@ keep_going:
 static void get_azalt_fov(const painter_t *painter, int frame,
                           double *azfov, double *altfov)
 {
-    double p[4] = {0, 0, 0, 0};
+    enum { N = 3 };
+    double p[4] = {0, 0, 0, 0}, grid[N * N + 1][3];
     double theta0, phi0, theta, phi;
     double theta_max = 0, theta_min = 0;
     double phi_max = 0, phi_min = 0;
     int i;
-    const int N = 3;
 
     /*
      * This works by unprojection all the points of an NxN grid from the screen
      * into the frame and testing the maximum and minimum distance to the
-     * central point for each of them.
+     * central point for each of them.  The last point is the center.
      */
-    project(painter->proj, PROJ_BACKWARD, p, p);
-    convert_frame(painter->obs, FRAME_VIEW, frame, true, p, p);
-    eraC2s(p, &theta0, &phi0);
+    for (i = 0; i < N * N + 1; i++) {
+        p[0] = i < N * N ? 2 * ((i % N) / (double)(N - 1) - 0.5) : 0;
+        p[1] = i < N * N ? 2 * ((i / N) / (double)(N - 1) - 0.5) : 0;
+        project(painter->proj, PROJ_BACKWARD, p, p);
+        vec3_copy(p, grid[i]);
+    }
+    convert_frame_batch(painter->obs, FRAME_VIEW, frame, true, N * N + 1,
+                        grid, grid);
+    eraC2s(grid[N * N], &theta0, &phi0);
 
     for (i = 0; i < N * N; i++) {
-        p[0] = 2 * ((i % N) / (double)(N - 1) - 0.5);
-        p[1] = 2 * ((i / N) / (double)(N - 1) - 0.5);
-        project(painter->proj, PROJ_BACKWARD, p, p);
-        convert_frame(painter->obs, FRAME_VIEW, frame, true, p, p);
-        eraC2s(p, &theta, &phi);
+        eraC2s(grid[i], &theta, &phi);
 
         theta = eraAnpm(theta - theta0);
         theta_max = max(theta_max, theta);
@@ -769,7 +774,7 @@ static int line_render(const obj_t *obj, const painter_t *painter_)
 static obj_klass_t line_klass = {
     .id = "line",
     .size = sizeof(line_t),
-    .flags = OBJ_IN_JSON_TREE,
+    .flags = OBJ_IN_JSON_TREE | OBJ_RENDER_JOB,
     .update = line_update,
     .render = line_render,
     .attributes = (attribute_t[]) {
@@ -783,7 +788,7 @@ OBJ_REGISTER(line_klass)
 static obj_klass_t lines_klass = {
     .id = "lines",
     .size = sizeof(lines_t),
-    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_RENDER_JOB,
     .init = lines_init,
     .update = lines_update,
     .render = lines_render,
@@ -164,7 +164,8 @@ static int meteors_update(obj_t *obj, double dt)
         }
     }
 
-    return 0;
+    // Keep rendering while some meteors are moving.
+    return obj->children ? 1 : 0;
 }
 
 static int meteors_render(const obj_t *obj, const painter_t *painter)
@@ -79,7 +79,7 @@ static int milkyway_add_data_source(
 static obj_klass_t milkyway_klass = {
     .id = "milkyway",
     .size = sizeof(milkyway_t),
-    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_ADAPTIVE,
     .init = milkyway_init,
     .update = milkyway_update,
     .render = milkyway_render,
@@ -106,56 +106,107 @@ static const char *ORBIT_TYPES[] = {
 };
 
 
-static void load_data(mplanets_t *mplanets, const char *data, int size)
+static void add_asteroids(mplanets_t *mplanets,
+                          const mpc_asteroid_t *recs, int nb)
 {
-    const char *line = NULL;
-    int r, len, line_idx = 0, flags, orbit_type, number, nb_err, nb;
-    char desig[24], name[24];
-    double h, g, m, w, o, i, e, n, a, epoch;
+    int i, orbit_type;
+    const mpc_asteroid_t *rec;
     mplanet_t *mplanet;
-    obj_t *tmp;
 
-    line_idx = 0;
-    nb_err = 0;
+    for (i = 0; i < nb; i++) {
+        rec = &recs[i];
+        mplanet = (void*)module_add_new(&mplanets->obj, "asteroid", NULL, NULL);
+        mplanet->orbit.d = rec->epoch;
+        mplanet->orbit.m = rec->m * DD2R;
+        mplanet->orbit.w = rec->peri * DD2R;
+        mplanet->orbit.o = rec->node * DD2R;
+        mplanet->orbit.i = rec->i * DD2R;
+        mplanet->orbit.e = rec->e;
+        mplanet->orbit.n = rec->n * DD2R;
+        mplanet->orbit.a = rec->a;
+        mplanet->h = rec->h;
+        mplanet->g = rec->g;
+
+        orbit_type = rec->flags & 0x3f;
+        if (orbit_type >= ARRAY_SIZE(ORBIT_TYPES)) orbit_type = 0;
+        strncpy(mplanet->obj.type, ORBIT_TYPES[orbit_type], 4);
+        mplanet->mpl_number = rec->number;
+        mplanet->obj.oid = compute_oid(rec->number, rec->desig);
+        _Static_assert(sizeof(rec->name) == sizeof(mplanet->name), "");
+        _Static_assert(sizeof(rec->desig) == sizeof(mplanet->desig), "");
+        if (rec->name[0])
+            memcpy(mplanet->name, rec->name, sizeof(rec->name));
+        if (rec->desig[0])
+            memcpy(mplanet->desig, rec->desig, sizeof(rec->desig));
+        // Only index the named asteroids, the full MPC catalog has more
+        // than a million entries.
+        if (rec->name[0]) names_add_obj(&mplanet->obj, 0);
+    }
+}
+
+/*
+ * Parse the MPC text data into an array of records.
+ * Return the number of records.
+ */
+static int parse_data(const char *data, int size, mpc_asteroid_t **recs)
+{
+    const char *line = NULL;
+    int r, len, nb_err = 0, nb = 0, capacity = 0;
+    mpc_asteroid_t *rec;
+
+    *recs = NULL;
     while (iter_lines(data, size, &line, &len)) {
-        line_idx++;
         if (len < 160) continue;
-        r = mpc_parse_line(line, len, &number, name, desig,
-                           &h, &g, &epoch, &m, &w, &o, &i, &e,
-                           &n, &a, &flags);
+        if (nb >= capacity) {
+            capacity = max(1024, capacity * 2);
+            *recs = realloc(*recs, capacity * sizeof(**recs));
+        }
+        rec = &(*recs)[nb];
+        memset(rec, 0, sizeof(*rec));
+        r = mpc_parse_line(line, len, &rec->number, rec->name, rec->desig,
+                           &rec->h, &rec->g, &rec->epoch, &rec->m,
+                           &rec->peri, &rec->node, &rec->i, &rec->e,
+                           &rec->n, &rec->a, &rec->flags);
         if (r) {
             nb_err++;
             continue;
         }
-        mplanet = (void*)module_add_new(&mplanets->obj, "asteroid", NULL, NULL);
-        mplanet->orbit.d = epoch;
-        mplanet->orbit.m = m * DD2R;
-        mplanet->orbit.w = w * DD2R;
-        mplanet->orbit.o = o * DD2R;
-        mplanet->orbit.i = i * DD2R;
-        mplanet->orbit.e = e;
-        mplanet->orbit.n = n * DD2R;
-        mplanet->orbit.a = a;
-        mplanet->h = h;
-        mplanet->g = g;
-
-        orbit_type = flags & 0x3f;
-        strncpy(mplanet->obj.type, ORBIT_TYPES[orbit_type], 4);
-        mplanet->mpl_number = number;
-        mplanet->obj.oid = compute_oid(number, desig);
-        if (name[0]) {
-            _Static_assert(sizeof(name) == sizeof(mplanet->name), "");
-            memcpy(mplanet->name, name, sizeof(name));
-        }
-        if (desig[0]) {
-            _Static_assert(sizeof(desig) == sizeof(mplanet->desig), "");
-            memcpy(mplanet->desig, desig, sizeof(desig));
-        }
+        nb++;
     }
     if (nb_err) {
         LOG_W("Minor planet data got %d errors lines.", nb_err);
     }
-    DL_COUNT(mplanets->obj.children, tmp, nb);
+    return nb;
+}
+
+static void load_data(mplanets_t *mplanets, const char *data, int size,
+                      const char *etag)
+{
+    char path[1024];
+    int nb;
+    uint64_t key;
+    mpc_asteroid_t *recs;
+    const mpc_asteroid_t *cached;
+
+    // Try first to use the binary cache of the parsed data.
+    snprintf(path, sizeof(path), "%s/.cache/mpc/%08lx.bin",
+             sys_get_user_dir(),
+             crc32(0L, (const Bytef*)mplanets->source_url,
+                   strlen(mplanets->source_url)));
+    key = mpc_cache_key(mplanets->source_url, etag, data, size);
+    cached = mpc_cache_load(path, key, sizeof(*cached), &nb);
+    if (cached) {
+        add_asteroids(mplanets, cached, nb);
+        mpc_cache_release(cached);
+        LOG_I("Loaded %d asteroids from cache", nb);
+        return;
+    }
+
+    nb = parse_data(data, size, &recs);
+    add_asteroids(mplanets, recs, nb);
+    if (sys_make_dir(path) == 0)
+        mpc_cache_save(path, key, recs, sizeof(*recs), nb);
+    free(recs);
     LOG_I("Parsed %d asteroids", nb);
 }
 
@@ -334,7 +385,7 @@ static int mplanets_update(obj_t *obj, double dt)
             LOG_W("Cannot read asteroids data: %s (%d)", mps->source_url, code);
             return 0;
         }
-        load_data(mps, data, size);
+        load_data(mps, data, size, asset_get_etag(mps->source_url));
         asset_release(mps->source_url);
     }
     return 0;
@@ -346,7 +397,8 @@ static int mplanets_render(const obj_t *obj, const painter_t *painter)
 
     mplanets_t *mps = (void*)obj;
     int i, nb;
-    const int update_nb = 32;
+    // Update less objects per frame if the governor asks for it.
+    const int update_nb = 32 - 24 * painter->degrade;
     mplanet_t *child;
     obj_t *tmp;
     uint64_t selection_oid = core->selection ? core->selection->oid : 0;
@@ -403,7 +455,8 @@ OBJ_REGISTER(mplanet_klass)
 static obj_klass_t mplanets_klass = {
     .id             = "minor_planets",
     .size           = sizeof(mplanets_t),
-    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_LISTABLE,
+    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_LISTABLE |
+                      OBJ_ADAPTIVE,
     .init           = mplanets_init,
     .add_data_source    = mplanets_add_data_source,
     .update         = mplanets_update,
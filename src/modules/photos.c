@@ -92,7 +92,7 @@ static int photo_render(const obj_t *obj, const painter_t *painter)
     uv_map_t map = {};
     painter_t painter2 = *painter;
 
-    fader_update(&photo->visible, 0.06);
+    if (fader_update(&photo->visible, 0.06)) core_mark_dirty();
     painter2.color[3] *= photo->visible.value;
     if (painter2.color[3] == 0.0) return 0;
 
@@ -12,6 +12,10 @@
 #include <regex.h>
 #include <zlib.h> // For crc32.
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 /* Planets module.
  *
  * All the data is in the file data/planets.ini.
@@ -179,6 +183,26 @@ static void moon_icrf_geocentric_pos(double tt, double pos[3])
 }
 
 
+#ifdef HAVE_PTHREAD
+// Protects the cached positions of the planets, since they can be computed
+// from several threads at once (see compute_events_batch).
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void cache_lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_cache_lock);
+#endif
+}
+
+static void cache_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_cache_lock);
+#endif
+}
+
 /*
  * Function: planet_get_pvh
  * Get the heliocentric (ICRF) position of a planet at a given time.
@@ -188,15 +212,19 @@ static void planet_get_pvh(const planet_t *planet, const observer_t *obs,
 {
     double dt, parent_pvh[2][3];
     int n;
+    planet_t *cache = (planet_t*)planet;
 
     // Use cached value if possible.
+    cache_lock();
     if (planet->last_full_update) {
         dt = obs->tt - planet->last_full_update;
         if (fabs(dt) < planet->update_delta_s / ERFA_DAYSEC) {
-            eraPvu(dt, planet->last_full_pvh, pvh);
+            eraPvu(dt, cache->last_full_pvh, pvh);
+            cache_unlock();
             return;
         }
     }
+    cache_unlock();
 
     switch (planet->id) {
     case EARTH:
@@ -251,8 +279,10 @@ static void planet_get_pvh(const planet_t *planet, const observer_t *obs,
     }
 
     // Cache the value for next time.
-    eraCpv(pvh, planet->last_full_pvh);
-    ((planet_t*)planet)->last_full_update = obs->tt;
+    cache_lock();
+    eraCpv(pvh, cache->last_full_pvh);
+    cache->last_full_update = obs->tt;
+    cache_unlock();
 }
 
 /*
@@ -269,11 +299,17 @@ static void planet_get_pvo(const planet_t *planet, const observer_t *obs,
 {
     double pvh[2][3];
     double ldt;
+    planet_t *cache = (planet_t*)planet;
 
     // Use cached value if possible.
-    if (adjust_light_speed && obs->hash == planet->pvo_obs_hash) {
-        eraCpv(planet->pvo, pvo);
-        return;
+    if (adjust_light_speed) {
+        cache_lock();
+        if (obs->hash == planet->pvo_obs_hash) {
+            eraCpv(cache->pvo, pvo);
+            cache_unlock();
+            return;
+        }
+        cache_unlock();
     }
 
     planet_get_pvh(planet, obs, pvh);
@@ -292,8 +328,10 @@ static void planet_get_pvo(const planet_t *planet, const observer_t *obs,
     eraPvmpv(pvo, obs->obs_pvb, pvo);
 
     // Copy value into cache to speed up next access.
-    ((planet_t*)planet)->pvo_obs_hash = obs->hash;
-    eraCpv(pvo, planet->pvo);
+    cache_lock();
+    cache->pvo_obs_hash = obs->hash;
+    eraCpv(pvo, cache->pvo);
+    cache_unlock();
 }
 
 // Same as get_pvo, but return homogenous 4d coordinates.
@@ -1229,6 +1267,7 @@ static int planets_init(obj_t *obj, json_value *args)
     ini_parse_string(data, planets_ini_handler, planets);
     assert(planets->sun);
     assert(planets->earth);
+    PLANETS_ITER(planets, p) names_add_obj(&p->obj, 0);
 
     // Add rings textures from assets.
     regcomp(&reg, "^.*/([^/]+)_rings.png$", REG_EXTENDED);
@@ -1266,12 +1305,13 @@ static int planets_update(obj_t *obj, double dt)
 {
     planets_t *planets = (void*)obj;
     planet_t *p;
+    bool changed = false;
 
-    fader_update(&planets->visible, dt);
+    changed |= fader_update(&planets->visible, dt);
     PLANETS_ITER(obj, p) {
-        fader_update(&p->orbit_visible, dt);
+        changed |= fader_update(&p->orbit_visible, dt);
     }
-    return 0;
+    return changed ? 1 : 0;
 }
 
 static obj_t *planets_get(const obj_t *obj, const char *id, int flags)
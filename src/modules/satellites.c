@@ -96,6 +96,7 @@ static int load_jsonl_data(satellites_t *sats, const char *data, int size,
         sat = (void*)module_add_new(&sats->obj, "tle_satellite", NULL, json);
         json_value_free(json);
         if (!sat) goto error;
+        names_add_obj(&sat->obj, 0);
         *last_epoch = max(*last_epoch, sgp4_get_satepoch(sat->elsetrec));
         nb++;
         continue;
@@ -146,7 +147,8 @@ static int satellites_render(const obj_t *obj, const painter_t *painter)
 
     satellites_t *sats = (void*)obj;
     int i, nb;
-    const int update_nb = 32;
+    // Update less objects per frame if the governor asks for it.
+    const int update_nb = 32 - 24 * painter->degrade;
     uint64_t selection_oid = core->selection ? core->selection->oid : 0;
     satellite_t *child;
     obj_t *tmp;
@@ -379,6 +381,8 @@ static int satellite_render(const obj_t *obj, const painter_t *painter_)
         return 0;
 
     sat->on_screen = true;
+    // Satellites move fast, so keep rendering while one is in view.
+    core_mark_dirty();
     core_get_point_for_mag(vmag, &size, &luminance);
 
     // Render symbol if needed.
@@ -470,7 +474,8 @@ OBJ_REGISTER(satellite_klass)
 static obj_klass_t satellites_klass = {
     .id             = "satellites",
     .size           = sizeof(satellites_t),
-    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_LISTABLE,
+    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_LISTABLE |
+                      OBJ_ADAPTIVE,
     .init           = satellites_init,
     .add_data_source = satellites_add_data_source,
     .render_order   = 30,
@@ -486,3 +491,40 @@ static obj_klass_t satellites_klass = {
     }
 };
 OBJ_REGISTER(satellites_klass)
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static sgp4_elsetrec_t *g_bench_elsetrec;
+
+static void bench_sgp4_setup(void)
+{
+    double startmfe, stopmfe, deltamin;
+    // Test satellite from the sgp4 verification data.  sgp4_twoline2rv
+    // expects buffers of 130 chars.
+    char tle1[130] = "1 00005U 58002B   00179.78495062  "
+                     ".00000023  00000-0  28098-4 0  4753";
+    char tle2[130] = "2 00005  34.2682 348.7242 1859667 331.7664  "
+                     "19.3264 10.82419157413667";
+    if (g_bench_elsetrec) return;
+    g_bench_elsetrec = sgp4_twoline2rv(tle1, tle2, 'c', 'm', 'i',
+                                       &startmfe, &stopmfe, &deltamin);
+}
+
+static int bench_sgp4(void)
+{
+    const int N = 10000;
+    double epoch, r[3], v[3];
+    int i;
+    epoch = sgp4_get_satepoch(g_bench_elsetrec);
+    for (i = 0; i < N; i++) {
+        sgp4(g_bench_elsetrec, epoch + i / 1440.0, r, v);
+        bench_keep(r[0]);
+    }
+    return N;
+}
+
+BENCH_REGISTER(bench_sgp4_setup, bench_sgp4)
+
+#endif
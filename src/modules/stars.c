@@ -20,6 +20,11 @@
 
 static const double LABEL_SPACING = 4;
 
+// Order offset of the impostors bins relative to their tile.
+#define IMPOSTOR_ORDER 3
+// Number of magnitude steps of the impostors light.
+#define IMPOSTOR_MAG_STEPS 8
+
 typedef struct stars stars_t;
 typedef struct {
     uint64_t oid;
@@ -78,17 +83,41 @@ struct stars {
 // Static instance.
 static stars_t *g_stars = NULL;
 
+/*
+ * Type: impostor_t
+ * Aggregated light of the stars of a tile that fall into the same healpix
+ * pixel at order + IMPOSTOR_ORDER.
+ *
+ * The illuminance is cumulative per magnitude step: illuminance[i] is the
+ * light of the stars brighter than mag_min + i * impostors_mag_step, so
+ * that we never add the light of the stars fainter than the limit.
+ */
+typedef struct {
+    double  pos[3];      // Illuminance weighted astrometric direction.
+    float   illuminance[IMPOSTOR_MAG_STEPS]; // (lux)
+    float   bv;          // Illuminance weighted B-V.
+} impostor_t;
+
 /*
  * Type: tile_t
  * Custom tile structure for the stars hips survey.
+ *
+ * When the stars of a tile are too small to be seen individually, we
+ * render the impostors instead, and we don't go into the children tiles.
  */
 typedef struct tile {
     int         flags;
     double      mag_min;
     double      mag_max;
     double      illuminance; // Totall illuminance (lux).
+    // Illuminance per magnitude of the faintest stars (lux/mag), used to
+    // estimate the light of the children tiles.
+    double      illuminance_faint;
     int         nb;
     star_data_t *sources;
+    int         impostors_nb;
+    double      impostors_mag_step;
+    impostor_t  *impostors;
 } tile_t;
 
 static uint64_t pix_to_nuniq(int order, int pix)
@@ -429,6 +458,7 @@ static int del_tile(void *data)
         free(tile->sources[i].sp_type);
     }
     free(tile->sources);
+    free(tile->impostors);
     free(tile);
     return 0;
 }
@@ -455,6 +485,93 @@ static uint64_t compute_oid(const star_data_t *s)
     return oid_create("HIP", 0);
 }
 
+// Add the designations of a star to the global names index.
+static void add_to_names_index(const star_data_t *s, uint64_t hint)
+{
+    char buf[32];
+    const char *names;
+
+    if (!s->names) {
+        if (!s->hip) return;
+        snprintf(buf, sizeof(buf), "HIP %d", s->hip);
+        names_add(buf, s->oid, hint);
+        return;
+    }
+    for (names = s->names; *names; names += strlen(names) + 1)
+        names_add(names, s->oid, hint);
+}
+
+// Return the impostor bin of a position, as an index into the tile.
+// The sources can be slightly outside of the tile, in that case we use the
+// closest bin of the tile.
+static int impostor_get_bin(int order, int pix, const double pos[3])
+{
+    const int nb_bins = 1 << (2 * IMPOSTOR_ORDER);
+    const int nside = 1 << (order + IMPOSTOR_ORDER);
+    int i, bin, ret = 0;
+    double center[3], d, best = -DBL_MAX;
+
+    healpix_ang2pix(nside, acos(clamp(pos[2], -1.0, 1.0)),
+                    atan2(pos[1], pos[0]), &bin);
+    if (bin / nb_bins == pix) return bin % nb_bins;
+    for (i = 0; i < nb_bins; i++) {
+        healpix_pix2vec(nside, pix * nb_bins + i, center);
+        d = vec3_dot(pos, center);
+        if (d > best) {
+            best = d;
+            ret = i;
+        }
+    }
+    return ret;
+}
+
+// Compute the impostors of a tile, from its sources sorted by vmag.
+static void build_impostors(tile_t *tile, int order, int pix)
+{
+    const int nb_bins = 1 << (2 * IMPOSTOR_ORDER);
+    impostor_t *bins, *imp;
+    const star_data_t *s;
+    double faint = 0, step, total;
+    int i, j;
+
+    if (!tile->nb) return;
+    step = max(0.1, (tile->mag_max - tile->mag_min) /
+                    (IMPOSTOR_MAG_STEPS - 1));
+    tile->impostors_mag_step = step;
+    bins = calloc(nb_bins, sizeof(*bins));
+    for (i = 0; i < tile->nb; i++) {
+        s = &tile->sources[i];
+        imp = &bins[impostor_get_bin(order, pix, s->pos)];
+        // First step that includes the star.
+        j = ceil((s->vmag - tile->mag_min) / step - 1e-6);
+        j = clamp(j, 0, IMPOSTOR_MAG_STEPS - 1);
+        vec3_addk(imp->pos, s->pos, s->illuminance, imp->pos);
+        imp->illuminance[j] += s->illuminance;
+        imp->bv += s->bv * s->illuminance;
+        if (s->vmag >= tile->mag_max - 1) faint += s->illuminance;
+    }
+    tile->illuminance_faint =
+        faint / max(0.1, min(1.0, tile->mag_max - tile->mag_min));
+
+    tile->impostors = calloc(nb_bins, sizeof(*tile->impostors));
+    for (i = 0; i < nb_bins; i++) {
+        total = 0;
+        for (j = 0; j < IMPOSTOR_MAG_STEPS; j++) {
+            total += bins[i].illuminance[j];
+            bins[i].illuminance[j] = total;
+        }
+        if (total <= 0) continue;
+        imp = &tile->impostors[tile->impostors_nb++];
+        vec3_normalize(bins[i].pos, imp->pos);
+        memcpy(imp->illuminance, bins[i].illuminance,
+               sizeof(imp->illuminance));
+        imp->bv = bins[i].bv / total;
+    }
+    tile->impostors = realloc(tile->impostors,
+            tile->impostors_nb * sizeof(*tile->impostors));
+    free(bins);
+}
+
 static int on_file_tile_loaded(const char type[4],
                                const void *data, int size,
                                const json_value *json,
@@ -561,6 +678,10 @@ static int on_file_tile_loaded(const char type[4],
     // Sort the data by vmag, so that we can early exit during render.
     qsort(tile->sources, tile->nb, sizeof(*tile->sources), star_data_cmp);
     free(table_data);
+    build_impostors(tile, order, pix);
+
+    for (i = 0; i < tile->nb; i++)
+        add_to_names_index(&tile->sources[i], pix_to_nuniq(order, pix));
 
     // If we have a json header, check for a children mask value.
     if (json) {
@@ -582,7 +703,8 @@ static const void *stars_create_tile(
     survey_t *survey = user;
     eph_load(data, size, USER_PASS(survey, &tile, transparency),
              on_file_tile_loaded);
-    if (tile) *cost = tile->nb * sizeof(*tile->sources);
+    if (tile) *cost = tile->nb * sizeof(*tile->sources) +
+                      tile->impostors_nb * sizeof(*tile->impostors);
     return tile;
 }
 
@@ -636,6 +758,77 @@ static tile_t *get_tile(stars_t *stars, survey_t *survey, int order, int pix,
     return tile;
 }
 
+/*
+ * Check whether we can render the impostors of a tile instead of its
+ * stars: that is if even the brightest star is rendered with the minimum
+ * point size, and the impostors bins are not bigger than a point.
+ */
+static bool tile_use_impostors(const painter_t *painter, const tile_t *tile,
+                               int order)
+{
+    double r, r_min, bin_size;
+    int i;
+
+    if (!tile->impostors_nb) return false;
+    // Keep rendering the selected star.
+    if (core->selection) {
+        for (i = 0; i < tile->nb; i++) {
+            if (tile->sources[i].oid == core->selection->oid) return false;
+        }
+    }
+    r_min = core->min_point_radius;
+    if (r_min * core->win_pixels_scale < 1.0) r_min = 1.0;
+    bin_size = sqrt(M_PI / 3) / (1 << (order + IMPOSTOR_ORDER));
+    if (core_get_point_for_apparent_angle(painter->proj, bin_size / 2) > r_min)
+        return false;
+    core_get_point_for_mag(tile->mag_min, &r, NULL);
+    return r <= r_min;
+}
+
+static void render_impostors(const painter_t *painter,
+                             const survey_t *survey, const tile_t *tile,
+                             double limit_mag, double *illuminance)
+{
+    int i, step, n = 0;
+    const impostor_t *imp;
+    double max_mag, scale, illum, mag, p_win[4], size, luminance, color[3];
+    const double illum_0 = core_mag_to_illuminance(0);
+    point_t *points;
+
+    // Add the light of the children tiles we don't visit, assuming a
+    // constant illuminance per magnitude down to the limit.
+    max_mag = limit_mag;
+    if (!isnan(survey->max_vmag)) max_mag = min(max_mag, survey->max_vmag);
+    scale = 1.0 + tile->illuminance_faint *
+                  max(0.0, max_mag - tile->mag_max) / tile->illuminance;
+    // Only add the light of the stars brighter than the limit.
+    step = floor((limit_mag - tile->mag_min) / tile->impostors_mag_step);
+    step = clamp(step, 0, IMPOSTOR_MAG_STEPS - 1);
+
+    points = malloc(tile->impostors_nb * sizeof(*points));
+    for (i = 0; i < tile->impostors_nb; i++) {
+        imp = &tile->impostors[i];
+        illum = imp->illuminance[step] * scale;
+        if (illum <= 0) continue;
+        if (!painter_project(painter, FRAME_ASTROM, imp->pos, true, true,
+                             p_win))
+            continue;
+        (*illuminance) += illum;
+        mag = -2.5 * log10(illum / illum_0);
+        if (!core_get_point_for_mag(mag, &size, &luminance))
+            continue;
+        bv_to_rgb(imp->bv, color);
+        points[n++] = (point_t) {
+            .pos = {p_win[0], p_win[1]},
+            .size = size,
+            .color = {color[0] * 255, color[1] * 255, color[2] * 255,
+                      luminance * 255},
+        };
+    }
+    paint_2d_points(painter, n, points);
+    free(points);
+}
+
 static int render_visitor(int order, int pix, void *user)
 {
     PROFILE(stars_render_visitor, PROFILE_AGGREGATE);
@@ -665,6 +858,11 @@ static int render_visitor(int order, int pix, void *user)
     if (!tile) goto end;
     if (tile->mag_min > limit_mag) goto end;
 
+    if (tile_use_impostors(&painter, tile, order)) {
+        render_impostors(&painter, survey, tile, limit_mag, illuminance);
+        return 0;
+    }
+
     point_t *points = malloc(tile->nb * sizeof(*points));
     for (i = 0; i < tile->nb; i++) {
         s = &tile->sources[i];
@@ -706,21 +904,29 @@ static int stars_render(const obj_t *obj, const painter_t *painter_)
 {
     PROFILE(stars_render, 0);
     stars_t *stars = (stars_t*)obj;
-    int nb_tot = 0, nb_loaded = 0;
+    int nb_tot = 0, nb_loaded = 0, order, pix;
     double illuminance = 0; // Totall illuminance
     painter_t painter = *painter_;
     survey_t *survey;
+    hips_iterator_t iter;
 
     if (!stars->visible) return 0;
+    // Render less faint stars if the governor asks for it.
+    painter.stars_limit_mag -= painter.degrade * 3;
 
     DL_FOREACH(stars->surveys, survey) {
         // Don't even traverse if the min vmag of the survey is higher than
         // the max visible vmag.
         if (survey->min_vmag > painter.stars_limit_mag)
             continue;
-        hips_traverse(USER_PASS(stars, survey, &painter,
-                      &nb_tot, &nb_loaded, &illuminance),
-                      render_visitor);
+        // Depth first, so that the memory only depends on the max order.
+        hips_iter_init_depth_first(&iter);
+        while (hips_iter_next(&iter, &order, &pix)) {
+            if (render_visitor(order, pix, USER_PASS(stars, survey, &painter,
+                               &nb_tot, &nb_loaded, &illuminance)) == 1)
+                hips_iter_push_children(&iter, order, pix);
+        }
+        hips_iter_release(&iter);
     }
 
     /* Get the global stars luminance */
@@ -789,13 +995,27 @@ static int stars_get_visitor(int order, int pix, void *user)
     return 1;
 }
 
+static obj_t *stars_get_by_oid(const obj_t *obj, uint64_t oid,
+                               uint64_t hint);
+
 static obj_t *stars_get(const obj_t *obj, const char *id, int flags)
 {
     int r, cat;
-    uint64_t n = 0;
+    uint64_t n = 0, oid, hint;
     regmatch_t matches[3];
+    obj_t *ret;
 
     stars_t *stars = (stars_t*)obj;
+
+    // Try first the names index, so that we only need to look in a single
+    // tile.
+    if (names_lookup(id, &oid, &hint) && hint &&
+            (oid_is_gaia(oid) || oid_is_catalog(oid, "HIP") ||
+             oid_is_catalog(oid, "TYC"))) {
+        ret = stars_get_by_oid(obj, oid, hint);
+        if (ret) return ret;
+    }
+
     r = regexec(&stars->search_reg, id, 3, matches, 0);
     if (r) return NULL;
     n = strtoull(id + matches[2].rm_so, NULL, 10);
@@ -889,6 +1109,7 @@ static int stars_list(const obj_t *obj, observer_t *obs,
             if (i < tile->nb) break;
             hips_iter_push_children(&iter, order, pix);
         }
+        hips_iter_release(&iter);
         return 0;
     }
 
@@ -909,6 +1130,17 @@ static int stars_list(const obj_t *obj, observer_t *obs,
     return 0;
 }
 
+static int stars_list_sources(const obj_t *obj, void *user,
+                              int (*f)(void *user, const char *key))
+{
+    const stars_t *stars = (const stars_t*)obj;
+    survey_t *survey;
+    DL_FOREACH(stars->surveys, survey) {
+        if (f(user, survey->key)) break;
+    }
+    return 0;
+}
+
 static int hips_property_handler(void* user, const char* section,
                                  const char* name, const char* value)
 {
@@ -1066,12 +1298,13 @@ OBJ_REGISTER(star_klass)
 static obj_klass_t stars_klass = {
     .id             = "stars",
     .size           = sizeof(stars_t),
-    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE,
+    .flags          = OBJ_IN_JSON_TREE | OBJ_MODULE | OBJ_ADAPTIVE,
     .init           = stars_init,
     .render         = stars_render,
     .get            = stars_get,
     .get_by_oid     = stars_get_by_oid,
     .list           = stars_list,
+    .list_sources   = stars_list_sources,
     .add_data_source = stars_add_data_source,
     .render_order   = 20,
     .attributes = (attribute_t[]) {
@@ -1111,4 +1344,92 @@ static void test_create_from_json(void)
 }
 TEST_REGISTER(NULL, test_create_from_json, TEST_AUTO);
 
+static void test_impostors(void)
+{
+    const int order = 8, pix = 12345, nb = 1000;
+    const int nb_bins = 1 << (2 * IMPOSTOR_ORDER);
+    const int nside = 1 << (order + IMPOSTOR_ORDER);
+    tile_t tile = {.mag_min = DBL_MAX, .mag_max = -DBL_MAX};
+    double illuminance = 0, bv = 0, bv_mean, center[3], total = 0, v[3];
+    double limit, expected;
+    projection_t proj;
+    painter_t painter = {.proj = &proj};
+    star_data_t *s;
+    int i, j, neighbours[8];
+
+    // Random stars around the center of a tile.
+    healpix_pix2vec(1 << order, pix, center);
+    tile.sources = calloc(nb, sizeof(*tile.sources));
+    for (i = 0; i < nb; i++) {
+        s = &tile.sources[tile.nb++];
+        vec3_set(v, (i % 37) / 37.0 - 0.5, (i % 41) / 41.0 - 0.5, 0);
+        vec3_addk(center, v, 0.005, s->pos);
+        vec3_normalize(s->pos, s->pos);
+        s->vmag = 12 + (i % 5);
+        s->bv = (i % 3) * 0.5;
+        s->illuminance = core_mag_to_illuminance(s->vmag);
+        illuminance += s->illuminance;
+        bv += s->bv * s->illuminance;
+        tile.mag_min = min(tile.mag_min, s->vmag);
+        tile.mag_max = max(tile.mag_max, s->vmag);
+    }
+    tile.illuminance = illuminance;
+    qsort(tile.sources, tile.nb, sizeof(*tile.sources), star_data_cmp);
+    build_impostors(&tile, order, pix);
+
+    // The impostors keep the total light and the mean color.
+    bv_mean = bv / illuminance;
+    assert(tile.impostors_nb > 0);
+    assert(tile.impostors_nb <= nb_bins);
+    bv = 0;
+    for (i = 0; i < tile.impostors_nb; i++) {
+        assert(vec3_is_normalized(tile.impostors[i].pos));
+        illuminance = tile.impostors[i].illuminance[IMPOSTOR_MAG_STEPS - 1];
+        total += illuminance;
+        bv += tile.impostors[i].bv * illuminance;
+    }
+    illuminance = tile.illuminance;
+    assert(fabs(total / illuminance - 1) < 1e-5);
+    assert(fabs(bv / total - bv_mean) < 1e-5);
+    assert(tile.illuminance_faint > 0 && tile.illuminance_faint < illuminance);
+
+    // Each magnitude step only contains the light of the brighter stars.
+    for (j = 0; j < IMPOSTOR_MAG_STEPS; j++) {
+        limit = tile.mag_min + j * tile.impostors_mag_step;
+        expected = 0;
+        for (i = 0; i < tile.nb; i++) {
+            if (tile.sources[i].vmag <= limit + 1e-6)
+                expected += tile.sources[i].illuminance;
+        }
+        total = 0;
+        for (i = 0; i < tile.impostors_nb; i++)
+            total += tile.impostors[i].illuminance[j];
+        assert(fabs(total - expected) <= 1e-5 * illuminance);
+    }
+
+    // Positions just outside the tile go into the bin sharing the edge
+    // (the SW, NW, NE and SE neighbours).
+    for (i = 0; i < nb_bins; i++) {
+        healpix_get_neighbours(nside, pix * nb_bins + i, neighbours);
+        for (j = 0; j < 8; j += 2) {
+            if (neighbours[j] == -1 || neighbours[j] / nb_bins == pix)
+                continue;
+            healpix_pix2vec(nside, neighbours[j], v);
+            assert(impostor_get_bin(order, pix, v) == i);
+        }
+        healpix_pix2vec(nside, pix * nb_bins + i, v);
+        assert(impostor_get_bin(order, pix, v) == i);
+    }
+
+    // Only used when the bins get smaller than a point.
+    projection_init(&proj, PROJ_STEREOGRAPHIC, 120 * DD2R, 800, 600);
+    assert(tile_use_impostors(&painter, &tile, order));
+    projection_init(&proj, PROJ_STEREOGRAPHIC, 1 * DD2R, 800, 600);
+    assert(!tile_use_impostors(&painter, &tile, order));
+
+    free(tile.sources);
+    free(tile.impostors);
+}
+TEST_REGISTER(NULL, test_impostors, TEST_AUTO);
+
 #endif
@@ -12,8 +12,17 @@
 #include "erfa.h" // Used for eraDtf2d.
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <zlib.h> // For crc32.
+
+#ifndef __EMSCRIPTEN__
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
 
 // Faster than atof.
 static inline int parse_float(const char *str, double *ret)
@@ -345,6 +354,145 @@ int mpc_parse_comet_line(const char *line, int len,
     return 0;
 }
 
+/*
+ * Binary cache of pre-parsed records.
+ *
+ * The file is just a fixed size header followed by the raw records, so that
+ * we can memory map it and use the records directly.  The record size is
+ * stored in the header, so any change to the records structures invalidates
+ * the old caches.
+ */
+
+#define CACHE_MAGIC     0x4d504343 // 'MPCC'
+#define CACHE_VERSION   1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rec_size;
+    uint32_t nb;
+    uint64_t key;
+    uint64_t pad_;
+} cache_header_t;
+
+_Static_assert(sizeof(cache_header_t) == 32, "");
+
+// FNV-1a hash.
+static uint64_t hash_str(uint64_t h, const char *str)
+{
+    while (*str) {
+        h ^= (uint8_t)*str++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t mpc_cache_key(const char *url, const char *etag,
+                       const char *data, int size)
+{
+    char buf[32];
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = hash_str(h, url);
+    if (etag) {
+        h = hash_str(h, etag);
+    } else {
+        snprintf(buf, sizeof(buf), "%d:%08lx", size,
+                 crc32(0L, (const Bytef*)data, size));
+        h = hash_str(h, buf);
+    }
+    return h;
+}
+
+#ifndef __EMSCRIPTEN__
+
+const void *mpc_cache_load(const char *path, uint64_t key, int rec_size,
+                           int *nb)
+{
+    int fd;
+    struct stat st;
+    const cache_header_t *header;
+    void *data;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    if (fstat(fd, &st) || st.st_size < sizeof(*header)) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    header = data;
+    if (    header->magic != CACHE_MAGIC ||
+            header->version != CACHE_VERSION ||
+            header->rec_size != rec_size ||
+            header->key != key ||
+            sizeof(*header) + (size_t)header->nb * rec_size != st.st_size) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    *nb = header->nb;
+    return header + 1;
+}
+
+void mpc_cache_release(const void *recs)
+{
+    const cache_header_t *header;
+    if (!recs) return;
+    header = (const cache_header_t*)recs - 1;
+    munmap((void*)header,
+           sizeof(*header) + (size_t)header->nb * header->rec_size);
+}
+
+int mpc_cache_save(const char *path, uint64_t key, const void *recs,
+                   int rec_size, int nb)
+{
+    FILE *file;
+    char tmp_path[1024];
+    bool ok;
+    cache_header_t header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .rec_size = rec_size,
+        .nb = nb,
+        .key = key,
+    };
+
+    // Write into a temporary file first so that a concurrent process never
+    // sees a partially written cache.
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    file = fopen(tmp_path, "wb");
+    if (!file) return -1;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         (nb == 0 || fwrite(recs, rec_size, nb, file) == nb);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+#else // No file system with emscripten.
+
+const void *mpc_cache_load(const char *path, uint64_t key, int rec_size,
+                           int *nb)
+{
+    return NULL;
+}
+
+void mpc_cache_release(const void *recs)
+{
+}
+
+int mpc_cache_save(const char *path, uint64_t key, const void *recs,
+                   int rec_size, int nb)
+{
+    return -1;
+}
+
+#endif
+
 /******* TESTS **********************************************************/
 
 #if COMPILE_TESTS
@@ -393,6 +541,143 @@ static void test_parse_comet(void)
     assert(strcmp(desig, "C/1995 O1 (Hale-Bopp)") == 0);
 }
 
+static void test_cache(void)
+{
+#ifndef __EMSCRIPTEN__
+    char path[1024];
+    mpc_comet_t recs[2] = {
+        {.number = 1, .orbit_type = 'P', .e = 0.967, .desig = "1P/Halley"},
+        {.number = 0, .orbit_type = 'C', .e = 0.995, .desig = "C/1995 O1"},
+    };
+    const mpc_comet_t *ret;
+    uint64_t key;
+    int r, nb;
+
+    snprintf(path, sizeof(path), "%s/swe-test-mpc.cache",
+             sys_get_user_dir());
+    sys_make_dir(path);
+    key = mpc_cache_key("http://test/CometEls.txt", "abc", NULL, 0);
+    assert(key != mpc_cache_key("http://test/CometEls.txt", "abd", NULL, 0));
+    r = mpc_cache_save(path, key, recs, sizeof(recs[0]), 2);
+    assert(r == 0);
+    ret = mpc_cache_load(path, key, sizeof(recs[0]), &nb);
+    assert(ret && nb == 2);
+    assert(memcmp(ret, recs, sizeof(recs)) == 0);
+    mpc_cache_release(ret);
+    // Wrong key or record size.
+    assert(!mpc_cache_load(path, key + 1, sizeof(recs[0]), &nb));
+    assert(!mpc_cache_load(path, key, sizeof(mpc_asteroid_t), &nb));
+    remove(path);
+#endif
+}
+
+/*
+ * Compare the batch orbit solver to the scalar version over the whole MPC
+ * catalog, if the data files are available.
+ */
+static void test_orbits_batch(void)
+{
+    const double mjd = 59000, k = 0.01720209895;
+    char *data, name[24], desig[64];
+    const char *line = NULL;
+    int size, len, nb = 0, capacity = 0, j, num, flags;
+    double h, g, epoch, m, peri, node, incl, e, n, a, q, peri_time;
+    double ref[3], (*pos)[3], (*speed)[3], r, v2, x, w, b, u, err, max_err;
+    char type;
+    orbit_elements_t *elems = NULL;
+
+    // Asteroids: compare to orbit_compute_pv with a very small precision.
+    data = read_file("data/skydata/mpcorb.dat", &size);
+    if (!data) return;
+    while (iter_lines(data, size, &line, &len)) {
+        if (mpc_parse_line(line, len, &num, name, desig, &h, &g, &epoch,
+                           &m, &peri, &node, &incl, &e, &n, &a, &flags))
+            continue;
+        if (nb >= capacity) {
+            capacity = max(1024, capacity * 2);
+            elems = realloc(elems, capacity * sizeof(*elems));
+        }
+        elems[nb++] = (orbit_elements_t) {
+            .d = epoch, .i = incl * DD2R, .o = node * DD2R, .w = peri * DD2R,
+            .q = a * (1 - e), .e = e, .n = n * DD2R, .ma = m * DD2R};
+    }
+    free(data);
+    pos = calloc(nb, sizeof(*pos));
+    orbit_compute_pv_batch(nb, elems, mjd, pos, NULL);
+    max_err = 0;
+    for (j = 0; j < nb; j++) {
+        a = elems[j].q / (1 - elems[j].e);
+        orbit_compute_pv(1e-12, mjd, ref, NULL, elems[j].d, elems[j].i,
+                         elems[j].o, elems[j].w, a, elems[j].n, elems[j].e,
+                         elems[j].ma, 0, 0);
+        err = vec3_dist(ref, pos[j]) / vec3_norm(ref);
+        max_err = max(max_err, err);
+    }
+    assert(max_err < 1e-9);
+    free(pos);
+
+    // Comets: compare elliptic orbits to orbit_compute_pv, parabolic orbits
+    // to the Barker equation, and check the vis-viva equation for all.
+    data = read_file("data/skydata/CometEls.txt", &size);
+    if (!data) goto end;
+    nb = 0;
+    line = NULL;
+    while (iter_lines(data, size, &line, &len)) {
+        if (mpc_parse_comet_line(line, len, &num, &type, &peri_time, &q, &e,
+                                 &peri, &node, &incl, &epoch, &h, &g, desig))
+            continue;
+        if (nb >= capacity) {
+            capacity = max(1024, capacity * 2);
+            elems = realloc(elems, capacity * sizeof(*elems));
+        }
+        elems[nb++] = (orbit_elements_t) {
+            .d = peri_time, .i = incl * DD2R, .o = node * DD2R,
+            .w = peri * DD2R, .q = q, .e = e};
+    }
+    free(data);
+    pos = calloc(nb, sizeof(*pos));
+    speed = calloc(nb, sizeof(*speed));
+    orbit_compute_pv_batch(nb, elems, mjd, pos, speed);
+    for (j = 0; j < nb; j++) {
+        q = elems[j].q;
+        e = elems[j].e;
+        r = vec3_norm(pos[j]);
+        v2 = vec3_norm2(speed[j]);
+        assert(r >= q * (1 - 1e-12));
+        if (e != 1) {
+            a = q / (1 - e);
+            assert(fabs(v2 / (k * k * (2 / r - 1 / a)) - 1) < 1e-8);
+        } else {
+            assert(fabs(v2 / (k * k * 2 / r) - 1) < 1e-8);
+        }
+        if (e < 0.98) {
+            orbit_compute_pv(1e-12, mjd, ref, NULL, elems[j].d, elems[j].i,
+                    elems[j].o, elems[j].w, a, k / sqrt(a * a * a), e, 0,
+                    0, 0);
+        } else if (e == 1) {
+            x = 1.5 * (mjd - elems[j].d) * k / sqrt(2 * q * q * q);
+            b = sqrt(1 + x * x);
+            w = cbrt(b + x) - cbrt(b - x);
+            r = q * (1 + w * w);
+            u = 2 * atan(w) + elems[j].w;
+            ref[0] = r * (cos(elems[j].o) * cos(u) -
+                          sin(elems[j].o) * sin(u) * cos(elems[j].i));
+            ref[1] = r * (sin(elems[j].o) * cos(u) +
+                          cos(elems[j].o) * sin(u) * cos(elems[j].i));
+            ref[2] = r * (sin(u) * sin(elems[j].i));
+        } else {
+            continue;
+        }
+        assert(vec3_dist(ref, pos[j]) / r < 1e-8);
+    }
+    free(pos);
+    free(speed);
+end:
+    free(elems);
+}
+
 TEST_REGISTER(NULL, test_parse_float, TEST_AUTO);
 TEST_REGISTER(NULL, test_parse_comet, TEST_AUTO);
+TEST_REGISTER(NULL, test_cache, TEST_AUTO);
+TEST_REGISTER(NULL, test_orbits_batch, TEST_AUTO);
 #endif
@@ -12,6 +12,7 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /*
  * Enum: MPC_ORBIT_TYPE
@@ -109,3 +110,99 @@ int mpc_parse_comet_line(const char *line, int len,
                          double *h,
                          double *g,
                          char   desig[static 64]);
+
+/*
+ * Type: mpc_asteroid_t
+ * Pre-parsed minor planet orbit record, as stored in the binary cache.
+ *
+ * All the values are the same as returned by <mpc_parse_line>.
+ */
+typedef struct {
+    int     number;
+    int     flags;
+    char    name[24];
+    char    desig[24];
+    double  h;
+    double  g;
+    double  epoch;
+    double  m;
+    double  peri;
+    double  node;
+    double  i;
+    double  e;
+    double  n;
+    double  a;
+} mpc_asteroid_t;
+
+/*
+ * Type: mpc_comet_t
+ * Pre-parsed comet orbit record, as stored in the binary cache.
+ *
+ * All the values are the same as returned by <mpc_parse_comet_line>, plus
+ * the index of the line in the source file.
+ */
+typedef struct {
+    int     number;
+    int     line_idx;
+    char    orbit_type;
+    char    desig[64];
+    double  peri_time;
+    double  peri_dist;
+    double  e;
+    double  peri;
+    double  node;
+    double  i;
+    double  epoch;
+    double  h;
+    double  g;
+} mpc_comet_t;
+
+/*
+ * Function: mpc_cache_key
+ * Compute the key that identifies a version of an MPC source file.
+ *
+ * If the server gave us an ETag we use it with the url, otherwise we fall
+ * back to the crc32 of the data.
+ *
+ * Parameters:
+ *   url    - Url of the source file.
+ *   etag   - ETag of the source file, or NULL.
+ *   data   - Source data, only used if etag is NULL.
+ *   size   - Size of the source data.
+ */
+uint64_t mpc_cache_key(const char *url, const char *etag,
+                       const char *data, int size);
+
+/*
+ * Function: mpc_cache_load
+ * Memory map a binary cache of pre-parsed records.
+ *
+ * Parameters:
+ *   path       - Path of the cache file.
+ *   key        - Key of the source, as returned by <mpc_cache_key>.
+ *   rec_size   - Size of a single record.
+ *   nb         - Get the number of records.
+ *
+ * Return:
+ *   A pointer to the records, that should be released with
+ *   <mpc_cache_release>, or NULL if the cache doesn't exist or doesn't
+ *   match the key.
+ */
+const void *mpc_cache_load(const char *path, uint64_t key, int rec_size,
+                           int *nb);
+
+/*
+ * Function: mpc_cache_release
+ * Release a cache returned by <mpc_cache_load>.
+ */
+void mpc_cache_release(const void *recs);
+
+/*
+ * Function: mpc_cache_save
+ * Write a binary cache of pre-parsed records.
+ *
+ * Return:
+ *   0 in case of success, an error code otherwise.
+ */
+int mpc_cache_save(const char *path, uint64_t key, const void *recs,
+                   int rec_size, int nb);
@@ -0,0 +1,767 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "names.h"
+#include "swe.h"
+
+#include "designation.h"
+
+#include <ctype.h>
+
+#ifdef HAVE_PTHREAD
+#   include <pthread.h>
+#endif
+
+#ifndef __EMSCRIPTEN__
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+// Minimum time in seconds between two merges of the pending names.
+#define MERGE_DELAY 1.0
+// Minimum time in seconds between two saves of the cache file, unless we
+// added more than SAVE_THRESHOLD names since the last save.
+#define SAVE_DELAY 60.0
+#define SAVE_THRESHOLD 10000
+
+/*
+ * The index file is a fixed size header, followed by the sorted entries,
+ * followed by the strings pool.  The entries only store offsets into the
+ * pool, so that we can memory map the file and use it directly.
+ */
+
+#define NAMES_MAGIC     0x4e414d45 // 'NAME'
+#define NAMES_VERSION   1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nb;
+    uint32_t strings_size;
+    uint64_t pad_[2];
+} names_header_t;
+
+_Static_assert(sizeof(names_header_t) == 32, "");
+
+typedef struct {
+    uint32_t key;   // Offset of the normalized key in the strings pool.
+    uint32_t name;  // Offset of the display name in the strings pool.
+    uint64_t oid;
+    uint64_t hint;
+} entry_t;
+
+_Static_assert(sizeof(entry_t) == 24, "");
+
+// A name not merged into the index yet.
+typedef struct {
+    char     *key;
+    char     *name;
+    uint64_t oid;
+    uint64_t hint;
+} pending_t;
+
+typedef struct {
+    pending_t   *values;
+    int         nb;
+    int         allocated;
+} pending_list_t;
+
+/*
+ * The index is either memory mapped from the cache file (read only), or
+ * allocated and grown in place by the merges.
+ */
+typedef struct {
+    entry_t         *entries;
+    int             nb;
+    int             allocated;
+    char            *strings;
+    uint32_t        strings_size;
+    uint32_t        strings_allocated;
+    void            *map;       // Set if the data is memory mapped.
+    size_t          map_size;
+} index_t;
+
+typedef struct {
+    worker_t        worker;
+    pending_list_t  *pending;
+} merge_worker_t;
+
+static struct {
+    char            *cache_path;
+    // Protected by the lock, since the merge worker modifies it in place.
+    index_t         *index;
+    pending_list_t  pending;
+    // List being merged by the worker, still visible to the searches.
+    pending_list_t  *merging;
+    merge_worker_t  worker;
+    double          last_merge;
+    double          last_save;
+    int             dirty;      // Number of names added since last save.
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+} g_names = {
+#ifdef HAVE_PTHREAD
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
+static void lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_names.lock);
+#endif
+}
+
+static void unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_names.lock);
+#endif
+}
+
+/*
+ * Compute the search key of a designation: the cleaned up designation in
+ * upper case, without accents and without any non alphanumeric ascii
+ * characters.
+ */
+static void make_key(const char *dsgn, char *out, int size)
+{
+    char buf[256];
+    char *src, *dst;
+
+    designation_cleanup(dsgn, out, size,
+                        BAYER_LATIN_LONG | BAYER_CONST_SHORT);
+    u8_remove_accents(buf, out, sizeof(buf));
+    u8_upper(out, buf, size);
+    for (src = dst = out; *src; src++) {
+        if ((*src & 0x80) || isalnum(*src)) *dst++ = *src;
+    }
+    *dst = '\0';
+}
+
+static void index_delete(index_t *index)
+{
+    if (!index) return;
+#ifndef __EMSCRIPTEN__
+    if (index->map) {
+        munmap(index->map, index->map_size);
+        free(index);
+        return;
+    }
+#endif
+    free((void*)index->entries);
+    free((void*)index->strings);
+    free(index);
+}
+
+static void pending_list_clear(pending_list_t *list)
+{
+    int i;
+    for (i = 0; i < list->nb; i++) {
+        free(list->values[i].key);
+        free(list->values[i].name);
+    }
+    free(list->values);
+    memset(list, 0, sizeof(*list));
+}
+
+#ifndef __EMSCRIPTEN__
+
+static index_t *index_load(const char *path)
+{
+    int fd;
+    struct stat st;
+    const names_header_t *header;
+    void *data;
+    index_t *index;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    if (fstat(fd, &st) || st.st_size < sizeof(*header)) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    header = data;
+    if (    header->magic != NAMES_MAGIC ||
+            header->version != NAMES_VERSION ||
+            sizeof(*header) + (size_t)header->nb * sizeof(entry_t) +
+            header->strings_size != st.st_size ||
+            (header->strings_size &&
+             ((char*)data)[st.st_size - 1] != '\0')) {
+        LOG_W("Invalid names index cache: %s", path);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    index = calloc(1, sizeof(*index));
+    index->map = data;
+    index->map_size = st.st_size;
+    index->nb = header->nb;
+    index->entries = (entry_t*)(header + 1);
+    index->strings = (char*)(index->entries + index->nb);
+    index->strings_size = header->strings_size;
+    return index;
+}
+
+static int index_save(const index_t *index, const char *path)
+{
+    FILE *file;
+    char tmp_path[1024];
+    bool ok;
+    names_header_t header = {
+        .magic = NAMES_MAGIC,
+        .version = NAMES_VERSION,
+        .nb = index->nb,
+        .strings_size = index->strings_size,
+    };
+
+    if (sys_make_dir(path) != 0) return -1;
+    // Write into a temporary file first so that a concurrent process never
+    // sees a partially written index.
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    file = fopen(tmp_path, "wb");
+    if (!file) return -1;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         (index->nb == 0 ||
+          fwrite(index->entries, sizeof(entry_t), index->nb, file) ==
+                index->nb) &&
+         (index->strings_size == 0 ||
+          fwrite(index->strings, index->strings_size, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+#else // No file system with emscripten.
+
+static index_t *index_load(const char *path)
+{
+    return NULL;
+}
+
+static int index_save(const index_t *index, const char *path)
+{
+    return -1;
+}
+
+#endif
+
+static int pending_cmp(const void *a_, const void *b_)
+{
+    const pending_t *a = a_, *b = b_;
+    int r = strcmp(a->key, b->key);
+    if (r) return r;
+    return cmp(a->oid, b->oid);
+}
+
+// Add a string into a strings pool, return its offset.
+static uint32_t pool_add(char **pool, uint32_t *size, uint32_t *allocated,
+                         const char *str)
+{
+    uint32_t ofs = *size, len = strlen(str) + 1;
+    if (*size + len > *allocated) {
+        *allocated = max(*allocated * 2, *size + len + 4096);
+        *pool = realloc(*pool, *allocated);
+    }
+    memcpy(*pool + ofs, str, len);
+    *size += len;
+    return ofs;
+}
+
+// Return the index of the first entry with a key not less than a prefix.
+static int index_lower_bound(const index_t *index, const char *prefix)
+{
+    int lo = 0, hi = index->nb, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(index->strings + index->entries[mid].key, prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool index_contains(const index_t *index, const char *key,
+                           uint64_t oid)
+{
+    int i;
+    for (i = index_lower_bound(index, key); i < index->nb; i++) {
+        if (strcmp(index->strings + index->entries[i].key, key) != 0)
+            break;
+        if (index->entries[i].oid == oid) return true;
+    }
+    return false;
+}
+
+// Convert a memory mapped index into an allocated one we can grow.
+static void index_unmap(index_t *index)
+{
+#ifndef __EMSCRIPTEN__
+    entry_t *entries;
+    char *strings;
+
+    if (!index->map) return;
+    entries = malloc(max(index->nb, 1) * sizeof(*entries));
+    memcpy(entries, index->entries, index->nb * sizeof(*entries));
+    strings = malloc(max(index->strings_size, 1));
+    memcpy(strings, index->strings, index->strings_size);
+    munmap(index->map, index->map_size);
+    index->map = NULL;
+    index->entries = entries;
+    index->allocated = max(index->nb, 1);
+    index->strings = strings;
+    index->strings_allocated = max(index->strings_size, 1);
+#endif
+}
+
+/*
+ * Merge a sorted list of pending names into the index, in place.
+ *
+ * The new strings are appended to the pool, so the offsets of the current
+ * entries stay valid, and the entries are merged from the end, so that we
+ * only move the ones that come after the new names.
+ *
+ * Return the number of names added to the index.
+ */
+static int index_merge(index_t *index, const pending_list_t *pending)
+{
+    int i, j, k, r, nb = 0;
+    const pending_t *p, *last = NULL;
+    const pending_t **added;
+    entry_t *e;
+
+    index_unmap(index);
+    // List the pending names not already in the index.
+    added = malloc(max(pending->nb, 1) * sizeof(*added));
+    for (j = 0; j < pending->nb; j++) {
+        p = &pending->values[j];
+        if (last && pending_cmp(last, p) == 0) continue;
+        last = p;
+        if (!index_contains(index, p->key, p->oid)) added[nb++] = p;
+    }
+
+    if (index->nb + nb > index->allocated) {
+        index->allocated = max(index->allocated * 2, index->nb + nb + 256);
+        index->entries = realloc(index->entries,
+                                 index->allocated * sizeof(*index->entries));
+    }
+
+    // Merge from the end.
+    i = index->nb - 1;
+    j = nb - 1;
+    for (k = index->nb + nb - 1; j >= 0; k--) {
+        e = i >= 0 ? &index->entries[i] : NULL;
+        p = added[j];
+        r = -1;
+        if (e) {
+            r = strcmp(index->strings + e->key, p->key);
+            if (r == 0) r = cmp(e->oid, p->oid);
+        }
+        if (r > 0) {
+            index->entries[k] = *e;
+            i--;
+            continue;
+        }
+        e = &index->entries[k];
+        e->key = pool_add(&index->strings, &index->strings_size,
+                          &index->strings_allocated, p->key);
+        e->name = pool_add(&index->strings, &index->strings_size,
+                           &index->strings_allocated, p->name);
+        e->oid = p->oid;
+        e->hint = p->hint;
+        j--;
+    }
+    index->nb += nb;
+    free(added);
+    return nb;
+}
+
+static void index_maybe_save(bool force)
+{
+    double now = sys_get_unix_time();
+    if (!g_names.cache_path || !g_names.index || !g_names.dirty) return;
+    if (!force && g_names.dirty < SAVE_THRESHOLD &&
+            now - g_names.last_save < SAVE_DELAY) return;
+    // No need for the lock, only the merge modifies the index.
+    index_save(g_names.index, g_names.cache_path);
+    g_names.last_save = now;
+    g_names.dirty = 0;
+}
+
+static int merge_worker_fn(worker_t *worker)
+{
+    merge_worker_t *w = (void*)worker;
+    // The searches can read the list and the index at the same time.
+    lock();
+    qsort(w->pending->values, w->pending->nb, sizeof(*w->pending->values),
+          pending_cmp);
+    if (!g_names.index) g_names.index = calloc(1, sizeof(*g_names.index));
+    g_names.dirty += index_merge(g_names.index, w->pending);
+    unlock();
+    index_maybe_save(false);
+    return 0;
+}
+
+static void merge_finish(void)
+{
+    merge_worker_t *w = &g_names.worker;
+    lock();
+    pending_list_clear(g_names.merging);
+    free(g_names.merging);
+    g_names.merging = NULL;
+    unlock();
+    memset(w, 0, sizeof(*w));
+}
+
+static void merge_start(void)
+{
+    merge_worker_t *w = &g_names.worker;
+    assert(!g_names.merging);
+    lock();
+    g_names.merging = malloc(sizeof(*g_names.merging));
+    *g_names.merging = g_names.pending;
+    memset(&g_names.pending, 0, sizeof(g_names.pending));
+    unlock();
+    worker_init(&w->worker, merge_worker_fn);
+    w->pending = g_names.merging;
+    g_names.last_merge = sys_get_unix_time();
+}
+
+void names_init(const char *cache_path)
+{
+    assert(!g_names.index);
+    free(g_names.cache_path);
+    g_names.cache_path = cache_path ? strdup(cache_path) : NULL;
+    if (cache_path) g_names.index = index_load(cache_path);
+    if (g_names.index)
+        LOG_I("Loaded %d names from %s", g_names.index->nb, cache_path);
+    g_names.last_save = sys_get_unix_time();
+    g_names.dirty = 0;
+}
+
+void names_update(void)
+{
+    if (g_names.merging) {
+        if (worker_iter(&g_names.worker.worker)) merge_finish();
+        return;
+    }
+    // No need for the lock, we only need an approximate value.
+    if (g_names.pending.nb == 0) return;
+    if (sys_get_unix_time() - g_names.last_merge < MERGE_DELAY) return;
+    merge_start();
+    if (worker_iter(&g_names.worker.worker)) merge_finish();
+}
+
+void names_release(void)
+{
+    if (g_names.merging) {
+        while (!worker_iter(&g_names.worker.worker)) {}
+        merge_finish();
+    }
+    if (g_names.pending.nb) {
+        merge_start();
+        merge_worker_fn(&g_names.worker.worker);
+        merge_finish();
+    }
+    index_maybe_save(true);
+    index_delete(g_names.index);
+    g_names.index = NULL;
+    free(g_names.cache_path);
+    g_names.cache_path = NULL;
+}
+
+void names_add(const char *dsgn, uint64_t oid, uint64_t hint)
+{
+    char key[128], name[128];
+    pending_list_t *list = &g_names.pending;
+    pending_t *p;
+
+    make_key(dsgn, key, sizeof(key));
+    if (!*key) return;
+    designation_cleanup(dsgn, name, sizeof(name), BAYER_CONST_SHORT);
+
+    lock();
+    if (list->nb >= list->allocated) {
+        list->allocated = max(list->allocated * 2, 256);
+        list->values = realloc(list->values,
+                               list->allocated * sizeof(*list->values));
+    }
+    p = &list->values[list->nb++];
+    p->key = strdup(key);
+    p->name = strdup(name);
+    p->oid = oid;
+    p->hint = hint;
+    unlock();
+}
+
+static void add_obj_designation(const obj_t *obj, void *user,
+                                const char *cat, const char *value)
+{
+    char buf[256];
+    uint64_t hint = *(uint64_t*)user;
+    if (*cat) {
+        snprintf(buf, sizeof(buf), "%s %s", cat, value);
+        names_add(buf, obj->oid, hint);
+    } else {
+        names_add(value, obj->oid, hint);
+    }
+}
+
+void names_add_obj(const obj_t *obj, uint64_t hint)
+{
+    if (!obj->oid) return;
+    obj_get_designations(obj, &hint, add_obj_designation);
+}
+
+bool names_lookup(const char *query, uint64_t *oid, uint64_t *hint)
+{
+    char key[128];
+    int i;
+    bool ret = false;
+    const index_t *index;
+    const pending_list_t *lists[2];
+    const pending_t *p = NULL;
+
+    make_key(query, key, sizeof(key));
+    if (!*key) return false;
+    lock();
+    index = g_names.index;
+    if (index) {
+        i = index_lower_bound(index, key);
+        if (i < index->nb &&
+                strcmp(index->strings + index->entries[i].key, key) == 0) {
+            *oid = index->entries[i].oid;
+            *hint = index->entries[i].hint;
+            unlock();
+            return true;
+        }
+    }
+    lists[0] = g_names.merging;
+    lists[1] = &g_names.pending;
+    for (i = 0; !ret && lists[0] && i < lists[0]->nb; i++) {
+        p = &lists[0]->values[i];
+        if (strcmp(p->key, key) == 0) ret = true;
+    }
+    for (i = 0; !ret && i < lists[1]->nb; i++) {
+        p = &lists[1]->values[i];
+        if (strcmp(p->key, key) == 0) ret = true;
+    }
+    if (ret) {
+        *oid = p->oid;
+        *hint = p->hint;
+    }
+    unlock();
+    return ret;
+}
+
+static bool oid_in(const uint64_t *oids, int nb, uint64_t oid)
+{
+    int i;
+    for (i = 0; i < nb; i++)
+        if (oids[i] == oid) return true;
+    return false;
+}
+
+int names_search(const char *prefix, int max, void *user,
+                 int (*f)(void *user, const char *name,
+                          uint64_t oid, uint64_t hint))
+{
+    char key[128];
+    int i, k, len, nb = 0;
+    bool stop = false;
+    uint64_t *oids;
+    const index_t *index;
+    const entry_t *e;
+    const pending_t *p;
+    const pending_list_t *lists[2];
+
+    make_key(prefix, key, sizeof(key));
+    len = strlen(key);
+    if (!len || max <= 0) return 0;
+    oids = malloc(max * sizeof(*oids));
+
+    lock();
+    index = g_names.index;
+    lists[0] = g_names.merging;
+    lists[1] = &g_names.pending;
+    if (index) {
+        for (i = index_lower_bound(index, key);
+             !stop && nb < max && i < index->nb; i++) {
+            e = &index->entries[i];
+            if (strncmp(index->strings + e->key, key, len) != 0) break;
+            if (oid_in(oids, nb, e->oid)) continue;
+            oids[nb++] = e->oid;
+            stop = f(user, index->strings + e->name, e->oid, e->hint);
+        }
+    }
+
+    // The pending names are not sorted, so we just iterate them all.  There
+    // should never be many of them.
+    for (k = 0; k < 2; k++) {
+        for (i = 0; lists[k] && !stop && nb < max && i < lists[k]->nb; i++) {
+            p = &lists[k]->values[i];
+            if (strncmp(p->key, key, len) != 0) continue;
+            if (oid_in(oids, nb, p->oid)) continue;
+            oids[nb++] = p->oid;
+            stop = f(user, p->name, p->oid, p->hint);
+        }
+    }
+    unlock();
+    free(oids);
+    return nb;
+}
+
+static int search_json_callback(void *user, const char *name,
+                                uint64_t oid, uint64_t hint)
+{
+    char buf[32];
+    json_value *ret = user, *jobj;
+    jobj = json_object_new(0);
+    json_object_push(jobj, "name", json_string_new(name));
+    // As string since json numbers are doubles.
+    snprintf(buf, sizeof(buf), "%" PRIu64, oid);
+    json_object_push(jobj, "oid", json_string_new(buf));
+    snprintf(buf, sizeof(buf), "%" PRIu64, hint);
+    json_object_push(jobj, "hint", json_string_new(buf));
+    json_array_push(ret, jobj);
+    return 0;
+}
+
+/*
+ * Function: names_search_json
+ * Same as names_search, but return the results as a json array string.
+ *
+ * Used by the js code for the search autocompletion.  The returned string
+ * should be freed by the caller.
+ */
+EMSCRIPTEN_KEEPALIVE
+char *names_search_json(const char *prefix, int max)
+{
+    char *ret;
+    json_value *jret = json_array_new(0);
+    names_search(prefix, max, jret, search_json_callback);
+    ret = json_to_string(jret);
+    json_builder_free(jret);
+    return ret;
+}
+
+/******* TESTS **********************************************************/
+
+#if COMPILE_TESTS
+
+static int test_search_callback(void *user, const char *name,
+                                uint64_t oid, uint64_t hint)
+{
+    uint64_t *oids = user;
+    oids[0]++;
+    oids[oids[0]] = oid;
+    return 0;
+}
+
+static void test_names(void)
+{
+    char path[1024];
+    uint64_t oid, hint, res[8];
+    int i;
+    const index_t *index;
+    typeof(g_names) save = g_names;
+
+    // Run the test on an empty index.
+    assert(!g_names.merging);
+    g_names.cache_path = NULL;
+    g_names.index = NULL;
+    memset(&g_names.pending, 0, sizeof(g_names.pending));
+
+    snprintf(path, sizeof(path), "%s/swe-test-names.bin",
+             sys_get_user_dir());
+    remove(path);
+    names_init(path);
+    names_add("NAME Polaris", 10, 100);
+    names_add("* alf UMi", 10, 100);
+    names_add("HIP 11767", 10, 100);
+    names_add("NAME Pollux", 11, 101);
+    names_add("M 31", 12, 0);
+    names_add("NGC 224", 12, 0);
+
+    // Search in the pending names.
+    assert(names_lookup("polaris", &oid, &hint) && oid == 10 && hint == 100);
+    assert(names_lookup("hip11767", &oid, &hint) && oid == 10);
+
+    // Merge into the index.
+    for (i = 0; i < 1000 && g_names.pending.nb; i++) {
+        g_names.last_merge = 0;
+        names_update();
+    }
+    while (g_names.merging) names_update();
+    assert(g_names.index && g_names.index->nb == 6);
+    // The cache is only saved after a while.
+    assert(!index_load(path) && g_names.dirty == 6);
+
+    // The next merges grow the same index.
+    index = g_names.index;
+    names_add("M 31", 12, 0); // Duplicated name.
+    names_add("M 33", 13, 0);
+    names_add("M 33", 13, 0);
+    g_names.last_merge = 0;
+    names_update();
+    while (g_names.merging) names_update();
+    assert(g_names.index == index && index->nb == 7);
+    for (i = 1; i < index->nb; i++) {
+        assert(strcmp(index->strings + index->entries[i - 1].key,
+                      index->strings + index->entries[i].key) <= 0);
+    }
+    names_release();
+
+    // Reload from the cache.
+    names_init(path);
+    assert(g_names.index && g_names.index->map);
+    assert(g_names.index->nb == 7);
+    assert(names_lookup("Alpha UMi", &oid, &hint) && oid == 10);
+    assert(names_lookup("M31", &oid, &hint) && oid == 12);
+    assert(!names_lookup("M3", &oid, &hint));
+
+    memset(res, 0, sizeof(res));
+    assert(names_search("pol", 8, res, test_search_callback) == 2);
+    assert(res[0] == 2 && res[1] == 10 && res[2] == 11);
+    memset(res, 0, sizeof(res));
+    assert(names_search("m3", 8, res, test_search_callback) == 2);
+    memset(res, 0, sizeof(res));
+    assert(names_search("m3", 1, res, test_search_callback) == 1);
+
+    // Merge into the memory mapped index.
+    names_add("NAME Andromeda Galaxy", 12, 0);
+    names_add("HIP 1", 1, 0);
+    g_names.last_merge = 0;
+    names_update();
+    while (g_names.merging) names_update();
+    assert(!g_names.index->map && g_names.index->nb == 9);
+    assert(names_lookup("hip1", &oid, &hint) && oid == 1);
+    assert(names_lookup("andromeda galaxy", &oid, &hint) && oid == 12);
+    assert(names_lookup("polaris", &oid, &hint) && oid == 10);
+    assert(names_lookup("m33", &oid, &hint) && oid == 13);
+    names_release();
+    remove(path);
+
+    g_names.cache_path = save.cache_path;
+    g_names.index = save.index;
+    g_names.pending = save.pending;
+}
+
+TEST_REGISTER(NULL, test_names, TEST_AUTO);
+
+#endif
@@ -0,0 +1,115 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include "obj.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * File: names.h
+ * Global index of the objects names and designations.
+ *
+ * The modules add the designations of their objects as soon as they get
+ * them (for example when a stars tile is loaded), and the index maps them
+ * to the object oid and hint, so that we can search for an object without
+ * having to load any data.
+ *
+ * The keys are normalized: upper case, without accents and without any
+ * non alphanumeric characters, so that 'hip1234' matches 'HIP 1234', and
+ * 'alpha umi' matches '* alf UMi'.
+ *
+ * The new names are first added to a pending list, that is merged into the
+ * sorted index by a background worker.  The index is saved into a cache
+ * file at release, or from time to time if it changed, and memory mapped
+ * at startup, so that the search works immediately the next time.
+ */
+
+/*
+ * Function: names_init
+ * Init the names index.
+ *
+ * Parameters:
+ *   cache_path - Path of the index cache file, or NULL for no cache.
+ */
+void names_init(const char *cache_path);
+
+/*
+ * Function: names_release
+ * Merge the pending names, save the cache file and release the index.
+ */
+void names_release(void);
+
+/*
+ * Function: names_update
+ * Start the merge of the pending names in the background if needed.
+ *
+ * Should be called once per frame.
+ */
+void names_update(void);
+
+/*
+ * Function: names_add
+ * Add a designation to the index.
+ *
+ * This can be called from any thread.
+ *
+ * Parameters:
+ *   dsgn   - A designation, as returned by the objects get_designations
+ *            method, e.g. 'NAME Polaris', 'HIP 11767' or '* alf UMi'.
+ *   oid    - Oid of the object.
+ *   hint   - Hint to pass to <obj_get_by_oid>, or zero.
+ */
+void names_add(const char *dsgn, uint64_t oid, uint64_t hint);
+
+/*
+ * Function: names_add_obj
+ * Add all the designations of an object to the index.
+ */
+void names_add_obj(const obj_t *obj, uint64_t hint);
+
+/*
+ * Function: names_lookup
+ * Find an object from one of its designations.
+ *
+ * Parameters:
+ *   query  - Name to search, case and spaces are ignored.
+ *   oid    - Get the object oid.
+ *   hint   - Get the object hint.
+ *
+ * Return:
+ *   True if the name was found.
+ */
+bool names_lookup(const char *query, uint64_t *oid, uint64_t *hint);
+
+/*
+ * Function: names_search
+ * Find the objects with a designation starting with a given prefix.
+ *
+ * Each object is only returned once, with the first matching designation
+ * in the index order.
+ *
+ * Parameters:
+ *   prefix - Prefix to search, case and spaces are ignored.
+ *   max    - Maximum number of results.
+ *   user   - Data passed to the callback.
+ *   f      - Callback called for each result, can return a non zero
+ *            value to stop the search.
+ *
+ * Return:
+ *   The number of results.
+ */
+int names_search(const char *prefix, int max, void *user,
+                 int (*f)(void *user, const char *name,
+                          uint64_t oid, uint64_t hint));
+
+#endif // NAMES_H
@@ -310,6 +310,145 @@ char *obj_get_info_json(const obj_t *obj, observer_t *obs,
     return json;
 }
 
+// Number of doubles used by an info value in an infos table.
+static int info_table_size(int info)
+{
+    switch (info % 16) {
+    case TYPE_FLOAT:
+    case TYPE_INT:
+    case TYPE_BOOL:
+        return 1;
+    case TYPE_V2: return 2;
+    case TYPE_V3: return 3;
+    case TYPE_V4: return 4;
+    case TYPE_V4X2: return 8;
+    default: return -1;
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int obj_infos_table_stride(int nb_infos, const int *infos)
+{
+    int i, size, ret = 0;
+    for (i = 0; i < nb_infos; i++) {
+        size = info_table_size(infos[i]);
+        if (size < 0) return -1;
+        ret += size;
+    }
+    return ret;
+}
+
+// Number of objects processed by a single worker.
+#define INFOS_TABLE_CHUNK_SIZE 64
+
+typedef struct {
+    observer_t      *obs;   // Clone of the observer.
+    obj_t           **objs;
+    int             nb_objs;
+    int             nb_times;
+    const double    *times;
+    int             nb_infos;
+    const int       *infos;
+    int             stride;
+    double          *out;
+} infos_table_task_t;
+
+static void infos_table_task_run(void *user, int idx)
+{
+    infos_table_task_t *task = (infos_table_task_t*)user + idx;
+    observer_t *obs = task->obs;
+    int i, j, k, l, size, type;
+    double *row;
+    union {
+        bool b;
+        int d;
+        double f[8];
+    } v;
+
+    // Loop over the times first so that we only update the observer once
+    // per time.
+    for (j = 0; j < task->nb_times; j++) {
+        obs->tt = task->times[j];
+        observer_update(obs, false);
+        for (i = 0; i < task->nb_objs; i++) {
+            row = task->out + ((size_t)i * task->nb_times + j) * task->stride;
+            for (k = 0; k < task->nb_infos; k++) {
+                type = task->infos[k] % 16;
+                size = info_table_size(task->infos[k]);
+                if (!task->objs[i] ||
+                        obj_get_info(task->objs[i], obs, task->infos[k], &v)) {
+                    for (l = 0; l < size; l++) row[l] = NAN;
+                } else if (type == TYPE_INT) {
+                    row[0] = v.d;
+                } else if (type == TYPE_BOOL) {
+                    row[0] = v.b;
+                } else {
+                    memcpy(row, v.f, size * sizeof(double));
+                }
+                row += size;
+            }
+        }
+    }
+}
+
+EMSCRIPTEN_KEEPALIVE
+int obj_get_infos_table(const observer_t *obs,
+                        int nb_objs, obj_t **objs,
+                        int nb_times, const double *times,
+                        int nb_infos, const int *infos,
+                        double *out)
+{
+    int i, nb_tasks, stride;
+    infos_table_task_t *tasks, *task;
+
+    stride = obj_infos_table_stride(nb_infos, infos);
+    if (stride < 0) {
+        LOG_E("Cannot compute table of non numerical infos");
+        return -1;
+    }
+    nb_tasks = (nb_objs + INFOS_TABLE_CHUNK_SIZE - 1) / INFOS_TABLE_CHUNK_SIZE;
+    tasks = calloc(nb_tasks, sizeof(*tasks));
+    for (i = 0; i < nb_tasks; i++) {
+        task = &tasks[i];
+        task->obs = (observer_t*)obj_clone(&obs->obj);
+        task->objs = objs + i * INFOS_TABLE_CHUNK_SIZE;
+        task->nb_objs = min(INFOS_TABLE_CHUNK_SIZE,
+                            nb_objs - i * INFOS_TABLE_CHUNK_SIZE);
+        task->nb_times = nb_times;
+        task->times = times;
+        task->nb_infos = nb_infos;
+        task->infos = infos;
+        task->stride = stride;
+        task->out = out + (size_t)i * INFOS_TABLE_CHUNK_SIZE * nb_times *
+                          stride;
+    }
+    worker_parallel_for(nb_tasks, infos_table_task_run, tasks);
+
+    for (i = 0; i < nb_tasks; i++)
+        obj_release(&tasks[i].obs->obj);
+    free(tasks);
+    return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int obj_get_infos_table_by_oids(const observer_t *obs,
+                                int nb_oids, const uint64_t *oids,
+                                int nb_times, const double *times,
+                                int nb_infos, const int *infos,
+                                double *out)
+{
+    int i, ret;
+    obj_t **objs = calloc(nb_oids, sizeof(*objs));
+    for (i = 0; i < nb_oids; i++)
+        objs[i] = obj_get_by_oid(NULL, oids[i], 0);
+    ret = obj_get_infos_table(obs, nb_oids, objs, nb_times, times,
+                              nb_infos, infos, out);
+    for (i = 0; i < nb_oids; i++)
+        obj_release(objs[i]);
+    free(objs);
+    return ret;
+}
+
 EMSCRIPTEN_KEEPALIVE
 const char *obj_get_id(const obj_t *obj)
 {
@@ -606,6 +745,7 @@ const char *obj_info_type_str(int type)
     return names[type];
 }
 
+EMSCRIPTEN_KEEPALIVE
 int obj_info_from_str(const char *str)
 {
 #define X(name, ...) if (strcasecmp(str, #name) == 0) return INFO_##name;
@@ -638,8 +778,17 @@ static json_value *test_lookat_fn(obj_t *obj, const attribute_t *attr,
     return NULL;
 }
 
+static int test_get_info(const obj_t *obj, const observer_t *obs, int info,
+                         void *out)
+{
+    if (info != INFO_VMAG) return 1;
+    *(double*)out = ((test_t*)obj)->alt + obs->tt;
+    return 0;
+}
+
 static obj_klass_t test_klass = {
     .id = "test",
+    .get_info = test_get_info,
     .attributes = (attribute_t[]) {
         PROPERTY(altitude, TYPE_FLOAT, MEMBER(test_t, alt)),
         PROPERTY(my_attr, TYPE_FLOAT, MEMBER(test_t, my_attr),
@@ -672,6 +821,46 @@ static void test_simple(void)
     assert(test.nb_changes == 2);
 }
 
+static void test_infos_table(void)
+{
+    const int nb = 100;
+    const double times[3] = {59000, 59000.5, 59001};
+    const int infos[2] = {INFO_VMAG, INFO_PVO};
+    int i, j, stride;
+    test_t *tests;
+    obj_t **objs;
+    observer_t *obs;
+    double *out, *v;
+
+    stride = obj_infos_table_stride(2, infos);
+    assert(stride == 9);
+    if (stride <= 0) return;
+
+    tests = calloc(nb, sizeof(*tests));
+    objs = calloc(nb, sizeof(*objs));
+    obs = (observer_t*)obj_create("observer", NULL, NULL);
+    for (i = 0; i < nb; i++) {
+        tests[i].obj.klass = &test_klass;
+        tests[i].alt = i;
+        objs[i] = &tests[i].obj;
+    }
+    out = calloc(nb * 3 * stride, sizeof(*out));
+    obj_get_infos_table(obs, nb, objs, 3, times, 2, infos, out);
+    for (i = 0; i < nb; i++) {
+        for (j = 0; j < 3; j++) {
+            v = out + (i * 3 + j) * stride;
+            (void)v;
+            assert(v[0] == i + times[j]);
+            assert(isnan(v[1]) && isnan(v[8]));
+        }
+    }
+    obj_release(&obs->obj);
+    free(out);
+    free(objs);
+    free(tests);
+}
+
 TEST_REGISTER(NULL, test_simple, TEST_AUTO);
+TEST_REGISTER(NULL, test_infos_table, TEST_AUTO);
 
 #endif
@@ -46,11 +46,21 @@
  * OBJ_LISTABLE         - For modules that maintain a list of children objects,
  *                        like comets, this allows obj_list to directly do
  *                        the listing.
+ * OBJ_ADAPTIVE         - The module can lower its rendering quality when
+ *                        the frame governor sets the painter 'degrade'
+ *                        value.  See governor.h.
+ * OBJ_RENDER_JOB       - The object can be rendered from a job thread,
+ *                        into a command list: its render function only
+ *                        reads its own data and calls the painter
+ *                        functions, without touching any shared state
+ *                        (labels, areas, caches, textures loading).
  */
 enum {
     OBJ_IN_JSON_TREE = 1 << 0,
     OBJ_MODULE       = 1 << 1,
     OBJ_LISTABLE     = 1 << 2,
+    OBJ_ADAPTIVE     = 1 << 3,
+    OBJ_RENDER_JOB   = 1 << 4,
 };
 
 typedef struct _json_value json_value;
@@ -97,6 +107,8 @@ typedef struct obj_klass obj_klass_t;
  * Module Methods:
  *   update  - Update the module.
  *   list    - List all the sky objects children from this module.
+ *   list_sources - List the keys of the data sources, for the modules
+ *                  that accept several sources.
  *   get_render_order - Return the render order.
  *   on_mouse   - Called when there is a mouse event.
  */
@@ -140,6 +152,9 @@ struct obj_klass
     int (*list)(const obj_t *obj, observer_t *obs, double max_mag,
                 uint64_t hint, const char *source, void *user,
                 int (*f)(void *user, obj_t *obj));
+    // List the keys of the data sources that can be passed to list.
+    int (*list_sources)(const obj_t *obj, void *user,
+                        int (*f)(void *user, const char *key));
 
     // Add a source of data.
     int (*add_data_source)(obj_t *obj, const char *url, const char *key);
@@ -362,6 +377,63 @@ int obj_get_info(obj_t *obj, observer_t *obs, int info, void *out);
  */
 char *obj_get_info_json(const obj_t *obj, observer_t *obs, const char *info);
 
+/*
+ * Function: obj_get_infos_table
+ * Compute numerical infos of many objects at many times.
+ *
+ * This is much faster than calling obj_get_info in a loop: the objects are
+ * split into chunks that run in parallel with <worker_parallel_for>, each
+ * one with its own clone of the observer, updated only once per time for
+ * all the objects of the chunk.
+ *
+ * The results are written in a packed array of doubles of size
+ * nb_objs * nb_times * stride, where stride is the value returned by
+ * <obj_infos_table_stride>.  The values of object i at time j start at
+ * index (i * nb_times + j) * stride, and contain all the requested infos in
+ * order (one value for float, int and bool infos, four values for V4 infos,
+ * etc).  Infos that an object doesn't support are set to NAN.
+ *
+ * Parameters:
+ *   obs      - The observer.  Not modified.
+ *   nb_objs  - Number of objects.
+ *   objs     - Array of objects.  NULL objects get NAN values.  Each object
+ *              must appear only once.
+ *   nb_times - Number of times.
+ *   times    - Array of times, in MJD (TT).
+ *   nb_infos - Number of infos.
+ *   infos    - Array of info enum values (INFO_PVO, INFO_VMAG, etc).
+ *   out      - Output buffer.
+ *
+ * Return:
+ *   0 on success, -1 if one of the infos is not numerical.
+ */
+int obj_get_infos_table(const observer_t *obs,
+                        int nb_objs, obj_t **objs,
+                        int nb_times, const double *times,
+                        int nb_infos, const int *infos,
+                        double *out);
+
+/*
+ * Function: obj_get_infos_table_by_oids
+ * Same as <obj_get_infos_table>, but with a list of objects oids.
+ *
+ * Objects that cannot be found get NAN values.
+ */
+int obj_get_infos_table_by_oids(const observer_t *obs,
+                                int nb_oids, const uint64_t *oids,
+                                int nb_times, const double *times,
+                                int nb_infos, const int *infos,
+                                double *out);
+
+/*
+ * Function: obj_infos_table_stride
+ * Return the number of doubles per entry of an infos table.
+ *
+ * Return:
+ *   The stride, or -1 if one of the infos is not numerical.
+ */
+int obj_infos_table_stride(int nb_infos, const int *infos);
+
 /*
  * Function: obj_get_2d_ellipse
  * Return the ellipse containing the rendered object in screen coordinates (px).
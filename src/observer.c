@@ -10,6 +10,10 @@
 #include "observer.h"
 #include "swe.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 // Simple xor hash function.
 static uint32_t hash_xor(uint32_t v, const char *data, int len)
 {
@@ -127,21 +131,148 @@ static void correct_speed_of_light(double pv[2][3]) {
 }
 
 
-static void update_nutation_precession_mat(observer_t *obs)
+/*
+ * Time dependent values that don't depend on the observer location.
+ *
+ * Computing them is slow (mostly because of the nutation series), so we
+ * keep a small per process cache of them on a regular time grid, and
+ * always interpolate in between, so that the values only depend on the
+ * time.  With a one hour step the errors are below 1e-10 rad for the
+ * angles and 1e-12 AU for the earth position.
+ */
+typedef struct {
+    double tt;
+    double ehpv[2][3];  // Earth heliocentric position/speed.
+    double ebpv[2][3];  // Earth barycentric position/speed.
+    double x, y;        // CIP X, Y.
+    double s;           // CIO locator s.
+    double sp;          // TIO locator s'.
+    double eo;          // Equation of the origins.
+    double rnp[3][3];   // IAU 2000A nutation/precession matrix.
+} earth_state_t;
+
+#define EARTH_STATE_STEP (1.0 / 24)
+#define EARTH_STATE_CACHE_SIZE 16 // Must be a power of two.
+
+// The lock is only held to copy the nodes in and out of the cache, so that
+// the batch computations can run in parallel.
+static struct {
+    earth_state_t nodes[EARTH_STATE_CACHE_SIZE];
+    int64_t idx[EARTH_STATE_CACHE_SIZE];
+    bool valid[EARTH_STATE_CACHE_SIZE];
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+} g_earth_cache = {
+#ifdef HAVE_PTHREAD
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
+static void earth_cache_lock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_earth_cache.lock);
+#endif
+}
+
+static void earth_cache_unlock(void)
+{
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_earth_cache.lock);
+#endif
+}
+
+static void earth_state_compute(double tt, earth_state_t *st)
+{
+    double r[3][3], dpsi, deps, epsa, rb[3][3], rp[3][3], rbp[3][3],
+           rn[3][3], rbpn[3][3];
+
+    st->tt = tt;
+    eraEpv00(DJM0, tt, st->ehpv, st->ebpv);
+    // Same as in eraApco13.
+    eraPnm06a(DJM0, tt, r);
+    eraBpn2xy(r, &st->x, &st->y);
+    st->s = eraS06(DJM0, tt, st->x, st->y);
+    st->sp = eraSp00(DJM0, tt);
+    st->eo = eraEors(r, st->s);
+    eraPn00a(DJM0, tt, &dpsi, &deps, &epsa, rb, rp, rbp, rn, rbpn);
+    mat3_mul(rn, rp, st->rnp);
+}
+
+// Get the grid node i, from the cache if possible.
+static void earth_state_node(int64_t i, earth_state_t *out)
+{
+    int slot = i & (EARTH_STATE_CACHE_SIZE - 1);
+    bool found;
+
+    earth_cache_lock();
+    found = g_earth_cache.valid[slot] && g_earth_cache.idx[slot] == i;
+    if (found) *out = g_earth_cache.nodes[slot];
+    earth_cache_unlock();
+    if (found) return;
+
+    earth_state_compute(i * EARTH_STATE_STEP, out);
+    earth_cache_lock();
+    g_earth_cache.nodes[slot] = *out;
+    g_earth_cache.idx[slot] = i;
+    g_earth_cache.valid[slot] = true;
+    earth_cache_unlock();
+}
+
+static void earth_state_interp(const earth_state_t *a, const earth_state_t *b,
+                               double tt, earth_state_t *out)
+{
+    int i, j;
+    double h = b->tt - a->tt, t = (tt - a->tt) / h;
+    // Cubic Hermite basis (and derivatives) for the positions and speeds.
+    double h00 = (1 + 2 * t) * (1 - t) * (1 - t),
+           h10 = t * (1 - t) * (1 - t),
+           h01 = t * t * (3 - 2 * t),
+           h11 = t * t * (t - 1),
+           d00 = 6 * t * (t - 1) / h,
+           d10 = (3 * t - 1) * (t - 1),
+           d11 = t * (3 * t - 2);
+    #define HERMITE(pv) do { \
+        out->pv[0][i] = h00 * a->pv[0][i] + h10 * h * a->pv[1][i] + \
+                        h01 * b->pv[0][i] + h11 * h * b->pv[1][i]; \
+        out->pv[1][i] = d00 * (a->pv[0][i] - b->pv[0][i]) + \
+                        d10 * a->pv[1][i] + d11 * b->pv[1][i]; \
+    } while (0)
+    #define LERP(x) out->x = mix(a->x, b->x, t)
+
+    out->tt = tt;
+    for (i = 0; i < 3; i++) {
+        HERMITE(ehpv);
+        HERMITE(ebpv);
+        for (j = 0; j < 3; j++) LERP(rnp[i][j]);
+    }
+    LERP(x);
+    LERP(y);
+    LERP(s);
+    LERP(sp);
+    LERP(eo);
+    #undef HERMITE
+    #undef LERP
+}
+
+// Get the earth state at a given time, interpolated from the grid nodes.
+static void earth_state_get(double tt, earth_state_t *out)
 {
-    // XXX: we can maybe optimize this, since eraPn00a is very slow!
-    double dpsi, deps, epsa, rb[3][3], rp[3][3], rbp[3][3], rn[3][3],
-           rbpn[3][3];
-    eraPn00a(obs->tt, DJM0, &dpsi, &deps, &epsa, rb, rp, rbp, rn, rbpn);
-    mat3_mul(rn, rp, obs->rnp);
+    int64_t i = floor(tt / EARTH_STATE_STEP);
+    earth_state_t a, b;
 
+    earth_state_node(i, &a);
+    earth_state_node(i + 1, &b);
+    earth_state_interp(&a, &b, tt, out);
 }
 
 void observer_update(observer_t *obs, bool fast)
 {
     double utc1, utc2, ut11, ut12, tai1, tai2;
-    double dt, dut1 = 0;
+    double dt, dut1 = 0, refa, refb;
     double p[3] = {0};
+    earth_state_t earth;
 
     uint64_t hash, hash_partial;
     observer_compute_hash(obs, &hash_partial, &hash);
@@ -172,18 +303,23 @@ void observer_update(observer_t *obs, bool fast)
             eraPvu(obs->tt - obs->last_update, obs->earth_pvb, obs->earth_pvb);
         }
     } else {
-        eraApco13(DJM0, obs->utc, dut1,
-                obs->elong, obs->phi,
-                obs->hm,
-                0, 0,
-                obs->refraction ? obs->pressure : 0,
-                15,       // Temperature (dec C)
-                0.5,      // Relative humidity (0-1)
-                0.55,     // Effective color (micron),
-                &obs->astrom,
-                &obs->eo);
+        // Same as eraApco13, but using the cached earth state.
+        earth_state_get(obs->tt, &earth);
+        eraUtcut1(DJM0, obs->utc, dut1, &ut11, &ut12);
+        eraRefco(obs->refraction ? obs->pressure : 0,
+                 15,       // Temperature (dec C)
+                 0.5,      // Relative humidity (0-1)
+                 0.55,     // Effective color (micron),
+                 &refa, &refb);
+        eraApco(DJM0, obs->tt, earth.ebpv, earth.ehpv[0],
+                earth.x, earth.y, earth.s, eraEra00(ut11, ut12),
+                obs->elong, obs->phi, obs->hm, 0, 0, earth.sp,
+                refa, refb, &obs->astrom);
+        obs->eo = earth.eo;
         // Update earth position.
-        eraEpv00(DJM0, obs->tt, obs->earth_pvh, obs->earth_pvb);
+        eraCpv(earth.ehpv, obs->earth_pvh);
+        eraCpv(earth.ebpv, obs->earth_pvb);
+        mat3_copy(earth.rnp, obs->rnp);
         eraCp(obs->astrom.eb, obs->obs_pvb[0]);
         vec3_mul(ERFA_DC, obs->astrom.v, obs->obs_pvb[1]);
         eraPvmpv(obs->obs_pvb, obs->earth_pvb, obs->obs_pvg);
@@ -211,7 +347,7 @@ void observer_update(observer_t *obs, bool fast)
     }
 
     update_matrices(obs);
-    if (!fast) update_nutation_precession_mat(obs);
+    frame_reset_rotations(obs);
 
     // Compute sun's apparent position in observer reference frame
     eraPvmpv(obs->sun_pvb, obs->obs_pvb, obs->sun_pvo);
@@ -314,3 +450,65 @@ static obj_klass_t observer_klass = {
 };
 OBJ_REGISTER(observer_klass)
 
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_earth_state_cache(void)
+{
+    int i;
+    double tt, err_pos = 0, err_vel = 0, err_ang = 0;
+    earth_state_t ref, st;
+
+    for (i = 0; i < 200; i++) {
+        tt = 58000 + i * 0.0173;
+        earth_state_get(tt, &st);
+        earth_state_compute(tt, &ref);
+        err_pos = max(err_pos, vec3_dist(st.ebpv[0], ref.ebpv[0]));
+        err_pos = max(err_pos, vec3_dist(st.ehpv[0], ref.ehpv[0]));
+        err_vel = max(err_vel, vec3_dist(st.ebpv[1], ref.ebpv[1]));
+        err_ang = max(err_ang, fabs(st.x - ref.x));
+        err_ang = max(err_ang, fabs(st.y - ref.y));
+        err_ang = max(err_ang, fabs(st.eo - ref.eo));
+        err_ang = max(err_ang, vec3_dist(st.rnp[0], ref.rnp[0]));
+        err_ang = max(err_ang, vec3_dist(st.rnp[2], ref.rnp[2]));
+    }
+    assert(err_pos < 1e-12);
+    assert(err_vel < 1e-10);
+    assert(err_ang < 1e-10);
+
+    // The values don't depend on the previous calls.
+    tt = 58000.3;
+    earth_state_get(tt, &ref);
+    for (i = 0; i < 2 * EARTH_STATE_CACHE_SIZE; i++)
+        earth_state_get(tt + 10 * i, &st);
+    earth_state_get(tt, &st);
+    assert(memcmp(&st, &ref, sizeof(st)) == 0);
+}
+
+TEST_REGISTER(NULL, test_earth_state_cache, TEST_AUTO);
+
+static observer_t g_bench_obs;
+
+static void bench_observer_update_setup(void)
+{
+    g_bench_obs = *core->observer;
+}
+
+// Accurate update of the observer, with the time moving by one minute
+// between each call.
+static int bench_observer_update(void)
+{
+    const int N = 100;
+    int i;
+    for (i = 0; i < N; i++) {
+        g_bench_obs.tt += 1.0 / 1440;
+        observer_update(&g_bench_obs, false);
+    }
+    return N;
+}
+
+BENCH_REGISTER(bench_observer_update_setup, bench_observer_update)
+
+#endif
@@ -12,6 +12,7 @@
 
 #include "obj.h"
 #include "erfa.h"
+#include "frames.h"
 
 /*
  * Type: observer_t
@@ -111,6 +112,14 @@ struct observer
     double re2i[3][3];  // Eclipic to Equatorial J2000 (ICRF).
     double rnp[3][3];   // Nutation/Precession rotation.
     double rc2v[3][3];  // Equatorial J2000 (ICRS) to view (no refraction).
+
+    // Composite rotations of the (origin, dest) pairs of frames, built on
+    // first use after each update.  rframes_valid is set once the rotation
+    // of a pair is built, and rframes_nb counts the built pairs.
+    // See <frame_reset_rotations>.
+    frame_rotation_t rframes[FRAMES_NB][FRAMES_NB];
+    uint8_t rframes_valid[FRAMES_NB][FRAMES_NB];
+    int rframes_nb;
 };
 
 void observer_update(observer_t *obs, bool fast);
@@ -475,17 +475,27 @@ bool painter_is_2d_circle_clipped(const painter_t *painter, const double p[2],
 
 bool painter_is_quad_clipped(const painter_t *painter, int frame,
                              const uv_map_t *map, bool outside)
+{
+    double bounding_cap[4] = {};
+    if (outside)
+        uv_map_get_bounding_cap(map, bounding_cap);
+    return painter_is_quad_clipped_with_cap(painter, frame, map,
+                                            bounding_cap, outside);
+}
+
+bool painter_is_quad_clipped_with_cap(const painter_t *painter, int frame,
+                                      const uv_map_t *map,
+                                      const double bounding_cap[4],
+                                      bool outside)
 {
     double corners[4][4];
     double quad[4][4], normals[4][3], normal[4];
     double p[4][4], direction[3];
-    double bounding_cap[4];
     uv_map_t children[4];
     int i;
     int order = map->order;
 
     if (outside) {
-        uv_map_get_bounding_cap(map, bounding_cap);
         assert(vec3_is_normalized(bounding_cap));
         if (painter_is_cap_clipped(painter, frame, bounding_cap))
             return true;
@@ -881,3 +891,47 @@ bool painter_unproject(const painter_t *painter, int frame,
     convert_frame(painter->obs, FRAME_VIEW, frame, true, p, pos);
     return ret;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#define BENCH_N 10000
+
+static double g_bench_pos[BENCH_N][3];
+static projection_t g_bench_proj;
+static painter_t g_bench_painter;
+
+static void bench_painter_project_setup(void)
+{
+    double z, r, a;
+    int i;
+    for (i = 0; i < BENCH_N; i++) {
+        z = 1 - 2 * (i + 0.5) / BENCH_N;
+        r = sqrt(1 - z * z);
+        a = i * 2.399963;
+        vec3_set(g_bench_pos[i], r * cos(a), r * sin(a), z);
+    }
+    core_get_proj(&g_bench_proj);
+    observer_update(core->observer, false);
+    g_bench_painter = (painter_t) {
+        .obs = core->observer,
+        .proj = &g_bench_proj,
+    };
+}
+
+static int bench_painter_project(void)
+{
+    double win[2];
+    int i;
+    for (i = 0; i < BENCH_N; i++) {
+        painter_project(&g_bench_painter, FRAME_ICRF, g_bench_pos[i],
+                        true, false, win);
+        bench_keep(win[0]);
+    }
+    return BENCH_N;
+}
+
+BENCH_REGISTER(bench_painter_project_setup, bench_painter_project)
+
+#endif
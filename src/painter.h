@@ -121,7 +121,7 @@ struct renderer
                  int                 verts_count,
                  const double        verts[][3],
                  int                 indices_count,
-                 const uint16_t      indices[]);
+                 const uint32_t      indices[]);
 
     void (*ellipse_2d)(renderer_t       *rend,
                        const painter_t  *painter,
@@ -143,8 +143,228 @@ struct renderer
 };
 
 renderer_t* render_gl_create(void);
+
+/*
+ * Function: render_svg_create
+ * Create a vector renderer that exports the frames as an SVG file.
+ *
+ * The page has the size of the window, and each rendered frame overwrites
+ * the file.  The output is streamed, so the memory usage doesn't depend on
+ * the number of elements.  Only the vector primitives (points, lines,
+ * meshes, shapes and texts) are exported, the textured quads are ignored.
+ *
+ * Parameters:
+ *   out    - Path of the output file.
+ *
+ * Return:
+ *   The new renderer, or NULL if the output file cannot be created.
+ */
 renderer_t* render_svg_create(const char *out);
 
+/*
+ * Function: render_pdf_create
+ * Same as <render_svg_create>, but export the frames as a PDF file.
+ *
+ * The texts use the standard Helvetica font, so only the latin-1
+ * characters are supported.
+ */
+renderer_t* render_pdf_create(const char *out);
+
+/*
+ * Function: render_svg_release
+ * Delete a renderer created with <render_svg_create> or
+ * <render_pdf_create>.
+ *
+ * Return:
+ *   0 on success, or -1 if one of the rendered frames could not be
+ *   written to the output file.
+ */
+int render_svg_release(renderer_t *rend);
+
+/*
+ * Enum: RENDER_OP
+ * The renderer methods, as counted by the null renderer and stored in the
+ * recorded command logs.
+ */
+enum {
+    RENDER_OP_PREPARE = 1,
+    RENDER_OP_FINISH,
+    RENDER_OP_POINTS_2D,
+    RENDER_OP_QUAD,
+    RENDER_OP_QUAD_WIREFRAME,
+    RENDER_OP_TEXTURE,
+    RENDER_OP_TEXT,
+    RENDER_OP_LINE,
+    RENDER_OP_MESH,
+    RENDER_OP_ELLIPSE_2D,
+    RENDER_OP_RECT_2D,
+    RENDER_OP_LINE_2D,
+    RENDER_OP_COUNT
+};
+
+/*
+ * Type: render_stats_t
+ * Counters of the calls made to a null renderer.
+ *
+ * Attributes:
+ *   frames     - Number of rendered frames.
+ *   calls      - Number of calls of each <RENDER_OP>.
+ *   vertices   - Number of vertices (or points, or text characters) passed
+ *                to each <RENDER_OP>.
+ *   textures   - Number of textures used by each <RENDER_OP>.
+ */
+typedef struct render_stats {
+    int frames;
+    struct {
+        int calls;
+        int vertices;
+        int textures;
+    } ops[RENDER_OP_COUNT];
+} render_stats_t;
+
+/*
+ * Function: render_null_create
+ * Create a renderer that doesn't draw anything but counts the calls.
+ *
+ * This can be used to run the core without a GPU, for example to profile
+ * the CPU side of the rendering.
+ */
+renderer_t* render_null_create(void);
+
+/*
+ * Function: render_null_release
+ * Delete a renderer created with <render_null_create>.
+ */
+void render_null_release(renderer_t *rend);
+
+/*
+ * Function: render_null_get_stats
+ * Get the counters of a null renderer since its creation.
+ */
+void render_null_get_stats(const renderer_t *rend, render_stats_t *stats);
+
+/*
+ * Function: render_op_get_name
+ * Return a short name for a <RENDER_OP> value, like 'points_2d'.
+ */
+const char *render_op_get_name(int op);
+
+/*
+ * Function: render_record_create
+ * Create a renderer that records all the calls into a binary command log.
+ *
+ * All the calls are also forwarded to a second renderer, that does the
+ * actual rendering.  The log can be replayed later with <render_replay>
+ * in the same build of the engine.
+ *
+ * Parameters:
+ *   path   - Path of the output command log file.
+ *   next   - Renderer that does the actual rendering (for example a null
+ *            renderer).
+ *
+ * Return:
+ *   The new renderer, or NULL if the file cannot be opened.
+ */
+renderer_t* render_record_create(const char *path, renderer_t *next);
+
+/*
+ * Function: render_record_release
+ * Flush the command log of a recording renderer and delete it.
+ *
+ * The forwarded renderer is not deleted.
+ */
+void render_record_release(renderer_t *rend);
+
+/*
+ * Function: render_replay
+ * Replay a command log recorded with <render_record_create>.
+ *
+ * The texture data, and the callbacks attached to the painter (like the
+ * atmosphere luminance function) are not recorded, so the replayed frames
+ * won't look exactly the same, but the sequence of calls and the geometry
+ * are identical.
+ *
+ * Parameters:
+ *   path   - Path of the command log.
+ *   rend   - The renderer we send the commands to.
+ *
+ * Return:
+ *   The number of replayed frames, or -1 in case of error.
+ */
+int render_replay(const char *path, renderer_t *rend);
+
+/*
+ * Function: render_list_create
+ * Create a renderer that records the calls into an in-memory command list.
+ *
+ * The list can then be submitted to any other renderer with
+ * <render_list_submit>.  The commands keep the pointers to the textures
+ * and to the painter callbacks, so the list has to be submitted during the
+ * frame it was recorded in.
+ *
+ * Several lists can be filled from different threads at the same time.
+ * The calls to compute the text bounds are directly forwarded to the
+ * 'measure' renderer, protected by a global lock.
+ *
+ * Parameters:
+ *   measure    - Renderer used to compute the text bounds, usually the one
+ *                the list will be submitted to.
+ */
+renderer_t* render_list_create(renderer_t *measure);
+
+/*
+ * Function: render_list_submit
+ * Send all the recorded commands of a list to an other renderer.
+ *
+ * Return:
+ *   The number of submitted commands.
+ */
+int render_list_submit(renderer_t *list, renderer_t *rend);
+
+/*
+ * Function: render_list_clear
+ * Remove all the commands of a list, so that it can be reused.
+ */
+void render_list_clear(renderer_t *list);
+
+/*
+ * Function: render_list_release
+ * Delete a renderer created with <render_list_create>.
+ */
+void render_list_release(renderer_t *list);
+
+/*
+ * Function: render_soft_create
+ * Create a multi-threaded software renderer.
+ *
+ * The renderer rasterizes the frames on the CPU into an RGBA buffer, that
+ * can be retrieved after each frame with <render_soft_get_buffer>.  The
+ * textures are sampled from their CPU copy, so texture data is kept from
+ * now on (see <texture_set_keep_data>).
+ *
+ * Parameters:
+ *   parallel   - If set, the tiles are rasterized in parallel with
+ *                <worker_parallel_for>, otherwise on the calling thread.
+ */
+renderer_t* render_soft_create(bool parallel);
+
+/*
+ * Function: render_soft_release
+ * Delete a software renderer.
+ */
+void render_soft_release(renderer_t *rend);
+
+/*
+ * Function: render_soft_get_buffer
+ * Return the RGBA pixels of the last frame rendered by a software renderer.
+ *
+ * Parameters:
+ *   rend   - A software renderer.
+ *   w      - Get the width of the image in pixels.
+ *   h      - Get the height of the image in pixels.
+ */
+const uint8_t *render_soft_get_buffer(const renderer_t *rend, int *w, int *h);
+
 
 struct point
 {
@@ -195,6 +415,10 @@ struct painter
     // above variables.
     double          hard_limit_mag;
 
+    // Quality reduction asked by the frame governor, from 0 (full
+    // quality) to 1.  Only set for the OBJ_ADAPTIVE modules.
+    double          degrade;
+
     // Point halo / core ratio (zero for no halo).
     double          points_halo;
     double          (*depth_range)[2]; // If set use depth test.
@@ -430,6 +654,18 @@ void paint_debug(bool value);
 bool painter_is_quad_clipped(const painter_t *painter, int frame,
                              const uv_map_t *map, bool outside);
 
+/*
+ * Function: painter_is_quad_clipped_with_cap
+ * Same as <painter_is_quad_clipped>, but with a precomputed bounding cap.
+ *
+ * Parameters:
+ *   cap        - Bounding cap of the quad, as returned by
+ *                <uv_map_get_bounding_cap>.  Only used for outside quads.
+ */
+bool painter_is_quad_clipped_with_cap(const painter_t *painter, int frame,
+                                      const uv_map_t *map,
+                                      const double cap[4], bool outside);
+
 
 // Function: painter_is_healpix_clipped
 //
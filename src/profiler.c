@@ -7,9 +7,10 @@
  * repository.
  */
 
+#include "swe.h"
+
 #if RMT_ENABLED
 
-#include "profiler.h"
 #include "Remotery.c"
 
 static Remotery* rmt = NULL;
@@ -34,10 +35,416 @@ int profile_release(void)
     return 0;
 }
 
+void profile_frame(int period) {}
+void profile_counter(const char *name, double value) {}
+void profile_set_thread_name(const char *name) {}
+struct _json_value *profile_get_stats(void) { return json_object_new(0); }
+char *profile_get_trace(void) { return strdup("{\"traceEvents\": []}"); }
+
 #else
 
-int profile_init(void) { return 0; }
+#include <time.h>
+
+#ifdef HAVE_PTHREAD
+#   include <pthread.h>
+#endif
+
+// Number of events in each thread ring buffer.
+#define RING_SIZE 8192
+
+/*
+ * Type: event_t
+ * A recorded zone.
+ *
+ * For aggregated zones, the event covers all the merged calls, from the
+ * start of the first one to the end of the last one, and 'total' is the
+ * sum of the individual durations.
+ *
+ * Counters events have a zero count, and only use 'start' and 'value'.
+ */
+typedef struct {
+    const char  *name;
+    uint64_t    start;
+    uint64_t    dur;
+    uint64_t    total;
+    double      value;
+    uint32_t    count;
+    uint16_t    depth;
+} event_t;
+
+/*
+ * Type: thread_t
+ * Per thread profiling state.
+ *
+ * Only the owner thread writes into the ring buffer: it first fills the
+ * event, then increments 'head' with release semantic, so that the readers
+ * never need a lock.  If the readers are too slow, the oldest events are
+ * just overwritten.
+ */
+typedef struct thread thread_t;
+struct thread {
+    thread_t    *next;
+    int         tid;
+    char        name[32];
+    int         depth;
+    event_t     pending; // Current aggregated event, not in the ring yet.
+    uint64_t    head;
+    uint64_t    read_pos; // Used by profile_frame, in the main thread.
+    event_t     ring[RING_SIZE];
+};
+
+typedef struct {
+    UT_hash_handle  hh;
+    const char      *name;
+    int             calls;
+    double          time;
+    double          avg;
+    double          max;
+    bool            is_counter;
+    double          value; // Last value of a counter.
+} zone_stats_t;
+
+static struct {
+    bool            recording;
+    int             frame;
+    int             nb_threads;
+    thread_t        *threads; // Never released.
+    zone_stats_t    *stats;   // Hash table of zone_stats_t.
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;     // Only to register new threads.
+#endif
+} g_profiler = {
+#ifdef HAVE_PTHREAD
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
+static __thread thread_t *g_thread = NULL;
+
+static uint64_t get_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static thread_t *get_thread(void)
+{
+    thread_t *thread;
+    if (g_thread) return g_thread;
+    thread = calloc(1, sizeof(*thread));
+#ifdef HAVE_PTHREAD
+    pthread_mutex_lock(&g_profiler.lock);
+#endif
+    thread->tid = g_profiler.nb_threads++;
+    if (thread->tid == 0) snprintf(thread->name, sizeof(thread->name), "main");
+    // Push in front, so that readers can iterate the list without lock.
+    thread->next = g_profiler.threads;
+    __atomic_store_n(&g_profiler.threads, thread, __ATOMIC_RELEASE);
+#ifdef HAVE_PTHREAD
+    pthread_mutex_unlock(&g_profiler.lock);
+#endif
+    g_thread = thread;
+    return thread;
+}
+
+static void push_event(thread_t *thread, const event_t *event)
+{
+    thread->ring[thread->head % RING_SIZE] = *event;
+    __atomic_store_n(&thread->head, thread->head + 1, __ATOMIC_RELEASE);
+}
+
+static void flush_pending(thread_t *thread)
+{
+    if (!thread->pending.name) return;
+    push_event(thread, &thread->pending);
+    thread->pending.name = NULL;
+}
+
+profile_zone_t profile_begin(const char *name, int flags)
+{
+    thread_t *thread;
+    if (!__atomic_load_n(&g_profiler.recording, __ATOMIC_RELAXED))
+        return (profile_zone_t){};
+    thread = get_thread();
+    return (profile_zone_t){
+        .name = name,
+        .flags = flags,
+        .depth = thread->depth++,
+        .start = get_time_ns(),
+    };
+}
+
+void profile_end(profile_zone_t *zone)
+{
+    thread_t *thread;
+    event_t *pending;
+    uint64_t end;
+
+    if (!zone->name) return;
+    end = get_time_ns();
+    thread = get_thread();
+    thread->depth = zone->depth;
+    pending = &thread->pending;
+
+    if (    (zone->flags & PROFILE_AGGREGATE) && pending->name &&
+            pending->name == zone->name && pending->depth == zone->depth) {
+        pending->dur = end - pending->start;
+        pending->total += end - zone->start;
+        pending->count++;
+        return;
+    }
+    // Any pending aggregated event is either a child or a previous
+    // sibling of this zone, so it is done.
+    flush_pending(thread);
+    *pending = (event_t){
+        .name = zone->name,
+        .start = zone->start,
+        .dur = end - zone->start,
+        .total = end - zone->start,
+        .count = 1,
+        .depth = zone->depth,
+    };
+    if (!(zone->flags & PROFILE_AGGREGATE)) flush_pending(thread);
+}
+
+void profile_counter(const char *name, double value)
+{
+    thread_t *thread;
+    if (!__atomic_load_n(&g_profiler.recording, __ATOMIC_RELAXED)) return;
+    thread = get_thread();
+    flush_pending(thread);
+    push_event(thread, &(event_t){
+        .name = name,
+        .start = get_time_ns(),
+        .value = value,
+    });
+}
+
+void profile_set_thread_name(const char *name)
+{
+    thread_t *thread = get_thread();
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+int profile_init(void)
+{
+    get_thread(); // Make sure the main thread gets the id 0.
+    return 0;
+}
+
+int profile_release(void)
+{
+    zone_stats_t *stats, *tmp;
+    HASH_ITER(hh, g_profiler.stats, stats, tmp) {
+        HASH_DEL(g_profiler.stats, stats);
+        free(stats);
+    }
+    return 0;
+}
+
+static zone_stats_t *get_stats(const char *name)
+{
+    zone_stats_t *stats;
+    HASH_FIND_PTR(g_profiler.stats, &name, stats);
+    if (stats) return stats;
+    stats = calloc(1, sizeof(*stats));
+    stats->name = name;
+    HASH_ADD_PTR(g_profiler.stats, name, stats);
+    return stats;
+}
+
+// Return the range of available events in a thread ring buffer.
+static void get_ring_range(const thread_t *thread, uint64_t *start,
+                           uint64_t *end)
+{
+    *end = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+    *start = (*end > RING_SIZE) ? *end - RING_SIZE : 0;
+}
+
+void profile_frame(int period)
+{
+    thread_t *thread;
+    zone_stats_t *stats, *tmp;
+    const event_t *event;
+    uint64_t i, start, end;
+    bool was_recording = g_profiler.recording;
+
+    if (was_recording) {
+        flush_pending(get_thread());
+        HASH_ITER(hh, g_profiler.stats, stats, tmp) {
+            stats->calls = 0;
+            stats->time = 0;
+        }
+        thread = __atomic_load_n(&g_profiler.threads, __ATOMIC_ACQUIRE);
+        for (; thread; thread = thread->next) {
+            get_ring_range(thread, &start, &end);
+            for (i = max(start, thread->read_pos); i < end; i++) {
+                event = &thread->ring[i % RING_SIZE];
+                stats = get_stats(event->name);
+                if (!event->count) {
+                    stats->is_counter = true;
+                    stats->value = event->value;
+                    continue;
+                }
+                stats->calls += event->count;
+                stats->time += event->total / 1E6;
+            }
+            thread->read_pos = end;
+        }
+        HASH_ITER(hh, g_profiler.stats, stats, tmp) {
+            stats->avg = stats->avg ? mix(stats->avg, stats->time, 0.1) :
+                                      stats->time;
+            stats->max = max(stats->max, stats->time);
+        }
+    }
+
+    g_profiler.frame++;
+    __atomic_store_n(&g_profiler.recording,
+                     period > 0 && g_profiler.frame % period == 0,
+                     __ATOMIC_RELAXED);
+}
+
+json_value *profile_get_stats(void)
+{
+    json_value *ret, *zone;
+    zone_stats_t *stats, *tmp;
+
+    ret = json_object_new(0);
+    HASH_ITER(hh, g_profiler.stats, stats, tmp) {
+        zone = json_object_push(ret, stats->name, json_object_new(0));
+        if (stats->is_counter) {
+            json_object_push(zone, "value", json_double_new(stats->value));
+            continue;
+        }
+        json_object_push(zone, "calls", json_integer_new(stats->calls));
+        json_object_push(zone, "time", json_double_new(stats->time));
+        json_object_push(zone, "avg", json_double_new(stats->avg));
+        json_object_push(zone, "max", json_double_new(stats->max));
+    }
+    return ret;
+}
+
+static json_value *trace_event(const char *name, const char *ph,
+                               int tid, json_value *args)
+{
+    json_value *ret = json_object_new(0);
+    json_object_push(ret, "name", json_string_new(name));
+    json_object_push(ret, "ph", json_string_new(ph));
+    json_object_push(ret, "pid", json_integer_new(1));
+    json_object_push(ret, "tid", json_integer_new(tid));
+    if (args) json_object_push(ret, "args", args);
+    return ret;
+}
+
+EMSCRIPTEN_KEEPALIVE
+char *profile_get_trace(void)
+{
+    json_value *trace, *events, *event, *args;
+    const thread_t *thread;
+    const event_t *e;
+    uint64_t i, start, end;
+    char *ret;
+
+    trace = json_object_new(0);
+    events = json_object_push(trace, "traceEvents", json_array_new(0));
+    thread = __atomic_load_n(&g_profiler.threads, __ATOMIC_ACQUIRE);
+    for (; thread; thread = thread->next) {
+        args = json_object_new(0);
+        json_object_push(args, "name", json_string_new(
+                    *thread->name ? thread->name : "thread"));
+        json_array_push(events,
+                trace_event("thread_name", "M", thread->tid, args));
+
+        get_ring_range(thread, &start, &end);
+        for (i = start; i < end; i++) {
+            e = &thread->ring[i % RING_SIZE];
+            if (!e->count) {
+                args = json_object_new(0);
+                json_object_push(args, "value", json_double_new(e->value));
+                event = trace_event(e->name, "C", thread->tid, args);
+                json_object_push(event, "ts", json_double_new(e->start / 1E3));
+                json_array_push(events, event);
+                continue;
+            }
+            args = NULL;
+            if (e->count > 1) {
+                args = json_object_new(0);
+                json_object_push(args, "count", json_integer_new(e->count));
+                json_object_push(args, "total_us",
+                                 json_double_new(e->total / 1E3));
+            }
+            event = trace_event(e->name, "X", thread->tid, args);
+            json_object_push(event, "ts", json_double_new(e->start / 1E3));
+            json_object_push(event, "dur", json_double_new(e->dur / 1E3));
+            json_array_push(events, event);
+        }
+    }
+    ret = calloc(1, json_measure(trace));
+    json_serialize(ret, trace);
+    json_builder_free(trace);
+    return ret;
+}
+
+#endif
+
+/******* TESTS **********************************************************/
+
+#if COMPILE_TESTS && !RMT_ENABLED
+
+static void test_profiler(void)
+{
+    json_value *stats;
+    char *trace;
+    int i, j, calls;
+    double time;
+
+    profile_frame(1); // Start recording.
+    for (i = 0; i < 3; i++) {
+        PROFILE(test_outer, 0);
+        for (j = 0; j < 10; j++) {
+            PROFILE(test_inner, PROFILE_AGGREGATE);
+        }
+        profile_counter("test_counter", i);
+    }
+    profile_frame(0); // Aggregate and stop recording.
+
+    stats = profile_get_stats();
+    assert(json_get_attr_f(json_get_attr(stats, "test_counter", json_object),
+                           "value", -1) == 2);
+    calls = json_get_attr_i(json_get_attr(stats, "test_outer", json_object),
+                            "calls", 0);
+    if (calls != 3) {
+        LOG_E("Wrong number of outer calls: %d", calls);
+        assert(false);
+    }
+    calls = json_get_attr_i(json_get_attr(stats, "test_inner", json_object),
+                            "calls", 0);
+    if (calls != 30) {
+        LOG_E("Wrong number of inner calls: %d", calls);
+        assert(false);
+    }
+    time = json_get_attr_f(json_get_attr(stats, "test_outer", json_object),
+                           "time", -1);
+    assert(time >= 0);
+    json_builder_free(stats);
+
+    // Not recording anymore.
+    for (i = 0; i < 3; i++) {
+        PROFILE(test_outer, 0);
+    }
+    profile_frame(0);
+    stats = profile_get_stats();
+    calls = json_get_attr_i(json_get_attr(stats, "test_outer", json_object),
+                            "calls", 0);
+    assert(calls == 3);
+    json_builder_free(stats);
+
+    trace = profile_get_trace();
+    assert(strstr(trace, "\"test_inner\""));
+    free(trace);
+}
 
-int profile_release(void) { return 0; }
+TEST_REGISTER(NULL, test_profiler, TEST_AUTO);
 
 #endif
@@ -9,34 +9,112 @@
 
 /*
  * File: profiler.h
- * Some profiling macros to use remotery:
+ * Profiling macros.
+ *
+ * By default we use a small built-in profiler: each <PROFILE> zone is
+ * recorded into a per-thread ring buffer, and at each frame the recorded
+ * zones are aggregated into per-zone statistics.  The profiler is disabled
+ * by default, and can be turned on for one frame every N frames with the
+ * core 'profiler' attribute, so that it can stay on in production.  The
+ * statistics are readable from the core 'profiler_stats' attribute, and
+ * the recorded zones can be exported as a Chrome trace file (to open
+ * in chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Alternatively we can use remotery:
  * https://github.com/Celtoys/Remotery
  *
  * To use it, compile with 'make remotery', then run the program and
  * launch vis/index.html in remotery sources from the browser.
  */
 
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
 // Disable by default.
 #ifndef RMT_ENABLED
 #define RMT_ENABLED 0
 #endif
 
-int profile_init(void);
-int profile_release(void);
-
-#if RMT_ENABLED
-
-#include "Remotery.h"
-
 /*
  * enum: PROFILE_FLAGS
  * Same meaning as in remotery.
+ *
+ * PROFILE_AGGREGATE - Consecutive calls to the same zone are merged into
+ *                     a single one.  Should be used for small functions
+ *                     called many times per frame.
+ * PROFILE_RECURSIVE - Only used by remotery.
  */
 enum {
     PROFILE_AGGREGATE = 1,
     PROFILE_RECURSIVE = 2,
 };
 
+int profile_init(void);
+int profile_release(void);
+
+/*
+ * Function: profile_frame
+ * Mark the end of a frame.
+ *
+ * Update the zones statistics with the zones recorded since the last
+ * call, and decide if we record the next frame.
+ *
+ * Parameters:
+ *   period - Record one frame every 'period' frames.  Zero to disable the
+ *            profiler.
+ */
+void profile_frame(int period);
+
+/*
+ * Function: profile_counter
+ * Record the value of a counter for the current frame.
+ *
+ * The counters are shown in the stats with a single 'value' attribute, and
+ * as counter events in the traces.  This is used to show the decisions of
+ * the frame governor.
+ *
+ * Parameters:
+ *   name   - Name of the counter.  As for the zones, the string has to
+ *            stay valid.
+ *   value  - Current value.
+ */
+void profile_counter(const char *name, double value);
+
+/*
+ * Function: profile_set_thread_name
+ * Set the name of the current thread, as shown in the exported traces.
+ */
+void profile_set_thread_name(const char *name);
+
+/*
+ * Function: profile_get_stats
+ * Return the per-zone statistics as a json object.
+ *
+ * For each zone name, we have the attributes:
+ *   calls  - Number of calls during the last recorded frame.
+ *   time   - Total time spent during the last recorded frame (ms).
+ *   avg    - Moving average of the time per recorded frame (ms).
+ *   max    - Max time per recorded frame (ms).
+ *
+ * The caller owns the returned value.
+ */
+struct _json_value *profile_get_stats(void);
+
+/*
+ * Function: profile_get_trace
+ * Export the last recorded zones in Chrome trace event json format.
+ *
+ * Return:
+ *   A newly allocated string, that the caller should free.
+ */
+char *profile_get_trace(void);
+
+#if RMT_ENABLED
+
+#include "Remotery.h"
+
 static inline void _profile_cleanup(int *v)
 {
     rmt_EndCPUSample();
@@ -57,6 +135,31 @@ static inline void _profile_cleanup(int *v)
 
 #else
 
-#define PROFILE(name, flags)
+typedef struct profile_zone {
+    const char  *name; // NULL if the profiler was disabled.
+    int         flags;
+    int         depth;
+    uint64_t    start; // Nanoseconds.
+} profile_zone_t;
+
+profile_zone_t profile_begin(const char *name, int flags);
+void profile_end(profile_zone_t *zone);
+
+/*
+ * Macro: PROFILE
+ * Put this at the top of a function to profile it.
+ *
+ * The zone ends when we exit the current scope.
+ *
+ * Parameters:
+ *   name   - the name of the sample.
+ *   flags  - union of <PROFILE_FLAGS> values.
+ */
+#define PROFILE(name, flags) \
+    profile_zone_t _profile __attribute__((__cleanup__(profile_end))) = \
+        profile_begin(#name, flags); \
+    (void)_profile;
 
 #endif
+
+#endif // PROFILER_H
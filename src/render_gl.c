@@ -20,6 +20,10 @@
 #include <float.h>
 
 #define GRID_CACHE_SIZE (2 * (1 << 20))
+#define TEXT_CACHE_SIZE (16 * (1 << 20))
+// Max number of vertices of a mesh item, so that the indices fit in the
+// 16 bits GL indices buffer.
+#define MESH_MAX_VERTS 65535
 
 enum {
     FONT_REGULAR = 0,
@@ -244,6 +248,7 @@ typedef struct renderer_gl {
 
     texture_t   *white_tex;
     tex_cache_t *tex_cache;
+    int64_t     tex_cache_size; // Memory used by the text textures.
     NVGcontext *vg;
 
     // Nanovg fonts references for regular and bold.
@@ -279,6 +284,33 @@ static void window_to_ndc(renderer_gl_t *rend,
     ndc[1] = 1 - (win[1] * rend->scale / rend->fb_size[1]) * 2;
 }
 
+static int64_t text_cache_get_size(void *user)
+{
+    renderer_gl_t *rend = user;
+    return rend->tex_cache_size;
+}
+
+// Release the least recently used text textures, except the ones used by
+// the current frame.  The cache list is kept sorted by last use.
+static int64_t text_cache_evict(void *user, int64_t size)
+{
+    renderer_gl_t *rend = user;
+    tex_cache_t *ctex, *tmp;
+    int64_t freed = 0;
+
+    DL_FOREACH_SAFE(rend->tex_cache, ctex, tmp) {
+        if (freed >= size) break;
+        if (ctex->in_use) continue;
+        freed += sizeof(*ctex) + ctex->tex->mem_size;
+        DL_DELETE(rend->tex_cache, ctex);
+        texture_release(ctex->tex);
+        free(ctex->text);
+        free(ctex);
+    }
+    rend->tex_cache_size -= freed;
+    return freed;
+}
+
 static void prepare(renderer_t *rend_, double win_w, double win_h,
                     double scale, bool cull_flipped)
 {
@@ -292,6 +324,9 @@ static void prepare(renderer_t *rend_, double win_w, double win_h,
 
     DL_FOREACH(rend->tex_cache, ctex)
         ctex->in_use = false;
+    // Keep the texts cache bounded even without global memory limit.
+    if (rend->tex_cache_size > TEXT_CACHE_SIZE)
+        text_cache_evict(rend, rend->tex_cache_size - TEXT_CACHE_SIZE);
 }
 
 /*
@@ -388,8 +423,11 @@ static const double (*get_grid(renderer_gl_t *rend,
 
     *should_delete = !can_cache;
     if (can_cache) {
-        if (!rend->grid_cache)
+        if (!rend->grid_cache) {
             rend->grid_cache = cache_create(GRID_CACHE_SIZE);
+            cache_register_membudget(rend->grid_cache, "grid",
+                                     MEMBUDGET_PRIORITY_LOW);
+        }
         grid = cache_get(rend->grid_cache, &key, sizeof(key));
         if (grid)
             return grid;
@@ -787,6 +825,11 @@ static void text_using_texture(renderer_gl_t *rend,
         ctex->tex = texture_from_data(img, w, h, 1, 0, 0, w, h, 0);
         free(img);
         DL_APPEND(rend->tex_cache, ctex);
+        rend->tex_cache_size += sizeof(*ctex) + ctex->tex->mem_size;
+    } else if (ctex->next) {
+        // Move to the end of the list, so that it gets evicted last.
+        DL_DELETE(rend->tex_cache, ctex);
+        DL_APPEND(rend->tex_cache, ctex);
     }
 
     ctex->in_use = true;
@@ -1547,15 +1590,86 @@ static void mesh(renderer_t          *rend_,
                  int                 verts_count,
                  const double        verts[][3],
                  int                 indices_count,
-                 const uint16_t      indices[])
+                 const uint32_t      indices[]);
+
+/*
+ * The GL indices buffers are 16 bits, so we split the meshes with too many
+ * vertices into several chunks, each one only containing the vertices used
+ * by its primitives.
+ */
+static void mesh_split(renderer_t          *rend_,
+                       const painter_t     *painter,
+                       int                 frame,
+                       int                 mode,
+                       int                 verts_count,
+                       const double        verts[][3],
+                       int                 indices_count,
+                       const uint32_t      indices[])
+{
+    int i, j, n, nb_verts = 0, nb_indices = 0;
+    const int prim_size = (mode == MODE_LINES) ? 2 : 3;
+    int *map; // Index of each vertex in the current chunk, or -1.
+    int *used; // Vertices of the current chunk.
+    double (*chunk_verts)[3];
+    uint32_t *chunk_indices;
+
+    map = malloc(verts_count * sizeof(*map));
+    memset(map, -1, verts_count * sizeof(*map));
+    used = malloc(MESH_MAX_VERTS * sizeof(*used));
+    chunk_verts = malloc(MESH_MAX_VERTS * sizeof(*chunk_verts));
+    chunk_indices = malloc(indices_count * sizeof(*chunk_indices));
+
+    for (i = 0; i < indices_count; i += prim_size) {
+        if (nb_verts + prim_size > MESH_MAX_VERTS) {
+            mesh(rend_, painter, frame, mode, nb_verts,
+                 (const double (*)[3])chunk_verts, nb_indices, chunk_indices);
+            for (j = 0; j < nb_verts; j++) map[used[j]] = -1;
+            nb_verts = nb_indices = 0;
+        }
+        for (j = 0; j < prim_size; j++) {
+            n = indices[i + j];
+            if (map[n] == -1) {
+                map[n] = nb_verts;
+                used[nb_verts] = n;
+                vec3_copy(verts[n], chunk_verts[nb_verts]);
+                nb_verts++;
+            }
+            chunk_indices[nb_indices++] = map[n];
+        }
+    }
+    if (nb_indices) {
+        mesh(rend_, painter, frame, mode, nb_verts,
+             (const double (*)[3])chunk_verts, nb_indices, chunk_indices);
+    }
+    free(map);
+    free(used);
+    free(chunk_verts);
+    free(chunk_indices);
+}
+
+static void mesh(renderer_t          *rend_,
+                 const painter_t     *painter,
+                 int                 frame,
+                 int                 mode,
+                 int                 verts_count,
+                 const double        verts[][3],
+                 int                 indices_count,
+                 const uint32_t      indices[])
 {
     int i, ofs;
     double pos[4] = {};
     double rot[3][3];
+    double (*view)[3];
     float color[4];
     item_t *item;
     renderer_gl_t *rend = (void*)rend_;
 
+    if (verts_count > MESH_MAX_VERTS) {
+        mesh_split(rend_, painter, frame, mode, verts_count, verts,
+                   indices_count, indices);
+        return;
+    }
+
     vec4_to_float(painter->color, color);
 
     item = get_item(rend, ITEM_MESH, verts_count, indices_count, NULL);
@@ -1590,16 +1704,19 @@ static void mesh(renderer_t          *rend_,
             gl_buf_next(&item->buf);
         }
     } else {
+        view = malloc(verts_count * sizeof(*view));
+        for (i = 0; i < verts_count; i++)
+            vec3_normalize(verts[i], view[i]);
+        convert_frame_batch(painter->obs, frame, FRAME_VIEW, true,
+                            verts_count, view, view);
         for (i = 0; i < verts_count; i++) {
-            vec3_copy(verts[i], pos);
-            pos[3] = 0.0;
-            vec3_normalize(pos, pos);
-            convert_frame(painter->obs, frame, FRAME_VIEW, true, pos, pos);
+            vec3_copy(view[i], pos);
             pos[3] = 0.0;
             project(painter->proj, PROJ_ALREADY_NORMALIZED, pos, pos);
             gl_buf_4f(&item->buf, -1, ATTR_POS, VEC4_SPLIT(pos));
             gl_buf_next(&item->buf);
         }
+        free(view);
     }
 
     // Fill the indice buffer.
@@ -1722,6 +1839,9 @@ renderer_t* render_gl_create(void)
     if (!sys_callbacks.render_text)
         set_default_fonts(rend);
 
+    membudget_register("text", MEMBUDGET_PRIORITY_NORMAL, rend,
+                       text_cache_get_size, text_cache_evict);
+
     // Query the point size range.
     GL(glGetIntegerv(GL_ALIASED_POINT_SIZE_RANGE, range));
     if (range[1] < 32)
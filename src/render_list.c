@@ -0,0 +1,467 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+#ifdef HAVE_PTHREAD
+#   include <pthread.h>
+#endif
+
+/*
+ * Renderer that records all the calls into an in-memory command list, that
+ * can then be submitted to an other renderer.
+ *
+ * Contrary to the recording renderer, the commands keep the pointers to
+ * the textures and to the painter callbacks, so a list is only valid
+ * during the frame it has been recorded in.  The arrays passed to the
+ * methods are copied, as well as the data pointed by the painter, since
+ * they often live on the caller stack.
+ *
+ * For the quads, we store the grid of mapped vertices instead of the uv
+ * map, and submit them with a map that interpolates the grid.
+ */
+
+// Call a renderer method only if it is set.
+#define REND(rend, f, ...) do { \
+        if ((rend)->f) (rend)->f((rend), ##__VA_ARGS__); \
+    } while (0)
+
+typedef struct {
+    int         op;
+    painter_t   painter;
+    // Copies of the data pointed by the painter.
+    double      depth_range[2];
+    double      sun[4];
+    double      light_emit[3];
+    double      (*shadow_spheres)[4];
+
+    int         frame;
+    int         mode;
+    int         n;
+    int         n2;
+    int         align;
+    int         effects;
+    double      pos[2];
+    double      size[2];
+    double      p2[2];
+    double      color[4];
+    double      uv[4][2];
+    double      scale;
+    double      angle;
+    double      nb_dashes;
+    texture_t   *tex;
+    void        *data;
+    void        *data2;
+} cmd_t;
+
+typedef struct {
+    renderer_t  rend;
+    renderer_t  *measure;
+    int         nb;
+    int         size;
+    cmd_t       *cmds;
+} renderer_list_t;
+
+// Grid of vertices used to submit the quads.
+typedef struct {
+    int             size;
+    const double    (*verts)[4];
+} list_grid_t;
+
+#ifdef HAVE_PTHREAD
+// Protect the calls to the measure renderers, since the lists can be
+// filled from several threads at the same time.
+static pthread_mutex_t g_measure_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void *copy_array(const void *data, int n, int size)
+{
+    void *ret;
+    if (!data || n <= 0) return NULL;
+    ret = malloc(n * size);
+    memcpy(ret, data, n * size);
+    return ret;
+}
+
+static void retain_texture(texture_t *tex)
+{
+    if (tex) __atomic_add_fetch(&tex->ref, 1, __ATOMIC_RELAXED);
+}
+
+// Add a new command, with a copy of the painter if given.
+static cmd_t *add_cmd(renderer_list_t *list, int op, const painter_t *painter)
+{
+    cmd_t *cmd;
+    const painter_t *p = painter;
+    int i;
+
+    if (list->nb >= list->size) {
+        list->size = max(64, list->size * 2);
+        list->cmds = realloc(list->cmds, list->size * sizeof(*list->cmds));
+    }
+    cmd = &list->cmds[list->nb++];
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->op = op;
+    if (!painter) return cmd;
+
+    cmd->painter = *painter;
+    if (p->depth_range) vec2_copy(*p->depth_range, cmd->depth_range);
+    for (i = 0; i < ARRAY_SIZE(p->textures); i++)
+        retain_texture(p->textures[i].tex);
+    if (!(p->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER)))
+        return cmd;
+    if (p->planet.sun) vec4_copy(*p->planet.sun, cmd->sun);
+    if (p->planet.light_emit) vec3_copy(*p->planet.light_emit, cmd->light_emit);
+    cmd->shadow_spheres = copy_array(p->planet.shadow_spheres,
+                                     p->planet.shadow_spheres_nb,
+                                     sizeof(*p->planet.shadow_spheres));
+    retain_texture(p->planet.shadow_color_tex);
+    return cmd;
+}
+
+// Restore the painter of a command, pointing to the command copies.
+static void get_painter(cmd_t *cmd, renderer_t *rend, painter_t *painter)
+{
+    const painter_t *p = &cmd->painter;
+    *painter = *p;
+    painter->rend = rend;
+    if (p->depth_range) painter->depth_range = &cmd->depth_range;
+    if (!(p->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER)))
+        return;
+    if (p->planet.sun) painter->planet.sun = &cmd->sun;
+    if (p->planet.light_emit) painter->planet.light_emit = &cmd->light_emit;
+    painter->planet.shadow_spheres = cmd->shadow_spheres;
+}
+
+static void release_cmd(cmd_t *cmd)
+{
+    const painter_t *p = &cmd->painter;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(p->textures); i++)
+        texture_release(p->textures[i].tex);
+    if (p->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER))
+        texture_release(p->planet.shadow_color_tex);
+    texture_release(cmd->tex);
+    free(cmd->shadow_spheres);
+    free(cmd->data);
+    free(cmd->data2);
+}
+
+static void points_2d(renderer_t *rend, const painter_t *painter,
+                      int n, const point_t *points)
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_POINTS_2D, painter);
+    cmd->n = n;
+    cmd->data = copy_array(points, n, sizeof(*points));
+}
+
+static void add_quad(renderer_t *rend, int op, const painter_t *painter,
+                     int frame, int grid_size, const uv_map_t *map)
+{
+    cmd_t *cmd = add_cmd((void*)rend, op, painter);
+    cmd->frame = frame;
+    cmd->n = grid_size;
+    cmd->data = malloc((grid_size + 1) * (grid_size + 1) * sizeof(double[4]));
+    uv_map_grid(map, grid_size, cmd->data, NULL);
+}
+
+static void quad(renderer_t *rend, const painter_t *painter,
+                 int frame, int grid_size, const uv_map_t *map)
+{
+    add_quad(rend, RENDER_OP_QUAD, painter, frame, grid_size, map);
+}
+
+static void quad_wireframe(renderer_t *rend, const painter_t *painter,
+                           int frame, int grid_size, const uv_map_t *map)
+{
+    add_quad(rend, RENDER_OP_QUAD_WIREFRAME, painter, frame, grid_size, map);
+}
+
+static void texture(renderer_t *rend, const texture_t *tex,
+                    double uv[4][2], const double pos[2], double size,
+                    const double color[4], double angle)
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_TEXTURE, NULL);
+    cmd->tex = (texture_t*)tex;
+    retain_texture(cmd->tex);
+    memcpy(cmd->uv, uv, sizeof(cmd->uv));
+    vec2_copy(pos, cmd->pos);
+    cmd->scale = size;
+    vec4_copy(color, cmd->color);
+    cmd->angle = angle;
+}
+
+static void text(renderer_t *rend, const char *text, const double pos[2],
+                 int align, int effects, double size, const double color[4],
+                 double angle, double bounds[4])
+{
+    renderer_list_t *list = (void*)rend;
+    cmd_t *cmd;
+
+    // The bounds are computed right away by the measure renderer.
+    if (bounds) {
+#ifdef HAVE_PTHREAD
+        pthread_mutex_lock(&g_measure_lock);
+#endif
+        REND(list->measure, text, text, pos, align, effects, size, NULL,
+             angle, bounds);
+#ifdef HAVE_PTHREAD
+        pthread_mutex_unlock(&g_measure_lock);
+#endif
+    }
+    if (!color) return;
+    cmd = add_cmd(list, RENDER_OP_TEXT, NULL);
+    cmd->data = strdup(text);
+    vec2_copy(pos, cmd->pos);
+    cmd->align = align;
+    cmd->effects = effects;
+    cmd->scale = size;
+    vec4_copy(color, cmd->color);
+    cmd->angle = angle;
+}
+
+static void line(renderer_t *rend, const painter_t *painter,
+                 const double (*line)[3], int size)
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_LINE, painter);
+    cmd->n = size;
+    cmd->data = copy_array(line, size, sizeof(*line));
+}
+
+static void mesh(renderer_t *rend, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint32_t indices[])
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_MESH, painter);
+    cmd->frame = frame;
+    cmd->mode = mode;
+    cmd->n = verts_count;
+    cmd->data = copy_array(verts, verts_count, sizeof(*verts));
+    cmd->n2 = indices_count;
+    cmd->data2 = copy_array(indices, indices_count, sizeof(*indices));
+}
+
+static void ellipse_2d(renderer_t *rend, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double nb_dashes)
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_ELLIPSE_2D, painter);
+    vec2_copy(pos, cmd->pos);
+    vec2_copy(size, cmd->size);
+    cmd->angle = angle;
+    cmd->nb_dashes = nb_dashes;
+}
+
+static void rect_2d(renderer_t *rend, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_RECT_2D, painter);
+    vec2_copy(pos, cmd->pos);
+    vec2_copy(size, cmd->size);
+    cmd->angle = angle;
+}
+
+static void line_2d(renderer_t *rend, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    cmd_t *cmd = add_cmd((void*)rend, RENDER_OP_LINE_2D, painter);
+    vec2_copy(p1, cmd->pos);
+    vec2_copy(p2, cmd->p2);
+}
+
+renderer_t *render_list_create(renderer_t *measure)
+{
+    renderer_list_t *list;
+    assert(measure);
+    list = calloc(1, sizeof(*list));
+    list->measure = measure;
+    list->rend.points_2d = points_2d;
+    list->rend.quad = quad;
+    list->rend.quad_wireframe = quad_wireframe;
+    list->rend.texture = texture;
+    list->rend.text = text;
+    list->rend.line = line;
+    list->rend.mesh = mesh;
+    list->rend.ellipse_2d = ellipse_2d;
+    list->rend.rect_2d = rect_2d;
+    list->rend.line_2d = line_2d;
+    return &list->rend;
+}
+
+void render_list_clear(renderer_t *rend)
+{
+    renderer_list_t *list = (void*)rend;
+    int i;
+    for (i = 0; i < list->nb; i++)
+        release_cmd(&list->cmds[i]);
+    list->nb = 0;
+}
+
+void render_list_release(renderer_t *rend)
+{
+    renderer_list_t *list = (void*)rend;
+    if (!rend) return;
+    render_list_clear(rend);
+    free(list->cmds);
+    free(list);
+}
+
+static void grid_map(const uv_map_t *map, const double v[2], double out[4])
+{
+    const list_grid_t *grid = map->user;
+    const int n = grid->size;
+    const double (*g)[4] = grid->verts;
+    double x, y, a[4], b[4];
+    int i, j;
+
+    x = v[0] * n;
+    y = v[1] * n;
+    j = clamp((int)floor(x), 0, n - 1);
+    i = clamp((int)floor(y), 0, n - 1);
+    x -= j;
+    y -= i;
+    vec4_mix(g[i * (n + 1) + j], g[i * (n + 1) + j + 1], x, a);
+    vec4_mix(g[(i + 1) * (n + 1) + j], g[(i + 1) * (n + 1) + j + 1], x, b);
+    vec4_mix(a, b, y, out);
+}
+
+static void submit_cmd(cmd_t *cmd, renderer_t *rend)
+{
+    painter_t painter;
+    list_grid_t grid;
+    uv_map_t map = {
+        .map = grid_map,
+        .user = &grid,
+    };
+
+    get_painter(cmd, rend, &painter);
+    switch (cmd->op) {
+    case RENDER_OP_POINTS_2D:
+        REND(rend, points_2d, &painter, cmd->n, cmd->data);
+        break;
+    case RENDER_OP_QUAD:
+    case RENDER_OP_QUAD_WIREFRAME:
+        grid.size = cmd->n;
+        grid.verts = cmd->data;
+        if (cmd->op == RENDER_OP_QUAD)
+            REND(rend, quad, &painter, cmd->frame, cmd->n, &map);
+        else
+            REND(rend, quad_wireframe, &painter, cmd->frame, cmd->n, &map);
+        break;
+    case RENDER_OP_TEXTURE:
+        REND(rend, texture, cmd->tex, cmd->uv, cmd->pos, cmd->scale,
+             cmd->color, cmd->angle);
+        break;
+    case RENDER_OP_TEXT:
+        REND(rend, text, cmd->data, cmd->pos, cmd->align, cmd->effects,
+             cmd->scale, cmd->color, cmd->angle, NULL);
+        break;
+    case RENDER_OP_LINE:
+        REND(rend, line, &painter, cmd->data, cmd->n);
+        break;
+    case RENDER_OP_MESH:
+        REND(rend, mesh, &painter, cmd->frame, cmd->mode, cmd->n, cmd->data,
+             cmd->n2, cmd->data2);
+        break;
+    case RENDER_OP_ELLIPSE_2D:
+        REND(rend, ellipse_2d, &painter, cmd->pos, cmd->size, cmd->angle,
+             cmd->nb_dashes);
+        break;
+    case RENDER_OP_RECT_2D:
+        REND(rend, rect_2d, &painter, cmd->pos, cmd->size, cmd->angle);
+        break;
+    case RENDER_OP_LINE_2D:
+        REND(rend, line_2d, &painter, cmd->pos, cmd->p2);
+        break;
+    default:
+        assert(false);
+    }
+}
+
+int render_list_submit(renderer_t *rend_list, renderer_t *rend)
+{
+    renderer_list_t *list = (void*)rend_list;
+    int i;
+    for (i = 0; i < list->nb; i++)
+        submit_cmd(&list->cmds[i], rend);
+    return list->nb;
+}
+
+/******* TESTS **********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_render(renderer_t *rend, const uv_map_t *map)
+{
+    painter_t painter;
+    projection_t proj;
+    const double color[4] = {1, 1, 1, 1};
+    const point_t points[2] = {{.pos = {10, 20}, .size = 2},
+                               {.pos = {30, 40}, .size = 3}};
+    double line[2][4] = {{1, 0, 0, 1}, {0, 1, 0, 1}};
+    double bounds[4];
+
+    core_get_proj(&proj);
+    painter = (painter_t) {
+        .rend = rend,
+        .obs = core->observer,
+        .proj = &proj,
+        .fb_size = {400, 300},
+        .pixel_scale = 1,
+        .color = {1, 1, 1, 1},
+        .contrast = 1,
+        .lines.width = 1,
+    };
+    paint_2d_points(&painter, 2, points);
+    paint_quad(&painter, FRAME_ICRF, map, 4);
+    paint_text_bounds(&painter, "test", points[0].pos, 0, 0, 12, bounds);
+    paint_text(&painter, "test", points[0].pos, 0, 0, 12, color, 0);
+    paint_line(&painter, FRAME_ICRF, line, NULL, 8,
+               PAINTER_SKIP_DISCONTINUOUS);
+    paint_2d_line(&painter, NULL, points[0].pos, points[1].pos);
+}
+
+static void test_render_list(void)
+{
+    renderer_t *direct, *submitted, *list;
+    render_stats_t stats, list_stats;
+    uv_map_t map;
+
+    uv_map_init_healpix(&map, 1, 3, false, true);
+    direct = render_null_create();
+    submitted = render_null_create();
+    list = render_list_create(submitted);
+
+    test_render(direct, &map);
+    test_render(list, &map);
+    render_null_get_stats(submitted, &list_stats);
+    // Nothing is rendered until we submit the list.
+    assert(list_stats.ops[RENDER_OP_TEXT].calls == 0);
+    assert(list_stats.ops[RENDER_OP_LINE].calls == 0);
+
+    render_list_submit(list, submitted);
+    render_list_clear(list);
+    assert(render_list_submit(list, submitted) == 0);
+    render_null_get_stats(direct, &stats);
+    render_null_get_stats(submitted, &list_stats);
+    if (memcmp(&stats, &list_stats, sizeof(stats)) != 0) {
+        LOG_E("Submitted list stats don't match the direct rendering");
+        assert(false);
+    }
+    render_list_release(list);
+    render_null_release(direct);
+    render_null_release(submitted);
+}
+
+TEST_REGISTER(NULL, test_render_list, TEST_AUTO);
+
+#endif
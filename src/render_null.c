@@ -0,0 +1,176 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+// Renderer that doesn't draw anything, but counts the calls.
+// Used to run the core without a GPU, for example for benchmarks.
+
+typedef struct {
+    renderer_t      rend;
+    render_stats_t  stats;
+} renderer_null_t;
+
+static void count(renderer_t *rend_, const painter_t *painter, int op,
+                  int vertices)
+{
+    renderer_null_t *rend = (void*)rend_;
+    int i;
+    rend->stats.ops[op].calls++;
+    rend->stats.ops[op].vertices += vertices;
+    if (!painter) return;
+    for (i = 0; i < ARRAY_SIZE(painter->textures); i++) {
+        if (painter->textures[i].tex) rend->stats.ops[op].textures++;
+    }
+}
+
+static void prepare(renderer_t *rend_, double win_w, double win_h,
+                    double scale, bool cull_flipped)
+{
+    renderer_null_t *rend = (void*)rend_;
+    count(rend_, NULL, RENDER_OP_PREPARE, 0);
+    rend->stats.frames++;
+}
+
+static void finish(renderer_t *rend)
+{
+    count(rend, NULL, RENDER_OP_FINISH, 0);
+}
+
+static void points_2d(renderer_t *rend, const painter_t *painter,
+                      int n, const point_t *points)
+{
+    count(rend, painter, RENDER_OP_POINTS_2D, n);
+}
+
+static void quad(renderer_t *rend, const painter_t *painter,
+                 int frame, int grid_size, const uv_map_t *map)
+{
+    count(rend, painter, RENDER_OP_QUAD,
+          (grid_size + 1) * (grid_size + 1));
+}
+
+static void quad_wireframe(renderer_t *rend, const painter_t *painter,
+                           int frame, int grid_size, const uv_map_t *map)
+{
+    count(rend, painter, RENDER_OP_QUAD_WIREFRAME,
+          (grid_size + 1) * (grid_size + 1));
+}
+
+static void texture(renderer_t *rend_, const texture_t *tex,
+                    double uv[4][2], const double pos[2], double size,
+                    const double color[4], double angle)
+{
+    renderer_null_t *rend = (void*)rend_;
+    count(rend_, NULL, RENDER_OP_TEXTURE, 4);
+    rend->stats.ops[RENDER_OP_TEXTURE].textures++;
+}
+
+static void text(renderer_t *rend, const char *text, const double pos[2],
+                 int align, int effects, double size, const double color[4],
+                 double angle, double bounds[4])
+{
+    double w, h;
+    if (color) count(rend, NULL, RENDER_OP_TEXT, u8_len(text));
+    if (!bounds) return;
+    // Rough estimation of the text size, so that the labels layout still
+    // works.
+    w = u8_len(text) * size * 0.6;
+    h = size;
+    bounds[0] = pos[0];
+    bounds[1] = pos[1] - h;
+    if (align & ALIGN_CENTER) bounds[0] -= w / 2;
+    if (align & ALIGN_RIGHT) bounds[0] -= w;
+    if (align & ALIGN_MIDDLE) bounds[1] += h / 2;
+    if (align & ALIGN_TOP) bounds[1] += h;
+    bounds[2] = bounds[0] + w;
+    bounds[3] = bounds[1] + h;
+}
+
+static void line(renderer_t *rend, const painter_t *painter,
+                 const double (*line)[3], int size)
+{
+    count(rend, painter, RENDER_OP_LINE, size);
+}
+
+static void mesh(renderer_t *rend, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint32_t indices[])
+{
+    count(rend, painter, RENDER_OP_MESH, verts_count);
+}
+
+static void ellipse_2d(renderer_t *rend, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double nb_dashes)
+{
+    count(rend, painter, RENDER_OP_ELLIPSE_2D, 0);
+}
+
+static void rect_2d(renderer_t *rend, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    count(rend, painter, RENDER_OP_RECT_2D, 4);
+}
+
+static void line_2d(renderer_t *rend, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    count(rend, painter, RENDER_OP_LINE_2D, 2);
+}
+
+renderer_t *render_null_create(void)
+{
+    renderer_null_t *rend = calloc(1, sizeof(*rend));
+    rend->rend.prepare = prepare;
+    rend->rend.finish = finish;
+    rend->rend.points_2d = points_2d;
+    rend->rend.quad = quad;
+    rend->rend.quad_wireframe = quad_wireframe;
+    rend->rend.texture = texture;
+    rend->rend.text = text;
+    rend->rend.line = line;
+    rend->rend.mesh = mesh;
+    rend->rend.ellipse_2d = ellipse_2d;
+    rend->rend.rect_2d = rect_2d;
+    rend->rend.line_2d = line_2d;
+    return &rend->rend;
+}
+
+void render_null_release(renderer_t *rend)
+{
+    free(rend);
+}
+
+void render_null_get_stats(const renderer_t *rend, render_stats_t *stats)
+{
+    *stats = ((const renderer_null_t*)rend)->stats;
+}
+
+const char *render_op_get_name(int op)
+{
+    const char *names[RENDER_OP_COUNT] = {
+        [RENDER_OP_PREPARE]         = "prepare",
+        [RENDER_OP_FINISH]          = "finish",
+        [RENDER_OP_POINTS_2D]       = "points_2d",
+        [RENDER_OP_QUAD]            = "quad",
+        [RENDER_OP_QUAD_WIREFRAME]  = "quad_wireframe",
+        [RENDER_OP_TEXTURE]         = "texture",
+        [RENDER_OP_TEXT]            = "text",
+        [RENDER_OP_LINE]            = "line",
+        [RENDER_OP_MESH]            = "mesh",
+        [RENDER_OP_ELLIPSE_2D]      = "ellipse_2d",
+        [RENDER_OP_RECT_2D]         = "rect_2d",
+        [RENDER_OP_LINE_2D]         = "line_2d",
+    };
+    if (op <= 0 || op >= RENDER_OP_COUNT) return NULL;
+    return names[op];
+}
@@ -0,0 +1,754 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+/*
+ * Renderer that records all the calls into a binary command log, and the
+ * function to replay the log into an other renderer.
+ *
+ * The log is a header followed by a list of commands.  Each command starts
+ * with an int32 <RENDER_OP> value, followed by the painter (if the method
+ * takes one) and the arguments.  The structures are stored in their raw
+ * binary form, so a log can only be replayed by the same build.
+ *
+ * Since the observer and projection are mostly constant during a frame, we
+ * only store them with a special OP_STATE command when they change.
+ *
+ * For the quads, we store the grid of mapped vertices instead of the uv
+ * map, and replay them with a map that interpolates the grid.
+ */
+
+#define MAGIC "SWEREC02"
+
+enum {
+    OP_STATE = RENDER_OP_COUNT,
+};
+
+// Call a renderer method only if it is set.
+#define REND(rend, f, ...) do { \
+        if ((rend)->f) (rend)->f((rend), ##__VA_ARGS__); \
+    } while (0)
+
+typedef struct {
+    renderer_t      rend;
+    renderer_t      *next;
+    FILE            *out;
+    bool            has_state;
+    uint64_t        obs_hash;   // Hash of the last written observer.
+    projection_t    proj;       // Last written projection.
+} renderer_record_t;
+
+// Sizes of the raw structures, to check that a log comes from the same
+// build.
+typedef struct {
+    char        magic[8];
+    int32_t     painter_size;
+    int32_t     observer_size;
+    int32_t     projection_size;
+    int32_t     point_size;
+} header_t;
+
+static const header_t HEADER = {
+    .magic = MAGIC,
+    .painter_size = sizeof(painter_t),
+    .observer_size = sizeof(observer_t),
+    .projection_size = sizeof(projection_t),
+    .point_size = sizeof(point_t),
+};
+
+static void write_data(renderer_record_t *rec, const void *data, int size)
+{
+    if (size) fwrite(data, size, 1, rec->out);
+}
+
+static void write_int(renderer_record_t *rec, int v)
+{
+    int32_t i = v;
+    write_data(rec, &i, sizeof(i));
+}
+
+static void write_double(renderer_record_t *rec, double v)
+{
+    write_data(rec, &v, sizeof(v));
+}
+
+static void write_texture(renderer_record_t *rec, const texture_t *tex)
+{
+    write_int(rec, tex ? tex->id : 0);
+    write_int(rec, tex ? tex->w : 0);
+    write_int(rec, tex ? tex->h : 0);
+}
+
+static void write_painter(renderer_record_t *rec, const painter_t *painter)
+{
+    int i;
+
+    write_data(rec, painter, sizeof(*painter));
+    write_int(rec, painter->depth_range != NULL);
+    if (painter->depth_range)
+        write_data(rec, *painter->depth_range, sizeof(double[2]));
+    for (i = 0; i < ARRAY_SIZE(painter->textures); i++)
+        write_texture(rec, painter->textures[i].tex);
+
+    if (!(painter->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER)))
+        return;
+    write_int(rec, painter->planet.sun != NULL);
+    if (painter->planet.sun)
+        write_data(rec, *painter->planet.sun, sizeof(double[4]));
+    write_int(rec, painter->planet.light_emit != NULL);
+    if (painter->planet.light_emit)
+        write_data(rec, *painter->planet.light_emit, sizeof(double[3]));
+    write_data(rec, painter->planet.shadow_spheres,
+               painter->planet.shadow_spheres_nb * sizeof(double[4]));
+    write_texture(rec, painter->planet.shadow_color_tex);
+}
+
+// Start a new command.
+static void begin(renderer_record_t *rec, int op, const painter_t *painter)
+{
+    if (painter && (!rec->has_state ||
+                    painter->obs->hash != rec->obs_hash ||
+                    memcmp(painter->proj, &rec->proj, sizeof(rec->proj)))) {
+        rec->obs_hash = painter->obs->hash;
+        rec->proj = *painter->proj;
+        rec->has_state = true;
+        write_int(rec, OP_STATE);
+        write_data(rec, painter->obs, sizeof(*painter->obs));
+        write_data(rec, &rec->proj, sizeof(rec->proj));
+    }
+    write_int(rec, op);
+    if (painter) write_painter(rec, painter);
+}
+
+static void prepare(renderer_t *rend, double win_w, double win_h,
+                    double scale, bool cull_flipped)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_PREPARE, NULL);
+    write_double(rec, win_w);
+    write_double(rec, win_h);
+    write_double(rec, scale);
+    write_int(rec, cull_flipped);
+    REND(rec->next, prepare, win_w, win_h, scale, cull_flipped);
+}
+
+static void finish(renderer_t *rend)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_FINISH, NULL);
+    REND(rec->next, finish);
+}
+
+static void points_2d(renderer_t *rend, const painter_t *painter,
+                      int n, const point_t *points)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_POINTS_2D, painter);
+    write_int(rec, n);
+    write_data(rec, points, n * sizeof(*points));
+    REND(rec->next, points_2d, painter, n, points);
+}
+
+static void write_quad(renderer_record_t *rec, int op,
+                       const painter_t *painter, int frame, int grid_size,
+                       const uv_map_t *map)
+{
+    double (*grid)[4];
+    int n = (grid_size + 1) * (grid_size + 1);
+
+    grid = malloc(n * sizeof(*grid));
+    uv_map_grid(map, grid_size, grid, NULL);
+    begin(rec, op, painter);
+    write_int(rec, frame);
+    write_int(rec, grid_size);
+    write_data(rec, grid, n * sizeof(*grid));
+    free(grid);
+}
+
+static void quad(renderer_t *rend, const painter_t *painter,
+                 int frame, int grid_size, const uv_map_t *map)
+{
+    renderer_record_t *rec = (void*)rend;
+    write_quad(rec, RENDER_OP_QUAD, painter, frame, grid_size, map);
+    REND(rec->next, quad, painter, frame, grid_size, map);
+}
+
+static void quad_wireframe(renderer_t *rend, const painter_t *painter,
+                           int frame, int grid_size, const uv_map_t *map)
+{
+    renderer_record_t *rec = (void*)rend;
+    write_quad(rec, RENDER_OP_QUAD_WIREFRAME, painter, frame, grid_size,
+               map);
+    REND(rec->next, quad_wireframe, painter, frame, grid_size, map);
+}
+
+static void texture(renderer_t *rend, const texture_t *tex,
+                    double uv[4][2], const double pos[2], double size,
+                    const double color[4], double angle)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_TEXTURE, NULL);
+    write_texture(rec, tex);
+    write_data(rec, uv, sizeof(double[4][2]));
+    write_data(rec, pos, sizeof(double[2]));
+    write_double(rec, size);
+    write_data(rec, color, sizeof(double[4]));
+    write_double(rec, angle);
+    REND(rec->next, texture, tex, uv, pos, size, color, angle);
+}
+
+static void text(renderer_t *rend, const char *text, const double pos[2],
+                 int align, int effects, double size, const double color[4],
+                 double angle, double bounds[4])
+{
+    renderer_record_t *rec = (void*)rend;
+    int len;
+    // Calls without color only compute the bounds.
+    if (color) {
+        len = strlen(text);
+        begin(rec, RENDER_OP_TEXT, NULL);
+        write_int(rec, len);
+        write_data(rec, text, len);
+        write_data(rec, pos, sizeof(double[2]));
+        write_int(rec, align);
+        write_int(rec, effects);
+        write_double(rec, size);
+        write_data(rec, color, sizeof(double[4]));
+        write_double(rec, angle);
+    }
+    REND(rec->next, text, text, pos, align, effects, size, color, angle,
+         bounds);
+}
+
+static void line(renderer_t *rend, const painter_t *painter,
+                 const double (*line)[3], int size)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_LINE, painter);
+    write_int(rec, size);
+    write_data(rec, line, size * sizeof(*line));
+    REND(rec->next, line, painter, line, size);
+}
+
+static void mesh(renderer_t *rend, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint32_t indices[])
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_MESH, painter);
+    write_int(rec, frame);
+    write_int(rec, mode);
+    write_int(rec, verts_count);
+    write_data(rec, verts, verts_count * sizeof(*verts));
+    write_int(rec, indices_count);
+    write_data(rec, indices, indices_count * sizeof(*indices));
+    REND(rec->next, mesh, painter, frame, mode, verts_count, verts,
+         indices_count, indices);
+}
+
+static void ellipse_2d(renderer_t *rend, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double nb_dashes)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_ELLIPSE_2D, painter);
+    write_data(rec, pos, sizeof(double[2]));
+    write_data(rec, size, sizeof(double[2]));
+    write_double(rec, angle);
+    write_double(rec, nb_dashes);
+    REND(rec->next, ellipse_2d, painter, pos, size, angle, nb_dashes);
+}
+
+static void rect_2d(renderer_t *rend, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_RECT_2D, painter);
+    write_data(rec, pos, sizeof(double[2]));
+    write_data(rec, size, sizeof(double[2]));
+    write_double(rec, angle);
+    REND(rec->next, rect_2d, painter, pos, size, angle);
+}
+
+static void line_2d(renderer_t *rend, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    renderer_record_t *rec = (void*)rend;
+    begin(rec, RENDER_OP_LINE_2D, painter);
+    write_data(rec, p1, sizeof(double[2]));
+    write_data(rec, p2, sizeof(double[2]));
+    REND(rec->next, line_2d, painter, p1, p2);
+}
+
+renderer_t *render_record_create(const char *path, renderer_t *next)
+{
+    renderer_record_t *rec;
+    FILE *out;
+
+    assert(next);
+    out = fopen(path, "wb");
+    if (!out) {
+        LOG_E("Cannot open %s", path);
+        return NULL;
+    }
+    rec = calloc(1, sizeof(*rec));
+    rec->out = out;
+    rec->next = next;
+    write_data(rec, &HEADER, sizeof(HEADER));
+
+    rec->rend.prepare = prepare;
+    rec->rend.finish = finish;
+    rec->rend.points_2d = points_2d;
+    rec->rend.quad = quad;
+    rec->rend.quad_wireframe = quad_wireframe;
+    rec->rend.texture = texture;
+    rec->rend.text = text;
+    rec->rend.line = line;
+    rec->rend.mesh = mesh;
+    rec->rend.ellipse_2d = ellipse_2d;
+    rec->rend.rect_2d = rect_2d;
+    rec->rend.line_2d = line_2d;
+    return &rec->rend;
+}
+
+void render_record_release(renderer_t *rend)
+{
+    renderer_record_t *rec = (void*)rend;
+    if (!rend) return;
+    fclose(rec->out);
+    free(rec);
+}
+
+/******** Replay *********************************************************/
+
+typedef struct {
+    UT_hash_handle  hh;
+    uint32_t        id;
+    texture_t       *tex;
+} replay_texture_t;
+
+typedef struct {
+    FILE            *in;
+    bool            error;
+    renderer_t      *rend;
+    observer_t      obs;
+    projection_t    proj;
+    // Storage for the data pointed by the painter.
+    double          depth_range[2];
+    double          sun[4];
+    double          light_emit[3];
+    double          (*shadow_spheres)[4];
+    replay_texture_t *textures; // Hash table of id -> texture.
+} replay_t;
+
+// Grid of vertices used to replay the quads.
+typedef struct {
+    int             size;
+    double          (*verts)[4];
+} replay_grid_t;
+
+static void read_data(replay_t *r, void *data, int size)
+{
+    if (!size || r->error) return;
+    if (fread(data, size, 1, r->in) != 1) r->error = true;
+}
+
+static int read_int(replay_t *r)
+{
+    int32_t i = 0;
+    read_data(r, &i, sizeof(i));
+    return i;
+}
+
+static double read_double(replay_t *r)
+{
+    double v = 0;
+    read_data(r, &v, sizeof(v));
+    return v;
+}
+
+// Read an array of 'n' elements of size 'size' into a new buffer.
+static void *read_array(replay_t *r, int n, int size)
+{
+    void *ret;
+    if (n < 0 || r->error) {
+        r->error = true;
+        return NULL;
+    }
+    ret = calloc(max(n, 1), size);
+    read_data(r, ret, n * size);
+    return ret;
+}
+
+// We only store the texture sizes, so we replay them with empty textures
+// of the same sizes.
+static texture_t *read_texture(replay_t *r)
+{
+    replay_texture_t *rt;
+    uint32_t id = read_int(r);
+    int w = read_int(r);
+    int h = read_int(r);
+
+    if (!id || r->error) return NULL;
+    HASH_FIND(hh, r->textures, &id, sizeof(id), rt);
+    if (!rt) {
+        rt = calloc(1, sizeof(*rt));
+        rt->id = id;
+        rt->tex = texture_create(max(w, 1), max(h, 1), 4);
+        HASH_ADD(hh, r->textures, id, sizeof(rt->id), rt);
+    }
+    return rt->tex;
+}
+
+static float replay_compute_lum(void *user, const float pos[3])
+{
+    return 0;
+}
+
+static void read_painter(replay_t *r, painter_t *painter)
+{
+    int i;
+
+    read_data(r, painter, sizeof(*painter));
+    painter->rend = r->rend;
+    painter->obs = &r->obs;
+    painter->proj = &r->proj;
+    painter->depth_range = NULL;
+    if (read_int(r)) {
+        read_data(r, r->depth_range, sizeof(r->depth_range));
+        painter->depth_range = &r->depth_range;
+    }
+    for (i = 0; i < ARRAY_SIZE(painter->textures); i++)
+        painter->textures[i].tex = read_texture(r);
+
+    if (painter->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER)) {
+        painter->planet.sun = NULL;
+        if (read_int(r)) {
+            read_data(r, r->sun, sizeof(r->sun));
+            painter->planet.sun = &r->sun;
+        }
+        painter->planet.light_emit = NULL;
+        if (read_int(r)) {
+            read_data(r, r->light_emit, sizeof(r->light_emit));
+            painter->planet.light_emit = &r->light_emit;
+        }
+        free(r->shadow_spheres);
+        r->shadow_spheres = read_array(r, painter->planet.shadow_spheres_nb,
+                                       sizeof(*r->shadow_spheres));
+        painter->planet.shadow_spheres = r->shadow_spheres;
+        painter->planet.shadow_color_tex = read_texture(r);
+    }
+    if (painter->flags & PAINTER_ATMOSPHERE_SHADER) {
+        painter->atm.compute_lum = replay_compute_lum;
+        painter->atm.user = NULL;
+    }
+}
+
+static void read_state(replay_t *r)
+{
+    projection_t proj;
+    read_data(r, &r->obs, sizeof(r->obs));
+    read_data(r, &r->proj, sizeof(r->proj));
+    if (r->error) return;
+    memset(&r->obs.obj, 0, sizeof(r->obs.obj));
+    // Restore the projection functions pointers.
+    projection_init(&proj, r->proj.type, 1, 1, 1);
+    r->proj.name = proj.name;
+    r->proj.project = proj.project;
+    r->proj.backward = proj.backward;
+}
+
+static void grid_map(const uv_map_t *map, const double v[2], double out[4])
+{
+    const replay_grid_t *grid = map->user;
+    const int n = grid->size;
+    const double (*g)[4] = (void*)grid->verts;
+    double x, y, a[4], b[4];
+    int i, j;
+
+    x = v[0] * n;
+    y = v[1] * n;
+    j = clamp((int)floor(x), 0, n - 1);
+    i = clamp((int)floor(y), 0, n - 1);
+    x -= j;
+    y -= i;
+    vec4_mix(g[i * (n + 1) + j], g[i * (n + 1) + j + 1], x, a);
+    vec4_mix(g[(i + 1) * (n + 1) + j], g[(i + 1) * (n + 1) + j + 1], x, b);
+    vec4_mix(a, b, y, out);
+}
+
+static void replay_quad(replay_t *r, int op, const painter_t *painter)
+{
+    int frame, n;
+    replay_grid_t grid;
+    uv_map_t map = {
+        .map = grid_map,
+        .user = &grid,
+    };
+
+    frame = read_int(r);
+    grid.size = read_int(r);
+    n = (grid.size + 1) * (grid.size + 1);
+    grid.verts = read_array(r, grid.size > 0 ? n : -1, sizeof(*grid.verts));
+    if (!r->error) {
+        if (op == RENDER_OP_QUAD)
+            REND(r->rend, quad, painter, frame, grid.size, &map);
+        else
+            REND(r->rend, quad_wireframe, painter, frame, grid.size, &map);
+    }
+    free(grid.verts);
+}
+
+// Replay a single command.
+static void replay_op(replay_t *r, int op)
+{
+    painter_t painter;
+    double win_w, win_h, scale, size, angle, nb_dashes;
+    double pos[2], size2[2], p2[2], color[4], uv[4][2];
+    int n, n2, frame, mode, align, effects;
+    texture_t *tex;
+    void *data, *data2;
+    char *str;
+
+    if (op == OP_STATE) {
+        read_state(r);
+        return;
+    }
+    if (    op != RENDER_OP_PREPARE && op != RENDER_OP_FINISH &&
+            op != RENDER_OP_TEXTURE && op != RENDER_OP_TEXT) {
+        read_painter(r, &painter);
+    }
+
+    switch (op) {
+    case RENDER_OP_PREPARE:
+        win_w = read_double(r);
+        win_h = read_double(r);
+        scale = read_double(r);
+        n = read_int(r);
+        REND(r->rend, prepare, win_w, win_h, scale, n);
+        break;
+    case RENDER_OP_FINISH:
+        REND(r->rend, finish);
+        break;
+    case RENDER_OP_POINTS_2D:
+        n = read_int(r);
+        data = read_array(r, n, sizeof(point_t));
+        if (!r->error) REND(r->rend, points_2d, &painter, n, data);
+        free(data);
+        break;
+    case RENDER_OP_QUAD:
+    case RENDER_OP_QUAD_WIREFRAME:
+        replay_quad(r, op, &painter);
+        break;
+    case RENDER_OP_TEXTURE:
+        tex = read_texture(r);
+        read_data(r, uv, sizeof(uv));
+        read_data(r, pos, sizeof(pos));
+        size = read_double(r);
+        read_data(r, color, sizeof(color));
+        angle = read_double(r);
+        if (!r->error) REND(r->rend, texture, tex, uv, pos, size, color,
+                            angle);
+        break;
+    case RENDER_OP_TEXT:
+        n = read_int(r);
+        if (n < 0) {
+            r->error = true;
+            break;
+        }
+        str = calloc(n + 1, 1);
+        read_data(r, str, n);
+        read_data(r, pos, sizeof(pos));
+        align = read_int(r);
+        effects = read_int(r);
+        size = read_double(r);
+        read_data(r, color, sizeof(color));
+        angle = read_double(r);
+        if (!r->error) REND(r->rend, text, str, pos, align, effects, size,
+                            color, angle, NULL);
+        free(str);
+        break;
+    case RENDER_OP_LINE:
+        n = read_int(r);
+        data = read_array(r, n, sizeof(double[3]));
+        if (!r->error) REND(r->rend, line, &painter, data, n);
+        free(data);
+        break;
+    case RENDER_OP_MESH:
+        frame = read_int(r);
+        mode = read_int(r);
+        n = read_int(r);
+        data = read_array(r, n, sizeof(double[3]));
+        n2 = read_int(r);
+        data2 = read_array(r, n2, sizeof(uint32_t));
+        if (!r->error) REND(r->rend, mesh, &painter, frame, mode, n, data,
+                            n2, data2);
+        free(data);
+        free(data2);
+        break;
+    case RENDER_OP_ELLIPSE_2D:
+        read_data(r, pos, sizeof(pos));
+        read_data(r, size2, sizeof(size2));
+        angle = read_double(r);
+        nb_dashes = read_double(r);
+        if (!r->error) REND(r->rend, ellipse_2d, &painter, pos, size2, angle,
+                            nb_dashes);
+        break;
+    case RENDER_OP_RECT_2D:
+        read_data(r, pos, sizeof(pos));
+        read_data(r, size2, sizeof(size2));
+        angle = read_double(r);
+        if (!r->error) REND(r->rend, rect_2d, &painter, pos, size2, angle);
+        break;
+    case RENDER_OP_LINE_2D:
+        read_data(r, pos, sizeof(pos));
+        read_data(r, p2, sizeof(p2));
+        if (!r->error) REND(r->rend, line_2d, &painter, pos, p2);
+        break;
+    default:
+        LOG_E("Unknown render op: %d", op);
+        r->error = true;
+    }
+}
+
+int render_replay(const char *path, renderer_t *rend)
+{
+    replay_t r = {.rend = rend};
+    replay_texture_t *rt, *tmp;
+    header_t header;
+    int32_t op;
+    int frames = 0;
+
+    r.in = fopen(path, "rb");
+    if (!r.in) {
+        LOG_E("Cannot open %s", path);
+        return -1;
+    }
+    read_data(&r, &header, sizeof(header));
+    if (r.error || memcmp(&header, &HEADER, sizeof(header)) != 0) {
+        LOG_E("Incompatible command log: %s", path);
+        fclose(r.in);
+        return -1;
+    }
+    while (!r.error && fread(&op, sizeof(op), 1, r.in) == 1) {
+        replay_op(&r, op);
+        if (op == RENDER_OP_FINISH) frames++;
+    }
+    if (r.error) LOG_E("Error replaying command log: %s", path);
+
+    HASH_ITER(hh, r.textures, rt, tmp) {
+        HASH_DEL(r.textures, rt);
+        texture_release(rt->tex);
+        free(rt);
+    }
+    free(r.shadow_spheres);
+    fclose(r.in);
+    return r.error ? -1 : frames;
+}
+
+/******* TESTS **********************************************************/
+
+#if COMPILE_TESTS
+
+// Renderer that only keeps the last quad grid.
+typedef struct {
+    renderer_t  rend;
+    double      grid[25][4];
+} test_renderer_t;
+
+static void test_quad(renderer_t *rend_, const painter_t *painter,
+                      int frame, int grid_size, const uv_map_t *map)
+{
+    test_renderer_t *rend = (void*)rend_;
+    assert(grid_size == 4);
+    uv_map_grid(map, grid_size, rend->grid, NULL);
+}
+
+static void test_render(renderer_t *rend, const uv_map_t *map,
+                        double p, double q)
+{
+    painter_t painter;
+    projection_t proj;
+    const double color[4] = {1, 1, 1, 1};
+    const point_t points[2] = {{.pos = {p, q}, .size = 2},
+                               {.pos = {q, p}, .size = 3}};
+    double line[2][4] = {{1, 0, 0, 1}, {0, 1, 0, 1}};
+
+    core_get_proj(&proj);
+    painter = (painter_t) {
+        .rend = rend,
+        .obs = core->observer,
+        .proj = &proj,
+        .fb_size = {400, 300},
+        .pixel_scale = 1,
+        .color = {1, 1, 1, 1},
+        .contrast = 1,
+        .lines.width = 1,
+    };
+    paint_prepare(&painter, 400, 300, 1);
+    paint_2d_points(&painter, 2, points);
+    paint_quad(&painter, FRAME_ICRF, map, 4);
+    paint_text(&painter, "test", points[0].pos, 0, 0, 12, color, 0);
+    paint_line(&painter, FRAME_ICRF, line, NULL, 8,
+               PAINTER_SKIP_DISCONTINUOUS);
+    paint_2d_line(&painter, NULL, points[0].pos, points[1].pos);
+    paint_finish(&painter);
+}
+
+static void test_render_record(void)
+{
+    renderer_t *rend, *replay_rend, *rec;
+    render_stats_t stats, replay_stats;
+    test_renderer_t test_rend = {.rend.quad = test_quad};
+    const char *path = "/tmp/swe_test_record.bin";
+    double grid[25][4];
+    uv_map_t map;
+    int frames;
+
+    uv_map_init_healpix(&map, 1, 3, false, true);
+    uv_map_grid(&map, 4, grid, NULL);
+
+    rend = render_null_create();
+    rec = render_record_create(path, rend);
+    assert(rec);
+    test_render(rec, &map, 10, 20);
+    test_render(rec, &map, 30, 40);
+    render_record_release(rec);
+
+    // Replay into a null renderer and compare the counters.
+    replay_rend = render_null_create();
+    frames = render_replay(path, replay_rend);
+    assert(frames == 2);
+    render_null_get_stats(rend, &stats);
+    render_null_get_stats(replay_rend, &replay_stats);
+    assert(stats.frames == 2);
+    assert(stats.ops[RENDER_OP_QUAD].calls == 2);
+    if (memcmp(&stats, &replay_stats, sizeof(stats)) != 0) {
+        LOG_E("Replay stats don't match the recording");
+        assert(false);
+    }
+
+    // Check that the replayed quads have the same vertices.
+    frames = render_replay(path, &test_rend.rend);
+    assert(frames == 2);
+    if (memcmp(grid, test_rend.grid, sizeof(grid)) != 0) {
+        LOG_E("Replay quad grid doesn't match the recording");
+        assert(false);
+    }
+    render_null_release(rend);
+    render_null_release(replay_rend);
+    remove(path);
+}
+
+TEST_REGISTER(NULL, test_render_record, TEST_AUTO);
+
+#endif
@@ -0,0 +1,1288 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+#include "fontstash.h"
+
+/*
+ * Software renderer.
+ *
+ * All the renderer calls are converted on the calling thread into a list
+ * of simple primitives in framebuffer coordinates: triangles (with an
+ * optional texture and per vertex colors), points with halo and anti
+ * aliased line segments.  The projections and colors use the same math as
+ * the OpenGL renderer shaders.
+ *
+ * When the frame is finished, the primitives are binned into square tiles,
+ * keeping their order, and the tiles are rasterized in parallel with
+ * worker_parallel_for.  Since
+ * each tile is only touched by a single thread the blending order is
+ * always the same as the calls order.
+ */
+
+#define TILE_SIZE 64
+#define ATLAS_SIZE 512
+// Primitives further than that are considered broken by the projection.
+#define MAX_COORD 100000.0f
+
+enum {
+    PRIM_TRIANGLE = 1,
+    PRIM_POINT,
+    PRIM_LINE,
+};
+
+enum {
+    BLEND_ALPHA = 0,    // src * a + dst * (1 - a)
+    BLEND_ADD,          // src + dst
+    BLEND_ADD_ALPHA,    // src * a + dst
+};
+
+enum {
+    // Luminance textures only modulate the alpha.
+    PRIM_TEX_LUMINANCE  = 1 << 0,
+    // Set for the triangle edges that follow the top-left fill rule.
+    PRIM_TOP_LEFT_0     = 1 << 1,
+    PRIM_TOP_LEFT_1     = 1 << 2,
+    PRIM_TOP_LEFT_2     = 1 << 3,
+};
+
+// Image sampled by the triangles.  Either a texture CPU data, or a glyph
+// bitmap copied from the font atlas.
+typedef struct {
+    int         w, h, bpp;
+    uint8_t     *data;
+    texture_t   *tex;
+} image_t;
+
+typedef struct {
+    uint8_t     type;
+    uint8_t     blend;
+    uint8_t     flags;
+    int         img;        // Index in the frame images, or -1 for white.
+    float       bbox[4];    // min x, min y, max x, max y, in pixels.
+    union {
+        // The triangles are stored as planes equations (a * x + b * y + c)
+        // relative to their first vertex.
+        struct {
+            float o[2];
+            float e[3][3];  // Edges functions, positive inside.
+            float uv[2][3];
+            float c[4][3];
+        } tri;
+        struct {
+            float pos[2];
+            float r;        // Total radius, including the halo.
+            float core;     // Core radius relative to the total radius.
+            float c[4];
+        } point;
+        struct {
+            float p[2][2];
+            float z[2];
+            float len;      // Length of the line up to p[0].
+            float width;    // All the values are in pixels.
+            float aa;
+            float glow;
+            float glow_r;
+            float dash_len;
+            float dash_ratio;
+            float fade[2];
+            float c[4];
+        } line;
+    };
+} prim_t;
+
+typedef struct {
+    int *idx;
+    int nb;
+    int size;
+} bin_t;
+
+typedef struct {
+    renderer_t  rend;
+    int         fb_size[2];
+    double      scale;
+    bool        cull_flipped;
+    bool        parallel;
+    uint8_t     *buf;
+
+    prim_t      *prims;
+    int         prims_nb;
+    int         prims_size;
+    image_t     *images;
+    int         images_nb;
+    int         images_size;
+
+    bin_t       *bins;
+    int         tiles[2];
+
+    FONScontext *fons;
+    int         fonts[2];
+} renderer_soft_t;
+
+static prim_t *add_prim(renderer_soft_t *rend, int type, int blend, int img)
+{
+    prim_t *prim;
+    if (rend->prims_nb >= rend->prims_size) {
+        rend->prims_size = max(1024, rend->prims_size * 2);
+        rend->prims = realloc(rend->prims,
+                              rend->prims_size * sizeof(*rend->prims));
+    }
+    prim = &rend->prims[rend->prims_nb++];
+    memset(prim, 0, sizeof(*prim));
+    prim->type = type;
+    prim->blend = blend;
+    prim->img = img;
+    return prim;
+}
+
+static int add_image(renderer_soft_t *rend, texture_t *tex,
+                     int w, int h, int bpp, uint8_t *data)
+{
+    image_t *img;
+    // Consecutive calls often use the same texture.
+    if (tex && rend->images_nb && rend->images[rend->images_nb - 1].tex == tex)
+        return rend->images_nb - 1;
+    if (tex && !tex->data) return -1;
+    if (rend->images_nb >= rend->images_size) {
+        rend->images_size = max(64, rend->images_size * 2);
+        rend->images = realloc(rend->images,
+                               rend->images_size * sizeof(*rend->images));
+    }
+    img = &rend->images[rend->images_nb];
+    if (tex) {
+        tex->ref++;
+        *img = (image_t){tex->w, tex->h, tex->bpp, tex->data, tex};
+    } else {
+        *img = (image_t){w, h, bpp, data, NULL};
+    }
+    return rend->images_nb++;
+}
+
+static void release_images(renderer_soft_t *rend)
+{
+    int i;
+    for (i = 0; i < rend->images_nb; i++) {
+        if (rend->images[i].tex)
+            texture_release(rend->images[i].tex);
+        else
+            free(rend->images[i].data);
+    }
+    rend->images_nb = 0;
+}
+
+static void window_to_fb(const renderer_soft_t *rend,
+                         const double win[2], float out[2])
+{
+    out[0] = win[0] * rend->scale;
+    out[1] = win[1] * rend->scale;
+}
+
+// Convert a clip space position as returned by the projections into
+// framebuffer coordinates.  Return false if the point is behind the view.
+static bool clip_to_fb(const renderer_soft_t *rend,
+                       const double p[4], float out[2])
+{
+    if (p[3] <= 0.0) return false;
+    out[0] = (+p[0] / p[3] + 1) / 2 * rend->fb_size[0];
+    out[1] = (-p[1] / p[3] + 1) / 2 * rend->fb_size[1];
+    return fabsf(out[0]) < MAX_COORD && fabsf(out[1]) < MAX_COORD;
+}
+
+// Compute the primitive bounding box, and return false if it doesn't
+// intersect the framebuffer.
+static bool prim_set_bbox(const renderer_soft_t *rend, prim_t *prim,
+                          int n, const float (*p)[2], float margin)
+{
+    int i;
+    prim->bbox[0] = prim->bbox[2] = p[0][0];
+    prim->bbox[1] = prim->bbox[3] = p[0][1];
+    for (i = 1; i < n; i++) {
+        prim->bbox[0] = min(prim->bbox[0], p[i][0]);
+        prim->bbox[1] = min(prim->bbox[1], p[i][1]);
+        prim->bbox[2] = max(prim->bbox[2], p[i][0]);
+        prim->bbox[3] = max(prim->bbox[3], p[i][1]);
+    }
+    prim->bbox[0] -= margin;
+    prim->bbox[1] -= margin;
+    prim->bbox[2] += margin;
+    prim->bbox[3] += margin;
+    return prim->bbox[2] >= 0 && prim->bbox[3] >= 0 &&
+           prim->bbox[0] < rend->fb_size[0] &&
+           prim->bbox[1] < rend->fb_size[1];
+}
+
+static float edge(const float a[2], const float b[2], const float p[2])
+{
+    return (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+}
+
+/*
+ * Function: add_triangle
+ * Add a triangle primitive.
+ *
+ * Parameters:
+ *   cull   - If set, cull the back faces like the OpenGL renderer does.
+ *   p      - Positions in framebuffer coordinates.
+ *   uv     - Texture coordinates, normalized to the image size.
+ *   c      - Per vertex colors.
+ */
+static void add_triangle(renderer_soft_t *rend, int blend, int flags,
+                         int img, bool cull, const float p_[3][2],
+                         const float uv_[3][2], const float c_[3][4])
+{
+    prim_t *prim;
+    float area = edge(p_[0], p_[1], p_[2]), p[3][2], uv[3][2], c[3][4];
+    float (*e)[3];
+    int i, j, k;
+
+    if (area == 0) return;
+    // With y pointing down, the OpenGL front faces have a negative area.
+    if (cull && (rend->cull_flipped ? area < 0 : area > 0)) return;
+
+    prim = add_prim(rend, PRIM_TRIANGLE, blend, img);
+    prim->flags = flags;
+    if (!prim_set_bbox(rend, prim, 3, p_, 0)) {
+        rend->prims_nb--;
+        return;
+    }
+
+    // Always use a positive area, relative to the first vertex.
+    for (i = 0; i < 3; i++) {
+        k = (area > 0) ? i : (3 - i) % 3;
+        p[i][0] = p_[k][0] - p_[0][0];
+        p[i][1] = p_[k][1] - p_[0][1];
+        memcpy(uv[i], uv_ ? uv_[k] : (float[2]){0}, sizeof(uv[i]));
+        memcpy(c[i], c_[k], sizeof(c[i]));
+    }
+    area = fabsf(area);
+    memcpy(prim->tri.o, p_[0], sizeof(prim->tri.o));
+
+    // Edges i is opposite to vertex i, so that the normalized edge
+    // functions are the barycentric coordinates.
+    e = prim->tri.e;
+    for (i = 0; i < 3; i++) {
+        const float *a = p[(i + 1) % 3], *b = p[(i + 2) % 3];
+        e[i][0] = -(b[1] - a[1]);
+        e[i][1] = b[0] - a[0];
+        e[i][2] = (b[1] - a[1]) * a[0] - (b[0] - a[0]) * a[1];
+        if ((a[1] == b[1] && b[0] > a[0]) || b[1] < a[1])
+            prim->flags |= PRIM_TOP_LEFT_0 << i;
+    }
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < 2; i++) {
+            prim->tri.uv[i][j] = (uv[0][i] * e[0][j] + uv[1][i] * e[1][j] +
+                                  uv[2][i] * e[2][j]) / area;
+        }
+        for (i = 0; i < 4; i++) {
+            prim->tri.c[i][j] = (c[0][i] * e[0][j] + c[1][i] * e[1][j] +
+                                 c[2][i] * e[2][j]) / area;
+        }
+    }
+}
+
+/*
+ * Function: add_segment
+ * Add an anti aliased line segment primitive.
+ *
+ * The width, anti aliasing and glow values follow the OpenGL renderer
+ * lines shader, but in pixels.
+ */
+static void add_segment(renderer_soft_t *rend, const painter_t *painter,
+                        const float p[2][2], const float z[2], float len,
+                        float width, float aa, float glow,
+                        const float color[4])
+{
+    prim_t *prim;
+    float margin;
+
+    prim = add_prim(rend, PRIM_LINE, BLEND_ALPHA, -1);
+    memcpy(prim->line.p, p, sizeof(prim->line.p));
+    prim->line.len = len;
+    prim->line.width = width;
+    prim->line.aa = aa;
+    prim->line.glow = glow;
+    prim->line.glow_r = glow ? 5 * rend->scale : 0;
+    memcpy(prim->line.c, color, sizeof(prim->line.c));
+    if (z) memcpy(prim->line.z, z, sizeof(prim->line.z));
+    if (painter && painter->lines.dash_length &&
+            painter->lines.dash_ratio < 1.0) {
+        prim->line.dash_len = painter->lines.dash_length * rend->scale;
+        prim->line.dash_ratio = painter->lines.dash_ratio;
+    }
+    if (painter && painter->lines.fade_dist_min) {
+        prim->line.fade[0] = painter->lines.fade_dist_min;
+        prim->line.fade[1] = painter->lines.fade_dist_max;
+    }
+    margin = max(width / 2 + aa, prim->line.glow_r) + 1;
+    if (!prim_set_bbox(rend, prim, 2, p, margin))
+        rend->prims_nb--;
+}
+
+// Add a polyline in framebuffer coordinates, with the painter line style.
+static void add_polyline(renderer_soft_t *rend, const painter_t *painter,
+                         int n, const float (*p)[2], const float *z,
+                         float width, float aa, float glow,
+                         const float color[4])
+{
+    int i;
+    float len = 0;
+    for (i = 0; i < n - 1; i++) {
+        add_segment(rend, painter, (const float(*)[2])p + i,
+                    z ? z + i : NULL, len, width, aa, glow, color);
+        len += hypotf(p[i + 1][0] - p[i][0], p[i + 1][1] - p[i][1]);
+    }
+}
+
+static void prepare(renderer_t *rend_, double win_w, double win_h,
+                    double scale, bool cull_flipped)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    int w = round(win_w * scale), h = round(win_h * scale);
+    int i;
+
+    if (w != rend->fb_size[0] || h != rend->fb_size[1]) {
+        for (i = 0; i < rend->tiles[0] * rend->tiles[1]; i++)
+            free(rend->bins[i].idx);
+        free(rend->bins);
+        free(rend->buf);
+        rend->fb_size[0] = w;
+        rend->fb_size[1] = h;
+        rend->buf = calloc(w * h, 4);
+        rend->tiles[0] = (w + TILE_SIZE - 1) / TILE_SIZE;
+        rend->tiles[1] = (h + TILE_SIZE - 1) / TILE_SIZE;
+        rend->bins = calloc(rend->tiles[0] * rend->tiles[1],
+                            sizeof(*rend->bins));
+    }
+    rend->scale = scale;
+    rend->cull_flipped = cull_flipped;
+    rend->prims_nb = 0;
+    release_images(rend);
+}
+
+static void points_2d(renderer_t *rend_, const painter_t *painter,
+                      int n, const point_t *points)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    int i, j;
+    float pos[1][2];
+    double halo = painter->points_halo ?: 1.0;
+    prim_t *prim;
+
+    for (i = 0; i < n; i++) {
+        window_to_fb(rend, points[i].pos, pos[0]);
+        prim = add_prim(rend, PRIM_POINT, BLEND_ADD_ALPHA, -1);
+        memcpy(prim->point.pos, pos[0], sizeof(prim->point.pos));
+        // Same as the points shader: the rendered point includes the halo,
+        // and is never less than one pixel wide.
+        prim->point.r = max(points[i].size * rend->scale * halo, 0.5);
+        prim->point.core = 1.0 / halo;
+        for (j = 0; j < 4; j++)
+            prim->point.c[j] = points[i].color[j] / 255.0 * painter->color[j];
+        if (!prim_set_bbox(rend, prim, 1, pos, prim->point.r))
+            rend->prims_nb--;
+
+        if (points[i].oid && core && core->areas) {
+            areas_add_circle(core->areas, points[i].pos, points[i].size,
+                             points[i].oid, points[i].hint);
+        }
+    }
+}
+
+static float gamma_correct(float c)
+{
+    if (c < 0.0031308) return 19.92 * c;
+    return 1.055 * powf(c, 1.0 / 2.4) - 0.055;
+}
+
+// Port of the atmosphere vertex shader.
+static void atmosphere_color(const painter_t *painter, const double pos[3],
+                             float lum, float out[4])
+{
+    const float *P = painter->atm.p;
+    const float tm[3] = {core->tonemapper.p, core->tonemapper.lwmax,
+                         core->tonemapper.exposure};
+    double p[3], cos_gamma, cos_gamma2, gamma, cos_theta, op, s;
+    double x, y, Y, xyz[3];
+
+    vec3_copy(pos, p);
+    p[2] = fabs(p[2]); // Mirror below horizon.
+    cos_gamma = p[0] * painter->atm.sun[0] + p[1] * painter->atm.sun[1] +
+                p[2] * painter->atm.sun[2];
+    cos_gamma2 = cos_gamma * cos_gamma;
+    gamma = acos(clamp(cos_gamma, -1.0, 1.0));
+    cos_theta = p[2];
+
+    x = ((1. + P[0] * exp(P[1] / cos_theta)) *
+         (1. + P[2] * exp(P[3] * gamma) + P[4] * cos_gamma2)) * P[5];
+    y = ((1. + P[6] * exp(P[7] / cos_theta)) *
+         (1. + P[8] * exp(P[9] * gamma) + P[10] * cos_gamma2)) * P[11];
+    Y = lum * 0.08;
+
+    // Blue shift and scotopic vision, see the shader for details.
+    op = (log10(Y) + 2.) / 2.6;
+    s = (Y <= 0.01) ? 0.0 : (Y > 3.981) ? 1.0 : op * op * (3. - 2. * op);
+    x = mix(0.25, x, s);
+    y = mix(0.25, y, s);
+    Y = 0.4468 * (1. - s) * Y + s * Y;
+    Y = min(0.7, log(1.0 + Y * tm[0]) / log(1.0 + tm[1] * tm[0]) * tm[2]);
+
+    xyz[0] = x * Y / y;
+    xyz[1] = Y;
+    xyz[2] = (1.0 - x - y) * Y / y;
+    out[0] = 3.2406 * xyz[0] - 1.5372 * xyz[1] - 0.4986 * xyz[2];
+    out[1] = -0.9689 * xyz[0] + 1.8758 * xyz[1] + 0.0415 * xyz[2];
+    out[2] = 0.0557 * xyz[0] - 0.2040 * xyz[1] + 1.0570 * xyz[2];
+    out[0] = clamp(gamma_correct(out[0]), 0.0, 1.0);
+    out[1] = clamp(gamma_correct(out[1]), 0.0, 1.0);
+    out[2] = clamp(gamma_correct(out[2]), 0.0, 1.0);
+    out[3] = 1.0;
+}
+
+static bool color_is_white(const double c[4])
+{
+    return c[0] == 1.0 && c[1] == 1.0 && c[2] == 1.0 && c[3] == 1.0;
+}
+
+/*
+ * The planets and rings are rendered as simple textured quads, without
+ * the lighting of the OpenGL planet shader.
+ */
+static void quad(renderer_t *rend_, const painter_t *painter,
+                 int frame, int grid_size, const uv_map_t *map)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const int INDICES[6][2] = {
+        {0, 0}, {0, 1}, {1, 0}, {1, 1}, {1, 0}, {0, 1} };
+    int n = grid_size + 1, i, j, k, idx, img, blend = BLEND_ALPHA, flags = 0;
+    double (*grid)[4], p[4], ndc_p[4], color[4];
+    float (*pos)[2], (*uv)[2], (*col)[4], lum;
+    float tri_p[3][2], tri_uv[3][2], tri_c[3][4];
+    bool *visible, ok;
+    texture_t *tex = painter->textures[PAINTER_TEX_COLOR].tex;
+
+    if (painter->flags & (PAINTER_ATMOSPHERE_SHADER | PAINTER_FOG_SHADER))
+        tex = NULL;
+    img = tex ? add_image(rend, tex, 0, 0, 0, NULL) : -1;
+    vec4_copy(painter->color, color);
+    if (painter->flags & (PAINTER_ADD | PAINTER_ATMOSPHERE_SHADER)) {
+        blend = BLEND_ADD;
+        // Emulate the GL_CONSTANT_COLOR blending.
+        if (!color_is_white(painter->color)) {
+            for (i = 0; i < 3; i++)
+                color[i] *= painter->color[i] * painter->color[3];
+        }
+    }
+    if (tex && tex->bpp == 1 && !(painter->flags & PAINTER_ADD))
+        flags |= PRIM_TEX_LUMINANCE;
+
+    grid = calloc(n * n, sizeof(*grid));
+    pos = calloc(n * n, sizeof(*pos));
+    uv = calloc(n * n, sizeof(*uv));
+    col = calloc(n * n, sizeof(*col));
+    visible = calloc(n * n, sizeof(*visible));
+    uv_map_grid(map, grid_size, grid, NULL);
+
+    for (i = 0; i < n; i++)
+    for (j = 0; j < n; j++) {
+        idx = i * n + j;
+        vec3_set(p, (double)j / grid_size, (double)i / grid_size, 1.0);
+        mat3_mul_vec3(painter->textures[PAINTER_TEX_COLOR].mat, p, p);
+        uv[idx][0] = p[0];
+        uv[idx][1] = p[1];
+
+        vec4_copy(grid[idx], p);
+        convert_framev4(painter->obs, frame, FRAME_VIEW, p, ndc_p);
+        project(painter->proj, 0, ndc_p, ndc_p);
+        visible[idx] = clip_to_fb(rend, ndc_p, pos[idx]);
+
+        for (k = 0; k < 4; k++) col[idx][k] = color[k];
+        if (painter->flags & PAINTER_ATMOSPHERE_SHADER) {
+            lum = painter->atm.compute_lum(painter->atm.user,
+                    (float[3]){p[0], p[1], p[2]});
+            atmosphere_color(painter, p, lum, col[idx]);
+            for (k = 0; k < 3; k++) col[idx][k] *= color[k];
+        }
+        if (painter->flags & PAINTER_FOG_SHADER) {
+            col[idx][0] = col[idx][1] = col[idx][2] = 1;
+            col[idx][3] = 0.15 * smoothstep(0.2, 0.0, fabs(p[2]));
+        }
+    }
+
+    for (i = 0; i < grid_size; i++)
+    for (j = 0; j < grid_size; j++) {
+        for (k = 0; k < 6; k++) {
+            idx = (INDICES[k][1] + i) * n + (INDICES[k][0] + j);
+            ok = visible[idx];
+            if (!ok) break;
+            memcpy(tri_p[k % 3], pos[idx], sizeof(tri_p[0]));
+            memcpy(tri_uv[k % 3], uv[idx], sizeof(tri_uv[0]));
+            memcpy(tri_c[k % 3], col[idx], sizeof(tri_c[0]));
+            if (k % 3 == 2)
+                add_triangle(rend, blend, flags, img, true,
+                             tri_p, tri_uv, tri_c);
+        }
+    }
+
+    free(grid);
+    free(pos);
+    free(uv);
+    free(col);
+    free(visible);
+}
+
+static void quad_wireframe(renderer_t *rend_, const painter_t *painter,
+                           int frame, int grid_size, const uv_map_t *map)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const float color[4] = {1, 0, 0, 0.25};
+    int n = grid_size + 1, i, j;
+    double (*grid)[4], p[4];
+    float (*pos)[2], seg[2][2];
+    bool *visible;
+
+    grid = calloc(n * n, sizeof(*grid));
+    pos = calloc(n * n, sizeof(*pos));
+    visible = calloc(n * n, sizeof(*visible));
+    uv_map_grid(map, grid_size, grid, NULL);
+    for (i = 0; i < n * n; i++) {
+        convert_framev4(painter->obs, frame, FRAME_VIEW, grid[i], p);
+        project(painter->proj, 0, p, p);
+        visible[i] = clip_to_fb(rend, p, pos[i]);
+    }
+
+    // Render a set of horizontal and vertical lines.
+    for (i = 0; i < n; i++)
+    for (j = 0; j < grid_size; j++) {
+        if (visible[j * n + i] && visible[(j + 1) * n + i]) {
+            memcpy(seg[0], pos[j * n + i], sizeof(seg[0]));
+            memcpy(seg[1], pos[(j + 1) * n + i], sizeof(seg[1]));
+            add_segment(rend, NULL, seg, NULL, 0, 1, 0.5, 0, color);
+        }
+        if (visible[i * n + j] && visible[i * n + j + 1]) {
+            memcpy(seg[0], pos[i * n + j], sizeof(seg[0]));
+            memcpy(seg[1], pos[i * n + j + 1], sizeof(seg[1]));
+            add_segment(rend, NULL, seg, NULL, 0, 1, 0.5, 0, color);
+        }
+    }
+    free(grid);
+    free(pos);
+    free(visible);
+}
+
+static void texture(renderer_t *rend_, const texture_t *tex,
+                    double uv[4][2], const double pos[2], double size,
+                    const double color[4], double angle)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const int INDICES[6] = {0, 1, 2, 3, 2, 1};
+    double verts[4][2], w, h;
+    float p[4][2], tuv[4][2], c[4], tri_p[3][2], tri_uv[3][2], tri_c[3][4];
+    int i, img, flags = 0;
+
+    img = add_image(rend, (texture_t*)tex, 0, 0, 0, NULL);
+    if (tex->bpp == 1) flags |= PRIM_TEX_LUMINANCE;
+    w = size;
+    h = size * tex->h / tex->w;
+    for (i = 0; i < 4; i++) {
+        verts[i][0] = (i % 2 - 0.5) * w;
+        verts[i][1] = (0.5 - i / 2) * h;
+        if (angle != 0.0) vec2_rotate(-angle, verts[i], verts[i]);
+        verts[i][0] = pos[0] + verts[i][0];
+        verts[i][1] = pos[1] + verts[i][1];
+        window_to_fb(rend, verts[i], p[i]);
+        // The uv are given relative to the OpenGL power of two texture.
+        tuv[i][0] = uv[i][0] * tex->tex_w / tex->w;
+        tuv[i][1] = uv[i][1] * tex->tex_h / tex->h;
+    }
+    for (i = 0; i < 4; i++) c[i] = color[i];
+    for (i = 0; i < 6; i++) {
+        memcpy(tri_p[i % 3], p[INDICES[i]], sizeof(tri_p[0]));
+        memcpy(tri_uv[i % 3], tuv[INDICES[i]], sizeof(tri_uv[0]));
+        memcpy(tri_c[i % 3], c, sizeof(tri_c[0]));
+        if (i % 3 == 2)
+            add_triangle(rend, BLEND_ALPHA, flags, img, false,
+                         tri_p, tri_uv, tri_c);
+    }
+}
+
+static void text(renderer_t *rend_, const char *text, const double pos[2],
+                 int align, int effects, double size, const double color[4],
+                 double angle, double bounds[4])
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const float font_scale = 1.38;
+    char buf[256];
+    float fbounds[4], q[4][2], c[4], tri_p[3][2], tri_uv[3][2], tri_c[3][4];
+    const float quv[4][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+    const int INDICES[6] = {0, 1, 2, 3, 2, 1};
+    double v[2];
+    int i, j, x, y, w, h, atlas_w, atlas_h, img, blend;
+    const uint8_t *atlas;
+    uint8_t *data;
+    FONStextIter iter;
+    FONSquad fq;
+    int font = (effects & TEXT_BOLD) ? 1 : 0;
+
+    if (strlen(text) >= sizeof(buf)) {
+        LOG_W("Text too large: %s", text);
+        return;
+    }
+    if (effects & TEXT_SMALL_CAP)
+        u8_upper(buf, text, sizeof(buf) - 1);
+    else
+        strcpy(buf, text);
+
+    fonsClearState(rend->fons);
+    fonsSetFont(rend->fons, rend->fonts[font]);
+    fonsSetSize(rend->fons, size * font_scale * rend->scale);
+    fonsSetAlign(rend->fons, align);
+    if (effects & TEXT_SPACED)
+        fonsSetSpacing(rend->fons,
+                       round(size * font_scale * 0.2) * rend->scale);
+    if (effects & TEXT_SEMI_SPACED)
+        fonsSetSpacing(rend->fons,
+                       round(size * font_scale * 0.05) * rend->scale);
+
+    if (bounds) {
+        fonsTextBounds(rend->fons, 0, 0, buf, NULL, fbounds);
+        for (i = 0; i < 4; i++)
+            bounds[i] = pos[i % 2] + fbounds[i] / rend->scale;
+        return;
+    }
+
+    blend = (effects & TEXT_BLEND_ADD) ? BLEND_ADD_ALPHA : BLEND_ALPHA;
+    for (i = 0; i < 4; i++) c[i] = clamp(color[i], 0.0, 1.0);
+    fonsTextIterInit(rend->fons, &iter, 0, 0, buf, NULL,
+                     FONS_GLYPH_BITMAP_REQUIRED);
+    while (fonsTextIterNext(rend->fons, &iter, &fq)) {
+        // Copy the glyph bitmap, since the atlas can be reset at any time.
+        atlas = fonsGetTextureData(rend->fons, &atlas_w, &atlas_h);
+        x = round(fq.s0 * atlas_w);
+        y = round(fq.t0 * atlas_h);
+        w = round(fq.s1 * atlas_w) - x;
+        h = round(fq.t1 * atlas_h) - y;
+        if (w <= 0 || h <= 0) continue;
+        data = malloc(w * h);
+        for (j = 0; j < h; j++)
+            memcpy(data + j * w, atlas + (y + j) * atlas_w + x, w);
+        img = add_image(rend, NULL, w, h, 1, data);
+
+        for (i = 0; i < 4; i++) {
+            v[0] = (i % 2) ? fq.x1 : fq.x0;
+            v[1] = (i / 2) ? fq.y1 : fq.y0;
+            if (angle != 0.0) vec2_rotate(angle, v, v);
+            q[i][0] = pos[0] * rend->scale + v[0];
+            q[i][1] = pos[1] * rend->scale + v[1];
+        }
+        for (i = 0; i < 6; i++) {
+            memcpy(tri_p[i % 3], q[INDICES[i]], sizeof(tri_p[0]));
+            memcpy(tri_uv[i % 3], quv[INDICES[i]], sizeof(tri_uv[0]));
+            memcpy(tri_c[i % 3], c, sizeof(tri_c[0]));
+            if (i % 3 == 2)
+                add_triangle(rend, blend, PRIM_TEX_LUMINANCE, img, false,
+                             tri_p, tri_uv, tri_c);
+        }
+    }
+}
+
+static void line(renderer_t *rend_, const painter_t *painter,
+                 const double (*line)[3], int size)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    float (*p)[2], *z, color[4];
+    int i;
+
+    if (size < 2) return;
+    p = calloc(size, sizeof(*p));
+    z = calloc(size, sizeof(*z));
+    for (i = 0; i < size; i++) {
+        window_to_fb(rend, line[i], p[i]);
+        z[i] = line[i][2];
+    }
+    for (i = 0; i < 4; i++) color[i] = painter->color[i];
+    if (painter->lines.glow) {
+        add_polyline(rend, painter, size, p, z,
+                     painter->lines.width * rend->scale, 1.2 * rend->scale,
+                     painter->lines.glow, color);
+    } else {
+        add_polyline(rend, NULL, size, p, NULL,
+                     painter->lines.width * rend->scale, 0.5, 0, color);
+    }
+    free(p);
+    free(z);
+}
+
+static void mesh(renderer_t *rend_, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint32_t indices[])
+{
+    renderer_soft_t *rend = (void*)rend_;
+    double pos[4], (*view)[3];
+    float (*p)[2], color[4], tri_p[3][2], tri_c[3][4];
+    bool *visible;
+    int i, k, n = (mode == MODE_TRIANGLES) ? 3 : 2;
+
+    p = calloc(verts_count, sizeof(*p));
+    visible = calloc(verts_count, sizeof(*visible));
+    view = malloc(verts_count * sizeof(*view));
+    for (i = 0; i < verts_count; i++)
+        vec3_normalize(verts[i], view[i]);
+    convert_frame_batch(painter->obs, frame, FRAME_VIEW, true,
+                        verts_count, view, view);
+    for (i = 0; i < verts_count; i++) {
+        vec3_copy(view[i], pos);
+        pos[3] = 0.0;
+        project(painter->proj, PROJ_ALREADY_NORMALIZED, pos, pos);
+        visible[i] = clip_to_fb(rend, pos, p[i]);
+    }
+    for (i = 0; i < 4; i++) color[i] = painter->color[i];
+    for (i = 0; i < 3; i++) memcpy(tri_c[i], color, sizeof(color));
+
+    for (i = 0; i + n <= indices_count; i += n) {
+        for (k = 0; k < n; k++) {
+            if (!visible[indices[i + k]]) break;
+            memcpy(tri_p[k], p[indices[i + k]], sizeof(tri_p[k]));
+        }
+        if (k < n) continue;
+        if (mode == MODE_TRIANGLES)
+            add_triangle(rend, BLEND_ALPHA, 0, -1, false, tri_p, NULL,
+                         tri_c);
+        else
+            add_segment(rend, NULL, tri_p, NULL, 0,
+                        painter->lines.width * rend->scale, 0.5, 0, color);
+    }
+    free(p);
+    free(visible);
+    free(view);
+}
+
+// Add a 2d path defined in a rotated and translated window space, like
+// with nanovg.
+static void add_path_2d(renderer_soft_t *rend, const painter_t *painter,
+                        const double pos[2], double angle,
+                        int n, const double (*path)[2])
+{
+    float (*p)[2], color[4];
+    double v[2];
+    int i;
+
+    p = calloc(n, sizeof(*p));
+    for (i = 0; i < n; i++) {
+        vec2_rotate(angle, path[i], v);
+        v[0] += pos[0];
+        v[1] += pos[1];
+        window_to_fb(rend, v, p[i]);
+    }
+    for (i = 0; i < 4; i++) color[i] = painter->color[i];
+    add_polyline(rend, NULL, n, p, NULL,
+                 painter->lines.width * rend->scale, 0.5, 0, color);
+    free(p);
+}
+
+static void ellipse_2d(renderer_t *rend_, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double dashes)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const int STEPS = 64, DASH_STEPS = 4;
+    double path[STEPS + 1][2], a, da;
+    int i;
+
+    if (!dashes) {
+        for (i = 0; i <= STEPS; i++) {
+            a = 2 * M_PI * i / STEPS;
+            path[i][0] = size[0] * cos(a);
+            path[i][1] = size[1] * sin(a);
+        }
+        add_path_2d(rend, painter, pos, angle, STEPS + 1, path);
+        return;
+    }
+
+    da = 2 * M_PI / dashes;
+    for (a = 0; a < 2 * M_PI; a += da) {
+        for (i = 0; i <= DASH_STEPS; i++) {
+            path[i][0] = size[0] * cos(a + da / 2 * i / DASH_STEPS);
+            path[i][1] = size[1] * sin(a + da / 2 * i / DASH_STEPS);
+        }
+        add_path_2d(rend, painter, pos, angle, DASH_STEPS + 1, path);
+    }
+}
+
+static void rect_2d(renderer_t *rend_, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const double path[5][2] = {
+        {-size[0], -size[1]}, {+size[0], -size[1]}, {+size[0], +size[1]},
+        {-size[0], +size[1]}, {-size[0], -size[1]}};
+    add_path_2d(rend, painter, pos, angle, 5, path);
+}
+
+static void line_2d(renderer_t *rend_, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    renderer_soft_t *rend = (void*)rend_;
+    const double path[2][2] = {{0, 0}, {p2[0] - p1[0], p2[1] - p1[1]}};
+    add_path_2d(rend, painter, p1, 0, 2, path);
+}
+
+/******** Rasterization ***************************************************/
+
+static inline void texel(const uint8_t *d, int bpp, float out[4])
+{
+    switch (bpp) {
+    case 1:
+        out[0] = out[1] = out[2] = d[0] / 255.f;
+        out[3] = 1;
+        break;
+    case 2:
+        out[0] = out[1] = out[2] = d[0] / 255.f;
+        out[3] = d[1] / 255.f;
+        break;
+    case 3:
+        out[0] = d[0] / 255.f;
+        out[1] = d[1] / 255.f;
+        out[2] = d[2] / 255.f;
+        out[3] = 1;
+        break;
+    default:
+        out[0] = d[0] / 255.f;
+        out[1] = d[1] / 255.f;
+        out[2] = d[2] / 255.f;
+        out[3] = d[3] / 255.f;
+        break;
+    }
+}
+
+// Bilinear sampling of an image, with clamp to edge.
+static void sample(const image_t *img, float u, float v, float out[4])
+{
+    float x, y, fx, fy, t[4][4];
+    int x0, y0, x1, y1, k;
+
+    x = clamp(u * img->w - 0.5f, 0.0f, img->w - 1.0f);
+    y = clamp(v * img->h - 0.5f, 0.0f, img->h - 1.0f);
+    x0 = (int)x;
+    y0 = (int)y;
+    x1 = min(x0 + 1, img->w - 1);
+    y1 = min(y0 + 1, img->h - 1);
+    fx = x - x0;
+    fy = y - y0;
+    texel(img->data + (y0 * img->w + x0) * img->bpp, img->bpp, t[0]);
+    texel(img->data + (y0 * img->w + x1) * img->bpp, img->bpp, t[1]);
+    texel(img->data + (y1 * img->w + x0) * img->bpp, img->bpp, t[2]);
+    texel(img->data + (y1 * img->w + x1) * img->bpp, img->bpp, t[3]);
+    for (k = 0; k < 4; k++) {
+        out[k] = (t[0][k] * (1 - fx) + t[1][k] * fx) * (1 - fy) +
+                 (t[2][k] * (1 - fx) + t[3][k] * fx) * fy;
+    }
+}
+
+static inline void blend(float dst[3], const float c[4], int mode)
+{
+    int i;
+    switch (mode) {
+    case BLEND_ALPHA:
+        for (i = 0; i < 3; i++) dst[i] = c[i] * c[3] + dst[i] * (1 - c[3]);
+        break;
+    case BLEND_ADD:
+        for (i = 0; i < 3; i++) dst[i] = min(dst[i] + c[i], 1.0f);
+        break;
+    case BLEND_ADD_ALPHA:
+        for (i = 0; i < 3; i++) dst[i] = min(dst[i] + c[i] * c[3], 1.0f);
+        break;
+    }
+}
+
+static inline float plane(const float e[3], float x, float y)
+{
+    return e[0] * x + e[1] * y + e[2];
+}
+
+static void raster_triangle(const renderer_soft_t *rend, const prim_t *prim,
+                            float *tile, const int rect[4])
+{
+    const float (*e)[3] = prim->tri.e;
+    const image_t *img = prim->img >= 0 ? &rend->images[prim->img] : NULL;
+    float l, c[4], s[4], px, py, bound;
+    int x, y, i, x0, x1, y0, y1, xs, xe;
+
+    x0 = max(rect[0], (int)floorf(prim->bbox[0]));
+    y0 = max(rect[1], (int)floorf(prim->bbox[1]));
+    x1 = min(rect[2], (int)ceilf(prim->bbox[2]) + 1);
+    y1 = min(rect[3], (int)ceilf(prim->bbox[3]) + 1);
+
+    for (y = y0; y < y1; y++) {
+        py = y + 0.5f - prim->tri.o[1];
+        // Compute the row span covered by the triangle, with one pixel
+        // margin, the exact test is done for each pixel.
+        xs = x0;
+        xe = x1;
+        for (i = 0; i < 3; i++) {
+            if (e[i][0] == 0) {
+                if (e[i][1] * py + e[i][2] < 0) xe = xs;
+                continue;
+            }
+            bound = -(e[i][1] * py + e[i][2]) / e[i][0] + prim->tri.o[0];
+            bound = clamp(bound, x0 - 1.0f, x1 + 1.0f);
+            if (e[i][0] > 0)
+                xs = max(xs, (int)floorf(bound - 0.5f));
+            else
+                xe = min(xe, (int)ceilf(bound - 0.5f) + 1);
+        }
+
+        for (x = xs; x < xe; x++) {
+            px = x + 0.5f - prim->tri.o[0];
+            for (i = 0; i < 3; i++) {
+                l = plane(e[i], px, py);
+                if (l < 0) break;
+                if (l == 0 && !(prim->flags & (PRIM_TOP_LEFT_0 << i))) break;
+            }
+            if (i < 3) continue;
+            for (i = 0; i < 4; i++) c[i] = plane(prim->tri.c[i], px, py);
+            if (img) {
+                sample(img, plane(prim->tri.uv[0], px, py),
+                            plane(prim->tri.uv[1], px, py), s);
+                if (prim->flags & PRIM_TEX_LUMINANCE) {
+                    c[3] *= s[0];
+                } else {
+                    for (i = 0; i < 4; i++) c[i] *= s[i];
+                }
+            }
+            blend(&tile[((y - rect[1]) * TILE_SIZE + (x - rect[0])) * 3],
+                  c, prim->blend);
+        }
+    }
+}
+
+static void raster_point(const prim_t *prim, float *tile, const int rect[4])
+{
+    int x, y, x0, x1, y0, y1;
+    float d, k, c[4];
+    const float core = prim->point.core;
+
+    x0 = max(rect[0], (int)floorf(prim->bbox[0]));
+    y0 = max(rect[1], (int)floorf(prim->bbox[1]));
+    x1 = min(rect[2], (int)ceilf(prim->bbox[2]) + 1);
+    y1 = min(rect[3], (int)ceilf(prim->bbox[3]) + 1);
+    memcpy(c, prim->point.c, sizeof(c));
+
+    for (y = y0; y < y1; y++)
+    for (x = x0; x < x1; x++) {
+        d = hypotf(x + 0.5f - prim->point.pos[0],
+                   y + 0.5f - prim->point.pos[1]) / prim->point.r;
+        if (d >= 1) continue;
+        // Same as the points shader.
+        k = smoothstep(core * 1.25, core * 0.75, d);
+        k += smoothstep(1.0, 0.0, d) * 0.08;
+        c[3] = prim->point.c[3] * clamp(k, 0.0f, 1.0f);
+        blend(&tile[((y - rect[1]) * TILE_SIZE + (x - rect[0])) * 3],
+              c, prim->blend);
+    }
+}
+
+static void raster_line(const renderer_soft_t *rend, const prim_t *prim,
+                        float *tile, const int rect[4])
+{
+    int x, y, x0, x1, y0, y1;
+    float d[2], v[2], len2, t, dist, base, glow, c[4], s, z, hw;
+    const float (*p)[2] = prim->line.p;
+    const float dash_len = prim->line.dash_len;
+    const float r = prim->line.dash_ratio;
+
+    d[0] = p[1][0] - p[0][0];
+    d[1] = p[1][1] - p[0][1];
+    len2 = d[0] * d[0] + d[1] * d[1];
+    if (len2 == 0) return;
+    hw = prim->line.width / 2;
+
+    x0 = max(rect[0], (int)floorf(prim->bbox[0]));
+    y0 = max(rect[1], (int)floorf(prim->bbox[1]));
+    x1 = min(rect[2], (int)ceilf(prim->bbox[2]) + 1);
+    y1 = min(rect[3], (int)ceilf(prim->bbox[3]) + 1);
+    memcpy(c, prim->line.c, sizeof(c));
+
+    for (y = y0; y < y1; y++)
+    for (x = x0; x < x1; x++) {
+        v[0] = x + 0.5f - p[0][0];
+        v[1] = y + 0.5f - p[0][1];
+        // No caps, like the lines meshes.
+        t = (v[0] * d[0] + v[1] * d[1]) / len2;
+        if (t < 0 || t >= 1) continue;
+        dist = fabsf(v[0] * d[1] - v[1] * d[0]) / sqrtf(len2);
+        base = 1 - smoothstep(hw - prim->line.aa, hw + prim->line.aa, dist);
+        glow = prim->line.glow_r ?
+               (1 - dist / prim->line.glow_r) * prim->line.glow : 0;
+        c[3] = prim->line.c[3] * max(max(glow, base), 0.0f);
+        if (c[3] <= 0) continue;
+        if (dash_len) {
+            s = prim->line.len + t * sqrtf(len2);
+            s = s - dash_len * floorf(s / dash_len);
+            c[3] *= smoothstep(dash_len / 2 * r + 0.01 * rend->scale,
+                               dash_len / 2 * r - 0.01 * rend->scale,
+                               fabsf(s - dash_len / 2));
+        }
+        if (prim->line.fade[0]) {
+            z = mix(prim->line.z[0], prim->line.z[1], t);
+            c[3] *= smoothstep(prim->line.fade[1], prim->line.fade[0], z);
+        }
+        blend(&tile[((y - rect[1]) * TILE_SIZE + (x - rect[0])) * 3],
+              c, prim->blend);
+    }
+}
+
+static void render_tile(renderer_soft_t *rend, int tile_idx)
+{
+    float tile[TILE_SIZE * TILE_SIZE * 3] = {};
+    const bin_t *bin = &rend->bins[tile_idx];
+    const prim_t *prim;
+    int i, x, y, k, rect[4];
+    uint8_t *dst;
+
+    rect[0] = (tile_idx % rend->tiles[0]) * TILE_SIZE;
+    rect[1] = (tile_idx / rend->tiles[0]) * TILE_SIZE;
+    rect[2] = min(rect[0] + TILE_SIZE, rend->fb_size[0]);
+    rect[3] = min(rect[1] + TILE_SIZE, rend->fb_size[1]);
+
+    for (i = 0; i < bin->nb; i++) {
+        prim = &rend->prims[bin->idx[i]];
+        switch (prim->type) {
+        case PRIM_TRIANGLE:
+            raster_triangle(rend, prim, tile, rect);
+            break;
+        case PRIM_POINT:
+            raster_point(prim, tile, rect);
+            break;
+        case PRIM_LINE:
+            raster_line(rend, prim, tile, rect);
+            break;
+        }
+    }
+
+    for (y = rect[1]; y < rect[3]; y++)
+    for (x = rect[0]; x < rect[2]; x++) {
+        dst = &rend->buf[(y * rend->fb_size[0] + x) * 4];
+        for (k = 0; k < 3; k++) {
+            dst[k] = clamp(tile[((y - rect[1]) * TILE_SIZE +
+                           (x - rect[0])) * 3 + k], 0.0f, 1.0f) * 255 + 0.5;
+        }
+        dst[3] = 255;
+    }
+}
+
+static void render_tile_job(void *user, int tile)
+{
+    PROFILE(render_soft_tile, PROFILE_AGGREGATE);
+    render_tile(user, tile);
+}
+
+static void bin_prims(renderer_soft_t *rend)
+{
+    int i, x, y, x0, x1, y0, y1;
+    const prim_t *prim;
+    bin_t *bin;
+
+    for (i = 0; i < rend->tiles[0] * rend->tiles[1]; i++)
+        rend->bins[i].nb = 0;
+
+    for (i = 0; i < rend->prims_nb; i++) {
+        prim = &rend->prims[i];
+        x0 = max(0, (int)floorf(prim->bbox[0]) / TILE_SIZE);
+        y0 = max(0, (int)floorf(prim->bbox[1]) / TILE_SIZE);
+        x1 = min(rend->tiles[0] - 1, (int)ceilf(prim->bbox[2]) / TILE_SIZE);
+        y1 = min(rend->tiles[1] - 1, (int)ceilf(prim->bbox[3]) / TILE_SIZE);
+        for (y = y0; y <= y1; y++)
+        for (x = x0; x <= x1; x++) {
+            bin = &rend->bins[y * rend->tiles[0] + x];
+            if (bin->nb >= bin->size) {
+                bin->size = max(64, bin->size * 2);
+                bin->idx = realloc(bin->idx, bin->size * sizeof(*bin->idx));
+            }
+            bin->idx[bin->nb++] = i;
+        }
+    }
+}
+
+static void finish(renderer_t *rend_)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    int i, nb;
+    PROFILE(render_soft_finish, 0);
+
+    bin_prims(rend);
+    nb = rend->tiles[0] * rend->tiles[1];
+    if (rend->parallel) {
+        worker_parallel_for(nb, render_tile_job, rend);
+    } else {
+        for (i = 0; i < nb; i++) render_tile(rend, i);
+    }
+
+    release_images(rend);
+}
+
+static void on_fons_error(void *user, int error, int val)
+{
+    renderer_soft_t *rend = user;
+    // We copy the glyphs bitmaps as soon as they are rendered, so we can
+    // simply reset the atlas when it is full.
+    if (error == FONS_ATLAS_FULL)
+        fonsResetAtlas(rend->fons, ATLAS_SIZE, ATLAS_SIZE);
+}
+
+static int add_font(renderer_soft_t *rend, const char *name,
+                    const char *url)
+{
+    const void *data;
+    int size;
+    data = asset_get_data(url, &size, NULL);
+    if (!data) {
+        LOG_E("Cannot load font %s", url);
+        return FONS_INVALID;
+    }
+    return fonsAddFontMem(rend->fons, name, (void*)data, size, 0);
+}
+
+renderer_t *render_soft_create(bool parallel)
+{
+    renderer_soft_t *rend;
+    FONSparams params = {
+        .width = ATLAS_SIZE,
+        .height = ATLAS_SIZE,
+        .flags = FONS_ZERO_TOPLEFT,
+    };
+
+    rend = calloc(1, sizeof(*rend));
+    rend->parallel = parallel;
+    texture_set_keep_data(true);
+
+    rend->fons = fonsCreateInternal(&params);
+    fonsSetErrorCallback(rend->fons, on_fons_error, rend);
+    rend->fonts[0] = add_font(rend, "regular",
+                              "asset://font/NotoSans-Regular.ttf");
+    rend->fonts[1] = add_font(rend, "bold",
+                              "asset://font/NotoSans-Bold.ttf");
+
+    rend->rend.prepare = prepare;
+    rend->rend.finish = finish;
+    rend->rend.points_2d = points_2d;
+    rend->rend.quad = quad;
+    rend->rend.quad_wireframe = quad_wireframe;
+    rend->rend.texture = texture;
+    rend->rend.text = text;
+    rend->rend.line = line;
+    rend->rend.mesh = mesh;
+    rend->rend.ellipse_2d = ellipse_2d;
+    rend->rend.rect_2d = rect_2d;
+    rend->rend.line_2d = line_2d;
+    return &rend->rend;
+}
+
+void render_soft_release(renderer_t *rend_)
+{
+    renderer_soft_t *rend = (void*)rend_;
+    int i;
+    if (!rend) return;
+    release_images(rend);
+    for (i = 0; i < rend->tiles[0] * rend->tiles[1]; i++)
+        free(rend->bins[i].idx);
+    free(rend->bins);
+    free(rend->prims);
+    free(rend->images);
+    free(rend->buf);
+    fonsDeleteInternal(rend->fons);
+    free(rend);
+}
+
+const uint8_t *render_soft_get_buffer(const renderer_t *rend_, int *w, int *h)
+{
+    const renderer_soft_t *rend = (const void*)rend_;
+    *w = rend->fb_size[0];
+    *h = rend->fb_size[1];
+    return rend->buf;
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_render_soft(void)
+{
+    renderer_t *rend;
+    projection_t proj;
+    const uint8_t *img, *px;
+    uint8_t *png;
+    int w, h, size;
+    uint8_t tex_data[4 * 4 * 3];
+    texture_t *tex;
+    const double quad_uv[4][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+
+    texture_set_headless(true);
+    rend = render_soft_create(true);
+    projection_init(&proj, PROJ_STEREOGRAPHIC, 90 * DD2R, 128, 128);
+    painter_t painter = {
+        .rend = rend,
+        .obs = core->observer,
+        .proj = &proj,
+        .points_halo = 1.0,
+        .color = {1, 1, 1, 1},
+        .lines.width = 3,
+    };
+
+    // A red texture, a white point, and a green line.
+    memset(tex_data, 0, sizeof(tex_data));
+    for (w = 0; w < 16; w++) tex_data[w * 3] = 255;
+    tex = texture_from_data(tex_data, 4, 4, 3, 0, 0, 4, 4, 0);
+    assert(tex->data && tex->bpp == 3);
+
+    paint_prepare(&painter, 128, 128, 1);
+    paint_texture(&painter, tex, quad_uv, VEC(32, 32), 32, NULL, 0);
+    paint_2d_points(&painter, 1, &(point_t){
+            .pos = {96, 32}, .size = 8, .color = {255, 255, 255, 255}});
+    painter.color[0] = 0;
+    painter.color[2] = 0;
+    paint_2d_line(&painter, NULL, VEC(0, 96), VEC(128, 96));
+    paint_finish(&painter);
+
+    img = render_soft_get_buffer(rend, &w, &h);
+    assert(w == 128 && h == 128);
+    px = &img[(32 * 128 + 32) * 4];
+    assert(px[0] == 255 && px[1] == 0 && px[2] == 0 && px[3] == 255);
+    px = &img[(32 * 128 + 96) * 4];
+    assert(px[0] == 255 && px[1] == 255 && px[2] == 255);
+    px = &img[(96 * 128 + 64) * 4];
+    assert(px[0] == 0 && px[1] == 255 && px[2] == 0);
+    px = &img[(64 * 128 + 64) * 4];
+    assert(px[0] == 0 && px[1] == 0 && px[2] == 0);
+
+    png = img_encode(img, w, h, 4, "png", 0, &size);
+    assert(png && size > 8 && memcmp(png + 1, "PNG", 3) == 0);
+    free(png);
+#ifdef HAVE_WEBP_ENCODER
+    uint8_t *webp, *dec;
+    int bpp = 0;
+    webp = img_encode(img, w, h, 4, "webp", 0, &size);
+    assert(webp);
+    dec = img_read_from_mem(webp, size, &w, &h, &bpp);
+    assert(dec && w == 128 && h == 128 && bpp == 4);
+    assert(memcmp(dec, img, 128 * 128 * 4) == 0);
+    free(dec);
+    free(webp);
+#endif
+
+    texture_release(tex);
+    render_soft_release(rend);
+    texture_set_keep_data(false);
+    texture_set_headless(false);
+}
+
+TEST_REGISTER(NULL, test_render_soft, TEST_AUTO);
+
+#endif
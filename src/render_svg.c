@@ -9,47 +9,707 @@
 
 #include "swe.h"
 
-// Support for svg rendering.
-// Still experimental.
+#include "fontstash.h"
+
+#include <zlib.h>
+
+// Vector renderer, used to export star charts as SVG or PDF.
+//
+// The page has the size of the window, and all the coordinates are in
+// window units.  The output is streamed to the file through a fixed size
+// buffer, so that the memory usage doesn't depend on the number of
+// elements.  Everything outside of the page is culled, and consecutive
+// primitives with the same style are merged into a single path, so that
+// a chart with hundreds of thousands of stars stays reasonably small.
+//
+// Only the vector primitives are supported: the textured quads (HiPS
+// surveys, atmosphere, planets textures) are not exported.
+
+#define BUF_SIZE (64 * 1024)
+// Max number of commands in a single path element.
+#define MAX_RUN 4096
+// Margin around the page for the culling, in window units.
+#define CULL_MARGIN 16
+
+// PDF objects numbers.
+enum {
+    OBJ_CATALOG = 1,
+    OBJ_PAGES,
+    OBJ_PAGE,
+    OBJ_FONT,
+    OBJ_FONT_BOLD,
+    OBJ_CONTENT,
+    OBJ_LENGTH,
+    OBJ_COUNT,
+};
+
+// Path styles.
+enum {
+    STYLE_NONE = 0,
+    STYLE_STROKE,
+    STYLE_FILL,
+};
+
+typedef struct {
+    FILE        *file;
+    long        pos;        // Number of bytes written to the file.
+    bool        deflate;    // Set to compress the data.
+    bool        error;      // Set if a write failed.
+    z_stream    z;
+    int         len;
+    char        buf[BUF_SIZE];
+} writer_t;
+
+typedef struct {
+    int         type;
+    uint8_t     color[4];
+    float       width;
+    float       dash[2];
+} style_t;
 
 typedef struct {
     renderer_t  rend;
-    FILE        *out;
+    char        *path;
+    FILE        *file;          // Opened at creation for the first frame.
+    bool        pdf;
+    writer_t    *out;
+    double      size[2];
+    style_t     style;          // Style of the current path run.
+    int         run_len;        // Number of commands in the current run.
+    bool        need_move;      // Set if the next path point starts a new
+                                // sub path.
+    double      last[2];        // Last point of the current sub path.
+    long        offsets[OBJ_COUNT];
+    long        stream_start;
+    FONScontext *fons;
+    int         fonts[2];
+    bool        error;          // Set if a frame could not be written.
 } renderer_svg_t;
 
-static void prepare(renderer_t *rend_, double w, double h, double scale,
-                    bool cull_flipped)
+/******** Buffered writer *************************************************/
+
+static void out_flush(writer_t *w)
+{
+    if (!w->len) return;
+    if (fwrite(w->buf, 1, w->len, w->file) != w->len) w->error = true;
+    w->pos += w->len;
+    w->len = 0;
+}
+
+static void out_write(writer_t *w, const void *data, int len)
+{
+    if (w->deflate) {
+        w->z.next_in = (void*)data;
+        w->z.avail_in = len;
+        do {
+            w->z.next_out = (void*)(w->buf + w->len);
+            w->z.avail_out = BUF_SIZE - w->len;
+            deflate(&w->z, Z_NO_FLUSH);
+            w->len = BUF_SIZE - w->z.avail_out;
+            if (w->z.avail_out == 0) out_flush(w);
+        } while (w->z.avail_in);
+        return;
+    }
+    if (w->len + len > BUF_SIZE) out_flush(w);
+    if (len > BUF_SIZE) {
+        if (fwrite(data, 1, len, w->file) != len) w->error = true;
+        w->pos += len;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void out_str(writer_t *w, const char *str)
+{
+    out_write(w, str, strlen(str));
+}
+
+__attribute__((format(printf, 2, 3)))
+static void out_printf(writer_t *w, const char *fmt, ...)
+{
+    char buf[1024];
+    va_list ap;
+    int len;
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    out_write(w, buf, min(len, (int)sizeof(buf) - 1));
+}
+
+// Write a number with up to 'prec' decimals and no trailing zeros.
+// This is a lot faster than printf, and most of the output is numbers.
+static void out_num(writer_t *w, double v, int prec)
+{
+    const int MULS[] = {1, 10, 100, 1000};
+    char tmp[32];
+    int n = sizeof(tmp), d;
+    long long i, ip, frac;
+    bool neg;
+
+    i = llround(clamp(v, -1e12, 1e12) * MULS[prec]);
+    neg = i < 0;
+    if (neg) i = -i;
+    ip = i / MULS[prec];
+    frac = i % MULS[prec];
+    for (d = 0; d < prec && frac % 10 == 0; d++) frac /= 10;
+    if (d < prec) {
+        for (; d < prec; d++) {
+            tmp[--n] = '0' + frac % 10;
+            frac /= 10;
+        }
+        tmp[--n] = '.';
+    }
+    do {
+        tmp[--n] = '0' + ip % 10;
+        ip /= 10;
+    } while (ip);
+    if (neg && i) tmp[--n] = '-';
+    out_write(w, tmp + n, sizeof(tmp) - n);
+}
+
+static void out_deflate_begin(writer_t *w)
+{
+    out_flush(w);
+    memset(&w->z, 0, sizeof(w->z));
+    deflateInit(&w->z, Z_BEST_SPEED);
+    w->deflate = true;
+}
+
+static void out_deflate_end(writer_t *w)
+{
+    int r;
+    w->z.next_in = NULL;
+    w->z.avail_in = 0;
+    do {
+        w->z.next_out = (void*)(w->buf + w->len);
+        w->z.avail_out = BUF_SIZE - w->len;
+        r = deflate(&w->z, Z_FINISH);
+        w->len = BUF_SIZE - w->z.avail_out;
+        out_flush(w);
+    } while (r == Z_OK);
+    deflateEnd(&w->z);
+    w->deflate = false;
+}
+
+/******** Paths ***********************************************************/
+
+static void style_set_color(style_t *style, const double color[4])
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        style->color[i] = round(clamp(color[i], 0.0, 1.0) * 255);
+}
+
+// Write a color, as an svg hex string or as pdf rgb values.
+static void out_color(renderer_svg_t *rend, const uint8_t color[4])
+{
+    int i;
+    if (!rend->pdf) {
+        out_printf(rend->out, "#%02x%02x%02x",
+                   color[0], color[1], color[2]);
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        out_num(rend->out, color[i] / 255.0, 3);
+        out_str(rend->out, " ");
+    }
+}
+
+// Set the pdf alpha, using one of the predefined graphic states.
+static void out_pdf_alpha(renderer_svg_t *rend, uint8_t alpha)
+{
+    out_printf(rend->out, "/GS%d gs\n", (int)round(alpha / 255.0 * 16));
+}
+
+static void run_end(renderer_svg_t *rend)
+{
+    if (rend->style.type == STYLE_NONE) return;
+    if (!rend->pdf)
+        out_str(rend->out, "'/>\n");
+    else
+        out_str(rend->out, rend->style.type == STYLE_FILL ? "f\n" : "S\n");
+    rend->style.type = STYLE_NONE;
+}
+
+// Start a new path run, or keep adding to the current one if the style
+// didn't change.
+static void run_begin(renderer_svg_t *rend, const style_t *style)
+{
+    writer_t *out = rend->out;
+    const style_t *s = style;
+
+    if (rend->style.type != STYLE_NONE && rend->run_len < MAX_RUN &&
+            memcmp(&rend->style, style, sizeof(*style)) == 0) {
+        return;
+    }
+    run_end(rend);
+    rend->style = *style;
+    rend->run_len = 0;
+    rend->need_move = true;
+
+    if (rend->pdf) {
+        out_color(rend, s->color);
+        out_str(out, s->type == STYLE_FILL ? "rg\n" : "RG\n");
+        out_pdf_alpha(rend, s->color[3]);
+        if (s->type == STYLE_STROKE) {
+            out_num(out, s->width, 2);
+            out_str(out, " w [");
+            if (s->dash[0]) {
+                out_num(out, s->dash[0], 2);
+                out_str(out, " ");
+                out_num(out, s->dash[1], 2);
+            }
+            out_str(out, "] 0 d\n");
+        }
+        return;
+    }
+
+    if (s->type == STYLE_FILL) {
+        out_str(out, "<path fill='");
+        out_color(rend, s->color);
+        if (s->color[3] != 255)
+            out_printf(out, "' fill-opacity='%.3g", s->color[3] / 255.0);
+    } else {
+        out_str(out, "<path fill='none' stroke='");
+        out_color(rend, s->color);
+        if (s->color[3] != 255)
+            out_printf(out, "' stroke-opacity='%.3g", s->color[3] / 255.0);
+        out_str(out, "' stroke-width='");
+        out_num(out, s->width, 2);
+        if (s->dash[0]) {
+            out_str(out, "' stroke-dasharray='");
+            out_num(out, s->dash[0], 2);
+            out_str(out, " ");
+            out_num(out, s->dash[1], 2);
+        }
+    }
+    out_str(out, "' d='");
+}
+
+static void path_point(renderer_svg_t *rend, const double p[2], bool move)
+{
+    writer_t *out = rend->out;
+    if (!rend->pdf) out_str(out, move ? "M" : "L");
+    out_num(out, p[0], 2);
+    out_str(out, rend->pdf ? " " : ",");
+    out_num(out, p[1], 2);
+    if (rend->pdf) out_str(out, move ? " m\n" : " l\n");
+    vec2_copy(p, rend->last);
+    rend->need_move = false;
+    rend->run_len++;
+}
+
+static void path_close(renderer_svg_t *rend)
+{
+    out_str(rend->out, rend->pdf ? "h\n" : "Z");
+    rend->need_move = true;
+}
+
+static bool bbox_visible(const renderer_svg_t *rend, const double bbox[4],
+                         double margin)
+{
+    margin += CULL_MARGIN;
+    return bbox[2] >= -margin && bbox[0] <= rend->size[0] + margin &&
+           bbox[3] >= -margin && bbox[1] <= rend->size[1] + margin;
+}
+
+static bool segment_visible(const renderer_svg_t *rend,
+                            const double a[2], const double b[2],
+                            double margin)
+{
+    const double bbox[4] = {min(a[0], b[0]), min(a[1], b[1]),
+                            max(a[0], b[0]), max(a[1], b[1])};
+    return bbox_visible(rend, bbox, margin);
+}
+
+// Add a polyline to the current stroke run, skipping the segments that
+// are outside of the page.
+static void add_polyline(renderer_svg_t *rend, const style_t *style,
+                         int n, const double (*p)[2])
+{
+    int i;
+    run_begin(rend, style);
+    for (i = 0; i < n - 1; i++) {
+        if (!segment_visible(rend, p[i], p[i + 1], style->width)) {
+            rend->need_move = true;
+            continue;
+        }
+        if (rend->need_move || rend->last[0] != p[i][0] ||
+                rend->last[1] != p[i][1])
+            path_point(rend, p[i], true);
+        path_point(rend, p[i + 1], false);
+    }
+}
+
+static void add_circle(renderer_svg_t *rend, const double pos[2], double r)
+{
+    writer_t *out = rend->out;
+    const double k = 0.5523 * r; // Bezier approximation of a quarter.
+    const double (*c)[2];
+    int i;
+
+    if (!rend->pdf) {
+        out_str(out, "M");
+        out_num(out, pos[0] - r, 2);
+        out_str(out, ",");
+        out_num(out, pos[1], 2);
+        out_str(out, "a");
+        out_num(out, r, 2);
+        out_str(out, ",");
+        out_num(out, r, 2);
+        out_str(out, " 0 1,0 ");
+        out_num(out, 2 * r, 2);
+        out_str(out, ",0a");
+        out_num(out, r, 2);
+        out_str(out, ",");
+        out_num(out, r, 2);
+        out_str(out, " 0 1,0 ");
+        out_num(out, -2 * r, 2);
+        out_str(out, ",0");
+        rend->run_len++;
+        return;
+    }
+
+    const double curves[4][3][2] = {
+        {{r, k}, {k, r}, {0, r}},
+        {{-k, r}, {-r, k}, {-r, 0}},
+        {{-r, -k}, {-k, -r}, {0, -r}},
+        {{k, -r}, {r, -k}, {r, 0}},
+    };
+    out_num(out, pos[0] + r, 2);
+    out_str(out, " ");
+    out_num(out, pos[1], 2);
+    out_str(out, " m\n");
+    for (i = 0; i < 4; i++) {
+        for (c = curves[i]; c < curves[i] + 3; c++) {
+            out_num(out, pos[0] + (*c)[0], 2);
+            out_str(out, " ");
+            out_num(out, pos[1] + (*c)[1], 2);
+            out_str(out, " ");
+        }
+        out_str(out, "c\n");
+    }
+    rend->run_len++;
+}
+
+/******** Renderer callbacks **********************************************/
+
+static void prepare(renderer_t *rend_, double win_w, double win_h,
+                    double scale, bool cull_flipped)
 {
     renderer_svg_t *rend = (void*)rend_;
-    fprintf(rend->out,
-            "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n");
+    writer_t *out;
+    int i;
+
+    rend->size[0] = win_w;
+    rend->size[1] = win_h;
+    rend->style.type = STYLE_NONE;
+    rend->out = out = calloc(1, sizeof(*out));
+    out->file = rend->file ?: fopen(rend->path, "wb");
+    rend->file = NULL;
+    if (!out->file) {
+        LOG_E("Cannot open %s", rend->path);
+        rend->error = true;
+        return;
+    }
+
+    if (!rend->pdf) {
+        out_printf(out,
+            "<svg xmlns='http://www.w3.org/2000/svg' version='1.1' "
+            "width='%g' height='%g' viewBox='0 0 %g %g'>\n"
+            "<rect width='100%%' height='100%%' fill='black'/>\n"
+            "<g font-family='Noto Sans, sans-serif'>\n",
+            win_w, win_h, win_w, win_h);
+        return;
+    }
+
+    out_str(out, "%PDF-1.4\n");
+    rend->offsets[OBJ_CATALOG] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Type /Catalog /Pages %d 0 R >>\n"
+               "endobj\n", OBJ_CATALOG, OBJ_PAGES);
+    rend->offsets[OBJ_PAGES] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Type /Pages /Kids [%d 0 R] "
+               "/Count 1 >>\nendobj\n", OBJ_PAGES, OBJ_PAGE);
+    rend->offsets[OBJ_PAGE] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Type /Page /Parent %d 0 R "
+               "/MediaBox [0 0 %g %g] /Contents %d 0 R\n"
+               "/Resources << /Font << /F1 %d 0 R /F2 %d 0 R >>\n"
+               "/ExtGState <<\n",
+               OBJ_PAGE, OBJ_PAGES, win_w, win_h, OBJ_CONTENT,
+               OBJ_FONT, OBJ_FONT_BOLD);
+    // Graphic states for the alpha values, quantized to 1/16.
+    for (i = 0; i <= 16; i++)
+        out_printf(out, "/GS%d << /ca %g /CA %g >>\n", i, i / 16.0,
+                   i / 16.0);
+    out_str(out, ">> >> >>\nendobj\n");
+    rend->offsets[OBJ_FONT] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Type /Font /Subtype /Type1 "
+               "/BaseFont /Helvetica /Encoding /WinAnsiEncoding >>\n"
+               "endobj\n", OBJ_FONT);
+    rend->offsets[OBJ_FONT_BOLD] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Type /Font /Subtype /Type1 "
+               "/BaseFont /Helvetica-Bold /Encoding /WinAnsiEncoding >>\n"
+               "endobj\n", OBJ_FONT_BOLD);
+    rend->offsets[OBJ_CONTENT] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n<< /Length %d 0 R /Filter /FlateDecode >>\n"
+               "stream\n", OBJ_CONTENT, OBJ_LENGTH);
+    out_flush(out);
+    rend->stream_start = out->pos;
+    out_deflate_begin(out);
+    // Flip the y axis so that we can use window coordinates, and fill
+    // the background.
+    out_printf(out, "1 0 0 -1 0 %g cm\n0 0 0 rg 0 0 %g %g re f\n",
+               win_h, win_w, win_h);
 }
 
 static void finish(renderer_t *rend_)
 {
     renderer_svg_t *rend = (void*)rend_;
-    fprintf(rend->out, "</svg>\n");
-    fclose(rend->out);
+    writer_t *out = rend->out;
+    long length, xref;
+    int i;
+
+    if (!out->file) goto end;
+    run_end(rend);
+    if (!rend->pdf) {
+        out_str(out, "</g>\n</svg>\n");
+        out_flush(out);
+        goto end;
+    }
+
+    out_deflate_end(out);
+    length = out->pos - rend->stream_start;
+    out_str(out, "\nendstream\nendobj\n");
+    rend->offsets[OBJ_LENGTH] = out->pos + out->len;
+    out_printf(out, "%d 0 obj\n%ld\nendobj\n", OBJ_LENGTH, length);
+    xref = out->pos + out->len;
+    out_printf(out, "xref\n0 %d\n0000000000 65535 f \n", OBJ_COUNT);
+    for (i = 1; i < OBJ_COUNT; i++)
+        out_printf(out, "%010ld 00000 n \n", rend->offsets[i]);
+    out_printf(out, "trailer\n<< /Size %d /Root %d 0 R >>\n"
+               "startxref\n%ld\n%%%%EOF\n", OBJ_COUNT, OBJ_CATALOG, xref);
+    out_flush(out);
+
+end:
+    if (out->file && fclose(out->file) != 0) out->error = true;
+    if (out->error) {
+        LOG_E("Cannot write %s", rend->path);
+        rend->error = true;
+    }
+    free(out);
+    rend->out = NULL;
+}
+
+static int point_color_cmp(const void *a_, const void *b_)
+{
+    const point_t *a = *(const point_t**)a_, *b = *(const point_t**)b_;
+    return memcmp(a->color, b->color, 4);
 }
 
-static void points(renderer_t *rend_, const painter_t *painter,
-                   int n,
-                   const point_t *points)
+static void points_2d(renderer_t *rend_, const painter_t *painter,
+                      int n, const point_t *points)
 {
     renderer_svg_t *rend = (void*)rend_;
+    style_t style = {STYLE_FILL};
+    const point_t *p, **sorted;
+    double bbox[4];
+    int i, k, nb = 0;
+
+    if (!rend->out->file) return;
+    // Sort the visible points by color, so that they can be merged into
+    // a few paths.
+    sorted = malloc(n * sizeof(*sorted));
+    for (i = 0; i < n; i++) {
+        p = &points[i];
+        bbox[0] = bbox[2] = p->pos[0];
+        bbox[1] = bbox[3] = p->pos[1];
+        if (bbox_visible(rend, bbox, p->size)) sorted[nb++] = p;
+    }
+    qsort(sorted, nb, sizeof(*sorted), point_color_cmp);
+    for (i = 0; i < nb; i++) {
+        // Quantize the colors to 4 bits, so that more points share the
+        // same style.
+        for (k = 0; k < 4; k++)
+            style.color[k] = (sorted[i]->color[k] & 0xf0) |
+                             (sorted[i]->color[k] >> 4);
+        run_begin(rend, &style);
+        add_circle(rend, sorted[i]->pos, sorted[i]->size);
+    }
+    free(sorted);
+}
+
+static void line(renderer_t *rend_, const painter_t *painter,
+                 const double (*line)[3], int size)
+{
+    renderer_svg_t *rend = (void*)rend_;
+    style_t style = {STYLE_STROKE};
+    double (*p)[2];
     int i;
-    double pos[4];
-    point_t p;
-    const double scale = 320;
+
+    if (!rend->out->file || size < 2) return;
+    style_set_color(&style, painter->color);
+    style.width = painter->lines.width;
+    if (painter->lines.dash_length && painter->lines.dash_ratio < 1) {
+        style.dash[0] = painter->lines.dash_length *
+                        painter->lines.dash_ratio;
+        style.dash[1] = painter->lines.dash_length - style.dash[0];
+    }
+    p = malloc(size * sizeof(*p));
+    for (i = 0; i < size; i++) vec2_copy(line[i], p[i]);
+    add_polyline(rend, &style, size, (void*)p);
+    free(p);
+}
+
+static void mesh(renderer_t *rend_, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint32_t indices[])
+{
+    renderer_svg_t *rend = (void*)rend_;
+    style_t style = {mode == MODE_TRIANGLES ? STYLE_FILL : STYLE_STROKE};
+    double pos[4], (*p)[2], bbox[4];
+    const double *v[3];
+    bool *visible;
+    int i, k, n = (mode == MODE_TRIANGLES) ? 3 : 2;
+
+    if (!rend->out->file) return;
+    style_set_color(&style, painter->color);
+    if (mode != MODE_TRIANGLES) style.width = painter->lines.width;
+
+    p = calloc(verts_count, sizeof(*p));
+    visible = calloc(verts_count, sizeof(*visible));
+    for (i = 0; i < verts_count; i++) {
+        vec3_copy(verts[i], pos);
+        pos[3] = 0.0;
+        vec3_normalize(pos, pos);
+        convert_frame(painter->obs, frame, FRAME_VIEW, true, pos, pos);
+        pos[3] = 0.0;
+        project(painter->proj, PROJ_ALREADY_NORMALIZED, pos, pos);
+        if (pos[3] <= 0.0) continue;
+        p[i][0] = (+pos[0] / pos[3] + 1) / 2 * rend->size[0];
+        p[i][1] = (-pos[1] / pos[3] + 1) / 2 * rend->size[1];
+        visible[i] = true;
+    }
+
+    for (i = 0; i + n <= indices_count; i += n) {
+        for (k = 0; k < n; k++) {
+            if (!visible[indices[i + k]]) break;
+            v[k] = p[indices[i + k]];
+        }
+        if (k < n) continue;
+        if (mode != MODE_TRIANGLES) {
+            add_polyline(rend, &style, 2, (const double (*)[2])v);
+            continue;
+        }
+        bbox[0] = min(v[0][0], min(v[1][0], v[2][0]));
+        bbox[1] = min(v[0][1], min(v[1][1], v[2][1]));
+        bbox[2] = max(v[0][0], max(v[1][0], v[2][0]));
+        bbox[3] = max(v[0][1], max(v[1][1], v[2][1]));
+        if (!bbox_visible(rend, bbox, 0)) continue;
+        run_begin(rend, &style);
+        for (k = 0; k < 3; k++) path_point(rend, v[k], k == 0);
+        path_close(rend);
+    }
+    free(p);
+    free(visible);
+}
+
+// Add a 2d path defined in a rotated and translated window space, like
+// with nanovg.
+static void add_path_2d(renderer_svg_t *rend, const painter_t *painter,
+                        const double pos[2], double angle,
+                        int n, const double (*path)[2])
+{
+    style_t style = {STYLE_STROKE};
+    double (*p)[2];
+    int i;
+
+    if (!rend->out->file) return;
+    style_set_color(&style, painter->color);
+    style.width = painter->lines.width;
+    p = malloc(n * sizeof(*p));
     for (i = 0; i < n; i++) {
-        p = points[i];
-        if (!project(painter->proj, PROJ_TO_NDC_SPACE, pos, pos)) continue;
-        pos[0] = (pos[0] + 1.0) * scale;
-        pos[1] = (pos[1] + 1.0) * scale;
-        fprintf(rend->out,
-                "<circle cx='%f' cy='%f' r='%f' fill='black' />\n",
-                pos[0], pos[1],
-                tan(p.size / 2) / painter->proj->scaling[0] * scale);
+        vec2_rotate(angle, path[i], p[i]);
+        p[i][0] += pos[0];
+        p[i][1] += pos[1];
+    }
+    add_polyline(rend, &style, n, (void*)p);
+    free(p);
+}
+
+static void ellipse_2d(renderer_t *rend_, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double dashes)
+{
+    renderer_svg_t *rend = (void*)rend_;
+    const int STEPS = 64, DASH_STEPS = 4;
+    double path[STEPS + 1][2], a, da;
+    int i;
+
+    if (!dashes) {
+        for (i = 0; i <= STEPS; i++) {
+            a = 2 * M_PI * i / STEPS;
+            path[i][0] = size[0] * cos(a);
+            path[i][1] = size[1] * sin(a);
+        }
+        add_path_2d(rend, painter, pos, angle, STEPS + 1, path);
+        return;
+    }
+
+    da = 2 * M_PI / dashes;
+    for (a = 0; a < 2 * M_PI; a += da) {
+        for (i = 0; i <= DASH_STEPS; i++) {
+            path[i][0] = size[0] * cos(a + da / 2 * i / DASH_STEPS);
+            path[i][1] = size[1] * sin(a + da / 2 * i / DASH_STEPS);
+        }
+        add_path_2d(rend, painter, pos, angle, DASH_STEPS + 1, path);
+    }
+}
+
+static void rect_2d(renderer_t *rend_, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    renderer_svg_t *rend = (void*)rend_;
+    const double path[5][2] = {
+        {-size[0], -size[1]}, {+size[0], -size[1]}, {+size[0], +size[1]},
+        {-size[0], +size[1]}, {-size[0], -size[1]}};
+    add_path_2d(rend, painter, pos, angle, 5, path);
+}
+
+static void line_2d(renderer_t *rend_, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    renderer_svg_t *rend = (void*)rend_;
+    const double path[2][2] = {{0, 0}, {p2[0] - p1[0], p2[1] - p1[1]}};
+    add_path_2d(rend, painter, p1, 0, 2, path);
+}
+
+// Write a text string, escaped for svg or pdf.  Since we only use the
+// pdf standard fonts, the non latin-1 characters are replaced by '?'.
+static void out_text(renderer_svg_t *rend, const char *text)
+{
+    writer_t *out = rend->out;
+    int len, code;
+    char c;
+
+    for (; *text; text += len) {
+        len = u8_char_len(text);
+        if (!rend->pdf) {
+            switch (*text) {
+            case '&': out_str(out, "&amp;"); break;
+            case '<': out_str(out, "&lt;"); break;
+            case '>': out_str(out, "&gt;"); break;
+            case '"': out_str(out, "&quot;"); break;
+            default: out_write(out, text, len);
+            }
+            continue;
+        }
+        code = u8_char_code(text);
+        c = (code < 256) ? code : '?';
+        if (c == '(' || c == ')' || c == '\\') out_str(out, "\\");
+        out_write(out, &c, 1);
     }
 }
 
@@ -57,46 +717,247 @@ static void text(renderer_t *rend_, const char *text, const double pos[2],
                  int align, int effects, double size, const double color[4],
                  double angle, double bounds[4])
 {
-    double p[2];
     renderer_svg_t *rend = (void*)rend_;
-    const double scale = 320;
+    writer_t *out = rend->out;
+    const float font_scale = 1.38;
+    char buf[256];
+    float fbounds[4], spacing = 0;
+    double p[2], bbox[4];
+    uint8_t c[4];
+    FONStextIter iter;
+    int i, font = (effects & TEXT_BOLD) ? 1 : 0;
+
+    if (strlen(text) >= sizeof(buf)) {
+        LOG_W("Text too large: %s", text);
+        return;
+    }
+    if (effects & TEXT_SMALL_CAP)
+        u8_upper(buf, text, sizeof(buf) - 1);
+    else
+        strcpy(buf, text);
 
+    size *= font_scale;
+    if (effects & TEXT_SPACED) spacing = round(size * 0.2);
+    if (effects & TEXT_SEMI_SPACED) spacing = round(size * 0.05);
+    fonsClearState(rend->fons);
+    fonsSetFont(rend->fons, rend->fonts[font]);
+    fonsSetSize(rend->fons, size);
+    fonsSetAlign(rend->fons, align);
+    fonsSetSpacing(rend->fons, spacing);
+    fonsTextBounds(rend->fons, 0, 0, buf, NULL, fbounds);
+    for (i = 0; i < 4; i++) bbox[i] = pos[i % 2] + fbounds[i];
     if (bounds) {
-        // XXX: not true!
-        bounds[0] = 0;
-        bounds[1] = 0;
-        bounds[2] = u8_len(text) * 8;
-        bounds[3] = 8;
+        memcpy(bounds, bbox, sizeof(bbox));
+        return;
+    }
+    if (!out->file || !bbox_visible(rend, bbox, 0)) return;
+
+    // Position of the start of the baseline.
+    fonsTextIterInit(rend->fons, &iter, 0, 0, buf, NULL,
+                     FONS_GLYPH_BITMAP_OPTIONAL);
+    p[0] = iter.x;
+    p[1] = iter.y;
+    if (angle != 0.0) vec2_rotate(angle, p, p);
+    p[0] += pos[0];
+    p[1] += pos[1];
+    for (i = 0; i < 4; i++) c[i] = round(clamp(color[i], 0.0, 1.0) * 255);
+
+    run_end(rend);
+    if (rend->pdf) {
+        out_str(out, "BT\n");
+        out_color(rend, c);
+        out_str(out, "rg\n");
+        out_pdf_alpha(rend, c[3]);
+        out_printf(out, "/F%d ", font + 1);
+        out_num(out, size, 2);
+        out_str(out, " Tf ");
+        if (spacing) {
+            out_num(out, spacing, 2);
+            out_str(out, " Tc ");
+        }
+        out_num(out, cos(angle), 3);
+        out_str(out, " ");
+        out_num(out, sin(angle), 3);
+        out_str(out, " ");
+        out_num(out, sin(angle), 3);
+        out_str(out, " ");
+        out_num(out, -cos(angle), 3);
+        out_str(out, " ");
+        out_num(out, p[0], 2);
+        out_str(out, " ");
+        out_num(out, p[1], 2);
+        out_str(out, " Tm (");
+        out_text(rend, buf);
+        out_str(out, ") Tj\nET\n");
+        return;
     }
-    if (bounds) return;
 
-    p[0] = (pos[0] + 1.0) * scale;
-    p[1] = (pos[1] + 1.0) * scale;
-    fprintf(rend->out,
-            "<text x='%f' y='%f' fill='black'>%s</text>\n",
-            p[0], p[1], text);
+    out_str(out, "<text x='");
+    out_num(out, p[0], 2);
+    out_str(out, "' y='");
+    out_num(out, p[1], 2);
+    out_str(out, "' font-size='");
+    out_num(out, size, 2);
+    out_str(out, "' fill='");
+    out_color(rend, c);
+    if (c[3] != 255) out_printf(out, "' fill-opacity='%.3g", c[3] / 255.0);
+    if (font) out_str(out, "' font-weight='bold");
+    if (spacing) {
+        out_str(out, "' letter-spacing='");
+        out_num(out, spacing, 2);
+    }
+    if (angle != 0.0) {
+        out_str(out, "' transform='rotate(");
+        out_num(out, angle * DR2D, 2);
+        out_str(out, " ");
+        out_num(out, p[0], 2);
+        out_str(out, " ");
+        out_num(out, p[1], 2);
+        out_str(out, ")");
+    }
+    out_str(out, "'>");
+    out_text(rend, buf);
+    out_str(out, "</text>\n");
 }
 
-static void line(renderer_t           *rend_,
-                 const painter_t      *painter,
-                 const double         (*line)[3],
-                 int size)
+static int add_font(renderer_svg_t *rend, const char *name, const char *url)
 {
-    // Not supported yet.
+    const void *data;
+    int size;
+    data = asset_get_data(url, &size, NULL);
+    if (!data) {
+        LOG_E("Cannot load font %s", url);
+        return FONS_INVALID;
+    }
+    return fonsAddFontMem(rend->fons, name, (void*)data, size, 0);
 }
 
-renderer_t *render_svg_create(const char *out)
+static renderer_t *create(const char *out, bool pdf)
 {
-    renderer_svg_t *rend = calloc(1, sizeof(*rend));
-    rend->out = fopen(out, "w");
-    assert(rend->out);
+    renderer_svg_t *rend;
+    FILE *file;
+    FONSparams params = {
+        .width = 512,
+        .height = 512,
+        .flags = FONS_ZERO_TOPLEFT,
+    };
+
+    file = fopen(out, "wb");
+    if (!file) {
+        LOG_E("Cannot open %s", out);
+        return NULL;
+    }
+    rend = calloc(1, sizeof(*rend));
+    rend->file = file;
+    rend->path = strdup(out);
+    rend->pdf = pdf;
+    // Only used to compute the text metrics.
+    rend->fons = fonsCreateInternal(&params);
+    rend->fonts[0] = add_font(rend, "regular",
+                              "asset://font/NotoSans-Regular.ttf");
+    rend->fonts[1] = add_font(rend, "bold",
+                              "asset://font/NotoSans-Bold.ttf");
 
     rend->rend.prepare = prepare;
     rend->rend.finish = finish;
-    rend->rend.points_2d = points;
+    rend->rend.points_2d = points_2d;
     rend->rend.text = text;
     rend->rend.line = line;
+    rend->rend.mesh = mesh;
+    rend->rend.ellipse_2d = ellipse_2d;
+    rend->rend.rect_2d = rect_2d;
+    rend->rend.line_2d = line_2d;
     return &rend->rend;
 }
 
+renderer_t *render_svg_create(const char *out)
+{
+    return create(out, false);
+}
+
+renderer_t *render_pdf_create(const char *out)
+{
+    return create(out, true);
+}
+
+int render_svg_release(renderer_t *rend_)
+{
+    renderer_svg_t *rend = (void*)rend_;
+    int ret;
+    if (!rend) return 0;
+    ret = rend->error ? -1 : 0;
+    if (rend->file) fclose(rend->file);
+    fonsDeleteInternal(rend->fons);
+    free(rend->path);
+    free(rend);
+    return ret;
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_render_svg(void)
+{
+    const char *exts[] = {"svg", "pdf"};
+    char path[1024];
+    const double color[4] = {1, 1, 1, 1};
+    const double l[4][3] = {{-100, 10}, {-50, 10}, {10, 10}, {10, 50}};
+    point_t points[2] = {
+        {.pos = {20, 20}, .size = 2, .color = {255, 255, 255, 255}},
+        {.pos = {-200, 20}, .size = 2, .color = {255, 255, 255, 255}},
+    };
+    painter_t painter = {.color = {1, 0, 0, 1}, .lines.width = 1};
+    renderer_t *rend;
+    double bounds[4];
+    char *data;
+    int i, size;
+
+    for (i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "%s/swe_test_render.%s",
+                 sys_get_user_dir(), exts[i]);
+        sys_make_dir(path);
+        rend = i ? render_pdf_create(path) : render_svg_create(path);
+        rend->prepare(rend, 100, 100, 1, false);
+        rend->points_2d(rend, &painter, 2, points);
+        rend->line(rend, &painter, l, 4);
+        rend->text(rend, "M<&>", VEC(50, 50), ALIGN_CENTER, 0, 15, color,
+                   0, bounds);
+        assert(bounds[0] < 45 && bounds[2] > 55);
+        rend->text(rend, "M<&>", VEC(50, 50), ALIGN_CENTER, 0, 15, color,
+                   0, NULL);
+        rend->finish(rend);
+        assert(render_svg_release(rend) == 0);
+        data = read_file(path, &size);
+        assert(data);
+        if (i == 0) {
+            // The off page point and line segment are culled.
+            assert(strstr(data, "d='M18,20a2,2 0 1,0 4,0a2,2 0 1,0 -4,0'"));
+            assert(strstr(data, "d='M-50,10L10,10L10,50'"));
+            assert(strstr(data, ">M&lt;&amp;&gt;</text>"));
+        } else {
+            assert(strncmp(data, "%PDF-1.4", 8) == 0);
+            assert(strstr(data, "%%EOF"));
+        }
+        free(data);
+        remove(path);
+    }
+
+    // The file cannot be created.
+    assert(!render_svg_create("/nonexistent/swe_test_render.svg"));
+
+    // The write errors are reported at release.
+    for (i = 0; i < 2; i++) {
+        rend = i ? render_pdf_create("/dev/full") :
+                   render_svg_create("/dev/full");
+        if (!rend) continue; // No /dev/full on this system.
+        rend->prepare(rend, 100, 100, 1, false);
+        rend->points_2d(rend, &painter, 2, points);
+        rend->finish(rend);
+        assert(render_svg_release(rend) == -1);
+    }
+}
+
+TEST_REGISTER(NULL, test_render_svg, TEST_AUTO);
 
+#endif
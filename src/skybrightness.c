@@ -102,7 +102,7 @@ void skybrightness_prepare(skybrightness_t *sb,
     sb->C4 = exp10f(-0.4f * sb->K * sb->airmass_sun);
 }
 
-float skybrightness_get_luminance(
+static inline float get_luminance(
         const skybrightness_t *sb,
         float cos_moon_dist, float cos_sun_dist, float cos_zenith_dist)
 {
@@ -160,3 +160,75 @@ float skybrightness_get_luminance(
     // Convert to nano lambert then cd/m2
     return b_total / 1.11E-15f * NLAMBERT_TO_CDM2;
 }
+
+float skybrightness_get_luminance(
+        const skybrightness_t *sb,
+        float cos_moon_dist, float cos_sun_dist, float cos_zenith_dist)
+{
+    return get_luminance(sb, cos_moon_dist, cos_sun_dist, cos_zenith_dist);
+}
+
+void skybrightness_get_luminance_batch(
+        const skybrightness_t *sb, int n,
+        const float *cos_moon_dist, const float *cos_sun_dist,
+        const float *cos_zenith_dist, float *out)
+{
+    int i;
+    const skybrightness_t sb_ = *sb; // So that the terms stay in registers.
+    for (i = 0; i < n; i++) {
+        out[i] = get_luminance(&sb_, cos_moon_dist[i], cos_sun_dist[i],
+                               cos_zenith_dist[i]);
+    }
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+#include <assert.h>
+
+static skybrightness_t g_test_sb;
+static float g_test_cos[3][1024];
+
+static void test_sb_setup(void)
+{
+    int i;
+    skybrightness_prepare(&g_test_sb, 2020, 3, -10, 43.6 * D2R, 150,
+                          15, 40, 60 * D2R, 95 * D2R);
+    for (i = 0; i < 1024; i++) {
+        g_test_cos[0][i] = cosf(i * 180.f / 1024 * D2R);
+        g_test_cos[1][i] = cosf((1023 - i) * 180.f / 1024 * D2R);
+        g_test_cos[2][i] = (float)(i % 32) / 32;
+    }
+}
+
+static void test_skybrightness_batch(void)
+{
+    int i;
+    float out[1024], lum;
+    test_sb_setup();
+    skybrightness_get_luminance_batch(&g_test_sb, 1024, g_test_cos[0],
+                                      g_test_cos[1], g_test_cos[2], out);
+    for (i = 0; i < 1024; i++) {
+        lum = skybrightness_get_luminance(&g_test_sb, g_test_cos[0][i],
+                                          g_test_cos[1][i], g_test_cos[2][i]);
+        assert(fabsf(out[i] - lum) <= 1e-3f * fabsf(lum));
+    }
+}
+
+TEST_REGISTER(NULL, test_skybrightness_batch, TEST_AUTO);
+
+static int bench_skybrightness_batch(void)
+{
+    float out[1024];
+    skybrightness_get_luminance_batch(&g_test_sb, 1024, g_test_cos[0],
+                                      g_test_cos[1], g_test_cos[2], out);
+    bench_keep(out[0]);
+    return 1024;
+}
+
+BENCH_REGISTER(test_sb_setup, bench_skybrightness_batch)
+
+#endif
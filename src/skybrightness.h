@@ -46,4 +46,16 @@ float skybrightness_get_luminance(
         const skybrightness_t *sb,
         float cos_moon_dist, float cos_sun_dist, float cos_zenith_dist);
 
+/*
+ * Compute the luminance of n points at once.
+ *
+ * The inputs are given as separate arrays (structure of arrays), so that
+ * the loop can be vectorized by the compiler.  Give the same results as
+ * skybrightness_get_luminance, up to floating point rounding.
+ */
+void skybrightness_get_luminance_batch(
+        const skybrightness_t *sb, int n,
+        const float *cos_moon_dist, const float *cos_sun_dist,
+        const float *cos_zenith_dist, float *out);
+
 #endif // SKYBRIGHTNESS_H
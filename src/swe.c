@@ -172,7 +172,8 @@ static double dtf2d(int iy, int im, int id, int h, int m, double s)
 
 static void test_events(void)
 {
-    obj_t *sun, *moon;
+    obj_t *sun, *moon, *objs[2];
+    event_times_t events[2];
     double t, djm0, djm;
     const double sec = 1. / 24 / 60 / 60;
     core_init(100, 100, 1.0);
@@ -203,6 +204,76 @@ static void test_events(void)
     // Get next setting.
     t = compute_event(core->observer, moon, EVENT_SET, djm, djm + 1, sec);
     assert(fabs(t - dtf2d(2009, 9, 6, 13, 5, 0)) < 1. / 24 / 60);
+
+    // Same thing with the batch API.
+    objs[0] = sun;
+    objs[1] = moon;
+    compute_events_batch(core->observer, 2, objs, djm, djm + 1, sec, events);
+    assert(fabs(events[0].rise - dtf2d(2009, 9, 6, 11, 15, 0)) < 1. / 24 / 60);
+    assert(fabs(events[0].set - dtf2d(2009, 9, 6, 23, 56, 0)) < 1. / 24 / 60);
+    assert(fabs(events[1].rise - dtf2d(2009, 9, 6, 0, 17, 0)) < 1. / 24 / 60);
+    assert(fabs(events[1].set - dtf2d(2009, 9, 6, 13, 5, 0)) < 1. / 24 / 60);
+    assert(events[0].transit > events[0].rise &&
+           events[0].transit < events[0].set);
+}
+
+// Check that a batch event time matches the one of compute_event.
+static void check_event_time(double t, double ref)
+{
+    assert(isnan(ref) ? isnan(t) : fabs(t - ref) < 10. / 24 / 60 / 60);
+}
+
+static void test_events_batch(void)
+{
+    const int nb = 300; // More than one chunk of 256 objects.
+    const double start = 59000, sec = 1. / 24 / 60 / 60;
+    obj_t **objs;
+    event_times_t *events;
+    observer_t *obs;
+    char json[256];
+    double t;
+    int i, nb_circumpolar = 0, nb_never_rises = 0;
+
+    core_init(100, 100, 1.0);
+    obs = core->observer;
+    obj_set_attr((obj_t*)obs, "latitude", 45 * DD2R);
+    observer_update(obs, false);
+
+    // Stars spread over all the declinations, so that we get some
+    // circumpolar and never rising ones.
+    objs = calloc(nb, sizeof(*objs));
+    events = calloc(nb, sizeof(*events));
+    for (i = 0; i < nb; i++) {
+        snprintf(json, sizeof(json),
+                 "{\"model_data\": {\"ra\": %f, \"de\": %f, "
+                 "\"Vmag\": 5}}", fmod(i * 137.5, 360),
+                 -89 + 178.0 * i / (nb - 1));
+        objs[i] = obj_create_str("star", NULL, json);
+    }
+    compute_events_batch(obs, nb, objs, start, start + 1, sec, events);
+
+    for (i = 0; i < nb; i++) {
+        if (events[i].flags & EVENT_CIRCUMPOLAR) nb_circumpolar++;
+        if (events[i].flags & EVENT_NEVER_RISES) nb_never_rises++;
+    }
+    assert(nb_circumpolar > 0 && nb_never_rises > 0);
+
+    // compute_event is slow, so only check one object out of ten, still in
+    // all the chunks and including the extreme declinations.
+    for (i = 0; i < nb; i += 10) {
+        t = compute_event(obs, objs[i], EVENT_RISE, start, start + 1, sec);
+        check_event_time(events[i].rise, t);
+        t = compute_event(obs, objs[i], EVENT_SET, start, start + 1, sec);
+        check_event_time(events[i].set, t);
+        if (!(events[i].flags & EVENT_NEVER_RISES)) {
+            t = compute_event(obs, objs[i], EVENT_TRANSIT, start, start + 1,
+                              sec);
+            check_event_time(events[i].transit, t);
+        }
+    }
+    for (i = 0; i < nb; i++) obj_release(objs[i]);
+    free(objs);
+    free(events);
 }
 
 /*
@@ -442,6 +513,7 @@ static void test_u8(void)
 }
 
 TEST_REGISTER(NULL, test_events, 0);
+TEST_REGISTER(NULL, test_events_batch, TEST_AUTO);
 TEST_REGISTER(NULL, test_ephemeris, TEST_AUTO);
 TEST_REGISTER(NULL, test_clipping, TEST_AUTO);
 TEST_REGISTER(NULL, test_iter_lines, TEST_AUTO);
@@ -30,6 +30,7 @@
 #include "json-builder.h"
 #include "eph-file.h"
 #include "erfa.h"
+#include "governor.h"
 #include "log.h"
 #include "profiler.h"
 #include "tests.h"
@@ -38,6 +39,7 @@
 #include "utils/color.h"
 #include "utils/fader.h"
 #include "utils/gesture.h"
+#include "utils/membudget.h"
 #include "utils/progressbar.h"
 #include "utils/texture.h"
 #include "utils/utils.h"
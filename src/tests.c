@@ -11,6 +11,18 @@
 
 #if COMPILE_TESTS
 
+#include "json-builder.h"
+
+#include <time.h>
+
+// Benchmarks run parameters.
+#define BENCH_WARMUP_TIME   0.05    // sec.
+#define BENCH_RUN_TIME      0.5     // sec.
+#define BENCH_MIN_RUNS      5
+#define BENCH_MAX_RUNS      100000
+// Default allowed regression of the median time relative to the baseline.
+#define BENCH_THRESHOLD     0.2
+
 typedef struct test {
     struct test *next;
     const char *name;
@@ -20,7 +32,16 @@ typedef struct test {
     int flags;
 } test_t;
 
+typedef struct bench {
+    struct bench *next;
+    const char *name;
+    const char *file;
+    void (*setup)(void);
+    int (*func)(void);
+} bench_t;
+
 static test_t *g_tests = NULL;
+static bench_t *g_benchs = NULL;
 
 void tests_register(const char *name, const char *file,
                     void (*setup)(void),
@@ -44,17 +65,28 @@ static bool filter_test(const char *filter, const test_t *test)
     return strstr(test->file, filter);
 }
 
+// User directory used while running the tests, so that the caches they
+// create don't end up in the working directory.
+static const char *tests_get_user_dir(void *user)
+{
+    return "/tmp/swe-tests";
+}
+
 EMSCRIPTEN_KEEPALIVE
 void tests_run(const char *filter)
 {
     test_t *test;
+    const char *(*get_user_dir)(void *user) = sys_callbacks.get_user_dir;
+
     LOG_I("Run tests: %s", filter);
+    sys_callbacks.get_user_dir = tests_get_user_dir;
     LL_FOREACH(g_tests, test) {
         if (!filter_test(filter, test)) continue;
         if (test->setup) test->setup();
         test->func();
         // LOG_I("Run %-20s OK (%s)", test->name, test->file);
     }
+    sys_callbacks.get_user_dir = get_user_dir;
 }
 
 bool tests_compare_time(double t, double ref, double max_delta_ms)
@@ -84,4 +116,152 @@ bool tests_compare_pv(const double pv[2][3], const double ref[2][3],
     return true;
 }
 
+void benchs_register(const char *name, const char *file,
+                     void (*setup)(void),
+                     int (*func)(void))
+{
+    bench_t *bench;
+    bench = calloc(1, sizeof(*bench));
+    bench->name = name;
+    bench->file = file;
+    bench->setup = setup;
+    bench->func = func;
+    LL_APPEND(g_benchs, bench);
+}
+
+static double get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+    return cmp(*(const double*)a, *(const double*)b);
+}
+
+// Run a single benchmark and return its stats as a json object, or NULL
+// if the benchmark cannot run.
+static json_value *bench_run(const bench_t *bench)
+{
+    double t, start, *times;
+    int n = 0, items = 0;
+    json_value *ret;
+
+    if (bench->setup) bench->setup();
+    start = get_time();
+    do {
+        items = bench->func();
+        if (items < 0) return NULL;
+    } while (get_time() - start < BENCH_WARMUP_TIME);
+
+    times = malloc(BENCH_MAX_RUNS * sizeof(*times));
+    start = get_time();
+    while (n < BENCH_MAX_RUNS &&
+           (n < BENCH_MIN_RUNS || get_time() - start < BENCH_RUN_TIME)) {
+        t = get_time();
+        items = bench->func();
+        times[n++] = get_time() - t;
+    }
+    qsort(times, n, sizeof(*times), double_cmp);
+
+    ret = json_object_new(0);
+    json_object_push(ret, "runs", json_integer_new(n));
+    json_object_push(ret, "items", json_integer_new(items));
+    json_object_push(ret, "min_ms", json_double_new(times[0] * 1000));
+    json_object_push(ret, "median_ms", json_double_new(times[n / 2] * 1000));
+    json_object_push(ret, "p99_ms",
+                     json_double_new(times[(int)((n - 1) * 0.99)] * 1000));
+    json_object_push(ret, "items_per_sec",
+                     json_double_new(items / max(times[n / 2], 1E-9)));
+    free(times);
+    return ret;
+}
+
+// Compare a benchmark result to the baseline, return false if the
+// median time regressed more than the allowed threshold.
+static bool bench_check(const char *name, json_value *res,
+                        json_value *baseline)
+{
+    json_value *ref;
+    double median, ref_median, threshold;
+
+    ref = json_get_attr(json_get_attr(baseline, "benchmarks", json_object),
+                        name, json_object);
+    if (!ref) return true;
+    median = json_get_attr_f(res, "median_ms", 0);
+    ref_median = json_get_attr_f(ref, "median_ms", 0);
+    threshold = json_get_attr_f(ref, "threshold",
+                    json_get_attr_f(baseline, "threshold", BENCH_THRESHOLD));
+    if (ref_median <= 0 || median <= ref_median * (1 + threshold))
+        return true;
+    LOG_E("Bench %s regressed: %.4f ms > %.4f ms (threshold %.0f%%)",
+          name, median, ref_median, threshold * 100);
+    return false;
+}
+
+int benchs_run(const char *filter, const char *baseline_path,
+               const char *output_path)
+{
+    const bench_t *bench;
+    json_value *results, *benchs, *res, *baseline = NULL;
+    json_serialize_opts opts = {
+        .mode = json_serialize_mode_multiline,
+        .indent_size = 4,
+    };
+    char *data, *buf;
+    int size, nb_regressions = 0;
+    FILE *out;
+
+    if (baseline_path) {
+        data = read_file(baseline_path, &size);
+        if (data) baseline = json_parse(data, size);
+        free(data);
+        if (!baseline) {
+            LOG_E("Cannot parse baseline file %s", baseline_path);
+            return -1;
+        }
+    }
+
+    LOG_I("Run benchmarks: %s", filter);
+    LOG_I("%-32s %10s %10s %10s %14s", "name", "min ms", "median ms",
+          "p99 ms", "items/s");
+    results = json_object_new(0);
+    benchs = json_object_push(results, "benchmarks", json_object_new(0));
+    LL_FOREACH(g_benchs, bench) {
+        if (filter && !strstr(bench->name, filter) &&
+                      !strstr(bench->file, filter))
+            continue;
+        res = bench_run(bench);
+        if (!res) {
+            LOG_W("%-32s skipped", bench->name);
+            continue;
+        }
+        json_object_push(benchs, bench->name, res);
+        LOG_I("%-32s %10.4f %10.4f %10.4f %14.0f", bench->name,
+              json_get_attr_f(res, "min_ms", 0),
+              json_get_attr_f(res, "median_ms", 0),
+              json_get_attr_f(res, "p99_ms", 0),
+              json_get_attr_f(res, "items_per_sec", 0));
+        if (baseline && !bench_check(bench->name, res, baseline))
+            nb_regressions++;
+    }
+
+    if (output_path) {
+        buf = calloc(1, json_measure_ex(results, opts));
+        json_serialize_ex(buf, results, opts);
+        if ((out = fopen(output_path, "w"))) {
+            fprintf(out, "%s\n", buf);
+            fclose(out);
+        } else {
+            LOG_E("Cannot write benchmarks results to %s", output_path);
+        }
+        free(buf);
+    }
+    json_builder_free(results);
+    json_value_free(baseline);
+    return nb_regressions;
+}
+
 #endif
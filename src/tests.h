@@ -20,6 +20,48 @@ void tests_register(const char *name, const char *file,
 
 void tests_run(const char *filter);
 
+/*
+ * Function: benchs_register
+ * Register a micro-benchmark.  Use the BENCH_REGISTER macro instead.
+ *
+ * The benchmark function runs the measured code once, and returns the
+ * number of items it processed, or a negative value if the benchmark cannot
+ * run (for example if some data file is missing).
+ */
+void benchs_register(const char *name, const char *file,
+                     void (*setup)(void),
+                     int (*func)(void));
+
+/*
+ * Function: benchs_run
+ * Run the registered benchmarks and log their timings.
+ *
+ * Each benchmark is first run for a short warm-up time, then repeated for
+ * about half a second to compute the min, median and p99 times.
+ *
+ * The baseline is a json file in the same format as the output, with an
+ * optional 'threshold' attribute (globally or per benchmark) to set the
+ * allowed regression of the median time (default to 0.2):
+ *
+ *   {
+ *     "threshold": 0.2,
+ *     "benchmarks": {
+ *       "bench_healpix_ang2pix": {"median_ms": 0.12, "threshold": 0.5}
+ *     }
+ *   }
+ *
+ * Parameters:
+ *   filter   - Only run the benchmarks whose name or file contains this
+ *              string.  Can be NULL.
+ *   baseline - Optional baseline json file.
+ *   output   - Optional json file where to save the results.
+ *
+ * Return:
+ *   The number of regressions compared to the baseline, or -1 in case of
+ *   error.
+ */
+int benchs_run(const char *filter, const char *baseline, const char *output);
+
 bool tests_compare_time(double t, double ref, double max_delta_ms);
 bool tests_compare_pv(const double pv[2][3], const double ref[2][3],
                        double max_delta_position,
@@ -42,9 +84,20 @@ bool tests_compare_pv(const double pv[2][3], const double ref[2][3],
     static void register_test_##func_() { \
         tests_register(#func_, __FILE__, setup_, func_, flags_); }
 
+// Prevent the compiler from optimizing away a benchmarked value.
+#define bench_keep(v) __asm__ volatile("" : : "g"(v) : "memory")
+
+#define BENCH_REGISTER(setup_, func_) \
+    static void register_bench_##func_() __attribute__((constructor)); \
+    static void register_bench_##func_() { \
+        benchs_register(#func_, __FILE__, setup_, func_); }
+
 #else // COMPILE_TEST
 
 #define TEST_REGISTER(...)
+#define BENCH_REGISTER(...)
 static inline void tests_run(const char *filter) {}
+static inline int benchs_run(const char *filter, const char *baseline,
+                             const char *output) { return 0; }
 
 #endif
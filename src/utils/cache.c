@@ -8,8 +8,11 @@
  */
 
 #include "cache.h"
+#include "membudget.h"
 #include "uthash.h"
 #include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
 
 typedef struct item item_t;
 struct item {
@@ -35,15 +38,26 @@ cache_t *cache_create(int size)
     return cache;
 }
 
+// Try to delete an item, return false if the delete function refused.
+static bool delete_item(cache_t *cache, item_t *item)
+{
+    if (item->delfunc) {
+        if (item->delfunc(item->data) == CACHE_KEEP) return false;
+    } else {
+        free(item->data);
+    }
+    HASH_DEL(cache->items, item);
+    assert(item != cache->items);
+    cache->size -= item->cost;
+    free(item);
+    return true;
+}
+
 static void cleanup(cache_t *cache)
 {
     item_t *item, *tmp;
     HASH_ITER(hh, cache->items, item, tmp) {
-        if (item->delfunc(item->data) == CACHE_KEEP) continue;
-        HASH_DEL(cache->items, item);
-        assert(item != cache->items);
-        cache->size -= item->cost;
-        free(item);
+        if (!delete_item(cache, item)) continue;
         if (cache->size < cache->max_size) return;
     }
 }
@@ -87,6 +101,17 @@ void cache_set_cost(cache_t *cache, const void *key, int keylen, int cost)
     if (cache->size >= cache->max_size) cleanup(cache);
 }
 
+int cache_evict(cache_t *cache, int cost)
+{
+    item_t *item, *tmp;
+    int size = cache->size;
+    HASH_ITER(hh, cache->items, item, tmp) {
+        if (size - cache->size >= cost) break;
+        delete_item(cache, item);
+    }
+    return size - cache->size;
+}
+
 /*
  * Function: cache_get_current_size
  * Return the total cost of all the currently cached items
@@ -95,3 +120,18 @@ int cache_get_current_size(const cache_t *cache)
 {
     return cache->size;
 }
+
+static int64_t budget_get_size(void *user)
+{
+    return cache_get_current_size(user);
+}
+
+static int64_t budget_evict(void *user, int64_t size)
+{
+    return cache_evict(user, size < INT_MAX ? size : INT_MAX);
+}
+
+void cache_register_membudget(cache_t *cache, const char *name, int priority)
+{
+    membudget_register(name, priority, cache, budget_get_size, budget_evict);
+}
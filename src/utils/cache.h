@@ -50,7 +50,7 @@ cache_t *cache_create(int size);
  *  cost    - Cost of the data used to compute the cache usage.
  *            It doesn't have to be the size.
  *  delfunc - Function that the case can use to free the data when the
- *            cache gets too large.
+ *            cache gets too large.  If NULL the data is freed with free.
  */
 void cache_add(cache_t *cache, const void *key, int keylen, void *data,
                int cost, int (*delfunc)(void *data));
@@ -73,9 +73,29 @@ void *cache_get(cache_t *cache, const void *key, int keylen);
  */
 void cache_set_cost(cache_t *cache, const void *key, int keylen, int cost);
 
+/*
+ * Function: cache_evict
+ * Delete the least recently used items to reduce the cache size.
+ *
+ * Parameters:
+ *   cost   - Total cost of the items to delete.
+ *
+ * Return:
+ *   The total cost of the deleted items, that can be less than the
+ *   requested value if some items could not be deleted.
+ */
+int cache_evict(cache_t *cache, int cost);
+
 /*
  * Function: cache_get_current_size
  * Return the total cost of all the currently cached items
  */
 int cache_get_current_size(const cache_t *cache);
 
+/*
+ * Function: cache_register_membudget
+ * Add the cache to the global memory budget.
+ *
+ * The items costs must be in bytes.  See <membudget_register>.
+ */
+void cache_register_membudget(cache_t *cache, const char *name, int priority);
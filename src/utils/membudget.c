@@ -0,0 +1,189 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "membudget.h"
+#include "utlist.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct client client_t;
+struct client {
+    client_t    *next, *prev;
+    char        *name;
+    int         priority;
+    void        *user;
+    int64_t     (*get_size)(void *user);
+    int64_t     (*evict)(void *user, int64_t size);
+};
+
+static struct {
+    client_t    *clients; // Sorted by priority.
+    int64_t     limit;
+    // Lower limit set after a memory pressure signal.
+    int64_t     pressure_limit;
+} g_budget = {};
+
+static int client_cmp(const client_t *a, const client_t *b)
+{
+    return a->priority - b->priority;
+}
+
+void membudget_register(const char *name, int priority, void *user,
+                        int64_t (*get_size)(void *user),
+                        int64_t (*evict)(void *user, int64_t size))
+{
+    client_t *client;
+    assert(get_size && evict);
+    client = calloc(1, sizeof(*client));
+    client->name = strdup(name);
+    client->priority = priority;
+    client->user = user;
+    client->get_size = get_size;
+    client->evict = evict;
+    DL_INSERT_INORDER(g_budget.clients, client, client_cmp);
+}
+
+void membudget_unregister(void *user)
+{
+    client_t *client, *tmp;
+    DL_FOREACH_SAFE(g_budget.clients, client, tmp) {
+        if (client->user != user) continue;
+        DL_DELETE(g_budget.clients, client);
+        free(client->name);
+        free(client);
+    }
+}
+
+void membudget_set_limit(int64_t limit)
+{
+    g_budget.limit = limit;
+    g_budget.pressure_limit = 0;
+}
+
+int64_t membudget_get_limit(void)
+{
+    return g_budget.limit;
+}
+
+int64_t membudget_get_total(void)
+{
+    client_t *client;
+    int64_t total = 0;
+    DL_FOREACH(g_budget.clients, client)
+        total += client->get_size(client->user);
+    return total;
+}
+
+// Evict from the caches, lowest priorities first, until the total size
+// goes under a given value.
+static void evict(int64_t target)
+{
+    client_t *client;
+    int64_t total = membudget_get_total();
+    DL_FOREACH(g_budget.clients, client) {
+        if (total <= target) return;
+        total -= client->evict(client->user, total - target);
+    }
+}
+
+void membudget_update(void)
+{
+    int64_t limit = g_budget.limit;
+    if (g_budget.pressure_limit && (!limit || g_budget.pressure_limit < limit))
+        limit = g_budget.pressure_limit;
+    if (!limit) return;
+    evict(limit);
+}
+
+void membudget_on_pressure(void)
+{
+    evict(membudget_get_total() / 2);
+    // Don't let the caches grow back to the previous size.
+    g_budget.pressure_limit = membudget_get_total();
+}
+
+int membudget_list(void *user,
+                   void (*f)(void *user, const char *name, int priority,
+                             int64_t size))
+{
+    client_t *client;
+    int nb = 0;
+    DL_FOREACH(g_budget.clients, client) {
+        f(user, client->name, client->priority,
+          client->get_size(client->user));
+        nb++;
+    }
+    return nb;
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+typedef struct {
+    int64_t size;
+    int64_t min_size; // Size that cannot be evicted.
+} test_cache_t;
+
+static int64_t test_get_size(void *user)
+{
+    return ((test_cache_t*)user)->size;
+}
+
+static int64_t test_evict(void *user, int64_t size)
+{
+    test_cache_t *cache = user;
+    int64_t freed = cache->size - cache->min_size;
+    if (freed > size) freed = size;
+    cache->size -= freed;
+    return freed;
+}
+
+static void test_membudget(void)
+{
+    typeof(g_budget) budget = g_budget;
+    test_cache_t low = {100, 20}, high = {200, 0};
+
+    // Isolate the test from the actual caches.
+    memset(&g_budget, 0, sizeof(g_budget));
+    membudget_register("high", 20, &high, test_get_size, test_evict);
+    membudget_register("low", 0, &low, test_get_size, test_evict);
+    assert(membudget_get_total() == 300);
+
+    membudget_update(); // No limit.
+    assert(low.size == 100 && high.size == 200);
+
+    // The low priority cache is evicted first.
+    membudget_set_limit(250);
+    membudget_update();
+    assert(low.size == 50 && high.size == 200);
+    membudget_set_limit(150);
+    membudget_update();
+    assert(low.size == 20 && high.size == 130);
+
+    membudget_on_pressure();
+    assert(membudget_get_total() == 75);
+    high.size += 100;
+    membudget_update();
+    assert(membudget_get_total() == 75);
+
+    membudget_unregister(&low);
+    membudget_unregister(&high);
+    assert(!g_budget.clients);
+    g_budget = budget;
+}
+
+TEST_REGISTER(NULL, test_membudget, TEST_AUTO);
+
+#endif
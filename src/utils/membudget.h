@@ -0,0 +1,115 @@
+/* Stellarium Web Engine - Copyright (c) 2018 - Noctua Software Ltd
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef MEMBUDGET_H
+#define MEMBUDGET_H
+
+#include <stdint.h>
+
+/*
+ * File: membudget.h
+ * Global memory budget shared by all the caches.
+ *
+ * Each cache registers itself with a name, a priority and two callbacks:
+ * one that returns its current size in bytes, and one that releases some
+ * of its items.  <membudget_update>, called once per frame, checks the
+ * total size of all the caches against the global limit, and if needed
+ * asks the caches to release memory, starting with the lowest priorities,
+ * until we are back under the limit.
+ */
+
+/*
+ * Enum: MEMBUDGET_PRIORITY
+ * Default priorities of the caches.  The caches with the lowest priority
+ * are evicted first.
+ *
+ * Values:
+ *   MEMBUDGET_PRIORITY_LOW     - Data that is cheap to recompute.
+ *   MEMBUDGET_PRIORITY_NORMAL  - Data that can be reloaded.
+ *   MEMBUDGET_PRIORITY_HIGH    - Data that is slow to reload, like the
+ *                                HiPS tiles.
+ */
+enum {
+    MEMBUDGET_PRIORITY_LOW      = 0,
+    MEMBUDGET_PRIORITY_NORMAL   = 10,
+    MEMBUDGET_PRIORITY_HIGH     = 20,
+};
+
+/*
+ * Function: membudget_register
+ * Register a cache to the global memory budget.
+ *
+ * Parameters:
+ *   name       - Name of the cache, as reported by <membudget_list>.
+ *   priority   - One of the <MEMBUDGET_PRIORITY> values.
+ *   user       - Data passed to the callbacks, also used to identify the
+ *                cache in <membudget_unregister>.
+ *   get_size   - Return the current size of the cache in bytes.
+ *   evict      - Release at least 'size' bytes if possible, and return
+ *                the number of bytes actually released.  Should only
+ *                release items that are not currently in use.
+ */
+void membudget_register(const char *name, int priority, void *user,
+                        int64_t (*get_size)(void *user),
+                        int64_t (*evict)(void *user, int64_t size));
+
+/*
+ * Function: membudget_unregister
+ * Remove a cache previously added with <membudget_register>.
+ */
+void membudget_unregister(void *user);
+
+/*
+ * Function: membudget_set_limit
+ * Set the global memory limit in bytes, or zero for no limit.
+ */
+void membudget_set_limit(int64_t limit);
+
+/*
+ * Function: membudget_get_limit
+ * Return the global memory limit in bytes.
+ */
+int64_t membudget_get_limit(void);
+
+/*
+ * Function: membudget_get_total
+ * Return the total size of all the registered caches in bytes.
+ */
+int64_t membudget_get_total(void);
+
+/*
+ * Function: membudget_update
+ * Evict items from the caches if the total size is over the limit.
+ *
+ * Should be called once per frame, outside of the rendering.
+ */
+void membudget_update(void);
+
+/*
+ * Function: membudget_on_pressure
+ * Release half of the memory used by the caches.
+ *
+ * Should be called when the system reports that the memory is low.  The
+ * limit is then lowered to the remaining memory, until
+ * <membudget_set_limit> is called again.
+ */
+void membudget_on_pressure(void);
+
+/*
+ * Function: membudget_list
+ * Iter all the registered caches.
+ *
+ * Return:
+ *   The number of caches.
+ */
+int membudget_list(void *user,
+                   void (*f)(void *user, const char *name, int priority,
+                             int64_t size));
+
+#endif // MEMBUDGET_H
@@ -20,11 +20,56 @@
 /* Degrees to radians */
 #define DD2R (1.745329251994329576923691e-2)
 
+// Max number of triangles in a bvh leaf.
+#define BVH_LEAF_SIZE 4
+// Size of the bvh traversal stack, enough for any median split tree.
+#define BVH_STACK_SIZE 64
+
+typedef struct bvh_node {
+    double  cap[4];
+    int     start;  // First triangle in the bvh triangles list.
+    int     count;  // Number of triangles, zero for inner nodes.
+    int     child;  // Index of the first of the two children nodes.
+} bvh_node_t;
+
+struct mesh_bvh {
+    int         nodes_count;
+    bvh_node_t  *nodes;
+    int         *tris; // Triangles indices, in the nodes order.
+};
+
 static double min(double x, double y)
 {
     return x < y ? x : y;
 }
 
+static double max(double x, double y)
+{
+    return x > y ? x : y;
+}
+
+/*
+ * Make sure an array can hold at least 'count' elements.  The capacity
+ * grows geometrically, so that adding elements one by one (as done by
+ * mesh_subdivide) is amortized.
+ */
+static void *array_reserve(void *data, int *capacity, int count, size_t size)
+{
+    if (count <= *capacity) return data;
+    *capacity = *capacity * 2 > count ? *capacity * 2 : count;
+    if (*capacity < 16) *capacity = 16;
+    return realloc(data, *capacity * size);
+}
+
+static void mesh_release_index(mesh_t *mesh)
+{
+    if (!mesh->bvh) return;
+    free(mesh->bvh->nodes);
+    free(mesh->bvh->tris);
+    free(mesh->bvh);
+    mesh->bvh = NULL;
+}
+
 mesh_t *mesh_create(void)
 {
     return calloc(1, sizeof(mesh_t));
@@ -32,6 +77,7 @@ mesh_t *mesh_create(void)
 
 void mesh_delete(mesh_t *mesh)
 {
+    mesh_release_index(mesh);
     free(mesh->vertices);
     free(mesh->triangles);
     free(mesh->lines);
@@ -45,6 +91,9 @@ mesh_t *mesh_copy(const mesh_t *mesh)
     ret->vertices_count = mesh->vertices_count;
     ret->triangles_count = mesh->triangles_count;
     ret->lines_count = mesh->lines_count;
+    ret->vertices_capacity = ret->vertices_count;
+    ret->triangles_capacity = ret->triangles_count;
+    ret->lines_capacity = ret->lines_count;
     ret->vertices = malloc(ret->vertices_count * sizeof(*ret->vertices));
     memcpy(ret->vertices, mesh->vertices,
            ret->vertices_count * sizeof(*ret->vertices));
@@ -89,9 +138,11 @@ static void lonlat2c(const double lonlat[2], double c[3])
 int mesh_add_vertices_lonlat(mesh_t *mesh, int count, double (*verts)[2])
 {
     int i, ofs;
+    mesh_release_index(mesh);
     ofs = mesh->vertices_count;
-    mesh->vertices = realloc(mesh->vertices,
-            (mesh->vertices_count + count) * sizeof(*mesh->vertices));
+    mesh->vertices = array_reserve(mesh->vertices, &mesh->vertices_capacity,
+                                   mesh->vertices_count + count,
+                                   sizeof(*mesh->vertices));
     for (i = 0; i < count; i++) {
         assert(!isnan(verts[i][0]));
         lonlat2c(verts[i], mesh->vertices[mesh->vertices_count + i]);
@@ -104,15 +155,27 @@ int mesh_add_vertices_lonlat(mesh_t *mesh, int count, double (*verts)[2])
     return ofs;
 }
 
-int mesh_add_vertices(mesh_t *mesh, int count, double (*verts)[3])
+// Add vertices without updating the bounding cap, used by the functions
+// that add many vertices one by one, and only update the cap at the end.
+static int mesh_add_vertices_(mesh_t *mesh, int count,
+                              const double (*verts)[3])
 {
     int ofs;
+    mesh_release_index(mesh);
     ofs = mesh->vertices_count;
-    mesh->vertices = realloc(mesh->vertices,
-            (mesh->vertices_count + count) * sizeof(*mesh->vertices));
+    mesh->vertices = array_reserve(mesh->vertices, &mesh->vertices_capacity,
+                                   mesh->vertices_count + count,
+                                   sizeof(*mesh->vertices));
     memcpy(mesh->vertices + mesh->vertices_count, verts,
            count * sizeof(*mesh->vertices));
     mesh->vertices_count += count;
+    return ofs;
+}
+
+int mesh_add_vertices(mesh_t *mesh, int count, double (*verts)[3])
+{
+    int ofs;
+    ofs = mesh_add_vertices_(mesh, count, (const double (*)[3])verts);
     // XXX: shouldn't be done here!
     compute_bounding_cap(mesh->vertices_count, mesh->vertices,
                          mesh->bounding_cap);
@@ -122,8 +185,9 @@ int mesh_add_vertices(mesh_t *mesh, int count, double (*verts)[3])
 void mesh_add_line(mesh_t *mesh, int ofs, int size)
 {
     int i;
-    mesh->lines = realloc(mesh->lines, (mesh->lines_count + (size - 1) * 2) *
-                          sizeof(*mesh->lines));
+    mesh->lines = array_reserve(mesh->lines, &mesh->lines_capacity,
+                                mesh->lines_count + (size - 1) * 2,
+                                sizeof(*mesh->lines));
     for (i = 0; i < size - 1; i++) {
         mesh->lines[mesh->lines_count + i * 2 + 0] = ofs + i;
         mesh->lines[mesh->lines_count + i * 2 + 1] = ofs + i + 1;
@@ -154,32 +218,34 @@ static void create_rotation_between_vecs(
 
 void mesh_add_poly(mesh_t *mesh, int nb_rings, const int ofs, const int *size)
 {
-    int r, i, j = 0, triangles_size;
+    int r, i, nb = 0, triangles_size;
     double rot[3][3], p[3];
     double (*centered_lonlat)[2];
-    const uint16_t *triangles;
+    const uint32_t *triangles;
     earcut_t *earcut;
 
+    mesh_release_index(mesh);
     earcut = earcut_new();
     // Triangulate the shape.
     // First we rotate the points so that they are centered around the
     // origin.
     create_rotation_between_vecs(rot, mesh->bounding_cap, VEC(1, 0, 0));
 
-    for (r = 0; r < nb_rings; r++) {
-        centered_lonlat = calloc(size[r], sizeof(*centered_lonlat));
-        for (i = 0; i < size[r]; i++) {
-            mat3_mul_vec3(rot, mesh->vertices[ofs + j++], p);
-            c2lonlat(p, centered_lonlat[i]);
-        }
-        earcut_add_poly(earcut, size[r], centered_lonlat);
-        free(centered_lonlat);
+    // All the rings are passed to earcut at once.
+    for (r = 0; r < nb_rings; r++) nb += size[r];
+    centered_lonlat = malloc(nb * sizeof(*centered_lonlat));
+    for (i = 0; i < nb; i++) {
+        mat3_mul_vec3(rot, mesh->vertices[ofs + i], p);
+        c2lonlat(p, centered_lonlat[i]);
     }
+    earcut_add_polys(earcut, nb_rings, size, centered_lonlat);
+    free(centered_lonlat);
 
     triangles = earcut_triangulate(earcut, &triangles_size);
-    mesh->triangles = realloc(mesh->triangles,
-            (mesh->triangles_count + triangles_size) *
-            sizeof(*mesh->triangles));
+    mesh->triangles = array_reserve(mesh->triangles,
+                                    &mesh->triangles_capacity,
+                                    mesh->triangles_count + triangles_size,
+                                    sizeof(*mesh->triangles));
     for (i = 0; i < triangles_size; i++) {
         mesh->triangles[mesh->triangles_count + i] = ofs + triangles[i];
     }
@@ -190,7 +256,7 @@ void mesh_add_poly(mesh_t *mesh, int nb_rings, const int ofs, const int *size)
 
 // Spherical triangle / point intersection.
 static bool triangle_contains_vec3(const double verts[][3],
-                                   const uint16_t indices[],
+                                   const uint32_t indices[],
                                    const double pos[3])
 {
     int i;
@@ -202,6 +268,157 @@ static bool triangle_contains_vec3(const double verts[][3],
     return true;
 }
 
+/*
+ * Compute the bounding cap of a list of triangles.
+ *
+ * The vertices are not always normalized (mesh_subdivide), so we normalize
+ * them here.  A cap larger than an hemisphere is not guaranteed to contain
+ * the triangles edges, so in that case we just use the full sphere.
+ */
+static void bvh_compute_cap(const mesh_t *mesh, const int *tris, int count,
+                            double cap[4])
+{
+    int i, j;
+    double v[3];
+
+    vec4_set(cap, 0, 0, 0, 1);
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < 3; j++) {
+            vec3_normalize(mesh->vertices[mesh->triangles[tris[i] * 3 + j]],
+                           v);
+            vec3_add(cap, v, cap);
+        }
+    }
+    if (vec3_norm2(cap) < 1e-12) {
+        vec4_set(cap, 1, 0, 0, -1);
+        return;
+    }
+    vec3_normalize(cap, cap);
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < 3; j++) {
+            vec3_normalize(mesh->vertices[mesh->triangles[tris[i] * 3 + j]],
+                           v);
+            cap[3] = min(cap[3], vec3_dot(cap, v));
+        }
+    }
+    // Small margin so that points on the edges are never rejected because
+    // of rounding errors.
+    cap[3] = cap[3] < 0 ? -1 : cap[3] - 1e-9;
+}
+
+typedef struct {
+    double  key;
+    int     tri;
+} bvh_sort_item_t;
+
+static int bvh_sort_cmp(const void *a, const void *b)
+{
+    double ka = ((const bvh_sort_item_t*)a)->key;
+    double kb = ((const bvh_sort_item_t*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static void bvh_build_node(mesh_bvh_t *bvh, const mesh_t *mesh,
+                           const double (*centers)[3], int node,
+                           int start, int count)
+{
+    int i, j, axis = 0, child;
+    double lo[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double hi[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    bvh_sort_item_t *items;
+    bvh_node_t *n = &bvh->nodes[node];
+
+    bvh_compute_cap(mesh, bvh->tris + start, count, n->cap);
+    n->start = start;
+    if (count <= BVH_LEAF_SIZE) {
+        n->count = count;
+        return;
+    }
+
+    // Split along the axis with the largest triangles centers extent.
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < 3; j++) {
+            lo[j] = min(lo[j], centers[bvh->tris[start + i]][j]);
+            hi[j] = max(hi[j], centers[bvh->tris[start + i]][j]);
+        }
+    }
+    for (j = 1; j < 3; j++) {
+        if (hi[j] - lo[j] > hi[axis] - lo[axis]) axis = j;
+    }
+    items = malloc(count * sizeof(*items));
+    for (i = 0; i < count; i++) {
+        items[i].tri = bvh->tris[start + i];
+        items[i].key = centers[items[i].tri][axis];
+    }
+    qsort(items, count, sizeof(*items), bvh_sort_cmp);
+    for (i = 0; i < count; i++) bvh->tris[start + i] = items[i].tri;
+    free(items);
+
+    n->count = 0;
+    n->child = child = bvh->nodes_count;
+    bvh->nodes_count += 2;
+    bvh_build_node(bvh, mesh, centers, child, start, count / 2);
+    bvh_build_node(bvh, mesh, centers, child + 1, start + count / 2,
+                   count - count / 2);
+}
+
+/*
+ * Function: mesh_build_index
+ * Build a bounding volume hierarchy of the mesh triangles.
+ */
+void mesh_build_index(mesh_t *mesh)
+{
+    int i, j, nb = mesh->triangles_count / 3;
+    double (*centers)[3];
+    mesh_bvh_t *bvh;
+
+    mesh_release_index(mesh);
+    if (nb <= BVH_LEAF_SIZE) return; // Not worth it.
+
+    bvh = calloc(1, sizeof(*bvh));
+    // A binary tree with leaves of at least one triangle has less than
+    // 2 * nb nodes.
+    bvh->nodes = calloc(2 * nb, sizeof(*bvh->nodes));
+    bvh->tris = malloc(nb * sizeof(*bvh->tris));
+    centers = calloc(nb, sizeof(*centers));
+    for (i = 0; i < nb; i++) {
+        bvh->tris[i] = i;
+        for (j = 0; j < 3; j++) {
+            vec3_add(centers[i], mesh->vertices[mesh->triangles[i * 3 + j]],
+                     centers[i]);
+        }
+    }
+    bvh->nodes_count = 1;
+    bvh_build_node(bvh, mesh, (const double (*)[3])centers, 0, 0, nb);
+    free(centers);
+    mesh->bvh = bvh;
+}
+
+static bool bvh_contains_vec3(const mesh_t *mesh, const double pos[3])
+{
+    const mesh_bvh_t *bvh = mesh->bvh;
+    const bvh_node_t *node;
+    int stack[BVH_STACK_SIZE], size = 0, i;
+
+    stack[size++] = 0;
+    while (size) {
+        node = &bvh->nodes[stack[--size]];
+        if (vec3_dot(node->cap, pos) < node->cap[3]) continue;
+        if (node->count) {
+            for (i = node->start; i < node->start + node->count; i++) {
+                if (triangle_contains_vec3(mesh->vertices,
+                            mesh->triangles + bvh->tris[i] * 3, pos))
+                    return true;
+            }
+            continue;
+        }
+        assert(size + 2 <= BVH_STACK_SIZE);
+        stack[size++] = node->child + 1;
+        stack[size++] = node->child;
+    }
+    return false;
+}
+
 /*
  * Function: mesh_contains_vec3
  * Test if a 3d direction vector intersects a 3d mesh.
@@ -211,6 +428,7 @@ bool mesh_contains_vec3(const mesh_t *mesh, const double pos[3])
     int i;
     if (!cap_contains_vec3(mesh->bounding_cap, pos))
         return false;
+    if (mesh->bvh) return bvh_contains_vec3(mesh, pos);
     for (i = 0; i < mesh->triangles_count; i += 3) {
         if (triangle_contains_vec3(mesh->vertices, mesh->triangles + i, pos))
             return true;
@@ -220,9 +438,11 @@ bool mesh_contains_vec3(const mesh_t *mesh, const double pos[3])
 
 static void mesh_add_triangle(mesh_t *mesh, int a, int b, int c)
 {
-    mesh->triangles = realloc(mesh->triangles,
-                                (mesh->triangles_count + 3) *
-                                sizeof(*mesh->triangles));
+    mesh_release_index(mesh);
+    mesh->triangles = array_reserve(mesh->triangles,
+                                    &mesh->triangles_capacity,
+                                    mesh->triangles_count + 3,
+                                    sizeof(*mesh->triangles));
     mesh->triangles[mesh->triangles_count + 0] = a;
     mesh->triangles[mesh->triangles_count + 1] = b;
     mesh->triangles[mesh->triangles_count + 2] = c;
@@ -260,7 +480,7 @@ static void mesh_cut_triangle_antimeridian(mesh_t *mesh, int idx)
     vec3_mix(vs[a], ac, 0.99, new_points[2]); // AC1
     vec3_mix(vs[c], ac, 0.99, new_points[3]); // AC2
 
-    ofs = mesh_add_vertices(mesh, 4, new_points);
+    ofs = mesh_add_vertices_(mesh, 4, (const double (*)[3])new_points);
     ab1 = ofs + 0;
     ab2 = ofs + 1;
     ac1 = ofs + 2;
@@ -281,11 +501,15 @@ static void mesh_cut_triangle_antimeridian(mesh_t *mesh, int idx)
  */
 void mesh_cut_antimeridian(mesh_t *mesh)
 {
-    int i, count;
+    int i, count, vertices_count = mesh->vertices_count;
+    mesh_release_index(mesh);
     count = mesh->triangles_count;
     for (i = 0; i < count; i += 3) {
         mesh_cut_triangle_antimeridian(mesh, i);
     }
+    if (mesh->vertices_count != vertices_count)
+        compute_bounding_cap(mesh->vertices_count, mesh->vertices,
+                             mesh->bounding_cap);
 }
 
 static void mesh_subdivide_edge(mesh_t *mesh, int e1, int e2)
@@ -297,7 +521,7 @@ static void mesh_subdivide_edge(mesh_t *mesh, int e1, int e2)
     vs = mesh->vertices;
     vec3_mix(vs[e1], vs[e2], 0.5, new_point);
     // vec3_normalize(new_point, new_point);
-    o = mesh_add_vertices(mesh, 1, &new_point);
+    o = mesh_add_vertices_(mesh, 1, (const double (*)[3])&new_point);
 
     count = mesh->triangles_count;
     for (i = 0; i < count; i += 3) {
@@ -349,8 +573,128 @@ static void mesh_subdivide_triangle(mesh_t *mesh, int idx, double max_length)
  */
 void mesh_subdivide(mesh_t *mesh, double max_length)
 {
-    int i;
+    int i, vertices_count = mesh->vertices_count;
+    mesh_release_index(mesh);
     for (i = 0; i < mesh->triangles_count; i += 3) {
         mesh_subdivide_triangle(mesh, i, max_length);
     }
+    if (mesh->vertices_count != vertices_count)
+        compute_bounding_cap(mesh->vertices_count, mesh->vertices,
+                             mesh->bounding_cap);
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+// Create a star shaped polygon around (ra, dec), in degrees.
+static mesh_t *test_create_star_mesh(int n, double ra, double dec,
+                                     double size)
+{
+    int i, ofs;
+    double (*verts)[2] = calloc(n, sizeof(*verts));
+    mesh_t *mesh = mesh_create();
+    for (i = 0; i < n; i++) {
+        verts[i][0] = ra + size * (i % 2 ? 1 : 0.4) * cos(i * 2 * M_PI / n);
+        verts[i][1] = dec + size * (i % 2 ? 1 : 0.4) * sin(i * 2 * M_PI / n);
+    }
+    ofs = mesh_add_vertices_lonlat(mesh, n, verts);
+    mesh_add_poly(mesh, 1, ofs, &n);
+    mesh_subdivide(mesh, M_PI / 64);
+    free(verts);
+    return mesh;
+}
+
+static void test_mesh_bvh(void)
+{
+    const int n = 20000;
+    int i, pass, nb_in = 0;
+    double p[3];
+    bool *ret = calloc(n, sizeof(*ret));
+    mesh_t *mesh = test_create_star_mesh(200, 30, 20, 15);
+
+    assert(mesh->triangles_count / 3 > 200);
+    // Compare the index results against the linear scan.
+    for (pass = 0; pass < 2; pass++) {
+        if (pass == 1) mesh_build_index(mesh);
+        for (i = 0; i < n; i++) {
+            lonlat2c(VEC(15 + 30.0 * (i % 141) / 141,
+                         5 + 30.0 * (i / 141) / 141), p);
+            if (pass == 0) {
+                ret[i] = mesh_contains_vec3(mesh, p);
+                nb_in += ret[i];
+            } else {
+                assert(mesh_contains_vec3(mesh, p) == ret[i]);
+            }
+        }
+    }
+    assert(mesh->bvh);
+    assert(nb_in > 1000);
+    free(ret);
+    mesh_delete(mesh);
+}
+
+TEST_REGISTER(NULL, test_mesh_bvh, TEST_AUTO);
+
+// Polygon with more vertices than a 16 bits index can address.
+static void test_mesh_large(void)
+{
+    const int n = 70000;
+    int i, ofs, max_idx = 0;
+    double (*verts)[2] = calloc(n, sizeof(*verts));
+    double p[3];
+    mesh_t *mesh = mesh_create();
+
+    for (i = 0; i < n; i++) {
+        verts[i][0] = 30 + 10 * cos(i * 2 * M_PI / n);
+        verts[i][1] = 20 + 10 * sin(i * 2 * M_PI / n);
+    }
+    ofs = mesh_add_vertices_lonlat(mesh, n, verts);
+    mesh_add_poly(mesh, 1, ofs, &n);
+    mesh_add_line(mesh, ofs, n);
+    assert(mesh->triangles_count == (n - 2) * 3);
+    assert(mesh->triangles_capacity >= mesh->triangles_count);
+    assert(mesh->lines_count == (n - 1) * 2);
+    for (i = 0; i < mesh->triangles_count; i++) {
+        assert(mesh->triangles[i] < n);
+        max_idx = max(max_idx, mesh->triangles[i]);
+    }
+    assert(max_idx == n - 1);
+    assert(mesh->lines[mesh->lines_count - 1] == n - 1);
+
+    lonlat2c(VEC(30, 20), p);
+    assert(mesh_contains_vec3(mesh, p));
+    lonlat2c(VEC(30, 35), p);
+    assert(!mesh_contains_vec3(mesh, p));
+    free(verts);
+    mesh_delete(mesh);
 }
+
+TEST_REGISTER(NULL, test_mesh_large, TEST_AUTO);
+
+static mesh_t *g_bench_mesh;
+
+static void bench_mesh_setup(void)
+{
+    if (g_bench_mesh) return;
+    g_bench_mesh = test_create_star_mesh(2000, 30, 20, 15);
+    mesh_build_index(g_bench_mesh);
+}
+
+static int bench_mesh_contains(void)
+{
+    int i;
+    double p[3];
+    for (i = 0; i < 1000; i++) {
+        lonlat2c(VEC(15 + 30.0 * (i % 31) / 31, 5 + 30.0 * (i / 31) / 31),
+                 p);
+        bench_keep(mesh_contains_vec3(g_bench_mesh, p));
+    }
+    return 1000;
+}
+
+BENCH_REGISTER(bench_mesh_setup, bench_mesh_contains)
+
+#endif
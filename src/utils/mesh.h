@@ -16,17 +16,26 @@
 /*
  * Struct: mesh_t
  * Represents a 3d triangle mesh, as used by geojson.
+ *
+ * The indices are 32 bits, so a single mesh can have any number of
+ * vertices.  The arrays grow geometrically, the *_capacity attributes give
+ * their allocated sizes.
  */
 typedef struct mesh mesh_t;
+typedef struct mesh_bvh mesh_bvh_t;
 struct mesh {
     mesh_t      *next, *prev; // Can be used to put mesh inside geojson.
     double      bounding_cap[4];
     int         vertices_count;
+    int         vertices_capacity;
     double      (*vertices)[3];
     int         triangles_count; // Number of triangles * 3.
-    uint16_t    *triangles;
+    int         triangles_capacity;
+    uint32_t    *triangles;
     int         lines_count; // Number of lines * 2.
-    uint16_t    *lines;
+    int         lines_capacity;
+    uint32_t    *lines;
+    mesh_bvh_t  *bvh; // Triangles index, see <mesh_build_index>.
 };
 
 mesh_t *mesh_create(void);
@@ -38,6 +47,17 @@ int mesh_add_vertices_lonlat(mesh_t *mesh, int count, double (*verts)[2]);
 void mesh_add_line(mesh_t *mesh, int ofs, int size);
 void mesh_add_poly(mesh_t *mesh, int nb_rings, const int ofs, const int *size);
 
+/*
+ * Function: mesh_build_index
+ * Build a bounding volume hierarchy of the mesh triangles.
+ *
+ * Once built, <mesh_contains_vec3> only tests the few triangles whose
+ * bounding caps contain the point.  The index is released by any function
+ * that modifies the mesh, so this should be called once the mesh is
+ * complete.
+ */
+void mesh_build_index(mesh_t *mesh);
+
 /*
  * Function: mesh_contains_vec3
  * Test if a 3d direction vector intersects a 3d mesh.
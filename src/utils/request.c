@@ -387,4 +387,9 @@ void request_make_fresh(request_t *req)
     req->etag = NULL;
 }
 
+const char *request_get_etag(request_t *req)
+{
+    return req->etag;
+}
+
 #endif // NO_LIBCURL
@@ -16,3 +16,5 @@ void request_delete(request_t *req);
 const void *request_get_data(request_t *req, int *size, int *status_code);
 // Don't use cache even if we have a local copy.
 void request_make_fresh(request_t *req);
+// Return the ETag of the resource if we know it, or NULL.
+const char *request_get_etag(request_t *req);
@@ -138,4 +138,10 @@ void request_make_fresh(request_t *req)
 {
 }
 
+const char *request_get_etag(request_t *req)
+{
+    // The browser takes care of the http cache for us.
+    return NULL;
+}
+
 #endif
@@ -15,6 +15,9 @@
 #include <stdio.h>
 
 #include "webp/decode.h"
+#ifdef HAVE_WEBP_ENCODER
+#   include "webp/encode.h"
+#endif
 #include <zlib.h>
 
 #ifdef __GNUC__
@@ -91,6 +94,53 @@ void img_write(const uint8_t *img, int w, int h, int bpp, const char *path)
     stbi_write_png(path, w, h, bpp, img, 0);
 }
 
+static void img_encode_write(void *user, void *data, int size)
+{
+    UT_string *buf = user;
+    utstring_bincpy(buf, data, size);
+}
+
+void *img_encode(const uint8_t *img, int w, int h, int bpp,
+                 const char *format, int quality, int *size)
+{
+    UT_string buf;
+    uint8_t *ret = NULL;
+
+    if (strcmp(format, "png") == 0) {
+        utstring_init(&buf);
+        if (stbi_write_png_to_func(img_encode_write, &buf, w, h, bpp,
+                                   img, 0)) {
+            *size = utstring_len(&buf);
+            ret = malloc(*size);
+            memcpy(ret, utstring_body(&buf), *size);
+        }
+        utstring_done(&buf);
+        return ret;
+    }
+
+#ifdef HAVE_WEBP_ENCODER
+    if (strcmp(format, "webp") == 0 && bpp == 4) {
+        if (quality <= 0)
+            *size = WebPEncodeLosslessRGBA(img, w, h, w * 4, &ret);
+        else
+            *size = WebPEncodeRGBA(img, w, h, w * 4, quality, &ret);
+        if (!*size) {
+            WebPFree(ret);
+            return NULL;
+        }
+        // Copy the data so that the caller can always use free.
+        img = ret;
+        ret = malloc(*size);
+        memcpy(ret, img, *size);
+        WebPFree((void*)img);
+        return ret;
+    }
+#endif
+
+    LOG_E("Unsupported image format: %s (bpp %d)", format, bpp);
+    return NULL;
+}
+
 int z_uncompress(void *dest, int dest_size, const void *src, int src_size)
 {
     stbi_zlib_decode_buffer(dest, dest_size, src, src_size);
@@ -21,10 +21,60 @@ static struct {
                      int *w, int *h, int *bpp);
 } g_callback = {};
 
-static inline bool is_pow2(int n) {return (n & (n - 1)) == 0;}
+// In headless mode we don't create any OpenGL texture, but still give
+// each texture a unique non zero id so that it is considered loaded.
+static struct {
+    bool        enabled;
+    uint32_t    last_id;
+} g_headless = {};
+
+static bool g_keep_data = false;
+
+// Total memory used by all the textures, in bytes.
+static int64_t g_total_mem_size = 0;
+
 static inline int next_pow2(int x) {return pow(2, ceil(log(x) / log(2)));}
 
 
+/*
+ * Check if we can use a non power of two size for a texture.
+ *
+ * OpenGL ES 2 and WebGL 1 only support it for textures without mipmaps and
+ * with a clamp to edge wrap mode (that we always use).
+ */
+static bool npot_supported(const texture_t *tex)
+{
+#ifdef GLES2
+    return !(tex->flags & TF_MIPMAP);
+#else
+    return true;
+#endif
+}
+
+static void set_size(texture_t *tex, int w, int h)
+{
+    tex->w = w;
+    tex->h = h;
+    tex->tex_w = npot_supported(tex) ? w : next_pow2(w);
+    tex->tex_h = npot_supported(tex) ? h : next_pow2(h);
+}
+
+// Compute the memory used by the texture data, including the mipmaps.
+static void update_mem_size(texture_t *tex, int bpp)
+{
+    int w = tex->tex_w, h = tex->tex_h, size = w * h * bpp;
+    if (tex->flags & TF_MIPMAP) {
+        while (w > 1 || h > 1) {
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+            size += w * h * bpp;
+        }
+    }
+    __atomic_add_fetch(&g_total_mem_size, size - tex->mem_size,
+                       __ATOMIC_RELAXED);
+    tex->mem_size = size;
+}
+
 static void blit(const uint8_t *src, int src_w, int src_h, int bpp,
                  uint8_t *dst, int dst_w, int dst_h,
                  int x, int y, int w, int h)
@@ -46,26 +96,54 @@ void texture_set_load_callback(void *user,
     g_callback.load = load;
 }
 
+void texture_set_headless(bool headless)
+{
+    g_headless.enabled = headless;
+}
+
+void texture_set_keep_data(bool keep)
+{
+    g_keep_data = keep;
+}
+
+static void gen_texture(texture_t *tex)
+{
+    if (g_headless.enabled) {
+        tex->id = __atomic_add_fetch(&g_headless.last_id, 1,
+                                     __ATOMIC_RELAXED);
+        return;
+    }
+    GL(glGenTextures(1, &tex->id));
+}
+
 void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp)
 {
     uint8_t *buff0 = NULL;
     int data_type = GL_UNSIGNED_BYTE;
     assert(tex->id);
 
-    tex->w = w;
-    tex->h = h;
-    tex->tex_w = next_pow2(w);
-    tex->tex_h = next_pow2(h);
+    set_size(tex, w, h);
     tex->format = (int[]){
         0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA
     }[bpp];
     assert(tex->format);
+    update_mem_size(tex, bpp);
+    if (g_keep_data) {
+        free(tex->data);
+        tex->data = malloc(w * h * bpp);
+        memcpy(tex->data, data, w * h * bpp);
+        tex->bpp = bpp;
+    }
+    if (g_headless.enabled) return;
 
-    if (!is_pow2(w) || !is_pow2(h)) {
+    if (tex->tex_w != w || tex->tex_h != h) {
         buff0 = calloc(bpp, tex->tex_w * tex->tex_h);
         blit(data, w, h, bpp, buff0, tex->tex_w, tex->tex_h, 0, 0, w, h);
         data = buff0;
     }
+    // The rows of non power of two images are not always 4 bytes aligned.
+    if ((tex->tex_w * bpp) % 4)
+        GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
     GL(glActiveTexture(GL_TEXTURE0));
     GL(glBindTexture(GL_TEXTURE_2D, tex->id));
     GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
@@ -76,6 +154,8 @@ void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp)
     GL(glTexImage2D(GL_TEXTURE_2D, 0, tex->format, tex->tex_w, tex->tex_h,
                 0, tex->format, data_type, data));
     free(buff0);
+    if ((tex->tex_w * bpp) % 4)
+        GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
 
     if (tex->flags & TF_MIPMAP)
         GL(glGenerateMipmap(GL_TEXTURE_2D));
@@ -86,12 +166,9 @@ texture_t *texture_create(int w, int h, int bpp)
     texture_t *tex;
     tex = calloc(1, sizeof(*tex));
     tex->ref = 1;
-    tex->tex_w = next_pow2(w);
-    tex->tex_h = next_pow2(h);
-    tex->w = w;
-    tex->h = h;
+    set_size(tex, w, h);
     tex->format = (int[]){0, 0, 0, GL_RGB, GL_RGBA}[bpp];
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(tex);
     return tex;
 }
 
@@ -101,10 +178,17 @@ void texture_release(texture_t *tex)
     tex->ref--;
     if (tex->ref) return;
     free(tex->url);
-    GL(glDeleteTextures(1, &tex->id));
+    free(tex->data);
+    __atomic_sub_fetch(&g_total_mem_size, tex->mem_size, __ATOMIC_RELAXED);
+    if (!g_headless.enabled) GL(glDeleteTextures(1, &tex->id));
     free(tex);
 }
 
+int64_t texture_get_total_mem_size(void)
+{
+    return __atomic_load_n(&g_total_mem_size, __ATOMIC_RELAXED);
+}
+
 texture_t *texture_from_data(const void *data, int img_w, int img_h, int bpp,
                              int x, int y, int w, int h, int flags)
 {
@@ -115,7 +199,7 @@ texture_t *texture_from_data(const void *data, int img_w, int img_h, int bpp,
     tex = calloc(1, sizeof(*tex));
     tex->ref = 1;
     tex->flags = flags;
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(tex);
 
     if (x != 0 || y != 0 || w != img_w || h != img_h) {
         img = calloc(w * h, bpp);
@@ -149,8 +233,44 @@ bool texture_load(texture_t *tex, int *code)
     assert(g_callback.load);
     img = g_callback.load(g_callback.user, tex->url, code, &w, &h, &bpp);
     if (!img) return false;
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(tex);
     texture_set_data(tex, img, w, h, bpp);
     free(img);
     return true;
 }
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+static void test_texture_mem_size(void)
+{
+    const bool headless = g_headless.enabled;
+    const int64_t total = texture_get_total_mem_size();
+    uint8_t *img = calloc(300 * 200, 4);
+    texture_t *tex, *tex2;
+
+    g_headless.enabled = true;
+    tex = texture_from_data(img, 300, 200, 3, 0, 0, 300, 200, 0);
+    assert(tex->mem_size == tex->tex_w * tex->tex_h * 3);
+#ifndef GLES2
+    assert(tex->tex_w == 300 && tex->tex_h == 200);
+#endif
+    // Mipmaps use one third more memory.
+    tex2 = texture_from_data(img, 300, 200, 4, 0, 0, 256, 128, TF_MIPMAP);
+    assert(tex2->mem_size == 4 * (256 * 128 + 128 * 64 + 64 * 32 + 32 * 16 +
+                                  16 * 8 + 8 * 4 + 4 * 2 + 2 * 1 + 1 * 1));
+    assert(texture_get_total_mem_size() ==
+           total + tex->mem_size + tex2->mem_size);
+    texture_release(tex);
+    texture_release(tex2);
+    assert(texture_get_total_mem_size() == total);
+    g_headless.enabled = headless;
+    free(img);
+}
+
+TEST_REGISTER(NULL, test_texture_mem_size, TEST_AUTO);
+
+#endif
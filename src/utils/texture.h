@@ -30,11 +30,17 @@ enum {
  *   ref    - For ref counting.
  *   w      - Width of the texture.
  *   h      - Height of the texture.
- *   tex_w  - Internal width of the texture.
+ *   tex_w  - Internal width of the texture, different from w only if the
+ *            data had to be padded to a power of two size.
  *   tex_h  - Internal height of the texture.
  *   format - OpenGL format.
  *   flags  - Configuration bit flags
  *   url    - For async texture: url source of the image.
+ *   data   - CPU copy of the pixels, only set if <texture_set_keep_data>
+ *            has been enabled.
+ *   bpp    - Bytes per pixel of the CPU copy.
+ *   mem_size - Memory used by the texture on the GPU, in bytes, including
+ *            the padding and the mipmaps.  Also computed in headless mode.
  */
 typedef struct texture {
     uint32_t        id;
@@ -43,6 +49,9 @@ typedef struct texture {
     int             format;
     int             flags;
     char            *url;
+    uint8_t         *data;
+    int             bpp;
+    int             mem_size;
 } texture_t;
 
 /*
@@ -63,6 +72,25 @@ void texture_set_load_callback(void *user,
         uint8_t *(*load)(void *user, const char *url, int *code,
                          int *w, int *h, int *bpp));
 
+/*
+ * Function: texture_set_headless
+ * Disable all the OpenGL calls, for rendering without a GL context.
+ *
+ * In headless mode the textures keep their size and flags, and get a fake
+ * id, but no data is uploaded.  Should be called before creating any
+ * texture.
+ */
+void texture_set_headless(bool headless);
+
+/*
+ * Function: texture_set_keep_data
+ * Keep a CPU copy of the pixels of all the new textures.
+ *
+ * This is needed by the software renderer, that samples the textures
+ * directly from the <texture_t> data attribute.
+ */
+void texture_set_keep_data(bool keep);
+
 texture_t *texture_create(int w, int h, int bpp);
 texture_t *texture_from_data(const void *data, int img_w, int img_h, int bpp,
                              int x, int y, int w, int h, int flags);
@@ -70,3 +98,11 @@ texture_t *texture_from_url(const char *url, int flags);
 bool texture_load(texture_t *tex, int *code);
 void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp);
 void texture_release(texture_t *tex);
+
+/*
+ * Function: texture_get_total_mem_size
+ * Return the memory used by all the textures, in bytes.
+ *
+ * See the texture_t mem_size attribute.
+ */
+int64_t texture_get_total_mem_size(void);
@@ -114,6 +114,30 @@ uint8_t *img_read_from_mem(const void *data, int size,
  */
 void img_write(const uint8_t *img, int w, int h, int bpp, const char *path);
 
+/*
+ * Function: img_encode
+ * Encode an image into a png or webp buffer.
+ *
+ * The webp format is only available if the engine has been compiled with
+ * the webp encoder (HAVE_WEBP_ENCODER), and only for RGBA images.
+ *
+ * Parameters:
+ *   img     - The image pixels.
+ *   w       - Width of the image.
+ *   h       - Height of the image.
+ *   bpp     - Bytes per pixel of the image.
+ *   format  - 'png' or 'webp'.
+ *   quality - Webp quality from 1 to 100, or 0 for lossless encoding.
+ *             Ignored for png.
+ *   size    - Get the size of the returned buffer.
+ *
+ * Return:
+ *   A newly allocated buffer that the caller should free, or NULL in case
+ *   of error.
+ */
+void *img_encode(const uint8_t *img, int w, int h, int bpp,
+                 const char *format, int quality, int *size);
+
 /*
  * Function: z_uncompress
  * Like zlib uncompress, but using stb instead.
@@ -8,9 +8,12 @@
  */
 
 #include "worker.h"
+#include "profiler.h"
 #include "uthash.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 enum {
@@ -21,6 +24,12 @@ enum {
 // How many threads in the pool
 #define THREADS_COUNT 2
 
+static int run_worker(worker_t *w)
+{
+    PROFILE(worker, 0);
+    return w->fn(w);
+}
+
 #ifdef HAVE_PTHREAD
 
 #include <pthread.h>
@@ -49,7 +58,10 @@ static void *thread_func(void *args)
     worker_t *w;
     thread_t *thread = (thread_t*)args;
     int r;
+    char name[32];
 
+    snprintf(name, sizeof(name), "worker %d", (int)(thread - g.threads));
+    profile_set_thread_name(name);
     thread->ready = true;
     while (true) {
         pthread_mutex_lock(&g.rlock);
@@ -64,7 +76,7 @@ static void *thread_func(void *args)
         g.waiting_worker = NULL;
         pthread_mutex_unlock(&g.rlock);
 
-        r = w->fn(w);
+        r = run_worker(w);
 
         pthread_mutex_lock(&g.rlock);
         w->ret = r;
@@ -137,7 +149,7 @@ void worker_init(worker_t *w, int (*fn)(worker_t *w))
 int worker_iter(worker_t *w)
 {
     if (w->state) return 1;
-    w->fn(w);
+    run_worker(w);
     w->state = 1;
     return 1;
 }
@@ -148,3 +160,148 @@ bool worker_is_running(worker_t *w)
 }
 
 #endif
+
+/******** Parallel for ****************************************************/
+
+#ifdef HAVE_PTHREAD
+
+#include <unistd.h>
+
+// Max number of threads used by worker_parallel_for.
+#define PARALLEL_MAX_THREADS 16
+
+static struct {
+    pthread_t       threads[PARALLEL_MAX_THREADS];
+    int             nb_threads;
+    bool            initialized;
+    pthread_mutex_t lock;
+    pthread_cond_t  start_cond;
+    pthread_cond_t  done_cond;
+    int             generation; // Incremented at each call.
+    int             running;    // Number of threads still working.
+    void            (*fn)(void *user, int i);
+    void            *user;
+    int             n;
+    int             next;       // Next index to run (atomic).
+} g_parallel = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void parallel_run(void)
+{
+    int i;
+    while (true) {
+        i = __atomic_fetch_add(&g_parallel.next, 1, __ATOMIC_RELAXED);
+        if (i >= g_parallel.n) break;
+        g_parallel.fn(g_parallel.user, i);
+    }
+}
+
+static void *parallel_thread_func(void *args)
+{
+    int generation = 0;
+    char name[32];
+
+    snprintf(name, sizeof(name), "parallel %d", (int)(intptr_t)args);
+    profile_set_thread_name(name);
+    pthread_mutex_lock(&g_parallel.lock);
+    while (true) {
+        while (g_parallel.generation == generation)
+            pthread_cond_wait(&g_parallel.start_cond, &g_parallel.lock);
+        generation = g_parallel.generation;
+        pthread_mutex_unlock(&g_parallel.lock);
+        parallel_run();
+        pthread_mutex_lock(&g_parallel.lock);
+        if (--g_parallel.running == 0)
+            pthread_cond_signal(&g_parallel.done_cond);
+    }
+    return NULL;
+}
+
+static void parallel_init(void)
+{
+    int i, nb = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    g_parallel.nb_threads = nb < 0 ? 0 :
+                            nb > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS :
+                            nb;
+    for (i = 0; i < g_parallel.nb_threads; i++) {
+        pthread_create(&g_parallel.threads[i], NULL, parallel_thread_func,
+                       (void*)(intptr_t)i);
+    }
+    g_parallel.initialized = true;
+}
+
+int worker_parallel_threads(void)
+{
+    if (!g_parallel.initialized) parallel_init();
+    return g_parallel.nb_threads;
+}
+
+void worker_parallel_for(int n, void (*fn)(void *user, int i), void *user)
+{
+    int i;
+    if (!g_parallel.initialized) parallel_init();
+    if (n <= 1 || !g_parallel.nb_threads) {
+        for (i = 0; i < n; i++) fn(user, i);
+        return;
+    }
+    pthread_mutex_lock(&g_parallel.lock);
+    g_parallel.fn = fn;
+    g_parallel.user = user;
+    g_parallel.n = n;
+    g_parallel.next = 0;
+    g_parallel.running = g_parallel.nb_threads;
+    g_parallel.generation++;
+    pthread_cond_broadcast(&g_parallel.start_cond);
+    pthread_mutex_unlock(&g_parallel.lock);
+
+    parallel_run();
+
+    pthread_mutex_lock(&g_parallel.lock);
+    while (g_parallel.running)
+        pthread_cond_wait(&g_parallel.done_cond, &g_parallel.lock);
+    pthread_mutex_unlock(&g_parallel.lock);
+}
+
+#else
+
+int worker_parallel_threads(void)
+{
+    return 0;
+}
+
+void worker_parallel_for(int n, void (*fn)(void *user, int i), void *user)
+{
+    int i;
+    for (i = 0; i < n; i++) fn(user, i);
+}
+
+#endif
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+#include <assert.h>
+
+static void test_parallel_fn(void *user, int i)
+{
+    int *values = user;
+    values[i] = i * i;
+}
+
+static void test_parallel_for(void)
+{
+    int i, values[100] = {};
+    worker_parallel_for(100, test_parallel_fn, values);
+    for (i = 0; i < 100; i++) assert(values[i] == i * i);
+    worker_parallel_for(0, test_parallel_fn, values);
+}
+
+TEST_REGISTER(NULL, test_parallel_for, TEST_AUTO);
+
+#endif
@@ -55,3 +55,27 @@ int worker_iter(worker_t *worker);
  * Return whether a worker is currently running.
  */
 bool worker_is_running(worker_t *worker);
+
+/*
+ * Function: worker_parallel_for
+ * Call a function for all the indices from 0 to n - 1 in parallel, and
+ * wait until all the calls are done.
+ *
+ * The calls are spread over a pool of threads, one per CPU core, and the
+ * calling thread also runs some of them.  Without thread support the calls
+ * are made in order from the calling thread.  This cannot be called from
+ * inside one of the calls.
+ *
+ * Parameters:
+ *   n      - Number of calls.
+ *   fn     - Function called with each index.
+ *   user   - Data passed to the function.
+ */
+void worker_parallel_for(int n, void (*fn)(void *user, int i), void *user);
+
+/*
+ * Function: worker_parallel_threads
+ * Return the number of threads used by <worker_parallel_for> in addition
+ * to the calling thread.
+ */
+int worker_parallel_threads(void);